@@ -0,0 +1,320 @@
+/*
+* CPU frame profiler
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanCpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	namespace
+	{
+		uint64_t getClockNanoseconds()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		std::string escapeJson(const std::string& text)
+		{
+			std::string escaped;
+			for (char c : text) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		// Zones with the same name get the same color in the flame graph
+		ImU32 getZoneColor(const char* name)
+		{
+			uint32_t hash = 2166136261u;
+			for (const char* c = name; *c != '\0'; c++) {
+				hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+			}
+			return ImColor::HSV(static_cast<float>(hash % 360) / 360.0f, 0.6f, 0.7f);
+		}
+	}
+
+	CpuProfiler::CpuProfiler()
+	{
+		startTime = getClockNanoseconds();
+	}
+
+	CpuProfiler& CpuProfiler::get()
+	{
+		static CpuProfiler profiler;
+		return profiler;
+	}
+
+	uint64_t CpuProfiler::now() const
+	{
+		return getClockNanoseconds() - startTime;
+	}
+
+	struct CpuProfiler::ThreadBufferOwner {
+		ThreadBuffer* buffer = nullptr;
+		~ThreadBufferOwner()
+		{
+			if (buffer != nullptr) {
+				CpuProfiler::get().releaseThreadBuffer(buffer);
+			}
+		}
+	};
+
+	CpuProfiler::ThreadBuffer* CpuProfiler::getThreadBuffer()
+	{
+		// Each thread acquires its buffer once, after that recording never takes a lock
+		static thread_local ThreadBufferOwner owner;
+		if (owner.buffer == nullptr) {
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			if (!freeThreads.empty()) {
+				// Zones the previous owner recorded before exiting are still collected by endFrame, the new thread appends after them
+				owner.buffer = freeThreads.back();
+				freeThreads.pop_back();
+			}
+			else {
+				threads.emplace_back(new ThreadBuffer());
+				owner.buffer = threads.back().get();
+				owner.buffer->index = static_cast<uint32_t>(threads.size() - 1);
+			}
+			owner.buffer->depth = 0;
+			owner.buffer->name = "Thread " + std::to_string(owner.buffer->index);
+		}
+		return owner.buffer;
+	}
+
+	void CpuProfiler::releaseThreadBuffer(ThreadBuffer* buffer)
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		freeThreads.push_back(buffer);
+	}
+
+	void CpuProfiler::beginZone()
+	{
+		getThreadBuffer()->depth++;
+	}
+
+	void CpuProfiler::endZone(const char* name, uint64_t begin)
+	{
+		ThreadBuffer* buffer = getThreadBuffer();
+		buffer->depth--;
+		if (!enabled.load(std::memory_order_relaxed)) {
+			return;
+		}
+		const uint64_t end = now();
+		const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+		if (head - buffer->tail.load(std::memory_order_acquire) >= ThreadBuffer::capacity) {
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Event& event = buffer->events[head % ThreadBuffer::capacity];
+		event.name = name;
+		event.begin = begin;
+		event.end = end;
+		event.depth = buffer->depth;
+		event.thread = buffer->index;
+		// Publishes the event to endFrame
+		buffer->head.store(head + 1, std::memory_order_release);
+	}
+
+	void CpuProfiler::setThreadName(const std::string& name)
+	{
+		ThreadBuffer* buffer = getThreadBuffer();
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		buffer->name = name;
+	}
+
+	void CpuProfiler::endFrame()
+	{
+		const uint64_t frameEnd = now();
+		const uint32_t frameThread = getThreadBuffer()->index;
+
+		FrameResult result;
+		result.frame = ++frameCounter;
+		result.begin = frameBegin;
+		result.end = frameEnd;
+		result.events.reserve(latestResult.events.size());
+		{
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			for (auto& buffer : threads) {
+				const uint64_t head = buffer->head.load(std::memory_order_acquire);
+				const uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+				for (uint64_t i = tail; i < head; i++) {
+					result.events.push_back(buffer->events[i % ThreadBuffer::capacity]);
+				}
+				// Hands the slots back to the recording thread
+				buffer->tail.store(head, std::memory_order_release);
+				result.threadNames.push_back(buffer->name);
+			}
+		}
+		frameBegin = frameEnd;
+
+		if (captureFramesLeft > 0) {
+			const Event frameEvent = { "Frame", result.begin, result.end, 0, frameThread };
+			traceEvents.push_back({ frameEvent, result.frame });
+			for (auto& event : result.events) {
+				traceEvents.push_back({ event, result.frame });
+			}
+			captureFramesLeft--;
+			if (captureFramesLeft == 0) {
+				if (saveChromeTrace(captureFilename)) {
+					std::cout << "CPU profiler: Saved trace to \"" << captureFilename << "\"" << std::endl;
+				}
+				else {
+					std::cerr << "CPU profiler: Could not write trace to \"" << captureFilename << "\"" << std::endl;
+				}
+				traceEvents.clear();
+			}
+		}
+
+		latestResult = std::move(result);
+	}
+
+	const CpuProfiler::FrameResult& CpuProfiler::getLatestResult() const
+	{
+		return latestResult;
+	}
+
+	uint64_t CpuProfiler::getDroppedCount()
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		uint64_t dropped = 0;
+		for (auto& buffer : threads) {
+			dropped += buffer->dropped.load(std::memory_order_relaxed);
+		}
+		return dropped;
+	}
+
+	void CpuProfiler::captureTrace(const std::string& filename, uint32_t frameCount)
+	{
+		captureFilename = filename;
+		captureFramesLeft = frameCount;
+		traceEvents.clear();
+	}
+
+	bool CpuProfiler::isCapturing() const
+	{
+		return captureFramesLeft > 0;
+	}
+
+	bool CpuProfiler::saveChromeTrace(const std::string& filename)
+	{
+		if (traceEvents.empty()) {
+			return false;
+		}
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			return false;
+		}
+		uint64_t captureStart = traceEvents.front().event.begin;
+		for (auto& traceEvent : traceEvents) {
+			captureStart = std::min(captureStart, traceEvent.event.begin);
+		}
+		// Complete events ("ph": "X") with microsecond timestamps, one track per thread
+		std::stringstream ss;
+		ss.precision(3);
+		ss << std::fixed;
+		ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		{
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			for (auto& buffer : threads) {
+				ss << (buffer->index > 0 ? "," : "") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->index << ",\"args\":{\"name\":\"" << escapeJson(buffer->name) << "\"}}";
+			}
+		}
+		for (auto& traceEvent : traceEvents) {
+			const Event& event = traceEvent.event;
+			ss << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread;
+			ss << ",\"ts\":" << (event.begin - captureStart) / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0;
+			ss << ",\"args\":{\"frame\":" << traceEvent.frame << "}}";
+		}
+		ss << "\n]}\n";
+		file << ss.str();
+		return file.good();
+	}
+
+	void CpuProfiler::onUpdateUIOverlay(vks::UIOverlay* overlay)
+	{
+		const FrameResult& frame = latestResult;
+		if ((frame.frame == 0) || (frame.end <= frame.begin)) {
+			overlay->text("Waiting for results");
+			return;
+		}
+		overlay->text("CPU frame: %.3f ms", (frame.end - frame.begin) / 1000000.0);
+
+		// Flame graph with one row per nesting level, threads without zones in this frame are skipped
+		std::vector<uint32_t> threadRows(frame.threadNames.size(), 0);
+		for (auto& event : frame.events) {
+			threadRows[event.thread] = std::max(threadRows[event.thread], event.depth + 1);
+		}
+		std::vector<uint32_t> threadOffsets(threadRows.size(), 0);
+		uint32_t rowCount = 0;
+		for (size_t i = 0; i < threadRows.size(); i++) {
+			threadOffsets[i] = rowCount;
+			rowCount += threadRows[i];
+		}
+		if (rowCount > 0) {
+			const float width = 300.0f * overlay->scale;
+			const float rowHeight = ImGui::GetTextLineHeight() + 2.0f * overlay->scale;
+			const ImVec2 origin = ImGui::GetCursorScreenPos();
+			const ImVec2 size = ImVec2(width, rowHeight * rowCount);
+			ImGui::InvisibleButton("##cpuprofilerflamegraph", size);
+			const bool hovered = ImGui::IsItemHovered();
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			drawList->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), ImGui::GetColorU32(ImGuiCol_FrameBg));
+			const double pixelsPerNanosecond = width / static_cast<double>(frame.end - frame.begin);
+			for (auto& event : frame.events) {
+				// Zones that started in an earlier frame are clipped to the start of this one
+				const uint64_t begin = std::max(event.begin, frame.begin);
+				float x0 = static_cast<float>((begin - frame.begin) * pixelsPerNanosecond);
+				float x1 = static_cast<float>((event.end - frame.begin) * pixelsPerNanosecond);
+				x1 = std::min(std::max(x1, x0 + 1.0f), width);
+				const float y = origin.y + (threadOffsets[event.thread] + event.depth) * rowHeight;
+				const ImVec2 min = ImVec2(origin.x + x0, y);
+				const ImVec2 max = ImVec2(origin.x + x1, y + rowHeight - 1.0f);
+				drawList->AddRectFilled(min, max, getZoneColor(event.name));
+				if (ImGui::CalcTextSize(event.name).x + 4.0f < x1 - x0) {
+					drawList->AddText(ImVec2(min.x + 2.0f, min.y + 1.0f), IM_COL32_WHITE, event.name);
+				}
+				if (hovered && ImGui::IsMouseHoveringRect(min, max)) {
+					ImGui::SetTooltip("%s (%s): %.3f ms", event.name, frame.threadNames[event.thread].c_str(), (event.end - event.begin) / 1000000.0);
+				}
+			}
+		}
+
+		// Most expensive zones of the frame summed up across all threads
+		std::map<std::string, std::pair<uint64_t, uint32_t>> totals;
+		for (auto& event : frame.events) {
+			auto& total = totals[event.name];
+			total.first += event.end - event.begin;
+			total.second++;
+		}
+		std::vector<std::pair<std::string, std::pair<uint64_t, uint32_t>>> sortedTotals(totals.begin(), totals.end());
+		std::sort(sortedTotals.begin(), sortedTotals.end(), [](const std::pair<std::string, std::pair<uint64_t, uint32_t>>& a, const std::pair<std::string, std::pair<uint64_t, uint32_t>>& b) {
+			return a.second.first > b.second.first;
+		});
+		const size_t maxListed = 8;
+		for (size_t i = 0; i < std::min(sortedTotals.size(), maxListed); i++) {
+			overlay->text("%s: %.3f ms (%u)", sortedTotals[i].first.c_str(), sortedTotals[i].second.first / 1000000.0, sortedTotals[i].second.second);
+		}
+
+		const uint64_t dropped = getDroppedCount();
+		if (dropped > 0) {
+			overlay->text("Dropped zones: %llu", static_cast<unsigned long long>(dropped));
+		}
+		if (!isCapturing() && overlay->button("Capture CPU trace")) {
+			captureTrace("cpu_trace.json", 60);
+		}
+	}
+}
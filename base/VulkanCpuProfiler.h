@@ -0,0 +1,156 @@
+/*
+* CPU frame profiler
+*
+* Records named zones on any thread into per-thread lock-free ring buffers, which are collected once per frame
+* The last frame can be displayed as a flame graph in the UI overlay and a number of frames can be exported as a
+* Chrome trace (load the file in chrome://tracing or https://ui.perfetto.dev)
+*
+* Zones are added with the VKS_PROFILE_ZONE macro, which compiles to nothing unless VKS_CPU_PROFILER is defined
+* (CMake option USE_CPU_PROFILER)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(VKS_CPU_PROFILER)
+#define VKS_PROFILE_CONCAT_INNER(a, b) a##b
+#define VKS_PROFILE_CONCAT(a, b) VKS_PROFILE_CONCAT_INNER(a, b)
+/** @brief Profiles the rest of the enclosing scope, name must be a string literal (or otherwise outlive the profiler) */
+#define VKS_PROFILE_ZONE(name) vks::CpuZone VKS_PROFILE_CONCAT(cpuProfilerZone, __LINE__)(name)
+/** @brief Names the calling thread in the trace and the overlay */
+#define VKS_PROFILE_THREAD(name) vks::CpuProfiler::get().setThreadName(name)
+/** @brief Collects the zones of all threads, call once per frame from the thread that renders */
+#define VKS_PROFILE_FRAME() vks::CpuProfiler::get().endFrame()
+#else
+#define VKS_PROFILE_ZONE(name)
+#define VKS_PROFILE_THREAD(name)
+#define VKS_PROFILE_FRAME()
+#endif
+
+namespace vks
+{
+	class UIOverlay;
+
+	class CpuProfiler
+	{
+	public:
+		struct Event {
+			/** @brief Not copied, has to stay valid for the lifetime of the profiler */
+			const char* name;
+			/** @brief Nanoseconds since the profiler has been created */
+			uint64_t begin;
+			uint64_t end;
+			/** @brief Nesting level on the recording thread */
+			uint32_t depth;
+			/** @brief Index of the recording thread */
+			uint32_t thread;
+		};
+
+		struct FrameResult {
+			uint64_t frame = 0;
+			uint64_t begin = 0;
+			uint64_t end = 0;
+			/** @brief Zones that ended during the frame, in no particular order */
+			std::vector<Event> events;
+			/** @brief Names of all threads that recorded zones so far, by thread index */
+			std::vector<std::string> threadNames;
+		};
+
+	private:
+		/** @brief Single producer (the owning thread), single consumer (endFrame) ring buffer */
+		struct ThreadBuffer {
+			static const uint32_t capacity = 4096;
+			Event events[capacity];
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> tail{ 0 };
+			std::atomic<uint64_t> dropped{ 0 };
+			/** @brief Current nesting level, only accessed by the owning thread */
+			uint32_t depth = 0;
+			uint32_t index = 0;
+			std::string name;
+		};
+		/** @brief Thread local owner of a thread's buffer, hands it back to the profiler when the thread exits */
+		struct ThreadBufferOwner;
+
+		struct TraceEvent {
+			Event event;
+			uint64_t frame;
+		};
+
+		/** @brief Guards the list of thread buffers, only taken when a thread records its first zone and once per frame */
+		std::mutex threadsMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threads;
+		/** @brief Buffers of threads that have exited, reused by new threads instead of allocating another one */
+		std::vector<ThreadBuffer*> freeThreads;
+		/** @brief Clock value at creation in nanoseconds, all times are relative to this */
+		uint64_t startTime = 0;
+		uint64_t frameCounter = 0;
+		uint64_t frameBegin = 0;
+		FrameResult latestResult;
+
+		// Chrome trace capture
+		std::string captureFilename;
+		uint32_t captureFramesLeft = 0;
+		std::vector<TraceEvent> traceEvents;
+
+		CpuProfiler();
+		ThreadBuffer* getThreadBuffer();
+		void releaseThreadBuffer(ThreadBuffer* buffer);
+		bool saveChromeTrace(const std::string& filename);
+	public:
+		/** @brief Recording can be paused at runtime, zones then only read the clock */
+		std::atomic<bool> enabled{ true };
+
+		static CpuProfiler& get();
+
+		/** @brief Current time in nanoseconds since the profiler has been created */
+		uint64_t now() const;
+
+		/** @brief Called by CpuZone, lock-free and wait-free (drops the zone if the thread's buffer is full) */
+		void beginZone();
+		void endZone(const char* name, uint64_t begin);
+
+		void setThreadName(const std::string& name);
+		/** @brief Moves the zones recorded by all threads since the last call into the latest result */
+		void endFrame();
+		const FrameResult& getLatestResult() const;
+		/** @brief Number of zones that were lost because a thread's buffer was full */
+		uint64_t getDroppedCount();
+
+		/** @brief Writes the zones of the next frameCount frames to a Chrome trace file */
+		void captureTrace(const std::string& filename, uint32_t frameCount);
+		bool isCapturing() const;
+
+		/** @brief Draws the latest frame as a flame graph per thread and lists the most expensive zones */
+		void onUpdateUIOverlay(vks::UIOverlay* overlay);
+	};
+
+	/** @brief Profiler zone that ends with the scope it has been declared in */
+	class CpuZone
+	{
+	private:
+		const char* name;
+		uint64_t begin;
+	public:
+		explicit CpuZone(const char* name) : name(name)
+		{
+			CpuProfiler& profiler = CpuProfiler::get();
+			profiler.beginZone();
+			begin = profiler.now();
+		}
+		~CpuZone()
+		{
+			CpuProfiler::get().endZone(name, begin);
+		}
+		CpuZone(const CpuZone&) = delete;
+		CpuZone& operator=(const CpuZone&) = delete;
+	};
+}
@@ -305,6 +305,36 @@ namespace vks
 			return result;
 		}
 
+		// Timeline semaphores need to be enabled by the application, either with the extension's or the Vulkan 1.2 feature structure
+		timelineSemaphores = false;
+		const VkBaseInStructure* chainEntry = static_cast<const VkBaseInStructure*>(pNextChain);
+		while (chainEntry)
+		{
+			if (chainEntry->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)
+			{
+				timelineSemaphores |= (reinterpret_cast<const VkPhysicalDeviceTimelineSemaphoreFeatures*>(chainEntry)->timelineSemaphore == VK_TRUE);
+			}
+			if (chainEntry->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+			{
+				timelineSemaphores |= (reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(chainEntry)->timelineSemaphore == VK_TRUE);
+			}
+			chainEntry = chainEntry->pNext;
+		}
+		if (timelineSemaphores)
+		{
+			// The KHR entry points are only exposed with the extension, the core ones only with Vulkan 1.2
+			vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphoresKHR"));
+			vkSignalSemaphoreKHR = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(vkGetDeviceProcAddr(logicalDevice, "vkSignalSemaphoreKHR"));
+			vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+			if (!vkWaitSemaphoresKHR)
+			{
+				vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphores"));
+				vkSignalSemaphoreKHR = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(vkGetDeviceProcAddr(logicalDevice, "vkSignalSemaphore"));
+				vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValue"));
+			}
+			timelineSemaphores = (vkWaitSemaphoresKHR != nullptr) && (vkSignalSemaphoreKHR != nullptr) && (vkGetSemaphoreCounterValueKHR != nullptr);
+		}
+
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
@@ -593,4 +623,157 @@ namespace vks
 		throw std::runtime_error("Could not find a matching depth format");
 	}
 
+	/**
+	* Create a timeline semaphore
+	*
+	* @param initialValue (Optional) Initial value of the semaphore's counter (Defaults to 0)
+	*
+	* @note Requires timelineSemaphores
+	*
+	* @return A handle to the created semaphore
+	*/
+	VkSemaphore VulkanDevice::createTimelineSemaphore(uint64_t initialValue)
+	{
+		assert(timelineSemaphores);
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo{};
+		semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeInfo.initialValue = initialValue;
+		VkSemaphoreCreateInfo semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+		semaphoreInfo.pNext = &semaphoreTypeInfo;
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore));
+		return semaphore;
+	}
+
+	/**
+	* Wait on the host until the counter of a timeline semaphore has reached a value
+	*
+	* @param semaphore Timeline semaphore to wait on
+	* @param value Value to wait for
+	* @param timeout (Optional) Timeout in nanoseconds (Defaults to no timeout)
+	*
+	* @return VK_SUCCESS once the value has been reached, VK_TIMEOUT if the timeout expired before
+	*/
+	VkResult VulkanDevice::waitTimelineSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		return vkWaitSemaphoresKHR(logicalDevice, &waitInfo, timeout);
+	}
+
+	/** @brief Returns the current counter value of a timeline semaphore without waiting */
+	uint64_t VulkanDevice::getTimelineSemaphoreValue(VkSemaphore semaphore)
+	{
+		uint64_t value = 0;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValueKHR(logicalDevice, semaphore, &value));
+		return value;
+	}
+
+	/**
+	* Record the release half of a queue family ownership transfer for a buffer
+	*
+	* The matching acquire (cmdAcquireBuffer with the same family indices) has to be recorded on a queue of the destination family,
+	* in a submission that waits on a semaphore signaled after the release
+	* Does nothing if both family indices are the same, as the semaphore then already orders and makes the writes visible
+	*
+	* @param commandBuffer Command buffer submitted to a queue of the source family
+	* @param srcAccessMask Accesses of the source family that have to be made available (e.g. shader writes)
+	* @param srcStageMask Stages of the source family that have to finish before the transfer
+	*/
+	void VulkanDevice::cmdReleaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStageMask, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+		{
+			return;
+		}
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = srcAccessMask;
+		// Destination access is ignored for the release
+		bufferBarrier.dstAccessMask = 0;
+		bufferBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		bufferBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		bufferBarrier.buffer = buffer;
+		bufferBarrier.offset = offset;
+		bufferBarrier.size = size;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Record the acquire half of a queue family ownership transfer for a buffer, see cmdReleaseBuffer
+	*
+	* @param commandBuffer Command buffer submitted to a queue of the destination family
+	* @param dstAccessMask Accesses of the destination family the buffer is used for afterwards
+	* @param dstStageMask Stages of the destination family that wait for the transfer
+	*/
+	void VulkanDevice::cmdAcquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+		{
+			return;
+		}
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		// Source access is ignored for the acquire
+		bufferBarrier.srcAccessMask = 0;
+		bufferBarrier.dstAccessMask = dstAccessMask;
+		bufferBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		bufferBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		bufferBarrier.buffer = buffer;
+		bufferBarrier.offset = offset;
+		bufferBarrier.size = size;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Record the release half of a queue family ownership transfer for an image
+	*
+	* A layout transition is executed once for both halves, so the acquire has to be recorded with the same layouts
+	* Does nothing if both family indices are the same, the layout is then changed by cmdAcquireImage
+	*/
+	void VulkanDevice::cmdReleaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageSubresourceRange subresourceRange, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStageMask)
+	{
+		if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+		{
+			return;
+		}
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.srcAccessMask = srcAccessMask;
+		imageBarrier.dstAccessMask = 0;
+		imageBarrier.oldLayout = oldLayout;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		imageBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	/**
+	* Record the acquire half of a queue family ownership transfer for an image, see cmdReleaseImage
+	*
+	* If both family indices are the same only the layout transition is recorded (if the layouts differ)
+	* The semaphore the submission waits on then has to include dstStageMask in its wait stages
+	*/
+	void VulkanDevice::cmdAcquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageSubresourceRange subresourceRange, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+	{
+		const bool transfer = (srcQueueFamilyIndex != dstQueueFamilyIndex);
+		if (!transfer && (oldLayout == newLayout))
+		{
+			return;
+		}
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = dstAccessMask;
+		imageBarrier.oldLayout = oldLayout;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.srcQueueFamilyIndex = transfer ? srcQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = transfer ? dstQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(commandBuffer, transfer ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) : dstStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
 };
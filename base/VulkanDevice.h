@@ -48,6 +48,12 @@ struct VulkanDevice
 		uint32_t compute;
 		uint32_t transfer;
 	} queueFamilyIndices;
+	/** @brief Set if the timelineSemaphore feature was enabled through the pNext chain passed to createLogicalDevice */
+	bool timelineSemaphores = false;
+	/** @brief Timeline semaphore functions, loaded if timelineSemaphores is set */
+	PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+	PFN_vkSignalSemaphoreKHR vkSignalSemaphoreKHR = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
 	operator VkDevice() const
 	{
 		return logicalDevice;
@@ -67,5 +73,12 @@ struct VulkanDevice
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
+	VkSemaphore     createTimelineSemaphore(uint64_t initialValue = 0);
+	VkResult        waitTimelineSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout = UINT64_MAX);
+	uint64_t        getTimelineSemaphoreValue(VkSemaphore semaphore);
+	void            cmdReleaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStageMask, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void            cmdAcquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void            cmdReleaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageSubresourceRange subresourceRange, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStageMask);
+	void            cmdAcquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageSubresourceRange subresourceRange, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
 };
 }        // namespace vks
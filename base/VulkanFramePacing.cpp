@@ -0,0 +1,195 @@
+/*
+* Frame pacing helpers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFramePacing.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	void FrameLimiter::setFrameRate(float framesPerSecond)
+	{
+		if (framesPerSecond <= 0.0f) {
+			period = Clock::duration::zero();
+		}
+		else {
+			period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+		}
+		started = false;
+	}
+
+	float FrameLimiter::getFrameRate() const
+	{
+		if (period == Clock::duration::zero()) {
+			return 0.0f;
+		}
+		return static_cast<float>(1.0 / std::chrono::duration<double>(period).count());
+	}
+
+	void FrameLimiter::wait()
+	{
+		lastWaitTime = 0.0;
+		if (period == Clock::duration::zero()) {
+			return;
+		}
+		const Clock::time_point start = Clock::now();
+		if (!started || (start - deadline > period)) {
+			// First frame or more than a frame behind
+			deadline = start;
+			started = true;
+		}
+		const double remaining = std::chrono::duration<double, std::milli>(deadline - start).count();
+		if (remaining > sleepOvershoot) {
+			const double requested = remaining - sleepOvershoot;
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(requested));
+			const double slept = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			// Follow longer sleeps right away and let the estimate decay slowly, so a single late wake up doesn't cause a missed deadline next time
+			sleepOvershoot = std::max(slept - requested, sleepOvershoot * 0.98);
+			sleepOvershoot = std::max(sleepOvershoot, 0.05);
+		}
+		while (Clock::now() < deadline) {
+			std::this_thread::yield();
+		}
+		deadline += period;
+		lastWaitTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void LatencyTracker::addSample(Interval interval, Clock::time_point begin, Clock::time_point end)
+	{
+		Samples &target = samples[interval];
+		const double value = std::chrono::duration<double, std::milli>(end - begin).count();
+		if (target.values.size() < sampleCount) {
+			target.values.push_back(value);
+		}
+		else {
+			target.values[target.next] = value;
+		}
+		target.next = (target.next + 1) % sampleCount;
+	}
+
+	void LatencyTracker::input()
+	{
+		if (!inputPending) {
+			pendingInput = Clock::now();
+			inputPending = true;
+		}
+	}
+
+	void LatencyTracker::beginFrame()
+	{
+		if (frame.active) {
+			// The previous frame has not been presented (e.g. the swap chain was out of date)
+			framesDropped++;
+		}
+		frame = Frame();
+		frame.active = true;
+		frame.simulation = Clock::now();
+		frame.hasInput = inputPending;
+		frame.input = pendingInput;
+		inputPending = false;
+	}
+
+	void LatencyTracker::submit()
+	{
+		if (!frame.active) {
+			return;
+		}
+		frame.submit = Clock::now();
+		frame.submitted = true;
+	}
+
+	void LatencyTracker::present()
+	{
+		if (!frame.active || !frame.submitted) {
+			return;
+		}
+		const Clock::time_point now = Clock::now();
+		if (frame.hasInput) {
+			addSample(InputToPresent, frame.input, now);
+		}
+		addSample(SimulationToSubmit, frame.simulation, frame.submit);
+		addSample(SubmitToPresent, frame.submit, now);
+		addSample(SimulationToPresent, frame.simulation, now);
+		frame.active = false;
+	}
+
+	LatencyTracker::Distribution LatencyTracker::getDistribution(Interval interval) const
+	{
+		Distribution distribution;
+		std::vector<double> values = samples[interval].values;
+		if (values.empty()) {
+			return distribution;
+		}
+		std::sort(values.begin(), values.end());
+		const size_t count = values.size();
+		// Nearest rank percentiles
+		auto percentile = [&](double p) {
+			size_t rank = static_cast<size_t>(p * static_cast<double>(count) + 0.5);
+			return values[std::min(std::max(rank, static_cast<size_t>(1)), count) - 1];
+		};
+		double sum = 0.0;
+		for (double value : values) {
+			sum += value;
+		}
+		distribution.samples = static_cast<uint32_t>(count);
+		distribution.min = values.front();
+		distribution.max = values.back();
+		distribution.mean = sum / static_cast<double>(count);
+		distribution.p50 = percentile(0.50);
+		distribution.p95 = percentile(0.95);
+		distribution.p99 = percentile(0.99);
+		return distribution;
+	}
+
+	const char* LatencyTracker::intervalName(Interval interval)
+	{
+		switch (interval) {
+		case InputToPresent: return "Input to present";
+		case SimulationToSubmit: return "Simulation to submit";
+		case SubmitToPresent: return "Submit to present";
+		case SimulationToPresent: return "Simulation to present";
+		default: return "Unknown";
+		}
+	}
+
+	void LatencyTracker::onUpdateUIOverlay(vks::UIOverlay *overlay) const
+	{
+		overlay->text("Last %u frames, p50 / p95 / p99 / max ms", sampleCount);
+		for (uint32_t i = 0; i < IntervalCount; i++) {
+			const Distribution distribution = getDistribution(static_cast<Interval>(i));
+			if (distribution.samples == 0) {
+				overlay->text("%s: -", intervalName(static_cast<Interval>(i)));
+				continue;
+			}
+			overlay->text("%s: %.2f / %.2f / %.2f / %.2f", intervalName(static_cast<Interval>(i)), distribution.p50, distribution.p95, distribution.p99, distribution.max);
+		}
+		if (framesDropped > 0) {
+			overlay->text("Frames not presented: %llu", static_cast<unsigned long long>(framesDropped));
+		}
+	}
+
+	void LatencyTracker::printSummary(std::ostream &stream) const
+	{
+		stream << "Frame latency over the last " << sampleCount << " frames in ms (min / mean / p50 / p95 / p99 / max):\n";
+		stream << std::fixed << std::setprecision(3);
+		for (uint32_t i = 0; i < IntervalCount; i++) {
+			const Distribution distribution = getDistribution(static_cast<Interval>(i));
+			stream << "  " << std::left << std::setw(24) << intervalName(static_cast<Interval>(i)) << std::right;
+			if (distribution.samples == 0) {
+				stream << "no samples\n";
+				continue;
+			}
+			stream << distribution.min << " / " << distribution.mean << " / " << distribution.p50 << " / " << distribution.p95 << " / " << distribution.p99 << " / " << distribution.max << " (" << distribution.samples << " samples)\n";
+		}
+		if (framesDropped > 0) {
+			stream << "  Frames not presented: " << framesDropped << "\n";
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/*
+* Frame pacing helpers
+*
+* FrameLimiter caps the frame rate by sleeping for the bulk of the remaining frame time and spinning for the rest, as
+* the granularity of the OS sleep is often in the range of milliseconds
+* LatencyTracker timestamps the stages of each frame (input, simulation, submit, present) and reports the distribution
+* of the time between them over the last frames
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+namespace vks
+{
+	class UIOverlay;
+
+	class FrameLimiter
+	{
+	private:
+		typedef std::chrono::steady_clock Clock;
+		Clock::duration period = Clock::duration::zero();
+		Clock::time_point deadline;
+		bool started = false;
+		/** @brief Estimate of how much longer than requested a sleep takes, the remainder is spun */
+		double sleepOvershoot = 1.0;
+	public:
+		/** @brief Time spent waiting in the last call to wait() in milliseconds */
+		double lastWaitTime = 0.0;
+
+		/** @brief Sets the frame rate cap in frames per second, 0 disables the limiter */
+		void setFrameRate(float framesPerSecond);
+		float getFrameRate() const;
+		/**
+		* Blocks until the next frame is due
+		*
+		* Call once per frame after presenting, so the following frame samples input as late as possible
+		* If a frame took longer than the period, the next deadline is moved instead of rendering the following frames faster to catch up
+		*/
+		void wait();
+	};
+
+	class LatencyTracker
+	{
+	public:
+		/** @brief Time between two stages of a frame */
+		enum Interval {
+			/** @brief Oldest input event not yet handled by a frame until that frame has been presented, only frames with input are sampled */
+			InputToPresent = 0,
+			SimulationToSubmit,
+			SubmitToPresent,
+			/** @brief Age of the simulated state once it has been presented */
+			SimulationToPresent,
+			IntervalCount
+		};
+
+		/** @brief Times in milliseconds */
+		struct Distribution {
+			uint32_t samples = 0;
+			double min = 0.0;
+			double mean = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+	private:
+		typedef std::chrono::steady_clock Clock;
+		static const uint32_t sampleCount = 512;
+
+		struct Frame {
+			Clock::time_point input;
+			Clock::time_point simulation;
+			Clock::time_point submit;
+			bool hasInput = false;
+			bool submitted = false;
+			bool active = false;
+		};
+
+		struct Samples {
+			std::vector<double> values;
+			uint32_t next = 0;
+		};
+
+		Clock::time_point pendingInput;
+		bool inputPending = false;
+		Frame frame;
+		Samples samples[IntervalCount];
+		uint64_t framesDropped = 0;
+
+		void addSample(Interval interval, Clock::time_point begin, Clock::time_point end);
+	public:
+		/** @brief Records an input event, only the oldest event before a frame begins is kept */
+		void input();
+		/** @brief The frame starts updating its state from the input received so far */
+		void beginFrame();
+		/** @brief All work of the frame has been submitted to the device */
+		void submit();
+		/**
+		* The frame has been handed to the presentation engine and the rendering it waits on has finished
+		*
+		* This is an upper bound for the time the presentation engine got the image, the scan out itself can't be observed without
+		* VK_GOOGLE_display_timing or VK_KHR_present_wait
+		*/
+		void present();
+
+		Distribution getDistribution(Interval interval) const;
+		static const char* intervalName(Interval interval);
+		void onUpdateUIOverlay(vks::UIOverlay *overlay) const;
+		void printSummary(std::ostream &stream) const;
+	};
+}
@@ -0,0 +1,421 @@
+/*
+* Scoped GPU profiler
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanGpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "VulkanDebug.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	namespace
+	{
+		// Display names in the order the statistics are returned (ascending flag bits)
+		const std::pair<VkQueryPipelineStatisticFlagBits, const char*> pipelineStatisticNames[] = {
+			{ VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT, "Input assembly vertices" },
+			{ VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT, "Input assembly primitives" },
+			{ VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT, "Vertex shader invocations" },
+			{ VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_INVOCATIONS_BIT, "Geometry shader invocations" },
+			{ VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_PRIMITIVES_BIT, "Geometry shader primitives" },
+			{ VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT, "Clipping invocations" },
+			{ VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT, "Clipping primitives" },
+			{ VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT, "Fragment shader invocations" },
+			{ VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT, "Tessellation control shader patches" },
+			{ VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT, "Tessellation evaluation shader invocations" },
+			{ VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT, "Compute shader invocations" },
+		};
+
+		// Debug label colors by nesting level
+		const glm::vec4 zoneColors[] = {
+			glm::vec4(0.9f, 0.5f, 0.1f, 1.0f),
+			glm::vec4(0.2f, 0.6f, 0.9f, 1.0f),
+			glm::vec4(0.3f, 0.8f, 0.3f, 1.0f),
+			glm::vec4(0.8f, 0.3f, 0.8f, 1.0f),
+		};
+
+		std::string escapeJson(const std::string &text)
+		{
+			std::string escaped;
+			for (char c : text) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+	}
+
+	void GpuProfiler::create(vks::VulkanDevice *device, uint32_t frameCount, uint32_t maxZones, VkQueryPipelineStatisticFlags pipelineStatistics, uint32_t queueFamilyIndex)
+	{
+		assert(frameCount > 0);
+		this->device = device;
+		this->maxZones = maxZones;
+		this->pipelineStatistics = pipelineStatistics;
+		// Results are read when the command buffer comes up for submission again, which is as late as possible without stalling
+		latency = frameCount - 1;
+
+		if (queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED) {
+			queueFamilyIndex = device->queueFamilyIndices.graphics;
+		}
+		const uint32_t validBits = device->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+		supported = (validBits > 0) && (device->properties.limits.timestampPeriod > 0.0f);
+		if (!supported) {
+			std::cout << "GPU profiler: Timestamps are not supported on queue family " << queueFamilyIndex << ", only debug labels will be added" << std::endl;
+			return;
+		}
+		timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+
+		statisticNames.clear();
+		for (auto &statistic : pipelineStatisticNames) {
+			if (pipelineStatistics & statistic.first) {
+				statisticNames.push_back(statistic.second);
+			}
+		}
+
+		slots.resize(frameCount);
+		timestamps.create(device, VK_QUERY_TYPE_TIMESTAMP, 2 + maxZones * 2, frameCount);
+		if (pipelineStatistics != 0) {
+			statistics.create(device, VK_QUERY_TYPE_PIPELINE_STATISTICS, maxZones, frameCount, pipelineStatistics);
+		}
+	}
+
+	void GpuProfiler::destroy()
+	{
+		timestamps.destroy();
+		statistics.destroy();
+		slots.clear();
+		recording.clear();
+	}
+
+	GpuProfiler::FrameSlot *GpuProfiler::getRecordingSlot(VkCommandBuffer commandBuffer, uint32_t &frameIndex)
+	{
+		auto it = recording.find(commandBuffer);
+		if (it == recording.end()) {
+			return nullptr;
+		}
+		frameIndex = it->second;
+		return &slots[frameIndex];
+	}
+
+	void GpuProfiler::cmdBeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!supported) {
+			return;
+		}
+		assert(frameIndex < slots.size());
+		FrameSlot &slot = slots[frameIndex];
+		recording[commandBuffer] = frameIndex;
+		slot.recordedZones.clear();
+		slot.openZones.clear();
+		slot.recordedStatisticsQueries = 0;
+		timestamps.cmdReset(commandBuffer, frameIndex);
+		if (pipelineStatistics != 0) {
+			statistics.cmdReset(commandBuffer, frameIndex);
+		}
+		timestamps.cmdWriteTimestamp(commandBuffer, frameIndex, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	}
+
+	void GpuProfiler::cmdEndFrame(VkCommandBuffer commandBuffer)
+	{
+		uint32_t frameIndex;
+		FrameSlot *slot = getRecordingSlot(commandBuffer, frameIndex);
+		if (slot == nullptr) {
+			return;
+		}
+		assert(slot->openZones.empty());
+		timestamps.cmdWriteTimestamp(commandBuffer, frameIndex, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		recording.erase(commandBuffer);
+	}
+
+	void GpuProfiler::cmdBeginZone(VkCommandBuffer commandBuffer, const char *name)
+	{
+		uint32_t frameIndex = 0;
+		FrameSlot *slot = getRecordingSlot(commandBuffer, frameIndex);
+		const uint32_t depth = (slot != nullptr) ? static_cast<uint32_t>(slot->openZones.size()) : 0;
+		vks::debugmarker::beginRegion(commandBuffer, name, zoneColors[depth % 4]);
+		if (slot == nullptr) {
+			return;
+		}
+		if (slot->recordedZones.size() >= maxZones) {
+			std::cerr << "GPU profiler: Zone \"" << name << "\" exceeds the maximum number of zones (" << maxZones << ")" << std::endl;
+			// Keep the zone stack balanced, the zone is not timed
+			slot->openZones.push_back(UINT32_MAX);
+			return;
+		}
+		ZoneRecord zone;
+		zone.name = name;
+		zone.depth = depth;
+		// Pipeline statistics queries of the same pool can't be active at the same time, so only top level zones get them
+		zone.statisticsQuery = -1;
+		if ((pipelineStatistics != 0) && (depth == 0)) {
+			zone.statisticsQuery = static_cast<int32_t>(slot->recordedStatisticsQueries++);
+		}
+		const uint32_t index = static_cast<uint32_t>(slot->recordedZones.size());
+		slot->recordedZones.push_back(zone);
+		slot->openZones.push_back(index);
+		timestamps.cmdWriteTimestamp(commandBuffer, frameIndex, 2 + index * 2, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		if (zone.statisticsQuery >= 0) {
+			statistics.cmdBeginQuery(commandBuffer, frameIndex, zone.statisticsQuery);
+		}
+	}
+
+	void GpuProfiler::cmdEndZone(VkCommandBuffer commandBuffer)
+	{
+		vks::debugmarker::endRegion(commandBuffer);
+		uint32_t frameIndex;
+		FrameSlot *slot = getRecordingSlot(commandBuffer, frameIndex);
+		if (slot == nullptr) {
+			return;
+		}
+		assert(!slot->openZones.empty());
+		const uint32_t index = slot->openZones.back();
+		slot->openZones.pop_back();
+		if (index == UINT32_MAX) {
+			return;
+		}
+		const ZoneRecord &zone = slot->recordedZones[index];
+		if (zone.statisticsQuery >= 0) {
+			statistics.cmdEndQuery(commandBuffer, frameIndex, zone.statisticsQuery);
+		}
+		timestamps.cmdWriteTimestamp(commandBuffer, frameIndex, 3 + index * 2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	}
+
+	bool GpuProfiler::fetch(FrameSlot &slot)
+	{
+		// The query managers keep the latest result of every query, the slot is complete once all of its queries belong to its submission
+		const uint32_t queryCount = 2 + static_cast<uint32_t>(slot.submittedZones.size()) * 2;
+		bool superseded = false;
+		for (uint32_t query = 0; query < queryCount; query++) {
+			const uint64_t resultFrame = timestamps.getResultFrame(query);
+			if (resultFrame < slot.submittedFrame) {
+				return false;
+			}
+			superseded = superseded || (resultFrame > slot.submittedFrame);
+		}
+		for (uint32_t query = 0; query < slot.submittedStatisticsQueries; query++) {
+			const uint64_t resultFrame = statistics.getResultFrame(query);
+			if (resultFrame < slot.submittedFrame) {
+				return false;
+			}
+			superseded = superseded || (resultFrame > slot.submittedFrame);
+		}
+		// Results of a newer submission were read first and replaced some of this one's
+		if (superseded || (slot.submittedFrame < latestResult.frame)) {
+			return true;
+		}
+		std::vector<uint64_t> timestampValues(queryCount);
+		for (uint32_t query = 0; query < queryCount; query++) {
+			timestampValues[query] = timestamps.getResult(query);
+		}
+
+		// Timestamp period is in nanoseconds per tick, only the valid bits of the timestamps are used
+		const double period = device->properties.limits.timestampPeriod / 1000000.0;
+		auto toMilliseconds = [&](uint64_t from, uint64_t to) {
+			return static_cast<double>((to - from) & timestampMask) * period;
+		};
+
+		FrameResult frameResult;
+		frameResult.frame = slot.submittedFrame;
+		frameResult.duration = toMilliseconds(timestampValues[0], timestampValues[1]);
+		frameResult.start = static_cast<double>(timestampValues[0] & timestampMask) * period;
+		// Averages carry over as long as the zone layout doesn't change
+		bool sameLayout = (latestResult.zones.size() == slot.submittedZones.size());
+		for (size_t i = 0; i < slot.submittedZones.size(); i++) {
+			const ZoneRecord &zone = slot.submittedZones[i];
+			ZoneResult zoneResult;
+			zoneResult.name = zone.name;
+			zoneResult.depth = zone.depth;
+			zoneResult.begin = toMilliseconds(timestampValues[0], timestampValues[2 + i * 2]);
+			zoneResult.duration = toMilliseconds(timestampValues[2 + i * 2], timestampValues[3 + i * 2]);
+			sameLayout = sameLayout && (latestResult.zones[i].name == zone.name);
+			zoneResult.averageDuration = sameLayout ? latestResult.zones[i].averageDuration * 0.9 + zoneResult.duration * 0.1 : zoneResult.duration;
+			if (zone.statisticsQuery >= 0) {
+				for (uint32_t value = 0; value < statistics.valuesPerQuery; value++) {
+					zoneResult.statistics.push_back(statistics.getResult(zone.statisticsQuery, value));
+				}
+			}
+			frameResult.zones.push_back(zoneResult);
+
+			auto it = summaryIndices.find(zone.name);
+			if (it == summaryIndices.end()) {
+				it = summaryIndices.insert(std::make_pair(zone.name, summary.size())).first;
+				summary.push_back(ZoneSummary());
+				summary.back().name = zone.name;
+				summary.back().minDuration = zoneResult.duration;
+			}
+			ZoneSummary &zoneSummary = summary[it->second];
+			zoneSummary.count++;
+			zoneSummary.totalDuration += zoneResult.duration;
+			zoneSummary.minDuration = std::min(zoneSummary.minDuration, zoneResult.duration);
+			zoneSummary.maxDuration = std::max(zoneSummary.maxDuration, zoneResult.duration);
+		}
+		latestResult = frameResult;
+
+		if (captureFramesLeft > 0) {
+			if (traceEvents.empty()) {
+				captureStart = timestampValues[0];
+			}
+			const double frameBegin = toMilliseconds(captureStart, timestampValues[0]);
+			traceEvents.push_back({ "Frame", frameResult.frame, frameBegin, frameResult.duration, {} });
+			for (auto &zone : frameResult.zones) {
+				traceEvents.push_back({ zone.name, frameResult.frame, frameBegin + zone.begin, zone.duration, zone.statistics });
+			}
+			captureFramesLeft--;
+			if (captureFramesLeft == 0) {
+				if (saveChromeTrace(captureFilename)) {
+					std::cout << "GPU profiler: Saved trace to \"" << captureFilename << "\"" << std::endl;
+				}
+				else {
+					std::cerr << "GPU profiler: Could not write trace to \"" << captureFilename << "\"" << std::endl;
+				}
+				traceEvents.clear();
+			}
+		}
+		return true;
+	}
+
+	void GpuProfiler::update()
+	{
+		if (!supported) {
+			return;
+		}
+		timestamps.latency = latency;
+		timestamps.update();
+		if (pipelineStatistics != 0) {
+			statistics.latency = latency;
+			statistics.update();
+		}
+		for (auto &slot : slots) {
+			if (slot.pending) {
+				slot.pending = !fetch(slot);
+			}
+		}
+	}
+
+	void GpuProfiler::submitted(uint32_t frameIndex)
+	{
+		if (!supported) {
+			return;
+		}
+		assert(frameIndex < slots.size());
+		FrameSlot &slot = slots[frameIndex];
+		// Command buffers are usually recorded once and submitted many times, so the zones are kept with the submission
+		slot.submittedZones = slot.recordedZones;
+		slot.submittedStatisticsQueries = slot.recordedStatisticsQueries;
+		timestamps.submitted(frameIndex, 2 + static_cast<uint32_t>(slot.submittedZones.size()) * 2);
+		if (pipelineStatistics != 0) {
+			statistics.submitted(frameIndex, slot.submittedStatisticsQueries);
+		}
+		// Submissions are counted the same way as by the query managers, so the numbers match their result frames
+		frameCounter++;
+		slot.submittedFrame = frameCounter;
+		slot.pending = true;
+		droppedResults = timestamps.droppedResults;
+	}
+
+	const GpuProfiler::FrameResult &GpuProfiler::getLatestResult() const
+	{
+		return latestResult;
+	}
+
+	const std::vector<GpuProfiler::ZoneSummary> &GpuProfiler::getSummary() const
+	{
+		return summary;
+	}
+
+	void GpuProfiler::resetSummary()
+	{
+		summary.clear();
+		summaryIndices.clear();
+	}
+
+	void GpuProfiler::printSummary() const
+	{
+		if (summary.empty()) {
+			return;
+		}
+		std::cout << "GPU zones (avg / min / max ms, frames):" << "\n";
+		std::cout << std::fixed << std::setprecision(3);
+		for (auto &zone : summary) {
+			std::cout << "  " << zone.name << ": " << zone.totalDuration / static_cast<double>(zone.count) << " / " << zone.minDuration << " / " << zone.maxDuration << ", " << zone.count << "\n";
+		}
+	}
+
+	void GpuProfiler::captureTrace(const std::string &filename, uint32_t frameCount)
+	{
+		captureFilename = filename;
+		captureFramesLeft = frameCount;
+		traceEvents.clear();
+	}
+
+	bool GpuProfiler::isCapturing() const
+	{
+		return captureFramesLeft > 0;
+	}
+
+	bool GpuProfiler::saveChromeTrace(const std::string &filename) const
+	{
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			return false;
+		}
+		// Complete events ("ph": "X") with microsecond timestamps, nesting is derived from the time ranges
+		std::stringstream ss;
+		ss.precision(3);
+		ss << std::fixed;
+		ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		for (size_t i = 0; i < traceEvents.size(); i++) {
+			const TraceEvent &event = traceEvents[i];
+			ss << (i > 0 ? "," : "") << "\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0";
+			ss << ",\"ts\":" << event.begin * 1000.0 << ",\"dur\":" << event.duration * 1000.0;
+			ss << ",\"args\":{\"frame\":" << event.frame;
+			for (size_t j = 0; j < event.statistics.size(); j++) {
+				ss << ",\"" << statisticNames[j] << "\":" << event.statistics[j];
+			}
+			ss << "}}";
+		}
+		ss << "\n]}\n";
+		file << ss.str();
+		return file.good();
+	}
+
+	void GpuProfiler::onUpdateUIOverlay(vks::UIOverlay *overlay) const
+	{
+		if (!supported) {
+			overlay->text("Timestamps not supported");
+			return;
+		}
+		if (latestResult.frame == 0) {
+			overlay->text("Waiting for results");
+			return;
+		}
+		overlay->text("GPU frame: %.3f ms", latestResult.duration);
+		for (auto &zone : latestResult.zones) {
+			overlay->text("%*s%s: %.3f ms", zone.depth * 2, "", zone.name.c_str(), zone.averageDuration);
+			for (size_t i = 0; i < zone.statistics.size(); i++) {
+				overlay->text("%*s%s: %llu", zone.depth * 2 + 2, "", statisticNames[i].c_str(), static_cast<unsigned long long>(zone.statistics[i]));
+			}
+		}
+		overlay->text("Result age: %llu frames, dropped: %llu", static_cast<unsigned long long>(frameCounter - latestResult.frame), static_cast<unsigned long long>(droppedResults));
+	}
+
+	GpuZone::GpuZone(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const char *name) : profiler(profiler), commandBuffer(commandBuffer)
+	{
+		profiler.cmdBeginZone(commandBuffer, name);
+	}
+
+	GpuZone::~GpuZone()
+	{
+		profiler.cmdEndZone(commandBuffer);
+	}
+}
@@ -0,0 +1,180 @@
+/*
+* Scoped GPU profiler
+*
+* Times named zones of a command buffer with timestamp queries (and optionally pipeline statistics) and labels them with debug markers
+* The queries are managed by vks::QueryManager, so results are read without waiting on the GPU a few frames after submission
+* They can be displayed in the UI overlay and exported as a Chrome trace (load the file in chrome://tracing or https://ui.perfetto.dev)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanQueryManager.h"
+
+namespace vks
+{
+	class UIOverlay;
+
+	class GpuProfiler
+	{
+	public:
+		struct ZoneResult {
+			std::string name;
+			/** @brief Nesting level, zero for zones that are not inside another zone */
+			uint32_t depth = 0;
+			/** @brief Start of the zone relative to the start of the frame in milliseconds */
+			double begin = 0.0;
+			double duration = 0.0;
+			/** @brief Exponential moving average of the duration over previous frames with the same zone layout */
+			double averageDuration = 0.0;
+			/** @brief Pipeline statistics in the order of the flag bits passed to create, only available for zones with depth zero */
+			std::vector<uint64_t> statistics;
+		};
+
+		struct FrameResult {
+			/** @brief Number of the submission the results belong to, zero if there are no results yet */
+			uint64_t frame = 0;
+			/** @brief Time between the start and the end of the frame's command buffer in milliseconds */
+			double duration = 0.0;
+			/** @brief Device timestamp of the start of the command buffer in milliseconds, comparable between profilers of the same device */
+			double start = 0.0;
+			std::vector<ZoneResult> zones;
+		};
+
+		/** @brief Durations of all read results of zones with the same name, e.g. to compare passes over a benchmark run */
+		struct ZoneSummary {
+			std::string name;
+			uint64_t count = 0;
+			double totalDuration = 0.0;
+			double minDuration = 0.0;
+			double maxDuration = 0.0;
+		};
+
+	private:
+		struct ZoneRecord {
+			std::string name;
+			uint32_t depth;
+			/** @brief Query in the statistics pool, -1 if no statistics are gathered for this zone */
+			int32_t statisticsQuery;
+		};
+		/** @brief Zones of the command buffer using the query pools of the same frame index */
+		struct FrameSlot {
+			/** @brief Zones recorded into the slot's command buffer */
+			std::vector<ZoneRecord> recordedZones;
+			/** @brief Zones of the last submission, results are read for these */
+			std::vector<ZoneRecord> submittedZones;
+			uint32_t recordedStatisticsQueries = 0;
+			uint32_t submittedStatisticsQueries = 0;
+			/** @brief Indices of the zones that have been started but not yet ended */
+			std::vector<uint32_t> openZones;
+			uint64_t submittedFrame = 0;
+			bool pending = false;
+		};
+		struct TraceEvent {
+			std::string name;
+			uint64_t frame;
+			double begin;
+			double duration;
+			std::vector<uint64_t> statistics;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		/** @brief The first two timestamps belong to the frame, followed by a pair for each zone */
+		vks::QueryManager timestamps;
+		/** @brief One query per top level zone, only created if pipeline statistics are requested */
+		vks::QueryManager statistics;
+		std::vector<FrameSlot> slots;
+		/** @brief Slots that are currently recorded, by command buffer */
+		std::unordered_map<VkCommandBuffer, uint32_t> recording;
+		uint64_t timestampMask = ~0ULL;
+		uint64_t frameCounter = 0;
+		uint32_t maxZones = 0;
+		VkQueryPipelineStatisticFlags pipelineStatistics = 0;
+		std::vector<std::string> statisticNames;
+		FrameResult latestResult;
+		std::vector<ZoneSummary> summary;
+		std::unordered_map<std::string, size_t> summaryIndices;
+
+		// Chrome trace capture
+		std::string captureFilename;
+		uint32_t captureFramesLeft = 0;
+		/** @brief GPU timestamp of the first captured frame, trace events are relative to this */
+		uint64_t captureStart = 0;
+		std::vector<TraceEvent> traceEvents;
+
+		/** @brief Builds the frame result once the query managers hold all results of the slot's submission */
+		bool fetch(FrameSlot &slot);
+		/** @brief Returns the slot recorded into the command buffer and its frame index */
+		FrameSlot *getRecordingSlot(VkCommandBuffer commandBuffer, uint32_t &frameIndex);
+		bool saveChromeTrace(const std::string &filename) const;
+	public:
+		/** @brief False if the device doesn't support timestamps on the profiled queue family, zones then only add debug labels */
+		bool supported = false;
+		/** @brief Minimum number of frames between submitting a command buffer and reading its results */
+		uint32_t latency = 0;
+		/** @brief Number of submissions whose results were not available before the command buffer was submitted again */
+		uint64_t droppedResults = 0;
+
+		/**
+		* Create the query pools
+		*
+		* @param device Device used to create the query pools
+		* @param frameCount Number of command buffers that are profiled (e.g. one per swap chain image)
+		* @param maxZones Maximum number of zones per command buffer
+		* @param pipelineStatistics (Optional) Pipeline statistics to gather for each top level zone (requires the pipelineStatisticsQuery feature)
+		* @param queueFamilyIndex (Optional) Family of the queue the command buffers are submitted to, defaults to the graphics family
+		*/
+		void create(vks::VulkanDevice *device, uint32_t frameCount, uint32_t maxZones = 64, VkQueryPipelineStatisticFlags pipelineStatistics = 0, uint32_t queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+		void destroy();
+
+		/** @brief Starts profiling a command buffer, must be recorded outside of a render pass before any zone */
+		void cmdBeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		/** @brief Ends profiling a command buffer, all zones need to be closed */
+		void cmdEndFrame(VkCommandBuffer commandBuffer);
+		/** @brief Starts a zone, zones can be nested but must begin and end in the same render pass instance (or both outside of one) */
+		void cmdBeginZone(VkCommandBuffer commandBuffer, const char *name);
+		void cmdEndZone(VkCommandBuffer commandBuffer);
+
+		/** @brief Reads the results of submissions that are at least latency frames old without blocking, call once per frame */
+		void update();
+		/** @brief Marks the frame's command buffer as submitted, call after the queue submission */
+		void submitted(uint32_t frameIndex);
+
+		/** @brief Results of the most recent frame that has been read */
+		const FrameResult &getLatestResult() const;
+
+		/** @brief Accumulated durations per zone name in the order the zones were first seen */
+		const std::vector<ZoneSummary> &getSummary() const;
+		void resetSummary();
+		/** @brief Prints average, minimum and maximum duration of every zone name to stdout */
+		void printSummary() const;
+
+		/** @brief Writes the results of the next frameCount frames to a Chrome trace file once they have been read */
+		void captureTrace(const std::string &filename, uint32_t frameCount);
+		bool isCapturing() const;
+
+		/** @brief Adds the zone timings of the latest frame to the UI overlay */
+		void onUpdateUIOverlay(vks::UIOverlay *overlay) const;
+	};
+
+	/** @brief Profiler zone that ends with the scope it has been declared in */
+	class GpuZone
+	{
+	private:
+		GpuProfiler &profiler;
+		VkCommandBuffer commandBuffer;
+	public:
+		GpuZone(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const char *name);
+		~GpuZone();
+		GpuZone(const GpuZone &) = delete;
+		GpuZone &operator=(const GpuZone &) = delete;
+	};
+}
@@ -0,0 +1,110 @@
+/*
+* Disk cache for image based lighting textures
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanIBLCache.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdlib.h>
+
+#include <ktx.h>
+
+#include "VulkanTools.h"
+
+namespace vks
+{
+	namespace
+	{
+		// Missing files leave the hash unchanged, the generation then fails on its own
+		uint64_t hashFile(const std::string& filename, uint64_t hash)
+		{
+			std::ifstream file(filename, std::ios::binary);
+			if (!file.is_open()) {
+				return hash;
+			}
+			std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			return vks::tools::hash(data.data(), data.size(), hash);
+		}
+	}
+
+	void IBLCache::setEnvironment(const std::string& filename)
+	{
+		environmentFilename = filename;
+		environmentHash = 0;
+		cachePath.clear();
+		if (!enabled) {
+			return;
+		}
+		cachePath = vks::tools::getCachePath();
+		if (cachePath.empty()) {
+			enabled = false;
+			return;
+		}
+		environmentHash = hashFile(filename, vks::tools::hashSeed);
+	}
+
+	const std::string& IBLCache::getEnvironment() const
+	{
+		return environmentFilename;
+	}
+
+	std::string IBLCache::getFilename(const std::string& name) const
+	{
+		const size_t separator = environmentFilename.find_last_of("/\\");
+		const std::string baseName = (separator == std::string::npos) ? environmentFilename : environmentFilename.substr(separator + 1);
+		return cachePath + baseName + "." + name + ".ktx";
+	}
+
+	std::string IBLCache::getKey(const std::vector<std::string>& shaderFiles, bool dependsOnEnvironment, const void* settings, size_t settingsSize) const
+	{
+		uint64_t hash = dependsOnEnvironment ? environmentHash : vks::tools::hashSeed;
+		for (const std::string& shaderFile : shaderFiles) {
+			hash = hashFile(shaderFile, hash);
+		}
+		hash = vks::tools::hash(settings, settingsSize, hash);
+		std::stringstream key;
+		key << std::hex << std::setw(16) << std::setfill('0') << hash;
+		return key.str();
+	}
+
+	bool IBLCache::isValid(const std::string& filename, const std::string& key, double& generationTime) const
+	{
+		if (!vks::tools::fileExists(filename)) {
+			return false;
+		}
+		// Only reads the header and the meta data
+		ktxTexture* ktxTexture;
+		if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture) != KTX_SUCCESS) {
+			return false;
+		}
+		bool valid = false;
+		unsigned int valueLength;
+		void* value;
+		if (ktxHashList_FindValue(&ktxTexture->kvDataHead, "vks.cachekey", &valueLength, &value) == KTX_SUCCESS) {
+			valid = (key == static_cast<const char*>(value));
+		}
+		generationTime = 0.0;
+		if (ktxHashList_FindValue(&ktxTexture->kvDataHead, "vks.generationtime", &valueLength, &value) == KTX_SUCCESS) {
+			generationTime = atof(static_cast<const char*>(value));
+		}
+		ktxTexture_Destroy(ktxTexture);
+		return valid;
+	}
+
+	void IBLCache::store(vks::Texture& texture, const std::string& filename, VkFormat format, bool cubeMap, const std::string& key, double generationTime, VkQueue queue) const
+	{
+		std::vector<std::pair<std::string, std::string>> keyValues = {
+			{ "vks.cachekey", key },
+			{ "vks.generationtime", std::to_string(generationTime) }
+		};
+		if (!texture.saveToKTXFile(filename, format, queue, cubeMap, keyValues)) {
+			std::cout << "Could not write " << filename << " to the cache" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*
+* Disk cache for image based lighting textures
+*
+* Textures generated from an environment map (BRDF LUT, irradiance and pre-filtered cube maps) only depend on that map,
+* the shaders used to generate them and a few settings. They're stored as KTX files in the cache directory
+* (see vks::tools::getCachePath) together with a key over these inputs, and are loaded instead of being generated again
+* as long as the key matches
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+	class IBLCache
+	{
+	private:
+		std::string environmentFilename;
+		std::string cachePath;
+		uint64_t environmentHash = 0;
+
+		std::string getFilename(const std::string& name) const;
+		/** @brief Checks if a cache file exists and was stored with the given key, also returns the time it originally took to generate the texture */
+		bool isValid(const std::string& filename, const std::string& key, double& generationTime) const;
+		void store(vks::Texture& texture, const std::string& filename, VkFormat format, bool cubeMap, const std::string& key, double generationTime, VkQueue queue) const;
+	public:
+#if defined(__ANDROID__)
+		// The environment map is a packed asset on Android that can't be hashed with file streams
+		bool enabled = false;
+#else
+		bool enabled = true;
+#endif
+		/** @brief Generation time in milliseconds of all textures that have been loaded from the cache instead */
+		double timeSaved = 0.0;
+
+		/** @brief Sets the environment map the cached textures are generated from, needs to be called before any other function */
+		void setEnvironment(const std::string& filename);
+		const std::string& getEnvironment() const;
+
+		/**
+		* Returns the key for a texture generated by the given SPIR-V files
+		*
+		* @param shaderFiles Full paths of the shaders used to generate the texture
+		* @param dependsOnEnvironment False for textures that are the same for all environment maps (e.g. the BRDF LUT)
+		* @param settings Generation settings (formats, sizes, sample counts), hashed as raw bytes
+		*/
+		std::string getKey(const std::vector<std::string>& shaderFiles, bool dependsOnEnvironment, const void* settings, size_t settingsSize) const;
+
+		/**
+		* Loads a texture from the cache if the stored key matches, otherwise calls generate and stores its result
+		*
+		* @param name Suffix appended to the environment map's file name for the cache file (e.g. "prefiltered")
+		* @return True if the texture was loaded from the cache
+		*/
+		template <typename T>
+		bool prepare(T& texture, const std::string& name, VkFormat format, const std::string& key, vks::VulkanDevice* device, VkQueue queue, const std::function<void()>& generate)
+		{
+			static_assert(std::is_same<T, vks::Texture2D>::value || std::is_same<T, vks::TextureCubeMap>::value, "Only 2D textures and cube maps can be cached");
+			const std::string filename = enabled ? getFilename(name) : "";
+			double generationTime = 0.0;
+			if (!filename.empty() && isValid(filename, key, generationTime)) {
+				texture.loadFromFile(filename, format, device, queue);
+				timeSaved += generationTime;
+				return true;
+			}
+			auto tStart = std::chrono::high_resolution_clock::now();
+			generate();
+			generationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			if (!filename.empty()) {
+				store(texture, filename, format, std::is_same<T, vks::TextureCubeMap>::value, key, generationTime, queue);
+			}
+			return false;
+		}
+	};
+}
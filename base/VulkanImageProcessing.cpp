@@ -0,0 +1,444 @@
+/*
+* CPU image processing helpers for texture loading
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanImageProcessing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string.h>
+
+#include "threadpool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKS_IMAGEPROCESSING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vks
+{
+	namespace imageprocessing
+	{
+		namespace
+		{
+			const double pi = 3.14159265358979323846;
+
+			// Splits [0, count) into ranges that are processed on the threads of the pool, small workloads run on the calling thread
+			void parallelFor(vks::ThreadPool* threadPool, size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& job)
+			{
+				const size_t threadCount = (threadPool != nullptr) ? threadPool->threads.size() : 1;
+				const size_t chunkCount = std::min(threadCount * 4, (count + grainSize - 1) / grainSize);
+				if ((threadCount < 2) || (chunkCount < 2)) {
+					job(0, count);
+					return;
+				}
+				const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+				for (size_t i = 0; i < chunkCount; i++) {
+					const size_t begin = i * chunkSize;
+					const size_t end = std::min(begin + chunkSize, count);
+					if (begin >= end) {
+						break;
+					}
+					threadPool->threads[i % threadCount]->addJob([&job, begin, end] { job(begin, end); });
+				}
+				threadPool->wait();
+			}
+
+			double sinc(double x)
+			{
+				return (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+			}
+
+			// Zeroth order modified Bessel function of the first kind
+			double besselI0(double x)
+			{
+				double sum = 1.0;
+				double term = 1.0;
+				for (uint32_t k = 1; k < 32; k++) {
+					term *= (x / (2.0 * k)) * (x / (2.0 * k));
+					sum += term;
+				}
+				return sum;
+			}
+
+			// Separable kernel for halving an image, destination texel x reads the source texels [2x + 1 - taps / 2, 2x + taps / 2]
+			struct Kernel {
+				uint32_t taps;
+				float weights[8];
+			};
+
+			Kernel getKernel(Filter filter)
+			{
+				Kernel kernel{};
+				kernel.taps = (filter == Filter::Box) ? 2 : (filter == Filter::Kaiser) ? 4 : 8;
+				double sum = 0.0;
+				double weights[8];
+				for (uint32_t i = 0; i < kernel.taps; i++) {
+					// Distance of the tap's center to the destination texel's center in destination texels
+					const double t = (static_cast<double>(i) - kernel.taps / 2 + 0.5) * 0.5;
+					switch (filter) {
+					case Filter::Box:
+						weights[i] = 1.0;
+						break;
+					case Filter::Kaiser:
+						// Same window as vks::MipGenerator (alpha = 4)
+						weights[i] = sinc(t) * besselI0(4.0 * std::sqrt(std::max(1.0 - t * t, 0.0))) / besselI0(4.0);
+						break;
+					case Filter::Lanczos:
+						weights[i] = sinc(t) * sinc(t / 2.0);
+						break;
+					}
+					sum += weights[i];
+				}
+				for (uint32_t i = 0; i < kernel.taps; i++) {
+					kernel.weights[i] = static_cast<float>(weights[i] / sum);
+				}
+				return kernel;
+			}
+
+			// Lookup tables for sRGB conversion, the encode table is indexed with 12 bit linear values
+			const uint32_t linearToSrgbTableSize = 4096;
+
+			struct SrgbTables {
+				float toLinear[256];
+				float unorm[256];
+				uint8_t toSrgb[linearToSrgbTableSize];
+				SrgbTables()
+				{
+					for (uint32_t i = 0; i < 256; i++) {
+						const double c = i / 255.0;
+						toLinear[i] = static_cast<float>((c <= 0.04045) ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+						unorm[i] = static_cast<float>(c);
+					}
+					for (uint32_t i = 0; i < linearToSrgbTableSize; i++) {
+						const double c = i / static_cast<double>(linearToSrgbTableSize - 1);
+						const double s = (c <= 0.0031308) ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+						toSrgb[i] = static_cast<uint8_t>(std::min(s * 255.0 + 0.5, 255.0));
+					}
+				}
+			};
+
+			const SrgbTables& getSrgbTables()
+			{
+				static const SrgbTables tables;
+				return tables;
+			}
+
+			// Four channel accumulator for the separable filters
+#if defined(VKS_IMAGEPROCESSING_SSE2)
+			typedef __m128 Pixel;
+			inline Pixel pixelZero() { return _mm_setzero_ps(); }
+			inline Pixel pixelLoad(const float* p) { return _mm_loadu_ps(p); }
+			inline void pixelStore(float* p, Pixel v) { _mm_storeu_ps(p, v); }
+			inline Pixel pixelMultiplyAdd(Pixel accumulator, Pixel v, float weight) { return _mm_add_ps(accumulator, _mm_mul_ps(v, _mm_set1_ps(weight))); }
+			inline Pixel pixelSaturate(Pixel v) { return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+#else
+			struct Pixel { float v[4]; };
+			inline Pixel pixelZero() { Pixel p = { { 0.0f, 0.0f, 0.0f, 0.0f } }; return p; }
+			inline Pixel pixelLoad(const float* p) { Pixel r = { { p[0], p[1], p[2], p[3] } }; return r; }
+			inline void pixelStore(float* p, Pixel v) { memcpy(p, v.v, sizeof(v.v)); }
+			inline Pixel pixelMultiplyAdd(Pixel accumulator, Pixel v, float weight)
+			{
+				for (uint32_t c = 0; c < 4; c++) {
+					accumulator.v[c] += v.v[c] * weight;
+				}
+				return accumulator;
+			}
+			inline Pixel pixelSaturate(Pixel v)
+			{
+				for (uint32_t c = 0; c < 4; c++) {
+					v.v[c] = std::min(std::max(v.v[c], 0.0f), 1.0f);
+				}
+				return v;
+			}
+#endif
+
+			// 2x2 average on 8 bit values, used for the box filter without sRGB conversion
+			void downsampleBoxRows(uint8_t* destination, const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, size_t rowBegin, size_t rowEnd)
+			{
+				const uint32_t width = std::max(sourceWidth >> 1, 1u);
+				for (size_t y = rowBegin; y < rowEnd; y++) {
+					const uint8_t* row0 = source + std::min<size_t>(y * 2, sourceHeight - 1) * sourceWidth * 4;
+					const uint8_t* row1 = source + std::min<size_t>(y * 2 + 1, sourceHeight - 1) * sourceWidth * 4;
+					uint8_t* target = destination + y * width * 4;
+					uint32_t x = 0;
+#if defined(VKS_IMAGEPROCESSING_SSE2)
+					// Four destination texels from eight source texels of both rows
+					const __m128i zero = _mm_setzero_si128();
+					const __m128i rounding = _mm_set1_epi16(2);
+					for (; (x + 4) * 2 <= sourceWidth; x += 4) {
+						const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+						const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+						const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+						const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+						// Vertical sums of texel pairs in 16 bit, then add the horizontal neighbours
+						__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+						__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+						__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+						__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+						s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+						s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+						s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+						s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+						__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), rounding), 2);
+						__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), rounding), 2);
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(target + x * 4), _mm_packus_epi16(lo, hi));
+					}
+#endif
+					for (; x < width; x++) {
+						const size_t x0 = std::min(x * 2, sourceWidth - 1) * 4;
+						const size_t x1 = std::min(x * 2 + 1, sourceWidth - 1) * 4;
+						for (uint32_t c = 0; c < 4; c++) {
+							target[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+						}
+					}
+				}
+			}
+
+			// Separable filter in float, used for sRGB data and the wider kernels
+			void downsampleSeparableRows(uint8_t* destination, const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, const Kernel& kernel, bool srgb, size_t rowBegin, size_t rowEnd)
+			{
+				const SrgbTables& tables = getSrgbTables();
+				const float* decode = srgb ? tables.toLinear : tables.unorm;
+				const uint32_t width = std::max(sourceWidth >> 1, 1u);
+				const int32_t taps = static_cast<int32_t>(kernel.taps);
+				const int32_t tapOffset = 1 - taps / 2;
+
+				// Horizontally filtered source rows needed for this range of destination rows
+				const int32_t firstRow = std::max(static_cast<int32_t>(rowBegin) * 2 + tapOffset, 0);
+				const int32_t lastRow = std::min(static_cast<int32_t>(rowEnd - 1) * 2 + tapOffset + taps - 1, static_cast<int32_t>(sourceHeight) - 1);
+				std::vector<float> rows(static_cast<size_t>(lastRow - firstRow + 1) * width * 4);
+				std::vector<float> texels(static_cast<size_t>(sourceWidth) * 4);
+				for (int32_t y = firstRow; y <= lastRow; y++) {
+					const uint8_t* sourceRow = source + static_cast<size_t>(y) * sourceWidth * 4;
+					for (uint32_t i = 0; i < sourceWidth * 4; i++) {
+						texels[i] = decode[sourceRow[i]];
+					}
+					// Alpha is never sRGB encoded
+					if (srgb) {
+						for (uint32_t x = 0; x < sourceWidth; x++) {
+							texels[x * 4 + 3] = tables.unorm[sourceRow[x * 4 + 3]];
+						}
+					}
+					float* target = &rows[static_cast<size_t>(y - firstRow) * width * 4];
+					for (uint32_t x = 0; x < width; x++) {
+						Pixel sum = pixelZero();
+						const int32_t start = static_cast<int32_t>(x) * 2 + tapOffset;
+						for (int32_t t = 0; t < taps; t++) {
+							const int32_t sx = std::min(std::max(start + t, 0), static_cast<int32_t>(sourceWidth) - 1);
+							sum = pixelMultiplyAdd(sum, pixelLoad(&texels[sx * 4]), kernel.weights[t]);
+						}
+						pixelStore(target + x * 4, sum);
+					}
+				}
+
+				float result[4];
+				for (size_t y = rowBegin; y < rowEnd; y++) {
+					uint8_t* target = destination + y * width * 4;
+					const int32_t start = static_cast<int32_t>(y) * 2 + tapOffset;
+					for (uint32_t x = 0; x < width; x++) {
+						Pixel sum = pixelZero();
+						for (int32_t t = 0; t < taps; t++) {
+							const int32_t sy = std::min(std::max(start + t, firstRow), lastRow);
+							sum = pixelMultiplyAdd(sum, pixelLoad(&rows[(static_cast<size_t>(sy - firstRow) * width + x) * 4]), kernel.weights[t]);
+						}
+						// Negative lobes of the Kaiser and Lanczos kernels can over- and undershoot
+						pixelStore(result, pixelSaturate(sum));
+						for (uint32_t c = 0; c < 3; c++) {
+							target[x * 4 + c] = srgb ? tables.toSrgb[static_cast<uint32_t>(result[c] * (linearToSrgbTableSize - 1) + 0.5f)] : static_cast<uint8_t>(result[c] * 255.0f + 0.5f);
+						}
+						target[x * 4 + 3] = static_cast<uint8_t>(result[3] * 255.0f + 0.5f);
+					}
+				}
+			}
+		}
+
+		uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+		{
+			uint32_t levels = 1;
+			for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+				levels++;
+			}
+			return levels;
+		}
+
+		void expandRgbToRgba(uint8_t* destination, const uint8_t* source, size_t pixelCount, uint8_t alpha, vks::ThreadPool* threadPool)
+		{
+			parallelFor(threadPool, pixelCount, 1 << 16, [=](size_t begin, size_t end) {
+				size_t i = begin;
+#if defined(VKS_IMAGEPROCESSING_SSE2)
+				// Four pixels per iteration, each 16 byte load reads past the twelve bytes used, so the last pixels are done by the scalar loop
+				const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+				const __m128i alphaValue = _mm_set1_epi32(static_cast<int32_t>(static_cast<uint32_t>(alpha) << 24));
+				for (; i + 6 <= end; i += 4) {
+					const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+					const __m128i p01 = _mm_unpacklo_epi32(rgb, _mm_srli_si128(rgb, 3));
+					const __m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(rgb, 6), _mm_srli_si128(rgb, 9));
+					const __m128i rgba = _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi64(p01, p23), colorMask), alphaValue);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), rgba);
+				}
+#endif
+				for (; i < end; i++) {
+					destination[i * 4 + 0] = source[i * 3 + 0];
+					destination[i * 4 + 1] = source[i * 3 + 1];
+					destination[i * 4 + 2] = source[i * 3 + 2];
+					destination[i * 4 + 3] = alpha;
+				}
+			});
+		}
+
+		void swizzle(uint8_t* destination, const uint8_t* source, size_t pixelCount, const uint8_t channels[4], vks::ThreadPool* threadPool)
+		{
+			const uint8_t c0 = channels[0], c1 = channels[1], c2 = channels[2], c3 = channels[3];
+			parallelFor(threadPool, pixelCount, 1 << 16, [=](size_t begin, size_t end) {
+				size_t i = begin;
+#if defined(VKS_IMAGEPROCESSING_SSE2)
+				// Each destination channel is the source channel shifted down to the lowest byte, masked and shifted up to its place
+				const __m128i byteMask = _mm_set1_epi32(0xFF);
+				const __m128i shift0 = _mm_cvtsi32_si128(c0 * 8), shift1 = _mm_cvtsi32_si128(c1 * 8), shift2 = _mm_cvtsi32_si128(c2 * 8), shift3 = _mm_cvtsi32_si128(c3 * 8);
+				for (; i + 4 <= end; i += 4) {
+					const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+					__m128i result = _mm_and_si128(_mm_srl_epi32(pixels, shift0), byteMask);
+					result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(_mm_srl_epi32(pixels, shift1), byteMask), 8));
+					result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(_mm_srl_epi32(pixels, shift2), byteMask), 16));
+					result = _mm_or_si128(result, _mm_slli_epi32(_mm_srl_epi32(pixels, shift3), 24));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), result);
+				}
+#endif
+				for (; i < end; i++) {
+					const uint8_t pixel[4] = { source[i * 4 + 0], source[i * 4 + 1], source[i * 4 + 2], source[i * 4 + 3] };
+					destination[i * 4 + 0] = pixel[c0];
+					destination[i * 4 + 1] = pixel[c1];
+					destination[i * 4 + 2] = pixel[c2];
+					destination[i * 4 + 3] = pixel[c3];
+				}
+			});
+		}
+
+		void downsample(uint8_t* destination, const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, Filter filter, bool srgb, vks::ThreadPool* threadPool)
+		{
+			const uint32_t width = std::max(sourceWidth >> 1, 1u);
+			const uint32_t height = std::max(sourceHeight >> 1, 1u);
+			// Aim for jobs of at least 64k destination texels
+			const size_t grainSize = std::max<size_t>((1 << 16) / width, 1);
+			if ((filter == Filter::Box) && !srgb) {
+				parallelFor(threadPool, height, grainSize, [=](size_t begin, size_t end) {
+					downsampleBoxRows(destination, source, sourceWidth, sourceHeight, begin, end);
+				});
+			}
+			else {
+				const Kernel kernel = getKernel(filter);
+				parallelFor(threadPool, height, grainSize, [=, &kernel](size_t begin, size_t end) {
+					downsampleSeparableRows(destination, source, sourceWidth, sourceHeight, kernel, srgb, begin, end);
+				});
+			}
+		}
+
+		void generateMipChain(MipChain& mipChain, const uint8_t* source, uint32_t width, uint32_t height, Filter filter, bool srgb, vks::ThreadPool* threadPool, uint32_t maxLevels)
+		{
+			mipChain.width = width;
+			mipChain.height = height;
+			uint32_t levelCount = getMipLevelCount(width, height);
+			if (maxLevels > 0) {
+				levelCount = std::min(levelCount, maxLevels);
+			}
+			mipChain.levelOffsets.resize(levelCount);
+			size_t size = 0;
+			for (uint32_t level = 0; level < levelCount; level++) {
+				mipChain.levelOffsets[level] = size;
+				size += static_cast<size_t>(mipChain.levelWidth(level)) * mipChain.levelHeight(level) * 4;
+			}
+			mipChain.data.resize(size);
+			memcpy(mipChain.data.data(), source, static_cast<size_t>(width) * height * 4);
+			for (uint32_t level = 1; level < levelCount; level++) {
+				downsample(mipChain.levelData(level), mipChain.levelData(level - 1), mipChain.levelWidth(level - 1), mipChain.levelHeight(level - 1), filter, srgb, threadPool);
+			}
+		}
+
+		BenchmarkResult benchmark(uint32_t width, uint32_t height, Filter filter, bool srgb, vks::ThreadPool* threadPool, uint32_t iterations)
+		{
+			BenchmarkResult result;
+			result.threadCount = (threadPool != nullptr) ? static_cast<uint32_t>(threadPool->threads.size()) : 1;
+
+			const size_t pixelCount = static_cast<size_t>(width) * height;
+			std::vector<uint8_t> rgb(pixelCount * 3);
+			for (size_t i = 0; i < rgb.size(); i++) {
+				rgb[i] = static_cast<uint8_t>((i * 7 + (i / 3) % 251) & 0xFF);
+			}
+			std::vector<uint8_t> rgba(pixelCount * 4);
+
+			auto measure = [iterations](double bytes, const std::function<void()>& function) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < iterations; i++) {
+					function();
+				}
+				const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+				return seconds > 0.0 ? bytes * iterations / seconds : 0.0;
+			};
+
+			// Per byte loop as used by the glTF loaders
+			result.referenceExpandRate = measure(static_cast<double>(rgb.size()), [&] {
+				uint8_t* target = rgba.data();
+				const uint8_t* rgbSource = rgb.data();
+				for (size_t i = 0; i < pixelCount; ++i) {
+					for (int32_t j = 0; j < 3; ++j) {
+						target[j] = rgbSource[j];
+					}
+					target[3] = 255;
+					target += 4;
+					rgbSource += 3;
+				}
+			});
+			result.expandRate = measure(static_cast<double>(rgb.size()), [&] {
+				expandRgbToRgba(rgba.data(), rgb.data(), pixelCount, 255, threadPool);
+			});
+
+			// Straightforward single threaded filter that evaluates the kernel and the sRGB curve per texel and channel
+			const Kernel kernel = getKernel(filter);
+			result.referenceMipChainRate = measure(static_cast<double>(rgba.size()), [&] {
+				std::vector<uint8_t> level(rgba);
+				uint32_t levelWidth = width, levelHeight = height;
+				while ((levelWidth > 1) || (levelHeight > 1)) {
+					const uint32_t w = std::max(levelWidth >> 1, 1u), h = std::max(levelHeight >> 1, 1u);
+					std::vector<uint8_t> next(static_cast<size_t>(w) * h * 4);
+					for (uint32_t y = 0; y < h; y++) {
+						for (uint32_t x = 0; x < w; x++) {
+							for (uint32_t c = 0; c < 4; c++) {
+								double sum = 0.0;
+								for (uint32_t ty = 0; ty < kernel.taps; ty++) {
+									for (uint32_t tx = 0; tx < kernel.taps; tx++) {
+										const int32_t sx = std::min(std::max(static_cast<int32_t>(x * 2 + tx) + 1 - static_cast<int32_t>(kernel.taps / 2), 0), static_cast<int32_t>(levelWidth) - 1);
+										const int32_t sy = std::min(std::max(static_cast<int32_t>(y * 2 + ty) + 1 - static_cast<int32_t>(kernel.taps / 2), 0), static_cast<int32_t>(levelHeight) - 1);
+										double v = level[(static_cast<size_t>(sy) * levelWidth + sx) * 4 + c] / 255.0;
+										if (srgb && (c < 3)) {
+											v = (v <= 0.04045) ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+										}
+										sum += v * kernel.weights[tx] * kernel.weights[ty];
+									}
+								}
+								sum = std::min(std::max(sum, 0.0), 1.0);
+								if (srgb && (c < 3)) {
+									sum = (sum <= 0.0031308) ? sum * 12.92 : 1.055 * std::pow(sum, 1.0 / 2.4) - 0.055;
+								}
+								next[(static_cast<size_t>(y) * w + x) * 4 + c] = static_cast<uint8_t>(sum * 255.0 + 0.5);
+							}
+						}
+					}
+					level.swap(next);
+					levelWidth = w;
+					levelHeight = h;
+				}
+			});
+			MipChain mipChain;
+			result.mipChainRate = measure(static_cast<double>(rgba.size()), [&] {
+				generateMipChain(mipChain, rgba.data(), width, height, filter, srgb, threadPool);
+			});
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+/*
+* CPU image processing helpers for texture loading
+*
+* Channel conversions (RGB to RGBA expansion, swizzles) and mip chain generation with box, Kaiser and Lanczos filters
+* for 8 bit RGBA images, optionally filtered in linear space for sRGB encoded color data
+* Hot loops use SSE2 where available and rows are distributed across an optional thread pool, so loaders can build
+* complete mip chains on worker threads without requiring blit support on the device
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace vks
+{
+	class ThreadPool;
+
+	namespace imageprocessing
+	{
+		enum class Filter {
+			/** @brief 2x2 average, fastest */
+			Box,
+			/** @brief 4x4 Kaiser windowed sinc, same kernel as the compute path of vks::MipGenerator */
+			Kaiser,
+			/** @brief 8x8 Lanczos (a = 2), sharpest but may ring at hard edges */
+			Lanczos
+		};
+
+		/** @brief Mip chain of an 8 bit RGBA image with all levels tightly packed one after another, starting with the base level */
+		struct MipChain {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<uint8_t> data;
+			/** @brief Offset of each level in data in bytes */
+			std::vector<size_t> levelOffsets;
+
+			uint32_t levelCount() const { return static_cast<uint32_t>(levelOffsets.size()); }
+			uint32_t levelWidth(uint32_t level) const { return width >> level > 0 ? width >> level : 1; }
+			uint32_t levelHeight(uint32_t level) const { return height >> level > 0 ? height >> level : 1; }
+			uint8_t* levelData(uint32_t level) { return data.data() + levelOffsets[level]; }
+			const uint8_t* levelData(uint32_t level) const { return data.data() + levelOffsets[level]; }
+		};
+
+		/** @brief Throughput of the current implementation compared to the plain per byte loops it replaces, in source bytes per second */
+		struct BenchmarkResult {
+			double referenceExpandRate = 0.0;
+			double expandRate = 0.0;
+			double referenceMipChainRate = 0.0;
+			double mipChainRate = 0.0;
+			uint32_t threadCount = 1;
+		};
+
+		/** @brief Number of levels of a full mip chain for the given size */
+		uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+		/**
+		* @brief Expands tightly packed 8 bit RGB pixels to RGBA
+		* @param destination Target buffer with room for pixelCount * 4 bytes, must not alias source
+		* @param alpha Value written to the alpha channel
+		*/
+		void expandRgbToRgba(uint8_t* destination, const uint8_t* source, size_t pixelCount, uint8_t alpha = 255, vks::ThreadPool* threadPool = nullptr);
+
+		/**
+		* @brief Reorders the channels of 8 bit RGBA pixels, destination channel i is taken from source channel channels[i]
+		* @note destination may alias source, e.g. { 2, 1, 0, 3 } converts between RGBA and BGRA in place
+		*/
+		void swizzle(uint8_t* destination, const uint8_t* source, size_t pixelCount, const uint8_t channels[4], vks::ThreadPool* threadPool = nullptr);
+
+		/**
+		* @brief Halves the size of an 8 bit RGBA image (each dimension is clamped to one)
+		* @param srgb Decode the color channels from sRGB before filtering and encode the result (alpha is always linear)
+		*/
+		void downsample(uint8_t* destination, const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, Filter filter = Filter::Box, bool srgb = false, vks::ThreadPool* threadPool = nullptr);
+
+		/**
+		* @brief Builds the mip chain of an 8 bit RGBA image, each level is generated from the previous one
+		* @param maxLevels Limits the number of levels, 0 generates the full chain
+		* @param threadPool Optional, rows of each level are distributed across its threads (small levels are done on the calling thread)
+		*/
+		void generateMipChain(MipChain& mipChain, const uint8_t* source, uint32_t width, uint32_t height, Filter filter = Filter::Box, bool srgb = false, vks::ThreadPool* threadPool = nullptr, uint32_t maxLevels = 0);
+
+		/** @brief Measures the RGB expansion and mip chain generation on a generated image of the given size against straightforward single threaded loops */
+		BenchmarkResult benchmark(uint32_t width, uint32_t height, Filter filter = Filter::Box, bool srgb = false, vks::ThreadPool* threadPool = nullptr, uint32_t iterations = 4);
+	}
+}
@@ -0,0 +1,585 @@
+/*
+* Mesh optimization helpers for vertex cache, overdraw and vertex fetch efficiency
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMeshOptimizer.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		namespace
+		{
+			// Symmetric 4x4 matrix storing the sum of squared distances to a set of planes
+			struct Quadric {
+				double a00, a01, a02, a03;
+				double a11, a12, a13;
+				double a22, a23;
+				double a33;
+			};
+
+			Quadric quadricFromPlane(double a, double b, double c, double d)
+			{
+				Quadric q;
+				q.a00 = a * a; q.a01 = a * b; q.a02 = a * c; q.a03 = a * d;
+				q.a11 = b * b; q.a12 = b * c; q.a13 = b * d;
+				q.a22 = c * c; q.a23 = c * d;
+				q.a33 = d * d;
+				return q;
+			}
+
+			void quadricAdd(Quadric& q, const Quadric& r)
+			{
+				q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+				q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+				q.a22 += r.a22; q.a23 += r.a23;
+				q.a33 += r.a33;
+			}
+
+			double quadricError(const Quadric& q, const float* p)
+			{
+				const double x = p[0], y = p[1], z = p[2];
+				const double error =
+					q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x +
+					q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y +
+					q.a22 * z * z + 2.0 * q.a23 * z +
+					q.a33;
+				// Can become slightly negative due to rounding
+				return error > 0.0 ? error : 0.0;
+			}
+
+			void triangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+			{
+				const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+				n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+				n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+			}
+		}
+
+		VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+		{
+			assert(indexCount % 3 == 0);
+			VertexCacheStatistics statistics{};
+			// Each vertex stores the value of the miss counter at the time it was put into the FIFO
+			// The vertex is still cached as long as less than cacheSize other vertices have been inserted since
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			uint32_t timestamp = cacheSize + 1;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				assert(index < vertexCount);
+				if (timestamp - cacheTimestamps[index] > cacheSize) {
+					cacheTimestamps[index] = timestamp++;
+					statistics.vertexTransforms++;
+				}
+			}
+			statistics.acmr = indexCount > 0 ? (float)statistics.vertexTransforms / (float)(indexCount / 3) : 0.0f;
+			statistics.atvr = vertexCount > 0 ? (float)statistics.vertexTransforms / (float)vertexCount : 0.0f;
+			return statistics;
+		}
+
+		void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* clusters)
+		{
+			assert(destination != indices);
+			assert(indexCount % 3 == 0);
+			const size_t triangleCount = indexCount / 3;
+
+			if (clusters) {
+				clusters->clear();
+			}
+			if (triangleCount == 0) {
+				return;
+			}
+
+			// Build vertex to triangle adjacency (compressed row storage)
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (size_t i = 0; i < indexCount; i++) {
+				assert(indices[i] < vertexCount);
+				liveTriangles[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+			}
+			std::vector<uint32_t> adjacency(indexCount);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < indexCount; i++) {
+					adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEndStack;
+			deadEndStack.reserve(indexCount);
+			std::vector<uint32_t> candidates;
+			candidates.reserve(64);
+
+			uint32_t timestamp = cacheSize + 1;
+			size_t cursor = 0;
+			size_t outputIndex = 0;
+			bool clusterStart = true;
+
+			// Start with the first vertex that is referenced by a triangle
+			while (liveTriangles[cursor] == 0) {
+				cursor++;
+			}
+			int64_t fanningVertex = static_cast<int64_t>(cursor);
+
+			while (fanningVertex >= 0) {
+				candidates.clear();
+				if (clusterStart && clusters) {
+					clusters->push_back(static_cast<uint32_t>(outputIndex));
+				}
+				clusterStart = false;
+
+				// Emit all remaining triangles of the fanning vertex
+				const uint32_t f = static_cast<uint32_t>(fanningVertex);
+				for (uint32_t a = adjacencyOffsets[f]; a < adjacencyOffsets[f + 1]; a++) {
+					const uint32_t triangle = adjacency[a];
+					if (emitted[triangle]) {
+						continue;
+					}
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t v = indices[triangle * 3 + k];
+						destination[outputIndex++] = v;
+						deadEndStack.push_back(v);
+						candidates.push_back(v);
+						liveTriangles[v]--;
+						if (timestamp - cacheTimestamps[v] > cacheSize) {
+							cacheTimestamps[v] = timestamp++;
+						}
+					}
+					emitted[triangle] = true;
+				}
+
+				// Select the next fanning vertex among the vertices of the last fan that are still in the cache
+				int64_t next = -1;
+				int64_t bestPriority = -1;
+				for (uint32_t v : candidates) {
+					if (liveTriangles[v] == 0) {
+						continue;
+					}
+					int64_t priority = 0;
+					// Prefer vertices that will still be in the cache once all of their triangles have been emitted
+					if ((int64_t)timestamp - (int64_t)cacheTimestamps[v] + 2 * (int64_t)liveTriangles[v] <= (int64_t)cacheSize) {
+						priority = (int64_t)timestamp - (int64_t)cacheTimestamps[v];
+					}
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						next = v;
+					}
+				}
+
+				if (next == -1) {
+					// Dead end, the next fan is likely to miss the cache so this is a good place to start a new cluster for overdraw sorting
+					clusterStart = true;
+					// Try recently used vertices first and fall back to the input order
+					while (!deadEndStack.empty()) {
+						const uint32_t v = deadEndStack.back();
+						deadEndStack.pop_back();
+						if (liveTriangles[v] > 0) {
+							next = v;
+							break;
+						}
+					}
+					if (next == -1) {
+						while (cursor < vertexCount) {
+							if (liveTriangles[cursor] > 0) {
+								next = static_cast<int64_t>(cursor);
+								break;
+							}
+							cursor++;
+						}
+					}
+				}
+				fanningVertex = next;
+			}
+			assert(outputIndex == indexCount);
+		}
+
+		void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, const std::vector<uint32_t>& clusters)
+		{
+			assert(destination != indices);
+			assert(indexCount % 3 == 0);
+
+			const uint8_t* positionData = reinterpret_cast<const uint8_t*>(positions);
+			auto position = [&](uint32_t index) {
+				return reinterpret_cast<const float*>(positionData + index * vertexStride);
+			};
+
+			if (clusters.size() < 2) {
+				std::copy(indices, indices + indexCount, destination);
+				return;
+			}
+
+			// Mesh centroid (area weighted) serves as the reference point for the view independent sort
+			float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+			float meshArea = 0.0f;
+
+			struct Cluster {
+				uint32_t firstIndex;
+				uint32_t indexCount;
+				float centroid[3];
+				float normal[3];
+				float area;
+				float sortKey;
+			};
+			std::vector<Cluster> sortClusters(clusters.size());
+
+			for (size_t c = 0; c < clusters.size(); c++) {
+				Cluster& cluster = sortClusters[c];
+				cluster.firstIndex = clusters[c];
+				cluster.indexCount = static_cast<uint32_t>(((c + 1) < clusters.size() ? clusters[c + 1] : indexCount) - clusters[c]);
+				cluster.centroid[0] = cluster.centroid[1] = cluster.centroid[2] = 0.0f;
+				cluster.normal[0] = cluster.normal[1] = cluster.normal[2] = 0.0f;
+				cluster.area = 0.0f;
+				for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i += 3) {
+					assert(indices[i] < vertexCount && indices[i + 1] < vertexCount && indices[i + 2] < vertexCount);
+					const float* p0 = position(indices[i]);
+					const float* p1 = position(indices[i + 1]);
+					const float* p2 = position(indices[i + 2]);
+					const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					// Unnormalized face normal, its length is twice the triangle area
+					const float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+					const float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5f;
+					for (uint32_t k = 0; k < 3; k++) {
+						cluster.centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+						cluster.normal[k] += n[k];
+					}
+					cluster.area += area;
+				}
+				for (uint32_t k = 0; k < 3; k++) {
+					meshCentroid[k] += cluster.centroid[k];
+				}
+				meshArea += cluster.area;
+				if (cluster.area > 0.0f) {
+					for (uint32_t k = 0; k < 3; k++) {
+						cluster.centroid[k] /= cluster.area;
+					}
+				}
+				const float length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+				if (length > 0.0f) {
+					for (uint32_t k = 0; k < 3; k++) {
+						cluster.normal[k] /= length;
+					}
+				}
+			}
+			if (meshArea > 0.0f) {
+				for (uint32_t k = 0; k < 3; k++) {
+					meshCentroid[k] /= meshArea;
+				}
+			}
+
+			// Clusters that are far out and facing away from the center are likely to occlude others, so draw them first
+			for (auto& cluster : sortClusters) {
+				cluster.sortKey =
+					(cluster.centroid[0] - meshCentroid[0]) * cluster.normal[0] +
+					(cluster.centroid[1] - meshCentroid[1]) * cluster.normal[1] +
+					(cluster.centroid[2] - meshCentroid[2]) * cluster.normal[2];
+			}
+			std::stable_sort(sortClusters.begin(), sortClusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+			size_t outputIndex = 0;
+			for (auto& cluster : sortClusters) {
+				std::copy(indices + cluster.firstIndex, indices + cluster.firstIndex + cluster.indexCount, destination + outputIndex);
+				outputIndex += cluster.indexCount;
+			}
+			assert(outputIndex == indexCount);
+		}
+
+		size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			const uint32_t unused = ~0u;
+			std::fill(remap, remap + vertexCount, unused);
+			uint32_t nextVertex = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				assert(indices[i] < vertexCount);
+				if (remap[indices[i]] == unused) {
+					remap[indices[i]] = nextVertex++;
+				}
+			}
+			const size_t referencedVertices = nextVertex;
+			// Keep unreferenced vertices at the end, so the vertex count of the mesh does not change
+			for (size_t v = 0; v < vertexCount; v++) {
+				if (remap[v] == unused) {
+					remap[v] = nextVertex++;
+				}
+			}
+			return referencedVertices;
+		}
+
+		void remapIndexBuffer(uint32_t* indices, size_t indexCount, const uint32_t* remap)
+		{
+			for (size_t i = 0; i < indexCount; i++) {
+				indices[i] = remap[indices[i]];
+			}
+		}
+
+		size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, float* resultError)
+		{
+			assert(indexCount % 3 == 0);
+
+			const uint8_t* positionData = reinterpret_cast<const uint8_t*>(positions);
+			auto position = [&](uint32_t index) {
+				return reinterpret_cast<const float*>(positionData + index * vertexStride);
+			};
+
+			if (resultError) {
+				*resultError = 0.0f;
+			}
+
+			// Weld vertices by position, collapses and topology are evaluated on the welded vertices while the output keeps the original vertex indices
+			std::vector<bool> referenced(vertexCount, false);
+			for (size_t i = 0; i < indexCount; i++) {
+				assert(indices[i] < vertexCount);
+				referenced[indices[i]] = true;
+			}
+			std::vector<uint32_t> sortedVertices;
+			sortedVertices.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (referenced[v]) {
+					sortedVertices.push_back(v);
+				}
+			}
+			std::sort(sortedVertices.begin(), sortedVertices.end(), [&](uint32_t a, uint32_t b) {
+				const float* pa = position(a);
+				const float* pb = position(b);
+				if (pa[0] != pb[0]) return pa[0] < pb[0];
+				if (pa[1] != pb[1]) return pa[1] < pb[1];
+				return pa[2] < pb[2];
+			});
+			std::vector<uint32_t> welded(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				welded[v] = v;
+			}
+			// Vertices that share a position with other vertices lie on an attribute seam
+			std::vector<bool> locked(vertexCount, false);
+			for (size_t i = 1; i < sortedVertices.size(); i++) {
+				const float* pa = position(sortedVertices[i - 1]);
+				const float* pb = position(sortedVertices[i]);
+				if (pa[0] == pb[0] && pa[1] == pb[1] && pa[2] == pb[2]) {
+					welded[sortedVertices[i]] = welded[sortedVertices[i - 1]];
+					locked[welded[sortedVertices[i]]] = true;
+				}
+			}
+
+			// Errors are reported relative to the extent of the mesh
+			float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t v : sortedVertices) {
+				for (uint32_t k = 0; k < 3; k++) {
+					min[k] = std::min(min[k], position(v)[k]);
+					max[k] = std::max(max[k], position(v)[k]);
+				}
+			}
+			const double extent = sortedVertices.empty() ? 0.0 : sqrt((double)(max[0] - min[0]) * (max[0] - min[0]) + (double)(max[1] - min[1]) * (max[1] - min[1]) + (double)(max[2] - min[2]) * (max[2] - min[2]));
+
+			// Remove triangles that are degenerate after welding
+			std::vector<uint32_t> result;
+			result.reserve(indexCount);
+			for (size_t i = 0; i < indexCount; i += 3) {
+				const uint32_t a = welded[indices[i]], b = welded[indices[i + 1]], c = welded[indices[i + 2]];
+				if (a != b && b != c && a != c) {
+					result.insert(result.end(), indices + i, indices + i + 3);
+				}
+			}
+
+			if ((extent <= 0.0) || (result.size() <= targetIndexCount)) {
+				std::copy(result.begin(), result.end(), destination);
+				return result.size();
+			}
+
+			// Accumulate the planes of all adjacent triangles for each welded vertex
+			std::vector<Quadric> quadrics(vertexCount, Quadric{});
+			for (size_t i = 0; i < result.size(); i += 3) {
+				const float* p0 = position(result[i]);
+				float n[3];
+				triangleNormal(p0, position(result[i + 1]), position(result[i + 2]), n);
+				const double length = sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+				if (length <= 0.0) {
+					continue;
+				}
+				const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+				const Quadric q = quadricFromPlane(a, b, c, -(a * p0[0] + b * p0[1] + c * p0[2]));
+				for (uint32_t k = 0; k < 3; k++) {
+					quadricAdd(quadrics[welded[result[i + k]]], q);
+				}
+			}
+
+			// Edges that aren't shared by exactly two triangles are open borders or non-manifold, lock their vertices to keep the outline of the mesh
+			{
+				std::vector<uint64_t> edges;
+				edges.reserve(result.size());
+				for (size_t i = 0; i < result.size(); i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t a = welded[result[i + k]];
+						const uint32_t b = welded[result[i + (k + 1) % 3]];
+						edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				for (size_t i = 0; i < edges.size();) {
+					size_t j = i + 1;
+					while (j < edges.size() && edges[j] == edges[i]) {
+						j++;
+					}
+					if (j - i != 2) {
+						locked[(uint32_t)(edges[i] >> 32)] = true;
+						locked[(uint32_t)(edges[i] & 0xffffffff)] = true;
+					}
+					i = j;
+				}
+			}
+
+			struct Collapse {
+				uint32_t from;
+				uint32_t to;
+				double error;
+			};
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			std::vector<bool> touched(vertexCount);
+			std::vector<uint32_t> remap(vertexCount);
+
+			const double errorLimit = (double)targetError * extent * (double)targetError * extent;
+			double maxError = 0.0;
+
+			// Each pass collapses a set of independent edges in order of increasing error
+			while (result.size() > targetIndexCount) {
+				const size_t triangleCount = result.size() / 3;
+
+				collapses.clear();
+				for (size_t i = 0; i < result.size(); i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t a = result[i + k];
+						const uint32_t b = result[i + (k + 1) % 3];
+						const uint32_t wa = welded[a], wb = welded[b];
+						// Vertices are collapsed onto the position of the other vertex, so the combined quadric is evaluated there
+						if (!locked[wa]) {
+							Quadric q = quadrics[wa];
+							quadricAdd(q, quadrics[wb]);
+							collapses.push_back({ a, b, quadricError(q, position(b)) });
+						}
+						if (!locked[wb]) {
+							Quadric q = quadrics[wb];
+							quadricAdd(q, quadrics[wa]);
+							collapses.push_back({ b, a, quadricError(q, position(a)) });
+						}
+					}
+				}
+				if (collapses.empty()) {
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+				// Welded vertex to triangle adjacency (compressed row storage)
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (size_t i = 0; i < result.size(); i++) {
+					adjacencyOffsets[welded[result[i]] + 1]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++) {
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				adjacency.resize(result.size());
+				{
+					std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+					for (size_t i = 0; i < result.size(); i++) {
+						adjacency[fill[welded[result[i]]]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+
+				std::fill(touched.begin(), touched.end(), false);
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					remap[v] = v;
+				}
+
+				size_t remainingTriangles = triangleCount;
+				size_t appliedCollapses = 0;
+				for (const Collapse& collapse : collapses) {
+					if ((remainingTriangles * 3 <= targetIndexCount) || (collapse.error > errorLimit)) {
+						break;
+					}
+					const uint32_t wa = welded[collapse.from];
+					const uint32_t wb = welded[collapse.to];
+					if (touched[wa] || touched[wb]) {
+						continue;
+					}
+
+					// Reject collapses that would flip the orientation of one of the remaining triangles
+					bool valid = true;
+					size_t removedTriangles = 0;
+					for (uint32_t a = adjacencyOffsets[wa]; a < adjacencyOffsets[wa + 1] && valid; a++) {
+						const uint32_t* triangle = &result[adjacency[a] * 3];
+						if (welded[triangle[0]] == wb || welded[triangle[1]] == wb || welded[triangle[2]] == wb) {
+							removedTriangles++;
+							continue;
+						}
+						const float* p[3];
+						const float* q[3];
+						for (uint32_t k = 0; k < 3; k++) {
+							p[k] = position(triangle[k]);
+							q[k] = (welded[triangle[k]] == wa) ? position(collapse.to) : p[k];
+						}
+						float n0[3], n1[3];
+						triangleNormal(p[0], p[1], p[2], n0);
+						triangleNormal(q[0], q[1], q[2], n1);
+						if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0f) {
+							valid = false;
+						}
+					}
+					if (!valid) {
+						continue;
+					}
+
+					remap[collapse.from] = collapse.to;
+					quadricAdd(quadrics[wb], quadrics[wa]);
+					maxError = std::max(maxError, collapse.error);
+					remainingTriangles -= removedTriangles;
+					appliedCollapses++;
+
+					// Triangles around the collapsed vertex change shape, so keep their vertices fixed for the rest of this pass
+					touched[wa] = true;
+					for (uint32_t a = adjacencyOffsets[wa]; a < adjacencyOffsets[wa + 1]; a++) {
+						for (uint32_t k = 0; k < 3; k++) {
+							touched[welded[result[adjacency[a] * 3 + k]]] = true;
+						}
+					}
+				}
+
+				if (appliedCollapses == 0) {
+					break;
+				}
+
+				// Apply the collapses and remove triangles that became degenerate
+				size_t writeIndex = 0;
+				for (size_t i = 0; i < result.size(); i += 3) {
+					const uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+					if (welded[a] != welded[b] && welded[b] != welded[c] && welded[a] != welded[c]) {
+						result[writeIndex++] = a;
+						result[writeIndex++] = b;
+						result[writeIndex++] = c;
+					}
+				}
+				result.resize(writeIndex);
+			}
+
+			if (resultError) {
+				*resultError = static_cast<float>(sqrt(maxError) / extent);
+			}
+			std::copy(result.begin(), result.end(), destination);
+			return result.size();
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+* Mesh optimization helpers for vertex cache, overdraw and vertex fetch efficiency
+*
+* Implements Tipsify (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+* along with a FIFO post-transform cache simulator that can be used to verify the results on the CPU
+* and a quadric error metric based simplifier (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics")
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		/** @brief Default number of entries of the simulated post-transform vertex cache */
+		const uint32_t defaultCacheSize = 16;
+
+		/** @brief Results of a post-transform vertex cache simulation */
+		struct VertexCacheStatistics {
+			/** @brief Number of vertex shader invocations (cache misses) */
+			uint32_t vertexTransforms = 0;
+			/** @brief Average cache miss ratio, transformed vertices per triangle (best case 0.5, worst case 3.0) */
+			float acmr = 0.0f;
+			/** @brief Average transform to vertex ratio, transformed vertices per vertex (best case 1.0) */
+			float atvr = 0.0f;
+		};
+
+		/** @brief Runs a FIFO post-transform cache simulation over the given triangle list without requiring a GPU */
+		VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultCacheSize);
+
+		/**
+		* @brief Reorders a triangle list for post-transform vertex cache locality using Tipsify
+		* @param destination Target index list (indexCount elements), must not alias indices
+		* @param indices Source triangle list with indices in the range [0, vertexCount)
+		* @param clusters Optional list that receives the first index of every cluster (a new cluster starts at each dead end of the fan sequence), used for overdraw optimization
+		*/
+		void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultCacheSize, std::vector<uint32_t>* clusters = nullptr);
+
+		/**
+		* @brief Sorts the clusters of a vertex cache optimized triangle list so that outward facing clusters get drawn first to reduce overdraw
+		* @param positions Pointer to the first vertex position (three floats), vertexStride is the distance between two positions in bytes
+		* @note Triangles within a cluster keep their order, so the vertex cache efficiency is mostly retained
+		*/
+		void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, const std::vector<uint32_t>& clusters);
+
+		/**
+		* @brief Generates a vertex remap table that orders vertices by first use in the index list for vertex fetch locality
+		* @param remap Receives the new position for each old vertex (vertexCount elements), unreferenced vertices are moved to the end
+		* @return Number of vertices referenced by the index list
+		*/
+		size_t optimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+		/** @brief Applies a remap table generated by optimizeVertexFetchRemap to an index list (in place) */
+		void remapIndexBuffer(uint32_t* indices, size_t indexCount, const uint32_t* remap);
+
+		/**
+		* @brief Reduces the number of triangles of a triangle list using edge collapses ordered by the quadric error metric
+		* @param destination Target index list, needs room for indexCount elements, may alias indices
+		* @param positions Pointer to the first vertex position (three floats), vertexStride is the distance between two positions in bytes
+		* @param targetIndexCount Number of indices to reduce the triangle list to, the result can be larger if the error limit is reached first
+		* @param targetError Maximum error relative to the extent of the mesh (e.g. 0.01 for 1%)
+		* @param resultError Optional, receives the largest error (relative to the extent of the mesh) introduced by the collapses
+		* @note Only the index list is modified and vertices are collapsed onto existing vertices, so the vertex buffer can be shared by all levels of detail
+		* @note Vertices on attribute seams (different vertices sharing a position) and open borders are never moved, so texture seams and mesh outlines are preserved
+		* @return Number of indices written to destination
+		*/
+		size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+		/** @brief Applies a remap table generated by optimizeVertexFetchRemap to a vertex list */
+		template <typename T>
+		void remapVertexBuffer(T* vertices, size_t vertexCount, const uint32_t* remap)
+		{
+			std::vector<T> source(vertices, vertices + vertexCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				vertices[remap[i]] = source[i];
+			}
+		}
+	}
+}
@@ -0,0 +1,289 @@
+/*
+* Meshlet generation, bounds and culling helpers for task/mesh shader based rendering
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMeshlet.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace vks
+{
+	namespace meshlet
+	{
+		namespace
+		{
+			const uint32_t cacheMagic = 0x4c48534d; // "MSHL"
+			const uint32_t cacheVersion = 1;
+
+			struct CacheHeader {
+				uint32_t magic;
+				uint32_t version;
+				uint64_t key;
+				uint32_t meshletCount;
+				uint32_t vertexCount;
+				uint32_t triangleCount;
+				uint32_t groupCount;
+			};
+
+			Bounds computeBounds(const MeshletSet& meshletSet, const Meshlet& meshlet, const float* positions, size_t vertexStride)
+			{
+				const uint8_t* positionData = reinterpret_cast<const uint8_t*>(positions);
+				auto position = [&](uint32_t localIndex) {
+					const float* p = reinterpret_cast<const float*>(positionData + meshletSet.vertices[meshlet.vertexOffset + localIndex] * vertexStride);
+					return glm::vec3(p[0], p[1], p[2]);
+				};
+
+				Bounds bounds{};
+
+				// Bounding sphere centered at the center of the axis aligned bounds
+				glm::vec3 min(FLT_MAX);
+				glm::vec3 max(-FLT_MAX);
+				for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+					const glm::vec3 p = position(i);
+					min = glm::min(min, p);
+					max = glm::max(max, p);
+				}
+				const glm::vec3 center = (min + max) * 0.5f;
+				float radius = 0.0f;
+				for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+					radius = std::max(radius, glm::length(position(i) - center));
+				}
+				bounds.sphere = glm::vec4(center, radius);
+
+				// Normal cone, the axis is the average of the face normals and the spread is given by the largest deviation from it
+				std::vector<glm::vec3> normals;
+				normals.reserve(meshlet.triangleCount);
+				glm::vec3 axis(0.0f);
+				for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+					const uint32_t triangle = meshletSet.triangles[meshlet.triangleOffset + t];
+					const glm::vec3 p0 = position(triangle & 0xff);
+					const glm::vec3 p1 = position((triangle >> 8) & 0xff);
+					const glm::vec3 p2 = position((triangle >> 16) & 0xff);
+					const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+					const float length = glm::length(n);
+					// Degenerate triangles don't contribute to visibility
+					if (length > 0.0f) {
+						normals.push_back(n / length);
+						axis += normals.back();
+					}
+				}
+				const float axisLength = glm::length(axis);
+				if (normals.empty() || axisLength <= 0.0f) {
+					bounds.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+					return bounds;
+				}
+				axis /= axisLength;
+				float minDot = 1.0f;
+				for (auto& n : normals) {
+					minDot = std::min(minDot, glm::dot(n, axis));
+				}
+				// A cone with an opening angle of 90 degrees or more can't be used for backface culling
+				const float cutoff = minDot <= 0.0f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+				bounds.cone = glm::vec4(axis, cutoff);
+				return bounds;
+			}
+		}
+
+		void MeshletSet::clear()
+		{
+			meshlets.clear();
+			bounds.clear();
+			vertices.clear();
+			triangles.clear();
+			groups.clear();
+		}
+
+		uint32_t build(MeshletSet& meshletSet, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, uint32_t maxVertices, uint32_t maxTriangles)
+		{
+			assert(indexCount % 3 == 0);
+			// Local indices are stored as 8 bits
+			assert(maxVertices >= 3 && maxVertices <= 256);
+			assert(maxTriangles >= 1);
+
+			Group group{};
+			group.firstMeshlet = static_cast<uint32_t>(meshletSet.meshlets.size());
+
+			// Meshlet local index of each vertex of the current meshlet, -1 if the vertex has not been added yet
+			std::vector<int16_t> localIndices(vertexCount, -1);
+
+			Meshlet meshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(meshletSet.vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(meshletSet.triangles.size());
+
+			auto finishMeshlet = [&]() {
+				if (meshlet.triangleCount == 0) {
+					return;
+				}
+				for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+					localIndices[meshletSet.vertices[meshlet.vertexOffset + i]] = -1;
+				}
+				meshletSet.meshlets.push_back(meshlet);
+				meshletSet.bounds.push_back(computeBounds(meshletSet, meshlet, positions, vertexStride));
+				meshlet.vertexOffset = static_cast<uint32_t>(meshletSet.vertices.size());
+				meshlet.triangleOffset = static_cast<uint32_t>(meshletSet.triangles.size());
+				meshlet.vertexCount = 0;
+				meshlet.triangleCount = 0;
+			};
+
+			for (size_t i = 0; i < indexCount; i += 3) {
+				const uint32_t a = indices[i];
+				const uint32_t b = indices[i + 1];
+				const uint32_t c = indices[i + 2];
+				assert(a < vertexCount && b < vertexCount && c < vertexCount);
+
+				const uint32_t newVertices = (localIndices[a] < 0) + (localIndices[b] < 0 && b != a) + (localIndices[c] < 0 && c != a && c != b);
+				if ((meshlet.vertexCount + newVertices > maxVertices) || (meshlet.triangleCount + 1 > maxTriangles)) {
+					finishMeshlet();
+				}
+
+				uint32_t local[3];
+				const uint32_t triangle[3] = { a, b, c };
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t v = triangle[k];
+					if (localIndices[v] < 0) {
+						localIndices[v] = static_cast<int16_t>(meshlet.vertexCount++);
+						meshletSet.vertices.push_back(v);
+					}
+					local[k] = static_cast<uint32_t>(localIndices[v]);
+				}
+				meshletSet.triangles.push_back(local[0] | (local[1] << 8) | (local[2] << 16));
+				meshlet.triangleCount++;
+			}
+			finishMeshlet();
+
+			group.meshletCount = static_cast<uint32_t>(meshletSet.meshlets.size()) - group.firstMeshlet;
+			meshletSet.groups.push_back(group);
+			return static_cast<uint32_t>(meshletSet.groups.size() - 1);
+		}
+
+		Statistics getStatistics(const MeshletSet& meshletSet, uint32_t maxVertices, uint32_t maxTriangles)
+		{
+			Statistics statistics{};
+			statistics.meshletCount = static_cast<uint32_t>(meshletSet.meshlets.size());
+			for (size_t i = 0; i < meshletSet.meshlets.size(); i++) {
+				statistics.vertexCount += meshletSet.meshlets[i].vertexCount;
+				statistics.triangleCount += meshletSet.meshlets[i].triangleCount;
+				if (meshletSet.bounds[i].cone.w < 1.0f) {
+					statistics.coneCullable++;
+				}
+			}
+			if (statistics.meshletCount > 0) {
+				statistics.averageVertices = (float)statistics.vertexCount / (float)statistics.meshletCount;
+				statistics.averageTriangles = (float)statistics.triangleCount / (float)statistics.meshletCount;
+				statistics.vertexUtilization = statistics.averageVertices / (float)maxVertices;
+				statistics.triangleUtilization = statistics.averageTriangles / (float)maxTriangles;
+			}
+			return statistics;
+		}
+
+		bool isVisible(const Bounds& bounds, const glm::vec4* frustumPlanes, const glm::vec3& cameraPosition, bool coneCulling, bool* coneCulled)
+		{
+			if (coneCulled) {
+				*coneCulled = false;
+			}
+			const glm::vec3 center = glm::vec3(bounds.sphere);
+			const float radius = bounds.sphere.w;
+			for (uint32_t i = 0; i < 6; i++) {
+				if (glm::dot(glm::vec3(frustumPlanes[i]), center) + frustumPlanes[i].w <= -radius) {
+					return false;
+				}
+			}
+			// The meshlet is backfacing if the camera lies within the negative normal cone (apex placed at the sphere center, enlarged by the radius)
+			if (coneCulling && bounds.cone.w < 1.0f) {
+				const glm::vec3 view = center - cameraPosition;
+				if (glm::dot(view, glm::vec3(bounds.cone)) >= bounds.cone.w * glm::length(view) + radius) {
+					if (coneCulled) {
+						*coneCulled = true;
+					}
+					return false;
+				}
+			}
+			return true;
+		}
+
+		CullStatistics cull(const MeshletSet& meshletSet, const glm::vec4* frustumPlanes, const glm::vec3& cameraPosition, bool coneCulling, std::vector<uint32_t>* visibleMeshlets)
+		{
+			CullStatistics statistics{};
+			if (visibleMeshlets) {
+				visibleMeshlets->clear();
+			}
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < meshletSet.bounds.size(); i++) {
+				bool coneCulled;
+				if (isVisible(meshletSet.bounds[i], frustumPlanes, cameraPosition, coneCulling, &coneCulled)) {
+					statistics.visible++;
+					if (visibleMeshlets) {
+						visibleMeshlets->push_back(static_cast<uint32_t>(i));
+					}
+				} else if (coneCulled) {
+					statistics.coneCulled++;
+				} else {
+					statistics.frustumCulled++;
+				}
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			statistics.tested = static_cast<uint32_t>(meshletSet.bounds.size());
+			statistics.time = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			return statistics;
+		}
+
+		bool saveToFile(const MeshletSet& meshletSet, const std::string& filename, uint64_t key)
+		{
+			std::ofstream file(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+			CacheHeader header{};
+			header.magic = cacheMagic;
+			header.version = cacheVersion;
+			header.key = key;
+			header.meshletCount = static_cast<uint32_t>(meshletSet.meshlets.size());
+			header.vertexCount = static_cast<uint32_t>(meshletSet.vertices.size());
+			header.triangleCount = static_cast<uint32_t>(meshletSet.triangles.size());
+			header.groupCount = static_cast<uint32_t>(meshletSet.groups.size());
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(meshletSet.meshlets.data()), meshletSet.meshlets.size() * sizeof(Meshlet));
+			file.write(reinterpret_cast<const char*>(meshletSet.bounds.data()), meshletSet.bounds.size() * sizeof(Bounds));
+			file.write(reinterpret_cast<const char*>(meshletSet.vertices.data()), meshletSet.vertices.size() * sizeof(uint32_t));
+			file.write(reinterpret_cast<const char*>(meshletSet.triangles.data()), meshletSet.triangles.size() * sizeof(uint32_t));
+			file.write(reinterpret_cast<const char*>(meshletSet.groups.data()), meshletSet.groups.size() * sizeof(Group));
+			return file.good();
+		}
+
+		bool loadFromFile(MeshletSet& meshletSet, const std::string& filename, uint64_t key)
+		{
+			std::ifstream file(filename, std::ios::binary | std::ios::in);
+			if (!file.is_open()) {
+				return false;
+			}
+			CacheHeader header{};
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+			if (!file.good() || header.magic != cacheMagic || header.version != cacheVersion || header.key != key) {
+				return false;
+			}
+			MeshletSet cached;
+			cached.meshlets.resize(header.meshletCount);
+			cached.bounds.resize(header.meshletCount);
+			cached.vertices.resize(header.vertexCount);
+			cached.triangles.resize(header.triangleCount);
+			cached.groups.resize(header.groupCount);
+			file.read(reinterpret_cast<char*>(cached.meshlets.data()), cached.meshlets.size() * sizeof(Meshlet));
+			file.read(reinterpret_cast<char*>(cached.bounds.data()), cached.bounds.size() * sizeof(Bounds));
+			file.read(reinterpret_cast<char*>(cached.vertices.data()), cached.vertices.size() * sizeof(uint32_t));
+			file.read(reinterpret_cast<char*>(cached.triangles.data()), cached.triangles.size() * sizeof(uint32_t));
+			file.read(reinterpret_cast<char*>(cached.groups.data()), cached.groups.size() * sizeof(Group));
+			if (!file.good()) {
+				return false;
+			}
+			meshletSet = std::move(cached);
+			return true;
+		}
+	}
+}
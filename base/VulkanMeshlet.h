@@ -0,0 +1,110 @@
+/*
+* Meshlet generation, bounds and culling helpers for task/mesh shader based rendering
+*
+* Splits indexed triangle lists into meshlets with a limited number of unique vertices and triangles,
+* computes bounding spheres and normal cones for culling and can store the results in a binary cache file
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace meshlet
+	{
+		/** @brief Default limits, these match the preferred output sizes of most mesh shader implementations */
+		const uint32_t defaultMaxVertices = 64;
+		const uint32_t defaultMaxTriangles = 124;
+
+		/** @brief Meshlet description, layout matches the std430 structure used by the shaders */
+		struct Meshlet {
+			/** @brief Offset into MeshletSet::vertices */
+			uint32_t vertexOffset;
+			/** @brief Offset into MeshletSet::triangles */
+			uint32_t triangleOffset;
+			uint32_t vertexCount;
+			uint32_t triangleCount;
+		};
+
+		/** @brief Culling data for a single meshlet, layout matches the std430 structure used by the shaders */
+		struct Bounds {
+			/** @brief Bounding sphere center (xyz) and radius (w) */
+			glm::vec4 sphere;
+			/** @brief Normal cone axis (xyz) and sine of the cone angle (w), w >= 1 means the cone can't be used for culling */
+			glm::vec4 cone;
+		};
+
+		/** @brief Range of meshlets generated from one triangle list (e.g. a glTF primitive) */
+		struct Group {
+			uint32_t firstMeshlet;
+			uint32_t meshletCount;
+		};
+
+		/** @brief Meshlets for one or more triangle lists sharing a common vertex buffer */
+		struct MeshletSet {
+			std::vector<Meshlet> meshlets;
+			std::vector<Bounds> bounds;
+			/** @brief Maps meshlet local vertex indices to indices into the source vertex buffer */
+			std::vector<uint32_t> vertices;
+			/** @brief One entry per triangle with the three meshlet local vertex indices packed into bits 0-7, 8-15 and 16-23 */
+			std::vector<uint32_t> triangles;
+			std::vector<Group> groups;
+			void clear();
+		};
+
+		struct Statistics {
+			uint32_t meshletCount = 0;
+			uint32_t triangleCount = 0;
+			/** @brief Sum of all meshlet vertex counts, vertices shared by several meshlets are counted multiple times */
+			uint32_t vertexCount = 0;
+			float averageVertices = 0.0f;
+			float averageTriangles = 0.0f;
+			/** @brief Fill rate of the meshlets relative to the limits used when building them */
+			float vertexUtilization = 0.0f;
+			float triangleUtilization = 0.0f;
+			/** @brief Number of meshlets with a normal cone usable for backface culling */
+			uint32_t coneCullable = 0;
+		};
+
+		struct CullStatistics {
+			uint32_t tested = 0;
+			uint32_t visible = 0;
+			uint32_t frustumCulled = 0;
+			uint32_t coneCulled = 0;
+			/** @brief CPU time spent for culling in milliseconds */
+			double time = 0.0;
+		};
+
+		/**
+		* @brief Splits a triangle list into meshlets and appends them to the meshlet set
+		* @param positions Pointer to the first vertex position (three floats), vertexStride is the distance between two positions in bytes
+		* @note The input order is kept, so running a vertex cache optimization first results in better filled meshlets
+		* @return Index of the group in MeshletSet::groups that contains the generated meshlets
+		*/
+		uint32_t build(MeshletSet& meshletSet, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, uint32_t maxVertices = defaultMaxVertices, uint32_t maxTriangles = defaultMaxTriangles);
+
+		/** @brief Returns fill rates and counts for the given meshlet set */
+		Statistics getStatistics(const MeshletSet& meshletSet, uint32_t maxVertices = defaultMaxVertices, uint32_t maxTriangles = defaultMaxTriangles);
+
+		/** @brief Returns true if the meshlet may be visible, same test as the task shader (frustum planes as generated by vks::Frustum) */
+		bool isVisible(const Bounds& bounds, const glm::vec4* frustumPlanes, const glm::vec3& cameraPosition, bool coneCulling, bool* coneCulled = nullptr);
+
+		/** @brief Culls all meshlets on the CPU, can be used to validate or benchmark the GPU culling path */
+		CullStatistics cull(const MeshletSet& meshletSet, const glm::vec4* frustumPlanes, const glm::vec3& cameraPosition, bool coneCulling, std::vector<uint32_t>* visibleMeshlets = nullptr);
+
+		/** @brief Writes a meshlet set to a binary cache file, returns false if the file could not be written */
+		bool saveToFile(const MeshletSet& meshletSet, const std::string& filename, uint64_t key);
+		/** @brief Reads a meshlet set from a binary cache file, returns false if the file does not exist or the key does not match */
+		bool loadFromFile(MeshletSet& meshletSet, const std::string& filename, uint64_t key);
+	}
+}
@@ -0,0 +1,305 @@
+/*
+* Compute shader based mip chain generation
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMipGenerator.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	namespace
+	{
+		// Same layouts as the push constant blocks of the shaders
+		struct BoxPushConstants {
+			int32_t width;
+			int32_t height;
+			uint32_t mipCount;
+			uint32_t workGroupCount;
+			uint32_t srgb;
+		};
+
+		struct KaiserPushConstants {
+			int32_t sourceWidth;
+			int32_t sourceHeight;
+			int32_t destinationWidth;
+			int32_t destinationHeight;
+			float outerWeight;
+			float innerWeight;
+			uint32_t srgb;
+		};
+
+		// Width and height of the source tile reduced by one workgroup of the single pass shader
+		const uint32_t boxTileSize = 64;
+		const uint32_t kaiserGroupSize = 8;
+
+		// Zeroth order modified Bessel function of the first kind
+		double besselI0(double x)
+		{
+			double sum = 1.0;
+			double term = 1.0;
+			for (uint32_t k = 1; k < 32; k++) {
+				term *= (x / (2.0 * k)) * (x / (2.0 * k));
+				sum += term;
+			}
+			return sum;
+		}
+	}
+
+	void MipGenerator::create(vks::VulkanDevice *device, VkPipelineShaderStageCreateInfo boxShaderStage, VkPipelineShaderStageCreateInfo kaiserShaderStage, VkPipelineCache pipelineCache)
+	{
+		this->device = device;
+
+		// Single pass box filter: source and up to twelve destination levels plus the workgroup counter
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, maxLevelsPerDispatch + 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &box.descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BoxPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&box.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &box.pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(box.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = boxShaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &box.pipeline));
+
+		// Kaiser filter: one source and one destination level per dispatch
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &kaiser.descriptorSetLayout));
+
+		pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(KaiserPushConstants), 0);
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&kaiser.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &kaiser.pipelineLayout));
+
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(kaiser.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = kaiserShaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &kaiser.pipeline));
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&counter,
+			sizeof(uint32_t)));
+	}
+
+	void MipGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, box.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, box.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, box.descriptorSetLayout, nullptr);
+		vkDestroyPipeline(device->logicalDevice, kaiser.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, kaiser.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, kaiser.descriptorSetLayout, nullptr);
+		counter.destroy();
+		device = nullptr;
+	}
+
+	bool MipGenerator::isFormatSupported(VkFormat format) const
+	{
+		// Not created (e.g. the compute shaders are not available)
+		if (!device) {
+			return false;
+		}
+		if ((format != VK_FORMAT_R8G8B8A8_UNORM) && (format != VK_FORMAT_R8G8B8A8_SRGB)) {
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+	}
+
+	void MipGenerator::getKaiserWeights(float alpha, float &outerWeight, float &innerWeight)
+	{
+		// Windowed sinc for a downsampling factor of two, evaluated at the distance of the taps to the destination texel center
+		// (0.5 and 1.5 source texels), the window spans the four taps
+		auto weight = [alpha](double distance) {
+			const double pi = 3.14159265358979323846;
+			const double x = distance * 0.5;
+			const double sinc = std::sin(pi * x) / (pi * x);
+			const double window = besselI0(alpha * std::sqrt(std::max(1.0 - x * x, 0.0))) / besselI0(alpha);
+			return sinc * window;
+		};
+		const double inner = weight(0.5);
+		const double outer = weight(1.5);
+		const double sum = 2.0 * (inner + outer);
+		outerWeight = static_cast<float>(outer / sum);
+		innerWeight = static_cast<float>(inner / sum);
+	}
+
+	void MipGenerator::generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout, VkQueue queue, MipFilter filter, bool srgb)
+	{
+		assert(device && isFormatSupported(format));
+
+		// Storage images can't use sRGB formats, sRGB data is decoded in the shaders instead if requested
+		std::vector<VkImageView> views(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+			viewCreateInfo.image = image;
+			viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &views[i]));
+		}
+
+		// Split the chain into the passes of the selected filter
+		struct Pass {
+			uint32_t sourceLevel;
+			uint32_t levelCount;
+		};
+		std::vector<Pass> passes;
+		if (filter == MipFilter::Box) {
+			uint32_t level = 0;
+			while (level + 1 < mipLevels) {
+				// The last workgroup reduces level six of the pass on its own, which needs to fit into a single tile
+				const uint32_t sourceSize = std::max(std::max(width >> level, height >> level), 1u);
+				const uint32_t maxLevels = (sourceSize > boxTileSize * boxTileSize) ? maxLevelsPerDispatch / 2 : maxLevelsPerDispatch;
+				const uint32_t levelCount = std::min(mipLevels - 1 - level, maxLevels);
+				passes.push_back({ level, levelCount });
+				level += levelCount;
+			}
+		}
+		else {
+			for (uint32_t level = 0; level + 1 < mipLevels; level++) {
+				passes.push_back({ level, 1 });
+			}
+		}
+
+		// All descriptors are only used for this call (single level images only get their layout transition)
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		if (!passes.empty()) {
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<uint32_t>(passes.size()) * (maxLevelsPerDispatch + 1)),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(passes.size())),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, static_cast<uint32_t>(passes.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		}
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			image,
+			VK_ACCESS_MEMORY_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			oldLayout,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			subresourceRange);
+
+		for (auto &pass : passes) {
+			const int32_t sourceWidth = static_cast<int32_t>(std::max(width >> pass.sourceLevel, 1u));
+			const int32_t sourceHeight = static_cast<int32_t>(std::max(height >> pass.sourceLevel, 1u));
+
+			VkDescriptorSet descriptorSet;
+			if (filter == MipFilter::Box) {
+				VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &box.descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+				// Levels beyond the pass point to its last level, they are never written
+				std::vector<VkDescriptorImageInfo> imageInfos(maxLevelsPerDispatch + 1);
+				for (uint32_t i = 0; i <= maxLevelsPerDispatch; i++) {
+					imageInfos[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, views[pass.sourceLevel + std::min(i, pass.levelCount)], VK_IMAGE_LAYOUT_GENERAL);
+				}
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, imageInfos.data(), static_cast<uint32_t>(imageInfos.size())),
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &counter.descriptor),
+				};
+				vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+				// Reset the counter of finished workgroups
+				vkCmdFillBuffer(commandBuffer, counter.buffer, 0, sizeof(uint32_t), 0);
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				BoxPushConstants pushConstants;
+				pushConstants.width = sourceWidth;
+				pushConstants.height = sourceHeight;
+				pushConstants.mipCount = pass.levelCount;
+				const uint32_t groupCountX = (sourceWidth + boxTileSize - 1) / boxTileSize;
+				const uint32_t groupCountY = (sourceHeight + boxTileSize - 1) / boxTileSize;
+				pushConstants.workGroupCount = groupCountX * groupCountY;
+				pushConstants.srgb = srgb ? 1 : 0;
+
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, box.pipeline);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, box.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdPushConstants(commandBuffer, box.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BoxPushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+			}
+			else {
+				VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &kaiser.descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+				VkDescriptorImageInfo sourceInfo = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, views[pass.sourceLevel], VK_IMAGE_LAYOUT_GENERAL);
+				VkDescriptorImageInfo destinationInfo = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, views[pass.sourceLevel + 1], VK_IMAGE_LAYOUT_GENERAL);
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &sourceInfo),
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destinationInfo),
+				};
+				vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+				KaiserPushConstants pushConstants;
+				pushConstants.sourceWidth = sourceWidth;
+				pushConstants.sourceHeight = sourceHeight;
+				pushConstants.destinationWidth = std::max(sourceWidth / 2, 1);
+				pushConstants.destinationHeight = std::max(sourceHeight / 2, 1);
+				getKaiserWeights(kaiserAlpha, pushConstants.outerWeight, pushConstants.innerWeight);
+				pushConstants.srgb = srgb ? 1 : 0;
+
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kaiser.pipeline);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, kaiser.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdPushConstants(commandBuffer, kaiser.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(KaiserPushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, (pushConstants.destinationWidth + kaiserGroupSize - 1) / kaiserGroupSize, (pushConstants.destinationHeight + kaiserGroupSize - 1) / kaiserGroupSize, 1);
+			}
+
+			// The next pass reads the levels written by this one
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			image,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL,
+			newLayout,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			subresourceRange);
+
+		device->flushCommandBuffer(commandBuffer, queue, true);
+
+		if (descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		for (auto view : views) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+	}
+}
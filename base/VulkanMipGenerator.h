@@ -0,0 +1,73 @@
+/*
+* Compute shader based mip chain generation
+*
+* Generates up to twelve mip levels with a single dispatch (box filter, see base/mipgen.comp) or one level per dispatch
+* with a Kaiser windowed sinc kernel (base/mipgenkaiser.comp), so no blit support is required for the image's format
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	enum class MipFilter {
+		/** @brief 2x2 average, all levels are generated in a single dispatch */
+		Box,
+		/** @brief 4x4 Kaiser windowed sinc, sharper than the box filter but needs one dispatch per level */
+		Kaiser
+	};
+
+	class MipGenerator
+	{
+	private:
+		vks::VulkanDevice *device = nullptr;
+		struct {
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+		} box, kaiser;
+		/** @brief Number of finished workgroups, used to find the last workgroup of a single pass dispatch */
+		vks::Buffer counter;
+	public:
+		/** @brief Maximum number of levels written by a single pass dispatch */
+		static const uint32_t maxLevelsPerDispatch = 12;
+		/** @brief Shape parameter of the Kaiser window, larger values reduce ringing at the cost of sharpness */
+		float kaiserAlpha = 4.0f;
+
+		/**
+		* Creates the compute pipelines
+		*
+		* @param device Device used to create the pipelines
+		* @param boxShaderStage Compute stage with base/mipgen.comp
+		* @param kaiserShaderStage Compute stage with base/mipgenkaiser.comp
+		* @param pipelineCache (Optional) Pipeline cache
+		*/
+		void create(vks::VulkanDevice *device, VkPipelineShaderStageCreateInfo boxShaderStage, VkPipelineShaderStageCreateInfo kaiserShaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		void destroy();
+
+		/** @brief True for formats that can be written through a R8G8B8A8_UNORM storage image view (sRGB images need VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT) */
+		bool isFormatSupported(VkFormat format) const;
+
+		/**
+		* Generates all mip levels of a 2D image from its first level and waits for the work to finish
+		*
+		* @param image Image created with VK_IMAGE_USAGE_STORAGE_BIT, level 0 needs to contain the source data
+		* @param oldLayout Current layout of all levels of the image
+		* @param newLayout Layout all levels are transitioned to after the mip chain has been generated
+		* @param queue Queue with compute support used to submit the work
+		* @param srgb Filter in linear space, for color data stored in sRGB (independent of the image's format)
+		*/
+		void generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout, VkQueue queue, MipFilter filter = MipFilter::Box, bool srgb = false);
+
+		/** @brief Returns the normalized weights for the outer and inner taps of the separable Kaiser kernel */
+		static void getKaiserWeights(float alpha, float &outerWeight, float &innerWeight);
+	};
+}
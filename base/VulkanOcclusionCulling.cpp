@@ -0,0 +1,391 @@
+/*
+* CPU occlusion culling
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanOcclusionCulling.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <float.h>
+#include <fstream>
+
+#include "threadpool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKS_OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vks
+{
+	OcclusionCuller::OcclusionCuller() : tested(0), occluded(0)
+	{
+	}
+
+	void OcclusionCuller::resize(uint32_t width, uint32_t height)
+	{
+		this->width = std::max((width + tileSize - 1) / tileSize, 1u) * tileSize;
+		this->height = std::max((height + tileSize - 1) / tileSize, 1u) * tileSize;
+		depth.assign(this->width * this->height, 1.0f);
+		tileMaxDepth.assign((this->width / tileSize) * (this->height / tileSize), 1.0f);
+	}
+
+	void OcclusionCuller::setThreadPool(vks::ThreadPool *threadPool)
+	{
+		this->threadPool = threadPool;
+	}
+
+	void OcclusionCuller::clear()
+	{
+		std::fill(depth.begin(), depth.end(), 1.0f);
+		std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+		occluders.clear();
+		tested = 0;
+		occluded = 0;
+	}
+
+	void OcclusionCuller::addOccluder(const glm::mat4 &mvp, const glm::vec3 *positions, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount)
+	{
+		Occluder occluder;
+		occluder.mvp = mvp;
+		occluder.positions = positions;
+		occluder.vertexCount = vertexCount;
+		occluder.indices = indices;
+		occluder.indexCount = indexCount;
+		occluders.push_back(occluder);
+	}
+
+	void OcclusionCuller::setupTriangles(uint32_t firstOccluder, uint32_t lastOccluder, std::vector<Triangle> &triangles) const
+	{
+		triangles.clear();
+		std::vector<glm::vec4> screenVertices;
+		for (uint32_t o = firstOccluder; o < lastOccluder; o++) {
+			const Occluder &occluder = occluders[o];
+			// Transform to screen space, w is kept to detect vertices in front of the near plane
+			screenVertices.resize(occluder.vertexCount);
+			for (uint32_t v = 0; v < occluder.vertexCount; v++) {
+				glm::vec4 clip = occluder.mvp * glm::vec4(occluder.positions[v], 1.0f);
+				if ((clip.w <= 0.0f) || (clip.z < 0.0f)) {
+					screenVertices[v] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+					continue;
+				}
+				const float invW = 1.0f / clip.w;
+				screenVertices[v] = glm::vec4((clip.x * invW * 0.5f + 0.5f) * (float)width, (clip.y * invW * 0.5f + 0.5f) * (float)height, clip.z * invW, 1.0f);
+			}
+			for (uint32_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+				glm::vec4 v0 = screenVertices[occluder.indices[i]];
+				glm::vec4 v1 = screenVertices[occluder.indices[i + 1]];
+				glm::vec4 v2 = screenVertices[occluder.indices[i + 2]];
+				// Skipping triangles that cross the near plane only removes occlusion, so no clipping is required
+				if ((v0.w < 0.0f) || (v1.w < 0.0f) || (v2.w < 0.0f)) {
+					continue;
+				}
+				float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+				if (std::abs(area) < 1.0e-6f) {
+					continue;
+				}
+				// Occluders are rasterized double sided, so both windings are brought into the same orientation
+				if (area < 0.0f) {
+					std::swap(v1, v2);
+					area = -area;
+				}
+
+				Triangle triangle;
+				// Pixels are covered if their center lies inside the triangle
+				triangle.minX = std::max((int32_t)std::ceil(std::min(v0.x, std::min(v1.x, v2.x)) - 0.5f), 0);
+				triangle.minY = std::max((int32_t)std::ceil(std::min(v0.y, std::min(v1.y, v2.y)) - 0.5f), 0);
+				triangle.maxX = std::min((int32_t)std::floor(std::max(v0.x, std::max(v1.x, v2.x)) - 0.5f), (int32_t)width - 1);
+				triangle.maxY = std::min((int32_t)std::floor(std::max(v0.y, std::max(v1.y, v2.y)) - 0.5f), (int32_t)height - 1);
+				if ((triangle.minX > triangle.maxX) || (triangle.minY > triangle.maxY)) {
+					continue;
+				}
+
+				// Edge i is opposite to vertex i, its function is the (unnormalized) barycentric coordinate of that vertex
+				const glm::vec4 *vertices[3] = { &v0, &v1, &v2 };
+				for (uint32_t e = 0; e < 3; e++) {
+					const glm::vec4 &a = *vertices[(e + 1) % 3];
+					const glm::vec4 &b = *vertices[(e + 2) % 3];
+					triangle.edgeA[e] = a.y - b.y;
+					triangle.edgeB[e] = b.x - a.x;
+					triangle.edgeC[e] = -(triangle.edgeA[e] * a.x + triangle.edgeB[e] * a.y);
+				}
+				// Depth is linear in screen space
+				const float invArea = 1.0f / area;
+				triangle.depthA = (triangle.edgeA[0] * v0.z + triangle.edgeA[1] * v1.z + triangle.edgeA[2] * v2.z) * invArea;
+				triangle.depthB = (triangle.edgeB[0] * v0.z + triangle.edgeB[1] * v1.z + triangle.edgeB[2] * v2.z) * invArea;
+				triangle.depthC = (triangle.edgeC[0] * v0.z + triangle.edgeC[1] * v1.z + triangle.edgeC[2] * v2.z) * invArea;
+				triangle.vertices[0] = glm::vec3(v0.x, v0.y, v0.z);
+				triangle.vertices[1] = glm::vec3(v1.x, v1.y, v1.z);
+				triangle.vertices[2] = glm::vec3(v2.x, v2.y, v2.z);
+				triangles.push_back(triangle);
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterizeBand(uint32_t firstRow, uint32_t lastRow, bool simd)
+	{
+		for (auto &triangles : triangleLists) {
+			for (auto &triangle : triangles) {
+				const int32_t startY = std::max(triangle.minY, (int32_t)firstRow);
+				const int32_t endY = std::min(triangle.maxY, (int32_t)lastRow - 1);
+				for (int32_t y = startY; y <= endY; y++) {
+					const float centerY = (float)y + 0.5f;
+					float rowEdge[3];
+					for (uint32_t e = 0; e < 3; e++) {
+						rowEdge[e] = triangle.edgeB[e] * centerY + triangle.edgeC[e];
+					}
+					const float rowDepth = triangle.depthB * centerY + triangle.depthC;
+					float *row = &depth[y * width];
+#if defined(VKS_OCCLUSION_SSE2)
+					if (simd) {
+						// Four pixels per iteration, the row is padded to a multiple of the tile size so the last group stays in bounds
+						const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+						const __m128 zero = _mm_setzero_ps();
+						for (int32_t x = triangle.minX & ~3; x <= triangle.maxX; x += 4) {
+							const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+							__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[0]), centerX), _mm_set1_ps(rowEdge[0])), zero);
+							inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[1]), centerX), _mm_set1_ps(rowEdge[1])), zero));
+							inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[2]), centerX), _mm_set1_ps(rowEdge[2])), zero));
+							if (_mm_movemask_ps(inside) == 0) {
+								continue;
+							}
+							const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA), centerX), _mm_set1_ps(rowDepth));
+							const __m128 current = _mm_loadu_ps(row + x);
+							const __m128 closest = _mm_min_ps(current, z);
+							_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, current)));
+						}
+						continue;
+					}
+#endif
+					for (int32_t x = triangle.minX; x <= triangle.maxX; x++) {
+						const float centerX = (float)x + 0.5f;
+						if ((triangle.edgeA[0] * centerX + rowEdge[0] >= 0.0f) && (triangle.edgeA[1] * centerX + rowEdge[1] >= 0.0f) && (triangle.edgeA[2] * centerX + rowEdge[2] >= 0.0f)) {
+							const float z = triangle.depthA * centerX + rowDepth;
+							row[x] = std::min(row[x], z);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterizeReference()
+	{
+		for (auto &triangles : triangleLists) {
+			for (auto &triangle : triangles) {
+				const glm::dvec3 v0 = glm::dvec3(triangle.vertices[0]);
+				const glm::dvec3 v1 = glm::dvec3(triangle.vertices[1]);
+				const glm::dvec3 v2 = glm::dvec3(triangle.vertices[2]);
+				const double area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+				for (int32_t y = triangle.minY; y <= triangle.maxY; y++) {
+					for (int32_t x = triangle.minX; x <= triangle.maxX; x++) {
+						const double px = (double)x + 0.5;
+						const double py = (double)y + 0.5;
+						const double w0 = ((v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x)) / area;
+						const double w1 = ((v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x)) / area;
+						const double w2 = ((v1.x - v0.x) * (py - v0.y) - (v1.y - v0.y) * (px - v0.x)) / area;
+						if ((w0 < 0.0) || (w1 < 0.0) || (w2 < 0.0)) {
+							continue;
+						}
+						float &d = depth[y * width + x];
+						d = std::min(d, (float)(w0 * v0.z + w1 * v1.z + w2 * v2.z));
+					}
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::updateTiles(uint32_t firstTileRow, uint32_t lastTileRow)
+	{
+		const uint32_t tilesX = width / tileSize;
+		for (uint32_t ty = firstTileRow; ty < lastTileRow; ty++) {
+			for (uint32_t tx = 0; tx < tilesX; tx++) {
+				float maxDepth = 0.0f;
+				for (uint32_t y = ty * tileSize; y < (ty + 1) * tileSize; y++) {
+					const float *row = &depth[y * width + tx * tileSize];
+					for (uint32_t x = 0; x < tileSize; x++) {
+						maxDepth = std::max(maxDepth, row[x]);
+					}
+				}
+				tileMaxDepth[ty * tilesX + tx] = maxDepth;
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterize(RasterizationPath path)
+	{
+		assert(width > 0 && height > 0);
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const uint32_t threadCount = ((threadPool != nullptr) && (path != RasterizationPath::Reference)) ? (uint32_t)threadPool->threads.size() : 1;
+		const uint32_t tileRows = height / tileSize;
+
+		// Set up triangles of a range of occluders per job
+		const uint32_t setupJobCount = std::max(std::min(threadCount, (uint32_t)occluders.size()), 1u);
+		triangleLists.resize(setupJobCount);
+		if (setupJobCount > 1) {
+			for (uint32_t j = 0; j < setupJobCount; j++) {
+				const uint32_t first = (uint32_t)occluders.size() * j / setupJobCount;
+				const uint32_t last = (uint32_t)occluders.size() * (j + 1) / setupJobCount;
+				threadPool->threads[j]->addJob([=] { setupTriangles(first, last, triangleLists[j]); });
+			}
+			threadPool->wait();
+		}
+		else {
+			setupTriangles(0, (uint32_t)occluders.size(), triangleLists[0]);
+		}
+
+		if (path == RasterizationPath::Reference) {
+			rasterizeReference();
+			updateTiles(0, tileRows);
+		}
+		else {
+			// Every job owns a band of tile rows, so no two jobs ever write to the same pixel
+			const bool simd = (path == RasterizationPath::Simd);
+			const uint32_t bandCount = (threadCount > 1) ? std::min(threadCount * 2, tileRows) : 1;
+			if (bandCount > 1) {
+				for (uint32_t b = 0; b < bandCount; b++) {
+					const uint32_t firstTileRow = tileRows * b / bandCount;
+					const uint32_t lastTileRow = tileRows * (b + 1) / bandCount;
+					threadPool->threads[b % threadCount]->addJob([=] {
+						rasterizeBand(firstTileRow * tileSize, lastTileRow * tileSize, simd);
+						updateTiles(firstTileRow, lastTileRow);
+					});
+				}
+				threadPool->wait();
+			}
+			else {
+				rasterizeBand(0, height, simd);
+				updateTiles(0, tileRows);
+			}
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		rasterizationTime = std::chrono::duration<float, std::milli>(tEnd - tStart).count();
+	}
+
+	bool OcclusionCuller::isVisible(const glm::mat4 &mvp, const glm::vec3 &min, const glm::vec3 &max)
+	{
+		tested++;
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+		for (uint32_t i = 0; i < 8; i++) {
+			const glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+			const glm::vec4 clip = mvp * glm::vec4(corner, 1.0f);
+			// Boxes crossing the near plane are always visible
+			if ((clip.w <= 0.0f) || (clip.z < 0.0f)) {
+				return true;
+			}
+			const float invW = 1.0f / clip.w;
+			const float x = (clip.x * invW * 0.5f + 0.5f) * (float)width;
+			const float y = (clip.y * invW * 0.5f + 0.5f) * (float)height;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			minZ = std::min(minZ, clip.z * invW);
+		}
+
+		// All pixels touched by the screen space bounds of the box
+		const int32_t startX = std::max((int32_t)std::floor(minX), 0);
+		const int32_t startY = std::max((int32_t)std::floor(minY), 0);
+		const int32_t endX = std::min((int32_t)std::ceil(maxX) - 1, (int32_t)width - 1);
+		const int32_t endY = std::min((int32_t)std::ceil(maxY) - 1, (int32_t)height - 1);
+		if ((startX > endX) || (startY > endY)) {
+			// Outside of the screen, left to frustum culling
+			return true;
+		}
+
+		// The box is hidden if every pixel it touches is closer than its closest point
+		// Tiles whose farthest depth is closer than that can be skipped without looking at their pixels
+		const uint32_t tilesX = width / tileSize;
+		for (int32_t ty = startY / tileSize; ty <= endY / (int32_t)tileSize; ty++) {
+			for (int32_t tx = startX / tileSize; tx <= endX / (int32_t)tileSize; tx++) {
+				if (tileMaxDepth[ty * tilesX + tx] < minZ) {
+					continue;
+				}
+				const int32_t y0 = std::max(startY, ty * (int32_t)tileSize);
+				const int32_t y1 = std::min(endY, (ty + 1) * (int32_t)tileSize - 1);
+				const int32_t x0 = std::max(startX, tx * (int32_t)tileSize);
+				const int32_t x1 = std::min(endX, (tx + 1) * (int32_t)tileSize - 1);
+				for (int32_t y = y0; y <= y1; y++) {
+					for (int32_t x = x0; x <= x1; x++) {
+						if (depth[y * width + x] >= minZ) {
+							return true;
+						}
+					}
+				}
+			}
+		}
+
+		occluded++;
+		return false;
+	}
+
+	OcclusionCuller::Statistics OcclusionCuller::getStatistics() const
+	{
+		Statistics statistics;
+		statistics.occluders = (uint32_t)occluders.size();
+		for (auto &triangles : triangleLists) {
+			statistics.triangles += (uint32_t)triangles.size();
+		}
+		statistics.tested = tested;
+		statistics.occluded = occluded;
+		statistics.rasterizationTime = rasterizationTime;
+		return statistics;
+	}
+
+	const std::vector<float> &OcclusionCuller::getDepth() const
+	{
+		return depth;
+	}
+
+	bool OcclusionCuller::saveDepthImage(const std::string &filename) const
+	{
+		std::ofstream file(filename, std::ios::out | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		// Negative scale denotes little endian data, rows are stored bottom to top
+		file << "Pf\n" << width << " " << height << "\n-1.0\n";
+		for (uint32_t y = height; y > 0; y--) {
+			file.write((const char*)&depth[(y - 1) * width], width * sizeof(float));
+		}
+		return file.good();
+	}
+
+	bool OcclusionCuller::loadDepthImage(const std::string &filename, std::vector<float> &depth, uint32_t &width, uint32_t &height)
+	{
+		std::ifstream file(filename, std::ios::in | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::string magic;
+		float scale;
+		file >> magic >> width >> height >> scale;
+		file.get();
+		if ((magic != "Pf") || (scale >= 0.0f) || !file.good()) {
+			return false;
+		}
+		depth.resize(width * height);
+		for (uint32_t y = height; y > 0; y--) {
+			file.read((char*)&depth[(y - 1) * width], width * sizeof(float));
+		}
+		return file.good();
+	}
+
+	uint32_t OcclusionCuller::compareDepth(const std::vector<float> &reference, float tolerance) const
+	{
+		assert(reference.size() == depth.size());
+		uint32_t differences = 0;
+		for (size_t i = 0; i < depth.size(); i++) {
+			if (std::abs(depth[i] - reference[i]) > tolerance) {
+				differences++;
+			}
+		}
+		return differences;
+	}
+}
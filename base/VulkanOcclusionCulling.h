@@ -0,0 +1,122 @@
+/*
+* CPU occlusion culling
+*
+* Rasterizes occluder triangles into a small software depth buffer with a per-tile maximum depth hierarchy
+* Bounding boxes can then be tested against this buffer before any command for the object is recorded
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class ThreadPool;
+
+	class OcclusionCuller
+	{
+	public:
+		enum class RasterizationPath {
+			/** @brief Single threaded, double precision barycentrics for every pixel of the triangle bounds, used to validate the other paths */
+			Reference,
+			Scalar,
+			/** @brief SSE2, four pixels at a time (falls back to the scalar path on other architectures) */
+			Simd
+		};
+
+		struct Statistics {
+			uint32_t occluders = 0;
+			uint32_t triangles = 0;
+			/** @brief Number of bounding box tests since the last call to clear */
+			uint32_t tested = 0;
+			/** @brief Number of bounding boxes found to be hidden since the last call to clear */
+			uint32_t occluded = 0;
+			/** @brief Time spent in rasterize in milliseconds */
+			float rasterizationTime = 0.0f;
+		};
+
+		/** @brief Width and height of the tiles of the depth hierarchy in pixels, the depth buffer size is rounded up to a multiple of this */
+		static const uint32_t tileSize = 8;
+
+	private:
+		struct Occluder {
+			glm::mat4 mvp;
+			const glm::vec3 *positions;
+			uint32_t vertexCount;
+			const uint32_t *indices;
+			uint32_t indexCount;
+		};
+		/** @brief Screen space triangle with edge functions and depth plane evaluated at pixel centers */
+		struct Triangle {
+			float edgeA[3], edgeB[3], edgeC[3];
+			float depthA, depthB, depthC;
+			int32_t minX, minY, maxX, maxY;
+			/** @brief Screen space vertices for the reference path (x, y, depth) */
+			glm::vec3 vertices[3];
+		};
+		std::vector<Occluder> occluders;
+		/** @brief Triangles set up by each job of the current frame */
+		std::vector<std::vector<Triangle>> triangleLists;
+		std::vector<float> depth;
+		std::vector<float> tileMaxDepth;
+		std::atomic<uint32_t> tested;
+		std::atomic<uint32_t> occluded;
+		float rasterizationTime = 0.0f;
+		vks::ThreadPool *threadPool = nullptr;
+
+		void setupTriangles(uint32_t firstOccluder, uint32_t lastOccluder, std::vector<Triangle> &triangles) const;
+		void rasterizeBand(uint32_t firstRow, uint32_t lastRow, bool simd);
+		void rasterizeReference();
+		void updateTiles(uint32_t firstTileRow, uint32_t lastTileRow);
+	public:
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		OcclusionCuller();
+
+		/** @brief Resizes the depth buffer, width and height are rounded up to a multiple of the tile size */
+		void resize(uint32_t width, uint32_t height);
+		/** @brief Work is split across the threads of this pool, without a pool everything runs on the calling thread */
+		void setThreadPool(vks::ThreadPool *threadPool);
+
+		/** @brief Clears the depth buffer, the list of occluders and the statistics, starts a new frame */
+		void clear();
+		/**
+		* @brief Adds an occluder mesh for the next rasterization
+		* @param mvp Model view projection matrix of the occluder, clip space depth has to be in the [0, 1] range
+		* @param positions Vertex positions, must stay valid until rasterize has been called
+		* @param indices Triangle list, must stay valid until rasterize has been called
+		* @note Occluders need to be fully contained in the geometry they stand for, otherwise the culling is not conservative
+		*/
+		void addOccluder(const glm::mat4 &mvp, const glm::vec3 *positions, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount);
+		/** @brief Rasterizes all occluders into the depth buffer and updates the depth hierarchy, triangles crossing the near plane are skipped */
+		void rasterize(RasterizationPath path = RasterizationPath::Simd);
+
+		/**
+		* @brief Tests a bounding box against the depth buffer, can be called from multiple threads at once after rasterize
+		* @param mvp Model view projection matrix of the object
+		* @return False if the box is hidden behind the occluders, true if it's (potentially) visible
+		*/
+		bool isVisible(const glm::mat4 &mvp, const glm::vec3 &min, const glm::vec3 &max);
+
+		Statistics getStatistics() const;
+		/** @brief Depth values of the last rasterization, row by row starting at the top, 1.0 where nothing has been rasterized */
+		const std::vector<float> &getDepth() const;
+
+		/** @brief Saves the depth buffer as a little endian portable float map (.pfm) for comparisons against reference images */
+		bool saveDepthImage(const std::string &filename) const;
+		/** @brief Loads a depth image written with saveDepthImage */
+		static bool loadDepthImage(const std::string &filename, std::vector<float> &depth, uint32_t &width, uint32_t &height);
+		/** @brief Returns the number of pixels whose depth differs from a reference image of the same size by more than the tolerance */
+		uint32_t compareDepth(const std::vector<float> &reference, float tolerance = 1.0e-4f) const;
+	};
+}
@@ -0,0 +1,167 @@
+/*
+* Parallel secondary command buffer recording
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanParallelRecorder.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanCpuProfiler.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	ParallelCommandRecorder::~ParallelCommandRecorder()
+	{
+		// Pools need the device, so they have to be destroyed explicitly
+		assert(framePools.empty());
+		delete threadPool;
+	}
+
+	void ParallelCommandRecorder::prepare(VkDevice device, uint32_t queueFamilyIndex)
+	{
+		this->device = device;
+		this->queueFamilyIndex = queueFamilyIndex;
+	}
+
+	void ParallelCommandRecorder::destroy()
+	{
+		destroyPools();
+		delete threadPool;
+		threadPool = nullptr;
+	}
+
+	void ParallelCommandRecorder::createThreads()
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threadPool = new vks::ThreadPool();
+		threadPool->setThreadCount(threadCount);
+	}
+
+	void ParallelCommandRecorder::destroyPools()
+	{
+		for (auto& threadPools : framePools) {
+			for (auto& pools : threadPools) {
+				// Destroying the pool also frees its command buffers
+				vkDestroyCommandPool(device, pools.commandPool, nullptr);
+			}
+		}
+		framePools.clear();
+		frameStatistics.clear();
+	}
+
+	void ParallelCommandRecorder::setThreadCount(uint32_t threadCount)
+	{
+		if (device != VK_NULL_HANDLE) {
+			vkDeviceWaitIdle(device);
+		}
+		destroyPools();
+		delete threadPool;
+		threadPool = nullptr;
+		this->threadCount = threadCount;
+	}
+
+	uint32_t ParallelCommandRecorder::getThreadCount()
+	{
+		if (threadPool == nullptr) {
+			createThreads();
+		}
+		return threadCount;
+	}
+
+	void ParallelCommandRecorder::beginFrame(uint32_t frameIndex)
+	{
+		assert(device != VK_NULL_HANDLE);
+		if (threadPool == nullptr) {
+			createThreads();
+		}
+		if (frameIndex >= framePools.size()) {
+			framePools.resize(frameIndex + 1);
+			frameStatistics.resize(frameIndex + 1);
+		}
+		std::vector<ThreadPools>& threadPools = framePools[frameIndex];
+		if (threadPools.empty()) {
+			threadPools.resize(threadCount);
+			VkCommandPoolCreateInfo commandPoolInfo = vks::initializers::commandPoolCreateInfo();
+			commandPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			for (auto& pools : threadPools) {
+				VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &pools.commandPool));
+			}
+		}
+		else {
+			for (auto& pools : threadPools) {
+				VK_CHECK_RESULT(vkResetCommandPool(device, pools.commandPool, 0));
+				pools.usedCount = 0;
+			}
+		}
+		frameStatistics[frameIndex] = Statistics();
+	}
+
+	VkCommandBuffer ParallelCommandRecorder::getCommandBuffer(ThreadPools& pools)
+	{
+		if (pools.usedCount == pools.commandBuffers.size()) {
+			VkCommandBuffer commandBuffer;
+			VkCommandBufferAllocateInfo allocateInfo = vks::initializers::commandBufferAllocateInfo(pools.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+			pools.commandBuffers.push_back(commandBuffer);
+		}
+		return pools.commandBuffers[pools.usedCount++];
+	}
+
+	void ParallelCommandRecorder::record(uint32_t frameIndex, VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t itemCount, const RecordFunction& record, uint32_t minItemsPerRange)
+	{
+		VKS_PROFILE_ZONE("ParallelCommandRecorder::record");
+		assert((frameIndex < framePools.size()) && !framePools[frameIndex].empty() && "beginFrame has to be called first");
+		if (itemCount == 0) {
+			return;
+		}
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		// Range i is recorded by thread i, which is the only thread that accesses that thread's pool
+		const uint32_t rangeCount = std::max(1u, std::min(threadCount, (itemCount + minItemsPerRange - 1) / std::max(1u, minItemsPerRange)));
+		std::vector<VkCommandBuffer> secondaries(rangeCount);
+		for (uint32_t i = 0; i < rangeCount; i++) {
+			const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * i / rangeCount);
+			const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * (i + 1) / rangeCount);
+			ThreadPools* pools = &framePools[frameIndex][i];
+			VkCommandBuffer* secondary = &secondaries[i];
+			threadPool->threads[i]->addJob([this, pools, secondary, first, last, &inheritanceInfo, &record] {
+				VKS_PROFILE_ZONE("Record secondary command buffer");
+				VkCommandBuffer commandBuffer = getCommandBuffer(*pools);
+				VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+				beginInfo.pInheritanceInfo = &inheritanceInfo;
+				VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+				record(commandBuffer, first, last - first);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+				*secondary = commandBuffer;
+			});
+		}
+		threadPool->wait();
+
+		// Executing in range order keeps the draw order of the items
+		vkCmdExecuteCommands(primary, rangeCount, secondaries.data());
+
+		Statistics& statistics = frameStatistics[frameIndex];
+		statistics.recordTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		statistics.secondaryCount += rangeCount;
+	}
+
+	const ParallelCommandRecorder::Statistics& ParallelCommandRecorder::getStatistics(uint32_t frameIndex) const
+	{
+		return frameStatistics[frameIndex];
+	}
+}
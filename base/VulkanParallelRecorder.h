@@ -0,0 +1,86 @@
+/*
+* Parallel secondary command buffer recording
+*
+* Splits a list of draws into contiguous ranges that are recorded into secondary command buffers on worker threads
+* Each worker has its own command pool per frame, pools are reset as a whole instead of freeing single command buffers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class ThreadPool;
+
+	class ParallelCommandRecorder
+	{
+	public:
+		/** @brief Records the items [first, first + count) into a secondary command buffer, called on a worker thread */
+		typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)> RecordFunction;
+
+		struct Statistics {
+			/** @brief CPU time spent in record() since the last beginFrame() in milliseconds */
+			double recordTime = 0.0;
+			/** @brief Secondary command buffers recorded since the last beginFrame() */
+			uint32_t secondaryCount = 0;
+		};
+
+	private:
+		struct ThreadPools {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			/** @brief Allocated once and reused after the pool has been reset */
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t queueFamilyIndex = 0;
+		uint32_t threadCount = 0;
+		vks::ThreadPool* threadPool = nullptr;
+		/** @brief Command pools by frame index and thread */
+		std::vector<std::vector<ThreadPools>> framePools;
+		std::vector<Statistics> frameStatistics;
+
+		void createThreads();
+		void destroyPools();
+		VkCommandBuffer getCommandBuffer(ThreadPools& pools);
+	public:
+		~ParallelCommandRecorder();
+
+		/** @brief Only stores the device, threads and pools are created when they are first used */
+		void prepare(VkDevice device, uint32_t queueFamilyIndex);
+		void destroy();
+
+		/** @brief Changes the number of worker threads, 0 uses all hardware threads (waits for the device to be idle) */
+		void setThreadCount(uint32_t threadCount);
+		uint32_t getThreadCount();
+
+		/**
+		* Resets the command pools of a frame, so its secondary command buffers can be recorded again
+		*
+		* @note The command buffers previously recorded for this frame must no longer be in use by the device
+		*/
+		void beginFrame(uint32_t frameIndex);
+
+		/**
+		* Records itemCount items in parallel and executes the resulting secondary command buffers in item order
+		*
+		* @param frameIndex Frame the secondary command buffers are allocated for (e.g. the index of the swap chain image)
+		* @param primary Command buffer inside a render pass instance that has been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		* @param renderPass, subpass, framebuffer Inheritance info of the render pass instance (framebuffer is optional)
+		* @param itemCount Number of items to record, split into at most one contiguous range per thread
+		* @param record Called for each range, state is not inherited from the primary, so this has to bind pipelines, descriptor sets and buffers and set dynamic state
+		* @param minItemsPerRange Ranges are not made smaller than this, so small lists use fewer threads
+		*/
+		void record(uint32_t frameIndex, VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t itemCount, const RecordFunction& record, uint32_t minItemsPerRange = 16);
+
+		const Statistics& getStatistics(uint32_t frameIndex) const;
+	};
+}
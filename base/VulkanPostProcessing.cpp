@@ -0,0 +1,385 @@
+/*
+* Compute shader based post processing blurs
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPostProcessing.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	namespace
+	{
+		// Same layouts as the push constant blocks of the shaders, the pipeline layout covers the larger one
+		struct SeparablePushConstants {
+			int32_t width;
+			int32_t height;
+			int32_t directionX;
+			int32_t directionY;
+			int32_t radius;
+			float sigma;
+			float intensity;
+			float depthSharpness;
+			int32_t depthComponent;
+		};
+
+		struct DualFilterPushConstants {
+			int32_t width;
+			int32_t height;
+			float offset;
+			float intensity;
+		};
+
+		// Output texels per workgroup of the separable blur, one workgroup covers a segment of a row or column
+		const uint32_t lineGroupSize = 256;
+		const uint32_t dualFilterGroupSize = 8;
+	}
+
+	void PostProcessing::create(vks::VulkanDevice *device, VkPipelineShaderStageCreateInfo separableShaderStage, VkPipelineShaderStageCreateInfo dualFilterShaderStage, VkPipelineCache pipelineCache)
+	{
+		this->device = device;
+
+		// Binding 0: Sampled input, binding 1: Output, binding 2: Sampled depth of the bilateral blur
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SeparablePushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Both shaders have a single boolean specialization constant, depth awareness and upsampling respectively
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+		const VkBool32 specializationData[2] = { VK_FALSE, VK_TRUE };
+		VkSpecializationInfo specializationInfos[2] = {
+			vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &specializationData[0]),
+			vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &specializationData[1]),
+		};
+
+		std::vector<VkComputePipelineCreateInfo> computePipelineCreateInfos(4, vks::initializers::computePipelineCreateInfo(pipelineLayout, 0));
+		for (uint32_t i = 0; i < 4; i++) {
+			computePipelineCreateInfos[i].stage = (i < 2) ? separableShaderStage : dualFilterShaderStage;
+			computePipelineCreateInfos[i].stage.pSpecializationInfo = &specializationInfos[i % 2];
+		}
+		VkPipeline computePipelines[4];
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, static_cast<uint32_t>(computePipelineCreateInfos.size()), computePipelineCreateInfos.data(), nullptr, computePipelines));
+		pipelines.gaussian = computePipelines[0];
+		pipelines.bilateral = computePipelines[1];
+		pipelines.downsample = computePipelines[2];
+		pipelines.upsample = computePipelines[3];
+
+		// Inputs are filtered to support sources with a different size than the output, depth must not be interpolated across edges
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = samplerInfo.addressModeU;
+		samplerInfo.addressModeW = samplerInfo.addressModeU;
+		samplerInfo.maxLod = 0.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &linearSampler));
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &nearestSampler));
+	}
+
+	void PostProcessing::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, pipelines.gaussian, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.bilateral, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.downsample, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.upsample, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroySampler(device->logicalDevice, linearSampler, nullptr);
+		vkDestroySampler(device->logicalDevice, nearestSampler, nullptr);
+		device = nullptr;
+	}
+
+	bool PostProcessing::isFormatSupported(VkFormat format) const
+	{
+		// The shaders write through storage images without a format qualifier, so any storage format can be used
+		if (!device || !device->enabledFeatures.shaderStorageImageWriteWithoutFormat) {
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+	}
+
+	void PostProcessing::createTarget(Target &target, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format)
+	{
+		target.width = width;
+		target.height = height;
+		target.mipLevels = mipLevels;
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &target.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, target.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &target.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, target.image, target.memory, 0));
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.image = target.image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &target.view));
+		if (mipLevels > 1) {
+			target.levelViews.resize(mipLevels);
+			for (uint32_t i = 0; i < mipLevels; i++) {
+				viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &target.levelViews[i]));
+			}
+		}
+		else {
+			target.levelViews = { target.view };
+		}
+
+		target.descriptor = vks::initializers::descriptorImageInfo(linearSampler, target.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	void PostProcessing::destroyTarget(Target &target)
+	{
+		if (target.image == VK_NULL_HANDLE) {
+			return;
+		}
+		if (target.mipLevels > 1) {
+			for (auto view : target.levelViews) {
+				vkDestroyImageView(device->logicalDevice, view, nullptr);
+			}
+		}
+		vkDestroyImageView(device->logicalDevice, target.view, nullptr);
+		vkDestroyImage(device->logicalDevice, target.image, nullptr);
+		vkFreeMemory(device->logicalDevice, target.memory, nullptr);
+		target = Target();
+	}
+
+	void PostProcessing::createBlur(Blur &blur, BlurType type, VkImageView input, uint32_t width, uint32_t height, VkFormat format, const BlurSettings &settings, VkImageView depth)
+	{
+		assert(device && isFormatSupported(format));
+		assert((type != BlurType::Bilateral) || (depth != VK_NULL_HANDLE));
+
+		blur.type = type;
+		blur.settings = settings;
+		blur.width = width;
+		blur.height = height;
+
+		// Pairs of source and destination views, one per dispatch
+		struct Pass {
+			VkImageView source;
+			VkImageLayout sourceLayout;
+			VkImageView destination;
+		};
+		std::vector<Pass> passes;
+		if (type == BlurType::DualFilter) {
+			// The chain starts at half the output size, levels that would be smaller than a texel are dropped
+			const uint32_t chainWidth = std::max(width / 2, 1u);
+			const uint32_t chainHeight = std::max(height / 2, 1u);
+			uint32_t levels = 1;
+			while ((levels < settings.levels) && ((std::max(chainWidth, chainHeight) >> levels) > 1)) {
+				levels++;
+			}
+			blur.settings.levels = levels;
+			createTarget(blur.intermediate, chainWidth, chainHeight, levels, format);
+			createTarget(blur.output, width, height, 1, format);
+			const std::vector<VkImageView> &chain = blur.intermediate.levelViews;
+			passes.push_back({ input, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, chain[0] });
+			for (uint32_t i = 1; i < levels; i++) {
+				passes.push_back({ chain[i - 1], VK_IMAGE_LAYOUT_GENERAL, chain[i] });
+			}
+			for (uint32_t i = levels - 1; i > 0; i--) {
+				passes.push_back({ chain[i], VK_IMAGE_LAYOUT_GENERAL, chain[i - 1] });
+			}
+			passes.push_back({ chain[0], VK_IMAGE_LAYOUT_GENERAL, blur.output.view });
+		}
+		else {
+			createTarget(blur.intermediate, width, height, 1, format);
+			createTarget(blur.output, width, height, 1, format);
+			passes.push_back({ input, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, blur.intermediate.view });
+			passes.push_back({ blur.intermediate.view, VK_IMAGE_LAYOUT_GENERAL, blur.output.view });
+		}
+
+		const uint32_t setCount = static_cast<uint32_t>(passes.size());
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount * 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &blur.descriptorPool));
+
+		std::vector<VkDescriptorSetLayout> setLayouts(setCount, descriptorSetLayout);
+		blur.descriptorSets.resize(setCount);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(blur.descriptorPool, setLayouts.data(), setCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, blur.descriptorSets.data()));
+
+		for (uint32_t i = 0; i < setCount; i++) {
+			VkDescriptorImageInfo sourceInfo = vks::initializers::descriptorImageInfo(linearSampler, passes[i].source, passes[i].sourceLayout);
+			VkDescriptorImageInfo destinationInfo = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, passes[i].destination, VK_IMAGE_LAYOUT_GENERAL);
+			// Only the bilateral blur reads the depth binding, the others get their source so the set is fully written
+			VkDescriptorImageInfo depthInfo = (type == BlurType::Bilateral) ? vks::initializers::descriptorImageInfo(nearestSampler, depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) : sourceInfo;
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(blur.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceInfo),
+				vks::initializers::writeDescriptorSet(blur.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destinationInfo),
+				vks::initializers::writeDescriptorSet(blur.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &depthInfo),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void PostProcessing::destroyBlur(Blur &blur)
+	{
+		if (!device) {
+			return;
+		}
+		destroyTarget(blur.intermediate);
+		destroyTarget(blur.output);
+		if (blur.descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device->logicalDevice, blur.descriptorPool, nullptr);
+			blur.descriptorPool = VK_NULL_HANDLE;
+		}
+		blur.descriptorSets.clear();
+	}
+
+	void PostProcessing::recordSeparable(VkCommandBuffer commandBuffer, const Blur &blur)
+	{
+		SeparablePushConstants pushConstants;
+		pushConstants.width = static_cast<int32_t>(blur.width);
+		pushConstants.height = static_cast<int32_t>(blur.height);
+		pushConstants.radius = std::min(std::max(blur.settings.radius, 0), maxRadius);
+		pushConstants.sigma = std::max(blur.settings.sigma, 0.01f);
+		pushConstants.depthSharpness = blur.settings.depthSharpness;
+		pushConstants.depthComponent = std::min(std::max(blur.settings.depthComponent, 0), 3);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, (blur.type == BlurType::Bilateral) ? pipelines.bilateral : pipelines.gaussian);
+
+		// Horizontal pass into the intermediate image
+		pushConstants.directionX = 1;
+		pushConstants.directionY = 0;
+		pushConstants.intensity = 1.0f;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &blur.descriptorSets[0], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SeparablePushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (blur.width + lineGroupSize - 1) / lineGroupSize, blur.height, 1);
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Vertical pass into the output
+		pushConstants.directionX = 0;
+		pushConstants.directionY = 1;
+		pushConstants.intensity = blur.settings.intensity;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &blur.descriptorSets[1], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SeparablePushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (blur.height + lineGroupSize - 1) / lineGroupSize, blur.width, 1);
+	}
+
+	void PostProcessing::recordDualFilter(VkCommandBuffer commandBuffer, const Blur &blur)
+	{
+		const uint32_t levels = blur.intermediate.mipLevels;
+		const uint32_t passCount = static_cast<uint32_t>(blur.descriptorSets.size());
+		for (uint32_t i = 0; i < passCount; i++) {
+			const bool upsample = i >= levels;
+			// Size of the level written by this pass, the upsample passes walk the chain back up to the output
+			uint32_t width = blur.width;
+			uint32_t height = blur.height;
+			if (i + 1 < passCount) {
+				const uint32_t level = upsample ? (passCount - 2 - i) : i;
+				width = std::max(blur.intermediate.width >> level, 1u);
+				height = std::max(blur.intermediate.height >> level, 1u);
+			}
+
+			DualFilterPushConstants pushConstants;
+			pushConstants.width = static_cast<int32_t>(width);
+			pushConstants.height = static_cast<int32_t>(height);
+			pushConstants.offset = blur.settings.offset;
+			pushConstants.intensity = (i + 1 == passCount) ? blur.settings.intensity : 1.0f;
+
+			if ((i == 0) || (i == levels)) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upsample ? pipelines.upsample : pipelines.downsample);
+			}
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &blur.descriptorSets[i], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DualFilterPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (width + dualFilterGroupSize - 1) / dualFilterGroupSize, (height + dualFilterGroupSize - 1) / dualFilterGroupSize, 1);
+
+			if (i + 1 < passCount) {
+				// Each pass samples the level written by the previous one
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+	}
+
+	void PostProcessing::recordBlur(VkCommandBuffer commandBuffer, const Blur &blur)
+	{
+		assert(device && !blur.descriptorSets.empty());
+
+		// Contents of the previous recording are not needed, but reads of the last frame's output have to finish before it is written again
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+		const Target *targets[2] = { &blur.intermediate, &blur.output };
+		for (auto target : targets) {
+			vks::tools::insertImageMemoryBarrier(
+				commandBuffer,
+				target->image,
+				0,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				subresourceRange);
+		}
+
+		if (blur.type == BlurType::DualFilter) {
+			recordDualFilter(commandBuffer, blur);
+		}
+		else {
+			recordSeparable(commandBuffer, blur);
+		}
+
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			blur.output.image,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			subresourceRange);
+	}
+}
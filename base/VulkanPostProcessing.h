@@ -0,0 +1,129 @@
+/*
+* Compute shader based post processing blurs
+*
+* Separable Gaussian and depth aware bilateral blurs that filter one row or column per workgroup from a tile in shared memory
+* (base/blurseparable.comp), and a dual filter (Kawase style) downsample and upsample chain for wide bloom (base/dualfilter.comp)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class PostProcessing
+	{
+	public:
+		enum class BlurType {
+			/** @brief Separable Gaussian, one horizontal and one vertical pass */
+			Gaussian,
+			/** @brief Separable Gaussian with weights attenuated by the depth difference to the center texel, keeps edges sharp */
+			Bilateral,
+			/** @brief Downsamples the input over several levels and upsamples it again, the width grows with the number of levels */
+			DualFilter
+		};
+
+		/** @brief Image written by the compute passes, kept in VK_IMAGE_LAYOUT_GENERAL unless it is a blur output */
+		struct Target {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			/** @brief Single level views for the dual filter chain */
+			std::vector<VkImageView> levelViews;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+			/** @brief Samples the whole image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL with the linear sampler of the module */
+			VkDescriptorImageInfo descriptor{};
+		};
+
+		struct BlurSettings {
+			/** @brief Kernel radius in texels of the separable blurs, clamped to maxRadius */
+			int32_t radius = 4;
+			float sigma = 2.0f;
+			/** @brief Scales the result of the last pass */
+			float intensity = 1.0f;
+			/** @brief Bilateral only: how fast weights fall off with the relative depth difference */
+			float depthSharpness = 32.0f;
+			/** @brief Bilateral only: component of the depth input that holds the (linear) depth */
+			int32_t depthComponent = 0;
+			/** @brief Dual filter only: number of downsample levels */
+			uint32_t levels = 4;
+			/** @brief Dual filter only: distance of the taps in texels of the level that is sampled */
+			float offset = 1.0f;
+		};
+
+		struct Blur {
+			BlurType type = BlurType::Gaussian;
+			BlurSettings settings;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			/** @brief Horizontal pass result of the separable blurs, mip chain of the dual filter */
+			Target intermediate;
+			Target output;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			/** @brief One set per dispatch in recording order */
+			std::vector<VkDescriptorSet> descriptorSets;
+		};
+
+		/** @brief Largest radius that fits the apron of the shared memory tile in base/blurseparable.comp */
+		static const int32_t maxRadius = 32;
+
+	private:
+		vks::VulkanDevice *device = nullptr;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		struct {
+			VkPipeline gaussian = VK_NULL_HANDLE;
+			VkPipeline bilateral = VK_NULL_HANDLE;
+			VkPipeline downsample = VK_NULL_HANDLE;
+			VkPipeline upsample = VK_NULL_HANDLE;
+		} pipelines;
+		VkSampler linearSampler = VK_NULL_HANDLE;
+		VkSampler nearestSampler = VK_NULL_HANDLE;
+
+		void createTarget(Target &target, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format);
+		void destroyTarget(Target &target);
+		void recordSeparable(VkCommandBuffer commandBuffer, const Blur &blur);
+		void recordDualFilter(VkCommandBuffer commandBuffer, const Blur &blur);
+	public:
+		/**
+		* Creates the compute pipelines
+		*
+		* @param device Device used to create the pipelines, needs shaderStorageImageWriteWithoutFormat enabled
+		* @param separableShaderStage Compute stage with base/blurseparable.comp
+		* @param dualFilterShaderStage Compute stage with base/dualfilter.comp
+		* @param pipelineCache (Optional) Pipeline cache
+		*/
+		void create(vks::VulkanDevice *device, VkPipelineShaderStageCreateInfo separableShaderStage, VkPipelineShaderStageCreateInfo dualFilterShaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		void destroy();
+
+		/** @brief True if blurs can be written to images of the given format on the device */
+		bool isFormatSupported(VkFormat format) const;
+
+		/**
+		* Creates the images and descriptors of a blur of a sampled image
+		*
+		* @param input View of the image to blur, needs to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when the blur is recorded
+		* @param width Width of the blur output, the input is sampled with normalized coordinates and may have a different size
+		* @param depth (Bilateral only) View of a sampled image with the depth in settings.depthComponent, may also have a different size
+		*/
+		void createBlur(Blur &blur, BlurType type, VkImageView input, uint32_t width, uint32_t height, VkFormat format, const BlurSettings &settings, VkImageView depth = VK_NULL_HANDLE);
+		void destroyBlur(Blur &blur);
+
+		/**
+		* Records all dispatches of a blur outside of a render pass
+		*
+		* Writes to the input need to be made visible to compute shaders by the caller (e.g. with a subpass dependency)
+		* The output can be sampled by fragment and compute shaders afterwards
+		* Settings other than the dual filter's level count can be changed between recordings
+		*/
+		void recordBlur(VkCommandBuffer commandBuffer, const Blur &blur);
+	};
+}
@@ -0,0 +1,179 @@
+/*
+* Vulkan query manager
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanQueryManager.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	void QueryManager::create(vks::VulkanDevice *device, VkQueryType type, uint32_t queryCount, uint32_t frameCount, VkQueryPipelineStatisticFlags pipelineStatistics)
+	{
+		assert(frameCount > 0);
+		assert((type != VK_QUERY_TYPE_PIPELINE_STATISTICS) || (pipelineStatistics != 0));
+		this->device = device;
+		this->type = type;
+		this->queryCount = queryCount;
+		// Results are read when the pool comes up for reuse, which is as late as possible without stalling
+		latency = frameCount - 1;
+
+		valuesPerQuery = 1;
+		if (type == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+			valuesPerQuery = 0;
+			for (uint32_t bits = pipelineStatistics; bits != 0; bits &= bits - 1) {
+				valuesPerQuery++;
+			}
+		}
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = type;
+		queryPoolInfo.queryCount = queryCount;
+		queryPoolInfo.pipelineStatistics = (type == VK_QUERY_TYPE_PIPELINE_STATISTICS) ? pipelineStatistics : 0;
+		framePools.resize(frameCount);
+		for (auto &framePool : framePools) {
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &framePool.pool));
+		}
+
+		// Each query returns its values followed by the availability
+		readback.resize(queryCount * (valuesPerQuery + 1));
+		results.assign(queryCount * valuesPerQuery, 0);
+		resultFrames.assign(queryCount, 0);
+	}
+
+	void QueryManager::destroy()
+	{
+		for (auto &framePool : framePools) {
+			vkDestroyQueryPool(device->logicalDevice, framePool.pool, nullptr);
+		}
+		framePools.clear();
+	}
+
+	VkQueryPool QueryManager::getPool(uint32_t frameIndex) const
+	{
+		assert(frameIndex < framePools.size());
+		return framePools[frameIndex].pool;
+	}
+
+	void QueryManager::cmdReset(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		vkCmdResetQueryPool(commandBuffer, getPool(frameIndex), 0, queryCount);
+	}
+
+	void QueryManager::cmdBeginQuery(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query, VkQueryControlFlags flags)
+	{
+		assert(query < queryCount);
+		vkCmdBeginQuery(commandBuffer, getPool(frameIndex), query, flags);
+	}
+
+	void QueryManager::cmdEndQuery(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query)
+	{
+		assert(query < queryCount);
+		vkCmdEndQuery(commandBuffer, getPool(frameIndex), query);
+	}
+
+	void QueryManager::cmdWriteTimestamp(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query, VkPipelineStageFlagBits pipelineStage)
+	{
+		assert(query < queryCount);
+		vkCmdWriteTimestamp(commandBuffer, pipelineStage, getPool(frameIndex), query);
+	}
+
+	bool QueryManager::fetch(FramePool &framePool)
+	{
+		// Never waits, queries that are not yet available are reported with an availability value of zero
+		if (framePool.usedQueries == 0) {
+			return true;
+		}
+		const VkDeviceSize stride = (valuesPerQuery + 1) * sizeof(uint64_t);
+		VkResult result = vkGetQueryPoolResults(device->logicalDevice, framePool.pool, 0, framePool.usedQueries, framePool.usedQueries * stride, readback.data(), stride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+			VK_CHECK_RESULT(result);
+		}
+		bool allAvailable = true;
+		for (uint32_t query = 0; query < framePool.usedQueries; query++) {
+			const uint64_t *values = &readback[query * (valuesPerQuery + 1)];
+			if (values[valuesPerQuery] == 0) {
+				allAvailable = false;
+				continue;
+			}
+			// Don't overwrite newer results from other pools
+			if (framePool.submittedFrame > resultFrames[query]) {
+				for (uint32_t i = 0; i < valuesPerQuery; i++) {
+					results[query * valuesPerQuery + i] = values[i];
+				}
+				resultFrames[query] = framePool.submittedFrame;
+			}
+		}
+		return allAvailable;
+	}
+
+	void QueryManager::update()
+	{
+		for (auto &framePool : framePools) {
+			if (framePool.pending && (frameCounter - framePool.submittedFrame >= latency)) {
+				framePool.pending = !fetch(framePool);
+			}
+		}
+	}
+
+	void QueryManager::submitted(uint32_t frameIndex, uint32_t usedQueries)
+	{
+		assert(frameIndex < framePools.size());
+		FramePool &framePool = framePools[frameIndex];
+		if (framePool.pending) {
+			// The pool has been reset by this submission before all results of the previous one could be read
+			droppedResults++;
+		}
+		frameCounter++;
+		framePool.submittedFrame = frameCounter;
+		framePool.pending = true;
+		framePool.usedQueries = std::min(usedQueries, queryCount);
+	}
+
+	bool QueryManager::hasResult(uint32_t query) const
+	{
+		assert(query < queryCount);
+		return resultFrames[query] > 0;
+	}
+
+	uint64_t QueryManager::getResult(uint32_t query, uint32_t index) const
+	{
+		assert((query < queryCount) && (index < valuesPerQuery));
+		return results[query * valuesPerQuery + index];
+	}
+
+	uint64_t QueryManager::getResultFrame(uint32_t query) const
+	{
+		assert(query < queryCount);
+		return resultFrames[query];
+	}
+
+	uint64_t QueryManager::getResultAge(uint32_t query) const
+	{
+		return hasResult(query) ? frameCounter - resultFrames[query] : 0;
+	}
+
+	bool QueryManager::isVisible(uint32_t query) const
+	{
+		assert(type == VK_QUERY_TYPE_OCCLUSION);
+		return !hasResult(query) || (getResult(query) > 0);
+	}
+
+	double QueryManager::getTimestampDelta(uint32_t firstQuery, uint32_t secondQuery) const
+	{
+		assert(type == VK_QUERY_TYPE_TIMESTAMP);
+		if (!hasResult(firstQuery) || !hasResult(secondQuery) || (resultFrames[firstQuery] != resultFrames[secondQuery])) {
+			return 0.0;
+		}
+		const uint64_t first = getResult(firstQuery);
+		const uint64_t second = getResult(secondQuery);
+		if (second < first) {
+			return 0.0;
+		}
+		// Timestamp period is in nanoseconds per tick
+		return static_cast<double>(second - first) * device->properties.limits.timestampPeriod / 1000000.0;
+	}
+}
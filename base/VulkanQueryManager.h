@@ -0,0 +1,96 @@
+/*
+* Vulkan query manager
+*
+* Manages a ring of query pools (one per frame in flight) for occlusion, timestamp and pipeline statistics queries
+* Results are polled without waiting on the GPU and consumed a fixed number of frames after their submission
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	class QueryManager
+	{
+	private:
+		struct FramePool {
+			VkQueryPool pool = VK_NULL_HANDLE;
+			/** @brief Frame number of the last submission using this pool */
+			uint64_t submittedFrame = 0;
+			/** @brief True if results of the last submission have not yet been read */
+			bool pending = false;
+			/** @brief Number of queries (starting at zero) written by the last submission */
+			uint32_t usedQueries = 0;
+		};
+		vks::VulkanDevice *device = nullptr;
+		std::vector<FramePool> framePools;
+		std::vector<uint64_t> readback;
+		/** @brief Latest available values for each query (valuesPerQuery entries per query) */
+		std::vector<uint64_t> results;
+		/** @brief Frame number the latest result for each query belongs to, zero if there is no result yet */
+		std::vector<uint64_t> resultFrames;
+		uint64_t frameCounter = 0;
+		bool fetch(FramePool &framePool);
+	public:
+		VkQueryType type = VK_QUERY_TYPE_OCCLUSION;
+		uint32_t queryCount = 0;
+		/** @brief Number of values returned per query, more than one for pipeline statistics queries */
+		uint32_t valuesPerQuery = 1;
+		/** @brief Minimum number of frames between submitting a pool and reading its results */
+		uint32_t latency = 0;
+		/** @brief Number of submissions whose results were not available before the pool had to be reused */
+		uint64_t droppedResults = 0;
+
+		/**
+		* Create the query pools
+		*
+		* @param device Device used to create the query pools
+		* @param type Type of the queries
+		* @param queryCount Number of queries used per frame
+		* @param frameCount Number of query pools in the ring, usually the number of frames (or command buffers) in flight
+		* @param pipelineStatistics (Optional) Statistics to query if type is VK_QUERY_TYPE_PIPELINE_STATISTICS
+		*/
+		void create(vks::VulkanDevice *device, VkQueryType type, uint32_t queryCount, uint32_t frameCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0);
+		void destroy();
+
+		/** @brief Returns the query pool for the given frame (ring) index */
+		VkQueryPool getPool(uint32_t frameIndex) const;
+		/** @brief Records a reset of all queries of a frame's pool, must be called outside of a render pass before the queries are used */
+		void cmdReset(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void cmdBeginQuery(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query, VkQueryControlFlags flags = 0);
+		void cmdEndQuery(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query);
+		void cmdWriteTimestamp(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t query, VkPipelineStageFlagBits pipelineStage);
+
+		/**
+		* Reads all available results that are at least latency frames old without blocking
+		* Must be called before a command buffer that resets a frame's pool gets submitted again
+		*/
+		void update();
+		/**
+		* Marks the queries of the frame's pool as submitted, call after the queue submission
+		*
+		* @param usedQueries (Optional) Number of queries the submission wrote, starting at the first one, results are only read for these
+		*/
+		void submitted(uint32_t frameIndex, uint32_t usedQueries = UINT32_MAX);
+
+		/** @brief True if a result for the query has been read */
+		bool hasResult(uint32_t query) const;
+		/** @brief Latest result of a query, index selects the value for pipeline statistics queries */
+		uint64_t getResult(uint32_t query, uint32_t index = 0) const;
+		/** @brief Number of the submission the latest result for this query belongs to, zero if there is no result yet */
+		uint64_t getResultFrame(uint32_t query) const;
+		/** @brief Number of frames between the submission of the latest result for this query and the current frame */
+		uint64_t getResultAge(uint32_t query) const;
+		/** @brief Conservative occlusion test: objects are visible until a result proves otherwise */
+		bool isVisible(uint32_t query) const;
+		/** @brief Converts the difference between two timestamp queries to milliseconds */
+		double getTimestampDelta(uint32_t firstQuery, uint32_t secondQuery) const;
+	};
+}
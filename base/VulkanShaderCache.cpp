@@ -0,0 +1,298 @@
+/*
+* Shader module cache and packed shader archive
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderCache.h"
+
+#include <assert.h>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "VulkanTools.h"
+#include "VulkanCpuProfiler.h"
+
+namespace vks
+{
+	namespace
+	{
+		const char archiveMagic[4] = { 'V', 'K', 'S', 'A' };
+		const uint32_t archiveVersion = 2;
+
+		struct ArchiveHeader {
+			char magic[4];
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+		};
+
+		struct ArchiveEntry {
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			uint32_t dataOffset;
+			uint32_t dataSize;
+			uint64_t hash;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+		};
+	}
+
+	ShaderArchive::~ShaderArchive()
+	{
+		close();
+	}
+
+	bool ShaderArchive::open(const std::string& filename)
+	{
+		close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+		const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		mappingHandle = mapping;
+		data = static_cast<const uint8_t*>(view);
+		size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int file = ::open(filename.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0)) {
+			::close(file);
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping stays valid after the descriptor has been closed
+		::close(file);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		data = static_cast<const uint8_t*>(view);
+		size = static_cast<size_t>(fileStat.st_size);
+#endif
+		if (!readIndex()) {
+			std::cerr << "Error: \"" << filename << "\" is not a valid shader archive" << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	bool ShaderArchive::readIndex()
+	{
+		if (size < sizeof(ArchiveHeader)) {
+			return false;
+		}
+		ArchiveHeader header;
+		memcpy(&header, data, sizeof(header));
+		if ((memcmp(header.magic, archiveMagic, sizeof(archiveMagic)) != 0) || (header.version != archiveVersion)) {
+			return false;
+		}
+		if (header.entryCount > (size - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry)) {
+			return false;
+		}
+		entries.reserve(header.entryCount);
+		for (uint32_t i = 0; i < header.entryCount; i++) {
+			ArchiveEntry archiveEntry;
+			memcpy(&archiveEntry, data + sizeof(ArchiveHeader) + i * sizeof(ArchiveEntry), sizeof(archiveEntry));
+			const bool nameInside = static_cast<uint64_t>(archiveEntry.nameOffset) + archiveEntry.nameLength <= size;
+			const bool dataInside = static_cast<uint64_t>(archiveEntry.dataOffset) + archiveEntry.dataSize <= size;
+			// SPIR-V is consumed as 32 bit words straight from the mapping
+			if (!nameInside || !dataInside || (archiveEntry.dataOffset % 4 != 0) || (archiveEntry.dataSize % 4 != 0)) {
+				return false;
+			}
+			Entry entry;
+			entry.code = reinterpret_cast<const uint32_t*>(data + archiveEntry.dataOffset);
+			entry.size = archiveEntry.dataSize;
+			entry.hash = archiveEntry.hash;
+			entry.sourceSize = archiveEntry.sourceSize;
+			entry.sourceTime = archiveEntry.sourceTime;
+			entries[std::string(reinterpret_cast<const char*>(data + archiveEntry.nameOffset), archiveEntry.nameLength)] = entry;
+		}
+		return true;
+	}
+
+	void ShaderArchive::close()
+	{
+		entries.clear();
+		if (data == nullptr) {
+			return;
+		}
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+		CloseHandle(static_cast<HANDLE>(mappingHandle));
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(data), size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	bool ShaderArchive::isOpen() const
+	{
+		return data != nullptr;
+	}
+
+	const ShaderArchive::Entry* ShaderArchive::find(const std::string& name) const
+	{
+		auto it = entries.find(name);
+		return (it != entries.end()) ? &it->second : nullptr;
+	}
+
+	size_t ShaderArchive::getEntryCount() const
+	{
+		return entries.size();
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+		// Modules need the device, so they have to be destroyed explicitly
+		assert(modules.empty());
+	}
+
+	void ShaderCache::prepare(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	void ShaderCache::destroy()
+	{
+		for (auto& module : modules) {
+			vkDestroyShaderModule(device, module.second, nullptr);
+		}
+		modules.clear();
+		fileModules.clear();
+		archive.close();
+	}
+
+	bool ShaderCache::openArchive(const std::string& filename, const std::string& rootPath)
+	{
+		VKS_PROFILE_ZONE("ShaderCache::openArchive");
+		if (!archive.open(filename)) {
+			return false;
+		}
+		archiveRoot = rootPath;
+		return true;
+	}
+
+	VkShaderModule ShaderCache::getModule(const uint32_t* code, size_t size, uint64_t hash)
+	{
+		const CodeKey key = { hash, size };
+		auto it = modules.find(key);
+		if (it != modules.end()) {
+			statistics.cacheHits++;
+			return it->second;
+		}
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = size;
+		moduleCreateInfo.pCode = code;
+		VkShaderModule shaderModule;
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule));
+		modules[key] = shaderModule;
+		statistics.modulesCreated++;
+		return shaderModule;
+	}
+
+	VkShaderModule ShaderCache::getModule(const uint32_t* code, size_t size)
+	{
+		return getModule(code, size, vks::tools::hash(code, size));
+	}
+
+	VkShaderModule ShaderCache::loadShader(const std::string& fileName)
+	{
+		assert(device != VK_NULL_HANDLE);
+		auto it = fileModules.find(fileName);
+		if (it != fileModules.end()) {
+			statistics.cacheHits++;
+			return it->second;
+		}
+
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		const ShaderArchive::Entry* entry = nullptr;
+		if (archive.isOpen() && (fileName.compare(0, archiveRoot.size(), archiveRoot) == 0)) {
+			entry = archive.find(fileName.substr(archiveRoot.size()));
+		}
+		if (entry != nullptr) {
+			// Only the file's meta data is compared, a missing file (e.g. an install that only ships the archive) keeps the archived code
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			if (vks::tools::getFileInfo(fileName, sourceSize, sourceTime) && ((sourceSize != entry->sourceSize) || (sourceTime != entry->sourceTime))) {
+				std::cout << "Shader archive entry for \"" << fileName << "\" is out of date, reading the file instead\n";
+				statistics.staleEntries++;
+				entry = nullptr;
+			}
+		}
+		if (entry != nullptr) {
+			// The hash was computed by the packer, so archived shaders are never hashed at runtime
+			statistics.archiveReads++;
+			shaderModule = getModule(entry->code, entry->size, entry->hash);
+		}
+		else {
+			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
+			if (!is.is_open()) {
+				std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+				return VK_NULL_HANDLE;
+			}
+			const size_t size = static_cast<size_t>(is.tellg());
+			assert((size > 0) && (size % 4 == 0));
+			is.seekg(0, std::ios::beg);
+			// Reading into words keeps the code suitably aligned for pCode
+			std::vector<uint32_t> code(size / 4);
+			is.read(reinterpret_cast<char*>(code.data()), size);
+			statistics.fileReads++;
+			shaderModule = getModule(code.data(), size);
+		}
+		fileModules[fileName] = shaderModule;
+		return shaderModule;
+	}
+
+	bool ShaderCache::isAvailable(const std::string& fileName) const
+	{
+		if (fileModules.find(fileName) != fileModules.end()) {
+			return true;
+		}
+		if (archive.isOpen() && (fileName.compare(0, archiveRoot.size(), archiveRoot) == 0) && (archive.find(fileName.substr(archiveRoot.size())) != nullptr)) {
+			return true;
+		}
+		return vks::tools::fileExists(fileName);
+	}
+
+	const ShaderCache::Statistics& ShaderCache::getStatistics() const
+	{
+		return statistics;
+	}
+}
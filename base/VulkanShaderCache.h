@@ -0,0 +1,133 @@
+/*
+* Shader module cache and packed shader archive
+*
+* Shader modules are shared between all users of identical SPIR-V, identified by a 64 bit FNV-1a hash of the code and its size
+* Shaders can optionally be read from a single memory mapped archive (see data/shaders/packshaders.py) instead of one file each
+* The archive stores the size and modification time of every packed file, entries that no longer match the file on disk are
+* ignored so recompiled shaders are picked up without packing the archive again
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* Read-only view of a packed shader archive that is mapped into memory as a whole
+	*
+	* Layout (little endian):
+	*   Header  { char magic[4] = "VKSA", uint32_t version = 2, uint32_t entryCount, uint32_t reserved }
+	*   Entry   { uint32_t nameOffset, uint32_t nameLength, uint32_t dataOffset, uint32_t dataSize, uint64_t hash, uint64_t sourceSize, int64_t sourceTime } x entryCount
+	*   Names blob (not null terminated), followed by the SPIR-V of all entries, each aligned to 4 bytes
+	*
+	* Offsets are relative to the start of the file, names are paths relative to the shader root using forward slashes
+	* hash is the FNV-1a hash of the code (vks::tools::hash), sourceSize and sourceTime are the size and modification time in seconds
+	* since the epoch of the .spv file at the time it was packed
+	*/
+	class ShaderArchive
+	{
+	public:
+		struct Entry {
+			const uint32_t* code = nullptr;
+			size_t size = 0;
+			uint64_t hash = 0;
+			uint64_t sourceSize = 0;
+			int64_t sourceTime = 0;
+		};
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+#if defined(_WIN32)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+		std::unordered_map<std::string, Entry> entries;
+
+		bool readIndex();
+	public:
+		~ShaderArchive();
+
+		/** @brief Maps the archive and reads its index, returns false if the file does not exist or is not a valid archive */
+		bool open(const std::string& filename);
+		void close();
+		bool isOpen() const;
+
+		/** @brief Returns the entry for a path relative to the shader root, or nullptr if the archive does not contain it */
+		const Entry* find(const std::string& name) const;
+		size_t getEntryCount() const;
+	};
+
+	class ShaderCache
+	{
+	public:
+		struct Statistics {
+			/** @brief Shaders read from single files */
+			uint32_t fileReads = 0;
+			/** @brief Shaders taken from the archive */
+			uint32_t archiveReads = 0;
+			/** @brief Archive entries skipped because the file on disk has changed since packing */
+			uint32_t staleEntries = 0;
+			/** @brief Requests answered without creating a new module */
+			uint32_t cacheHits = 0;
+			uint32_t modulesCreated = 0;
+		};
+
+	private:
+		struct CodeKey {
+			uint64_t hash;
+			size_t size;
+			bool operator==(const CodeKey& other) const { return (hash == other.hash) && (size == other.size); }
+		};
+		struct CodeKeyHash {
+			size_t operator()(const CodeKey& key) const { return static_cast<size_t>(key.hash ^ (static_cast<uint64_t>(key.size) << 32)); }
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		ShaderArchive archive;
+		std::string archiveRoot;
+		/** @brief Owns all modules, keyed by content */
+		std::unordered_map<CodeKey, VkShaderModule, CodeKeyHash> modules;
+		/** @brief Repeated loads of the same file neither touch the file system nor hash the code again */
+		std::unordered_map<std::string, VkShaderModule> fileModules;
+		Statistics statistics;
+
+		VkShaderModule getModule(const uint32_t* code, size_t size, uint64_t hash);
+	public:
+		~ShaderCache();
+
+		void prepare(VkDevice device);
+		/** @brief Destroys all modules handed out by the cache */
+		void destroy();
+
+		/**
+		* Opens a packed shader archive that is used for all files below rootPath
+		*
+		* @return False if the archive could not be opened, shaders are then read from single files
+		*/
+		bool openArchive(const std::string& filename, const std::string& rootPath);
+
+		/**
+		* Returns the module for a SPIR-V file, which is taken from the archive if it contains the file
+		* The file on disk is read instead if its size or modification time differ from the ones stored in the archive
+		*
+		* @note The module is owned by the cache and may be shared, callers must not destroy it
+		* @return VK_NULL_HANDLE if the file could not be read
+		*/
+		VkShaderModule loadShader(const std::string& fileName);
+		/** @brief Returns true if loadShader would find the file, either in the archive or on disk */
+		bool isAvailable(const std::string& fileName) const;
+		/** @brief Returns the module for SPIR-V code that is already in memory, the code is not referenced after this returns */
+		VkShaderModule getModule(const uint32_t* code, size_t size);
+
+		const Statistics& getStatistics() const;
+	};
+}
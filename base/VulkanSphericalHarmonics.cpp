@@ -0,0 +1,453 @@
+/*
+* Spherical harmonics helpers for image based lighting
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSphericalHarmonics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "threadpool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKS_SH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vks
+{
+	namespace sh
+	{
+		namespace
+		{
+			const double pi = 3.14159265358979323846;
+
+			// Basis function constants for bands 0-2
+			const float Y0 = 0.282095f;
+			const float Y1 = 0.488603f;
+			const float Y2 = 1.092548f;
+			const float Y20 = 0.315392f;
+			const float Y22 = 0.546274f;
+
+			// Maps face coordinates s and t (-1..1) to a direction: origin + s * u + t * v (matches Vulkan cube map addressing)
+			struct FaceBasis {
+				float origin[3];
+				float u[3];
+				float v[3];
+			};
+			const FaceBasis faceBases[6] = {
+				{ {  1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ { -1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ {  0.0f,  1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f } },
+				{ {  0.0f, -1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f } },
+				{ {  0.0f,  0.0f,  1.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ {  0.0f,  0.0f, -1.0f }, { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } },
+			};
+
+			struct Accumulator {
+				double coefficients[9][3] = {};
+				double weight = 0.0;
+			};
+
+			uint32_t getTexelSize(VkFormat format)
+			{
+				switch (format) {
+				case VK_FORMAT_R8G8B8A8_UNORM:
+				case VK_FORMAT_R8G8B8A8_SRGB:
+					return 4;
+				case VK_FORMAT_R16G16B16A16_SFLOAT:
+					return 8;
+				case VK_FORMAT_R32G32B32A32_SFLOAT:
+					return 16;
+				default:
+					return 0;
+				}
+			}
+
+			float halfToFloat(uint16_t value)
+			{
+				const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+				int32_t exponent = (value >> 10) & 0x1f;
+				uint32_t mantissa = value & 0x3ff;
+				uint32_t bits;
+				if (exponent == 0) {
+					if (mantissa == 0) {
+						bits = sign;
+					} else {
+						// Denormalized half, renormalize for float
+						exponent = 1;
+						while ((mantissa & 0x400) == 0) {
+							mantissa <<= 1;
+							exponent--;
+						}
+						mantissa &= 0x3ff;
+						bits = sign | (static_cast<uint32_t>(exponent + 112) << 23) | (mantissa << 13);
+					}
+				} else if (exponent == 31) {
+					bits = sign | 0x7f800000 | (mantissa << 13);
+				} else {
+					bits = sign | (static_cast<uint32_t>(exponent + 112) << 23) | (mantissa << 13);
+				}
+				float result;
+				memcpy(&result, &bits, sizeof(float));
+				return result;
+			}
+
+			const float* getSrgbTable()
+			{
+				static const std::vector<float> table = []() {
+					std::vector<float> values(256);
+					for (uint32_t i = 0; i < 256; i++) {
+						const float c = static_cast<float>(i) / 255.0f;
+						values[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+					}
+					return values;
+				}();
+				return table.data();
+			}
+
+			// Converts a row of texels to linear RGBA floats
+			void convertRow(const uint8_t* source, uint32_t count, VkFormat format, float* destination)
+			{
+				switch (format) {
+				case VK_FORMAT_R8G8B8A8_UNORM:
+					for (uint32_t i = 0; i < count * 4; i++) {
+						destination[i] = static_cast<float>(source[i]) / 255.0f;
+					}
+					break;
+				case VK_FORMAT_R8G8B8A8_SRGB: {
+					const float* srgbTable = getSrgbTable();
+					for (uint32_t i = 0; i < count * 4; i++) {
+						// Alpha is always linear
+						destination[i] = ((i & 3) == 3) ? static_cast<float>(source[i]) / 255.0f : srgbTable[source[i]];
+					}
+					break;
+				}
+				case VK_FORMAT_R16G16B16A16_SFLOAT: {
+					const uint16_t* halfs = reinterpret_cast<const uint16_t*>(source);
+					for (uint32_t i = 0; i < count * 4; i++) {
+						destination[i] = halfToFloat(halfs[i]);
+					}
+					break;
+				}
+				case VK_FORMAT_R32G32B32A32_SFLOAT:
+					memcpy(destination, source, count * 4 * sizeof(float));
+					break;
+				default:
+					assert(false);
+				}
+			}
+
+			void evaluateBasis(float x, float y, float z, float* basis)
+			{
+				basis[0] = Y0;
+				basis[1] = Y1 * y;
+				basis[2] = Y1 * z;
+				basis[3] = Y1 * x;
+				basis[4] = Y2 * x * y;
+				basis[5] = Y2 * y * z;
+				basis[6] = Y20 * (3.0f * z * z - 1.0f);
+				basis[7] = Y2 * x * z;
+				basis[8] = Y22 * (x * x - y * y);
+			}
+
+			// Differential solid angle of the cube face area from the face center to (x, y)
+			double areaElement(double x, double y)
+			{
+				return atan2(x * y, sqrt(x * x + y * y + 1.0));
+			}
+
+			// Accumulates a single texel, the solid angle is approximated by the projected texel area
+			inline void accumulateTexel(const FaceBasis& face, float s, float t, float texelArea, const float* rgba, float (&coefficients)[9][3], float& weight)
+			{
+				const float invLengthSq = 1.0f / (1.0f + s * s + t * t);
+				const float invLength = sqrtf(invLengthSq);
+				const float x = (face.origin[0] + s * face.u[0] + t * face.v[0]) * invLength;
+				const float y = (face.origin[1] + s * face.u[1] + t * face.v[1]) * invLength;
+				const float z = (face.origin[2] + s * face.u[2] + t * face.v[2]) * invLength;
+				const float w = texelArea * invLengthSq * invLength;
+				float basis[9];
+				evaluateBasis(x, y, z, basis);
+				for (uint32_t i = 0; i < 9; i++) {
+					const float bw = basis[i] * w;
+					coefficients[i][0] += bw * rgba[0];
+					coefficients[i][1] += bw * rgba[1];
+					coefficients[i][2] += bw * rgba[2];
+				}
+				weight += w;
+			}
+
+			// Projects rows [firstRow, lastRow) with all rows of the six faces numbered consecutively
+			void projectRows(const void* const faces[6], uint32_t size, VkFormat format, uint32_t firstRow, uint32_t lastRow, bool simd, Accumulator& accumulator)
+			{
+				const uint32_t texelSize = getTexelSize(format);
+				const float texelArea = 4.0f / (static_cast<float>(size) * static_cast<float>(size));
+				const float scale = 2.0f / static_cast<float>(size);
+				std::vector<float> row(size * 4);
+
+				for (uint32_t r = firstRow; r < lastRow; r++) {
+					const uint32_t faceIndex = r / size;
+					const uint32_t y = r % size;
+					const FaceBasis& face = faceBases[faceIndex];
+					const float t = (static_cast<float>(y) + 0.5f) * scale - 1.0f;
+					convertRow(static_cast<const uint8_t*>(faces[faceIndex]) + static_cast<size_t>(y) * size * texelSize, size, format, row.data());
+
+					// Rows are accumulated in single precision and then added to the double precision totals
+					float coefficients[9][3] = {};
+					float weight = 0.0f;
+					uint32_t x = 0;
+#if defined(VKS_SH_SSE2)
+					if (simd) {
+						// Four texels per iteration
+						__m128 accumulators[9][3];
+						for (uint32_t i = 0; i < 9; i++) {
+							accumulators[i][0] = accumulators[i][1] = accumulators[i][2] = _mm_setzero_ps();
+						}
+						__m128 weights = _mm_setzero_ps();
+						const __m128 vt = _mm_set1_ps(t);
+						const __m128 one = _mm_set1_ps(1.0f);
+						const __m128 three = _mm_set1_ps(3.0f);
+						const __m128 area = _mm_set1_ps(texelArea);
+						const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+						const __m128 vscale = _mm_set1_ps(scale);
+						for (; x + 4 <= size; x += 4) {
+							const __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets), vscale), one);
+							const __m128 invLengthSq = _mm_div_ps(one, _mm_add_ps(one, _mm_add_ps(_mm_mul_ps(s, s), _mm_mul_ps(vt, vt))));
+							const __m128 invLength = _mm_sqrt_ps(invLengthSq);
+							__m128 dir[3];
+							for (uint32_t c = 0; c < 3; c++) {
+								dir[c] = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(face.origin[c] + t * face.v[c]), _mm_mul_ps(s, _mm_set1_ps(face.u[c]))), invLength);
+							}
+							const __m128 w = _mm_mul_ps(area, _mm_mul_ps(invLengthSq, invLength));
+							weights = _mm_add_ps(weights, w);
+
+							__m128 basis[9];
+							basis[0] = _mm_set1_ps(Y0);
+							basis[1] = _mm_mul_ps(_mm_set1_ps(Y1), dir[1]);
+							basis[2] = _mm_mul_ps(_mm_set1_ps(Y1), dir[2]);
+							basis[3] = _mm_mul_ps(_mm_set1_ps(Y1), dir[0]);
+							basis[4] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dir[0], dir[1]));
+							basis[5] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dir[1], dir[2]));
+							basis[6] = _mm_mul_ps(_mm_set1_ps(Y20), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dir[2], dir[2])), one));
+							basis[7] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(dir[0], dir[2]));
+							basis[8] = _mm_mul_ps(_mm_set1_ps(Y22), _mm_sub_ps(_mm_mul_ps(dir[0], dir[0]), _mm_mul_ps(dir[1], dir[1])));
+
+							// Transpose four RGBA texels to one register per channel
+							__m128 r = _mm_loadu_ps(&row[x * 4 + 0]);
+							__m128 g = _mm_loadu_ps(&row[x * 4 + 4]);
+							__m128 b = _mm_loadu_ps(&row[x * 4 + 8]);
+							__m128 a = _mm_loadu_ps(&row[x * 4 + 12]);
+							_MM_TRANSPOSE4_PS(r, g, b, a);
+							const __m128 weighted[3] = { _mm_mul_ps(r, w), _mm_mul_ps(g, w), _mm_mul_ps(b, w) };
+							for (uint32_t i = 0; i < 9; i++) {
+								for (uint32_t c = 0; c < 3; c++) {
+									accumulators[i][c] = _mm_add_ps(accumulators[i][c], _mm_mul_ps(basis[i], weighted[c]));
+								}
+							}
+						}
+						float lanes[4];
+						for (uint32_t i = 0; i < 9; i++) {
+							for (uint32_t c = 0; c < 3; c++) {
+								_mm_storeu_ps(lanes, accumulators[i][c]);
+								coefficients[i][c] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+							}
+						}
+						_mm_storeu_ps(lanes, weights);
+						weight += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+					}
+#endif
+					// Scalar path and remaining texels of the SIMD path
+					for (; x < size; x++) {
+						const float s = (static_cast<float>(x) + 0.5f) * scale - 1.0f;
+						accumulateTexel(face, s, t, texelArea, &row[x * 4], coefficients, weight);
+					}
+
+					for (uint32_t i = 0; i < 9; i++) {
+						for (uint32_t c = 0; c < 3; c++) {
+							accumulator.coefficients[i][c] += coefficients[i][c];
+						}
+					}
+					accumulator.weight += weight;
+				}
+			}
+
+			void projectReference(const void* const faces[6], uint32_t size, VkFormat format, Accumulator& accumulator)
+			{
+				const uint32_t texelSize = getTexelSize(format);
+				const double invSize = 1.0 / static_cast<double>(size);
+				std::vector<float> row(size * 4);
+				for (uint32_t faceIndex = 0; faceIndex < 6; faceIndex++) {
+					const FaceBasis& face = faceBases[faceIndex];
+					for (uint32_t y = 0; y < size; y++) {
+						convertRow(static_cast<const uint8_t*>(faces[faceIndex]) + static_cast<size_t>(y) * size * texelSize, size, format, row.data());
+						const double t = (static_cast<double>(y) + 0.5) * 2.0 * invSize - 1.0;
+						for (uint32_t x = 0; x < size; x++) {
+							const double s = (static_cast<double>(x) + 0.5) * 2.0 * invSize - 1.0;
+							// Exact solid angle of the texel
+							const double x0 = s - invSize, x1 = s + invSize;
+							const double y0 = t - invSize, y1 = t + invSize;
+							const double solidAngle = areaElement(x0, y0) - areaElement(x0, y1) - areaElement(x1, y0) + areaElement(x1, y1);
+							double dir[3];
+							double length = 0.0;
+							for (uint32_t c = 0; c < 3; c++) {
+								dir[c] = face.origin[c] + s * face.u[c] + t * face.v[c];
+								length += dir[c] * dir[c];
+							}
+							length = sqrt(length);
+							float basis[9];
+							evaluateBasis(static_cast<float>(dir[0] / length), static_cast<float>(dir[1] / length), static_cast<float>(dir[2] / length), basis);
+							for (uint32_t i = 0; i < 9; i++) {
+								for (uint32_t c = 0; c < 3; c++) {
+									accumulator.coefficients[i][c] += basis[i] * solidAngle * row[x * 4 + c];
+								}
+							}
+							accumulator.weight += solidAngle;
+						}
+					}
+				}
+			}
+		}
+
+		bool projectCubeMap(const void* const faces[6], uint32_t size, VkFormat format, SH9& sh, uint32_t threadCount, ProjectionPath path)
+		{
+			if (getTexelSize(format) == 0 || size == 0) {
+				return false;
+			}
+
+			Accumulator total;
+			if (path == ProjectionPath::Reference) {
+				projectReference(faces, size, format, total);
+			} else {
+				if (threadCount == 0) {
+					threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+				}
+				const uint32_t rowCount = 6 * size;
+				threadCount = std::min(threadCount, rowCount);
+				std::vector<Accumulator> accumulators(threadCount);
+				const bool simd = (path == ProjectionPath::Simd);
+				if (threadCount == 1) {
+					projectRows(faces, size, format, 0, rowCount, simd, accumulators[0]);
+				} else {
+					vks::ThreadPool threadPool;
+					threadPool.setThreadCount(threadCount);
+					for (uint32_t i = 0; i < threadCount; i++) {
+						const uint32_t firstRow = rowCount * i / threadCount;
+						const uint32_t lastRow = rowCount * (i + 1) / threadCount;
+						Accumulator* accumulator = &accumulators[i];
+						threadPool.threads[i]->addJob([=] { projectRows(faces, size, format, firstRow, lastRow, simd, *accumulator); });
+					}
+					threadPool.wait();
+				}
+				for (auto& accumulator : accumulators) {
+					for (uint32_t i = 0; i < 9; i++) {
+						for (uint32_t c = 0; c < 3; c++) {
+							total.coefficients[i][c] += accumulator.coefficients[i][c];
+						}
+					}
+					total.weight += accumulator.weight;
+				}
+			}
+
+			// The texel weights should add up to the solid angle of the sphere, normalizing removes the error of the approximation
+			const double normalization = (4.0 * pi) / total.weight;
+			for (uint32_t i = 0; i < 9; i++) {
+				sh.coefficients[i] = glm::vec4(
+					static_cast<float>(total.coefficients[i][0] * normalization),
+					static_cast<float>(total.coefficients[i][1] * normalization),
+					static_cast<float>(total.coefficients[i][2] * normalization),
+					0.0f);
+			}
+			return true;
+		}
+
+		bool projectCubeMap(ktxTexture* cubeMap, VkFormat format, SH9& sh, uint32_t level, uint32_t threadCount, ProjectionPath path)
+		{
+			if (!cubeMap->isCubemap || level >= cubeMap->numLevels) {
+				return false;
+			}
+			const void* faces[6];
+			const ktx_uint8_t* data = ktxTexture_GetData(cubeMap);
+			for (uint32_t face = 0; face < 6; face++) {
+				ktx_size_t offset;
+				if (ktxTexture_GetImageOffset(cubeMap, level, 0, face, &offset) != KTX_SUCCESS) {
+					return false;
+				}
+				faces[face] = data + offset;
+			}
+			return projectCubeMap(faces, std::max(cubeMap->baseWidth >> level, 1u), format, sh, threadCount, path);
+		}
+
+		bool computeIrradiance(ktxTexture* cubeMap, VkFormat format, SH9& irradiance, bool validate)
+		{
+			uint32_t level = 0;
+			while ((level + 1 < cubeMap->numLevels) && ((cubeMap->baseWidth >> level) > 128)) {
+				level++;
+			}
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			SH9 radiance;
+			if (!projectCubeMap(cubeMap, format, radiance, level)) {
+				return false;
+			}
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Projecting the environment map onto spherical harmonics took " << tDiff << " ms";
+			if (validate) {
+				SH9 reference;
+				projectCubeMap(cubeMap, format, reference, level, 1, ProjectionPath::Reference);
+				std::cout << " (max. difference to reference " << maxDifference(radiance, reference) << ")";
+			}
+			std::cout << std::endl;
+
+			irradiance = convolveIrradiance(radiance);
+			return true;
+		}
+
+		VkResult createUniformBuffer(vks::VulkanDevice* device, vks::Buffer* buffer, const SH9& sh)
+		{
+			// The initial data is only copied
+			SH9 data = sh;
+			return device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, sizeof(SH9), &data);
+		}
+
+		SH9 convolveIrradiance(const SH9& radiance)
+		{
+			// Clamped cosine lobe per band (pi, 2pi/3, pi/4), divided by pi to match the irradiance cube map
+			const float bandFactors[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+			SH9 irradiance;
+			for (uint32_t i = 0; i < 9; i++) {
+				const uint32_t band = (i == 0) ? 0 : ((i < 4) ? 1 : 2);
+				irradiance.coefficients[i] = radiance.coefficients[i] * bandFactors[band];
+			}
+			return irradiance;
+		}
+
+		glm::vec3 evaluate(const SH9& sh, const glm::vec3& direction)
+		{
+			float basis[9];
+			evaluateBasis(direction.x, direction.y, direction.z, basis);
+			glm::vec3 result(0.0f);
+			for (uint32_t i = 0; i < 9; i++) {
+				result += glm::vec3(sh.coefficients[i]) * basis[i];
+			}
+			return glm::max(result, glm::vec3(0.0f));
+		}
+
+		float maxDifference(const SH9& a, const SH9& b)
+		{
+			float difference = 0.0f;
+			for (uint32_t i = 0; i < 9; i++) {
+				for (uint32_t c = 0; c < 3; c++) {
+					difference = std::max(difference, fabsf(a.coefficients[i][c] - b.coefficients[i][c]));
+				}
+			}
+			return difference;
+		}
+	}
+}
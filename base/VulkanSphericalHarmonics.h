@@ -0,0 +1,75 @@
+/*
+* Spherical harmonics helpers for image based lighting
+*
+* Projects cube maps onto the first three bands of real spherical harmonics (9 coefficients per color channel),
+* which is enough to represent diffuse irradiance without a separate irradiance cube map
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+#include <ktx.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace sh
+	{
+		/** @brief RGB coefficients for SH bands 0-2, stored as vec4 so they can be copied to a std140 uniform block as is */
+		struct SH9 {
+			glm::vec4 coefficients[9];
+		};
+
+		enum class ProjectionPath {
+			/** @brief Single threaded, exact texel solid angles and double precision accumulation, used to validate the other paths */
+			Reference,
+			Scalar,
+			/** @brief SSE2 (falls back to the scalar path on other architectures) */
+			Simd
+		};
+
+		/**
+		* @brief Projects a cube map onto SH9 using solid angle weighted texels
+		* @param faces Pointers to the six faces of one mip level in Vulkan face order (+X, -X, +Y, -Y, +Z, -Z), rows need to be tightly packed
+		* @param size Width and height of a face in texels
+		* @param format Supported formats are VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16B16A16_SFLOAT and VK_FORMAT_R32G32B32A32_SFLOAT
+		* @param threadCount Number of threads used for the projection, 0 uses all hardware threads
+		* @return False if the format is not supported
+		*/
+		bool projectCubeMap(const void* const faces[6], uint32_t size, VkFormat format, SH9& sh, uint32_t threadCount = 0, ProjectionPath path = ProjectionPath::Simd);
+
+		/** @brief Projects a mip level of a cube map loaded with libktx onto SH9 */
+		bool projectCubeMap(ktxTexture* cubeMap, VkFormat format, SH9& sh, uint32_t level = 0, uint32_t threadCount = 0, ProjectionPath path = ProjectionPath::Simd);
+
+		/** @brief Convolves projected radiance with a clamped cosine lobe, evaluating the result returns the irradiance divided by pi (the value stored in an irradiance cube map) */
+		SH9 convolveIrradiance(const SH9& radiance);
+
+		/** @brief Evaluates the SH9 coefficients for a normalized direction, same as in the shaders */
+		glm::vec3 evaluate(const SH9& sh, const glm::vec3& direction);
+
+		/** @brief Returns the largest absolute difference between two sets of coefficients */
+		float maxDifference(const SH9& a, const SH9& b);
+
+		/**
+		* @brief Projects a cube map onto SH9 and convolves the result for diffuse irradiance (see convolveIrradiance)
+		* @note Projects the first mip level with a face size of at most 128 texels, as nine coefficients can't hold higher frequencies anyway
+		* @param validate Also runs the single threaded reference projection and logs the largest difference, only meant for debugging as it's a lot slower
+		* @return False if the texture is not a cube map or the format is not supported
+		*/
+		bool computeIrradiance(ktxTexture* cubeMap, VkFormat format, SH9& irradiance, bool validate = false);
+
+		/** @brief Creates a host visible uniform buffer with the coefficients, which is laid out as a std140 vec4[9] array */
+		VkResult createUniformBuffer(vks::VulkanDevice* device, vks::Buffer* buffer, const SH9& sh);
+	}
+}
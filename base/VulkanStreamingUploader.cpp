@@ -0,0 +1,543 @@
+/*
+* Background streaming uploads on the transfer queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStreamingUploader.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <memory>
+
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanUIOverlay.h"
+#include "VulkanCpuProfiler.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	// Covers the texel block size of all formats, copies into images need offsets that are a multiple of it
+	static const VkDeviceSize stagingAlignment = 16;
+
+	static double millisecondsSince(std::chrono::time_point<std::chrono::high_resolution_clock> start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	StreamingUploader::~StreamingUploader()
+	{
+		// Vulkan objects need the device, so they have to be destroyed explicitly
+		assert(worker == nullptr);
+	}
+
+	void StreamingUploader::create(vks::VulkanDevice *device, VkQueue transferQueue, VkQueue graphicsQueue, VkDeviceSize stagingSize)
+	{
+		this->device = device;
+		this->transferQueue = transferQueue;
+		this->graphicsQueue = graphicsQueue;
+		transferQueueFamilyIndex = device->queueFamilyIndices.transfer;
+		graphicsQueueFamilyIndex = device->queueFamilyIndices.graphics;
+		// Queues need to be externally synchronized, so without a queue of its own the worker leaves submitting to update()
+		workerSubmits = (transferQueue != graphicsQueue);
+		timelineSemaphores = device->timelineSemaphores;
+		if (timelineSemaphores) {
+			timeline = device->createTimelineSemaphore(0);
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ring, stagingSize));
+		VK_CHECK_RESULT(ring.map());
+		ringHead = 0;
+
+		// Command buffers are only used once and freed when their submission has finished
+		transferCommandPool = device->createCommandPool(transferQueueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		acquireCommandPool = device->createCommandPool(graphicsQueueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+		worker = new vks::Thread();
+	}
+
+	void StreamingUploader::destroy()
+	{
+		if (!worker) {
+			return;
+		}
+		// Finishes all requests, the worker never waits for batches that only update() would submit
+		delete worker;
+		worker = nullptr;
+		vkDeviceWaitIdle(device->logicalDevice);
+
+		for (auto &upload : uploads) {
+			if (upload.target) {
+				upload.texture.destroy();
+			}
+		}
+		uploads.clear();
+		for (auto &batch : batches) {
+			if (batch.fence != VK_NULL_HANDLE) {
+				vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+			}
+			batch.overflowBuffer.destroy();
+		}
+		batches.clear();
+		for (auto &submission : acquireSubmissions) {
+			vkDestroyFence(device->logicalDevice, submission.fence, nullptr);
+		}
+		acquireSubmissions.clear();
+
+		// Destroying the pools also frees their command buffers
+		vkDestroyCommandPool(device->logicalDevice, transferCommandPool, nullptr);
+		vkDestroyCommandPool(device->logicalDevice, acquireCommandPool, nullptr);
+		ring.destroy();
+		if (timeline != VK_NULL_HANDLE) {
+			vkDestroySemaphore(device->logicalDevice, timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+	}
+
+	// Needs the mutex to be locked
+	uint64_t StreamingUploader::updateCompletedValue()
+	{
+		if (timelineSemaphores) {
+			completedValue = device->getTimelineSemaphoreValue(timeline);
+		}
+		else {
+			// Batches are submitted in order, so the value only advances up to the first one that hasn't finished
+			for (auto &batch : batches) {
+				if (batch.value <= completedValue) {
+					continue;
+				}
+				if (!batch.submitted || (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS)) {
+					break;
+				}
+				completedValue = batch.value;
+			}
+		}
+		return completedValue;
+	}
+
+	// Frees the resources of finished batches, needs the mutex to be locked and is only called by the worker as it owns the transfer command pool
+	void StreamingUploader::retireBatches()
+	{
+		const uint64_t completed = updateCompletedValue();
+		while (!batches.empty() && batches.front().submitted && (batches.front().value <= completed)) {
+			Batch &batch = batches.front();
+			vkFreeCommandBuffers(device->logicalDevice, transferCommandPool, 1, &batch.commandBuffer);
+			if (batch.fence != VK_NULL_HANDLE) {
+				vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+			}
+			batch.overflowBuffer.destroy();
+			batches.pop_front();
+		}
+	}
+
+	// The used part of the ring starts at the oldest batch that still reads from it and ends at the write position
+	bool StreamingUploader::findRingSpace(VkDeviceSize size, VkDeviceSize &offset)
+	{
+		const Batch *oldest = nullptr;
+		for (auto &batch : batches) {
+			if (batch.ringSize > 0) {
+				oldest = &batch;
+				break;
+			}
+		}
+		if (!oldest) {
+			ringHead = 0;
+			offset = 0;
+			return size <= ring.size;
+		}
+		const VkDeviceSize tail = oldest->ringOffset;
+		if (ringHead > tail) {
+			if (ringHead + size <= ring.size) {
+				offset = ringHead;
+				return true;
+			}
+			// Wrap around, the rest of the end of the ring is free again once the oldest batch has finished
+			if (size <= tail) {
+				offset = 0;
+				return true;
+			}
+			return false;
+		}
+		if (ringHead < tail) {
+			if (ringHead + size <= tail) {
+				offset = ringHead;
+				return true;
+			}
+		}
+		// The write position has caught up with the oldest batch, so the ring is full
+		return false;
+	}
+
+	StreamingUploader::Staging StreamingUploader::beginBatch(VkDeviceSize size, Batch &batch)
+	{
+		VKS_PROFILE_ZONE("Streaming staging");
+		Staging staging;
+		size = (size + stagingAlignment - 1) & ~(stagingAlignment - 1);
+		bool fits = false;
+		while (size <= ring.size) {
+			std::unique_lock<std::mutex> lock(mutex);
+			retireBatches();
+			VkDeviceSize offset = 0;
+			if (findRingSpace(size, offset)) {
+				batch.ringOffset = offset;
+				batch.ringSize = size;
+				ringHead = offset + size;
+				fits = true;
+				break;
+			}
+			// Wait for the oldest batch that reads from the ring, unless it is waiting for update() to be submitted
+			const Batch *oldest = nullptr;
+			for (auto &pending : batches) {
+				if (pending.ringSize > 0) {
+					oldest = &pending;
+					break;
+				}
+			}
+			if (!oldest || !oldest->submitted) {
+				break;
+			}
+			const uint64_t value = oldest->value;
+			const VkFence fence = oldest->fence;
+			// The fence is only destroyed by this thread, so it stays valid after unlocking
+			lock.unlock();
+			if (timelineSemaphores) {
+				VK_CHECK_RESULT(device->waitTimelineSemaphore(timeline, value));
+			}
+			else {
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+			}
+		}
+		if (fits) {
+			staging.buffer = ring.buffer;
+			staging.offset = batch.ringOffset;
+			staging.mapped = static_cast<uint8_t*>(ring.mapped) + batch.ringOffset;
+		}
+		else {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &batch.overflowBuffer, size));
+			VK_CHECK_RESULT(batch.overflowBuffer.map());
+			staging.buffer = batch.overflowBuffer.buffer;
+			staging.offset = 0;
+			staging.mapped = static_cast<uint8_t*>(batch.overflowBuffer.mapped);
+		}
+
+		batch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool, true);
+		if (!timelineSemaphores) {
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &batch.fence));
+		}
+		return staging;
+	}
+
+	void StreamingUploader::endBatch(Batch &batch, Upload &upload)
+	{
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+		std::lock_guard<std::mutex> lock(mutex);
+		// Values are handed out in the order the batches are submitted in, no matter which thread submits them
+		batch.value = ++nextValue;
+		upload.value = batch.value;
+		upload.overflow = (batch.overflowBuffer.buffer != VK_NULL_HANDLE);
+		batches.push_back(batch);
+		uploads.push_back(upload);
+		if (workerSubmits) {
+			submitBatch(batches.back());
+		}
+	}
+
+	// Needs the mutex to be locked
+	void StreamingUploader::submitBatch(Batch &batch)
+	{
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		if (timelineSemaphores) {
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &batch.value;
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence));
+		batch.submitted = true;
+	}
+
+	void StreamingUploader::addRequest(const std::function<void()> &job)
+	{
+		if (statistics.uploadsPending == 0) {
+			activeStart = std::chrono::high_resolution_clock::now();
+		}
+		statistics.uploadsPending++;
+		worker->addJob(job);
+	}
+
+	void StreamingUploader::processBuffer(Upload &upload, const std::vector<uint8_t> &data)
+	{
+		Batch batch;
+		Staging staging = beginBatch(upload.size, batch);
+		memcpy(staging.mapped, data.data(), static_cast<size_t>(upload.size));
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.dstOffset = upload.offset;
+		copyRegion.size = upload.size;
+		vkCmdCopyBuffer(batch.commandBuffer, staging.buffer, upload.buffer, 1, &copyRegion);
+
+		if (transferQueueFamilyIndex != graphicsQueueFamilyIndex) {
+			device->cmdReleaseBuffer(batch.commandBuffer, upload.buffer, transferQueueFamilyIndex, graphicsQueueFamilyIndex, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, upload.offset, upload.size);
+		}
+		else {
+			// Without an ownership transfer the copy is made visible here, update() only hands the buffer back once the batch has finished
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = upload.dstAccessMask;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = upload.buffer;
+			bufferBarrier.offset = upload.offset;
+			bufferBarrier.size = upload.size;
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, upload.dstStageMask, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		}
+
+		endBatch(batch, upload);
+	}
+
+	void StreamingUploader::processTexture2D(Upload &upload, const std::string &filename, VkFormat format, VkImageUsageFlags imageUsageFlags)
+	{
+		VKS_PROFILE_ZONE("Streaming texture");
+		vks::Texture2D &texture = upload.texture;
+		ktxTexture *ktxTexture;
+		ktxResult result = texture.loadKTXFile(filename, &ktxTexture);
+		assert(result == KTX_SUCCESS);
+
+		texture.device = device;
+		texture.width = ktxTexture->baseWidth;
+		texture.height = ktxTexture->baseHeight;
+		texture.mipLevels = ktxTexture->numLevels;
+		texture.layerCount = 1;
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		upload.size = ktxTexture_GetSize(ktxTexture);
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = texture.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		imageCreateInfo.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, texture.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &texture.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texture.image, texture.deviceMemory, 0));
+
+		Batch batch;
+		Staging staging = beginBatch(upload.size, batch);
+		memcpy(staging.mapped, ktxTexture_GetData(ktxTexture), static_cast<size_t>(upload.size));
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t i = 0; i < texture.mipLevels; i++) {
+			ktx_size_t offset;
+			result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+			assert(result == KTX_SUCCESS);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, texture.width >> i);
+			bufferCopyRegion.imageExtent.height = std::max(1u, texture.height >> i);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+		}
+		ktxTexture_Destroy(ktxTexture);
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 };
+		vks::tools::setImageLayout(batch.commandBuffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBufferToImage(batch.commandBuffer, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		if (transferQueueFamilyIndex != graphicsQueueFamilyIndex) {
+			// The layout transition is part of the ownership transfer, update() records the acquire with the same layouts
+			device->cmdReleaseImage(batch.commandBuffer, texture.image, subresourceRange, transferQueueFamilyIndex, graphicsQueueFamilyIndex, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.imageLayout, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+		else {
+			vks::tools::setImageLayout(batch.commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.imageLayout, subresourceRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.maxLod = static_cast<float>(texture.mipLevels);
+		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &texture.sampler));
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = subresourceRange;
+		viewCreateInfo.image = texture.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &texture.view));
+		texture.updateDescriptor();
+
+		endBatch(batch, upload);
+	}
+
+	void StreamingUploader::uploadBuffer(VkBuffer buffer, const void *data, VkDeviceSize size, VkDeviceSize offset, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, CompletionFunction onComplete)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		Upload upload;
+		upload.size = size;
+		upload.onComplete = onComplete;
+		upload.buffer = buffer;
+		upload.offset = offset;
+		upload.dstAccessMask = dstAccessMask;
+		upload.dstStageMask = dstStageMask;
+		// Shared, as the job is copied when the worker picks it up
+		std::shared_ptr<std::vector<uint8_t>> copy = std::make_shared<std::vector<uint8_t>>(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+		addRequest([this, upload, copy]() mutable {
+			processBuffer(upload, *copy);
+		});
+		statistics.renderThreadTime += millisecondsSince(tStart);
+	}
+
+	void StreamingUploader::loadTexture2D(const std::string &filename, VkFormat format, vks::Texture2D *texture, CompletionFunction onComplete, VkImageUsageFlags imageUsageFlags)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		Upload upload;
+		upload.onComplete = onComplete;
+		upload.target = texture;
+		addRequest([this, upload, filename, format, imageUsageFlags]() mutable {
+			processTexture2D(upload, filename, format, imageUsageFlags);
+		});
+		statistics.renderThreadTime += millisecondsSince(tStart);
+	}
+
+	void StreamingUploader::createPlaceholder(vks::Texture2D &texture, uint32_t color)
+	{
+		texture.fromBuffer(&color, sizeof(color), VK_FORMAT_R8G8B8A8_UNORM, 1, 1, device, graphicsQueue);
+	}
+
+	uint32_t StreamingUploader::update()
+	{
+		VKS_PROFILE_ZONE("Streaming update");
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Acquire command buffers of earlier calls
+		for (auto it = acquireSubmissions.begin(); it != acquireSubmissions.end();) {
+			if (vkGetFenceStatus(device->logicalDevice, it->fence) == VK_SUCCESS) {
+				vkFreeCommandBuffers(device->logicalDevice, acquireCommandPool, 1, &it->commandBuffer);
+				vkDestroyFence(device->logicalDevice, it->fence, nullptr);
+				it = acquireSubmissions.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		std::vector<Upload> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!workerSubmits) {
+				for (auto &batch : batches) {
+					if (!batch.submitted) {
+						submitBatch(batch);
+					}
+				}
+			}
+			const uint64_t completed = updateCompletedValue();
+			while (!uploads.empty() && (uploads.front().value <= completed)) {
+				finished.push_back(uploads.front());
+				uploads.pop_front();
+			}
+		}
+
+		if (!finished.empty() && (transferQueueFamilyIndex != graphicsQueueFamilyIndex)) {
+			// The transfer queue has finished, so no semaphore is needed for the acquiring half of the ownership transfers
+			AcquireSubmission submission;
+			submission.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, acquireCommandPool, true);
+			for (auto &upload : finished) {
+				if (upload.target) {
+					VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, upload.texture.mipLevels, 0, 1 };
+					device->cmdAcquireImage(submission.commandBuffer, upload.texture.image, subresourceRange, transferQueueFamilyIndex, graphicsQueueFamilyIndex, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.texture.imageLayout, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+				}
+				else {
+					device->cmdAcquireBuffer(submission.commandBuffer, upload.buffer, transferQueueFamilyIndex, graphicsQueueFamilyIndex, upload.dstAccessMask, upload.dstStageMask, upload.offset, upload.size);
+				}
+			}
+			VK_CHECK_RESULT(vkEndCommandBuffer(submission.commandBuffer));
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &submission.fence));
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &submission.commandBuffer;
+			// Later submissions to the graphics queue are ordered after the acquire barriers
+			VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, submission.fence));
+			acquireSubmissions.push_back(submission);
+		}
+
+		const bool active = (statistics.uploadsPending > 0);
+		for (auto &upload : finished) {
+			if (upload.target) {
+				upload.target->destroy();
+				*upload.target = upload.texture;
+			}
+			statistics.bytesUploaded += upload.size;
+			statistics.uploadsCompleted++;
+			statistics.uploadsPending--;
+			if (upload.overflow) {
+				statistics.ringOverflows++;
+			}
+			if (upload.onComplete) {
+				upload.onComplete();
+			}
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		if (active) {
+			activeTime += std::chrono::duration<double>(tEnd - activeStart).count();
+			activeStart = tEnd;
+		}
+		if (activeTime > 0.0) {
+			statistics.throughput = static_cast<double>(statistics.bytesUploaded) / (1024.0 * 1024.0) / activeTime;
+		}
+		statistics.lastUpdateTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		statistics.renderThreadTime += statistics.lastUpdateTime;
+		return static_cast<uint32_t>(finished.size());
+	}
+
+	bool StreamingUploader::idle() const
+	{
+		return statistics.uploadsPending == 0;
+	}
+
+	const StreamingUploader::Statistics &StreamingUploader::getStatistics() const
+	{
+		return statistics;
+	}
+
+	void StreamingUploader::onUpdateUIOverlay(vks::UIOverlay *overlay) const
+	{
+		overlay->text("Uploads: %u done, %u pending", statistics.uploadsCompleted, statistics.uploadsPending);
+		overlay->text("Uploaded: %.1f MB at %.1f MB/s", static_cast<double>(statistics.bytesUploaded) / (1024.0 * 1024.0), statistics.throughput);
+		overlay->text("Render thread: %.3f ms total, %.3f ms last update", statistics.renderThreadTime, statistics.lastUpdateTime);
+		if (statistics.ringOverflows > 0) {
+			overlay->text("Staging ring overflows: %u", statistics.ringOverflows);
+		}
+	}
+}
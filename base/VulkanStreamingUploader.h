@@ -0,0 +1,183 @@
+/*
+* Background streaming uploads on the transfer queue
+*
+* Requests are processed on a worker thread that copies the data into a persistent staging ring buffer and records the copies
+* for the transfer queue, so loading doesn't stall the render loop the way VulkanDevice::flushCommandBuffer does
+* Submissions are tracked with a timeline semaphore (fences if the device doesn't have them enabled), finished uploads are
+* handed back to the render thread in update(), which acquires them for the graphics queue family and calls their completion callbacks
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+	class Thread;
+	class UIOverlay;
+
+	class StreamingUploader
+	{
+	public:
+		/** @brief Called on the render thread from update() once the upload can be used on the graphics queue */
+		typedef std::function<void()> CompletionFunction;
+
+		struct Statistics {
+			/** @brief Size of all uploads that have been handed back */
+			uint64_t bytesUploaded = 0;
+			uint32_t uploadsCompleted = 0;
+			/** @brief Requested uploads that have not been handed back yet */
+			uint32_t uploadsPending = 0;
+			/** @brief Uploads that didn't fit into the free part of the ring and got a staging buffer of their own */
+			uint32_t ringOverflows = 0;
+			/** @brief Megabytes per second over the time uploads were pending */
+			double throughput = 0.0;
+			/** @brief Time the render thread spent in the request functions and update() in milliseconds */
+			double renderThreadTime = 0.0;
+			/** @brief Render thread time of the last update() in milliseconds */
+			double lastUpdateTime = 0.0;
+		};
+
+	private:
+		/** @brief An upload as it is handed back to the render thread */
+		struct Upload {
+			/** @brief Submission that has to finish before the upload can be used */
+			uint64_t value = 0;
+			VkDeviceSize size = 0;
+			CompletionFunction onComplete;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkAccessFlags dstAccessMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+			/** @brief Texture replaced by the streamed one, which is created by the worker thread */
+			vks::Texture2D *target = nullptr;
+			vks::Texture2D texture;
+			/** @brief Set if the upload didn't fit into the ring */
+			bool overflow = false;
+		};
+
+		/** @brief Command buffer submitted to the transfer queue and the staging memory it reads from */
+		struct Batch {
+			uint64_t value = 0;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			/** @brief Only used without timeline semaphores */
+			VkFence fence = VK_NULL_HANDLE;
+			VkDeviceSize ringOffset = 0;
+			VkDeviceSize ringSize = 0;
+			/** @brief Used instead of the ring for uploads that don't fit into it */
+			vks::Buffer overflowBuffer;
+			bool submitted = false;
+		};
+
+		/** @brief Staging memory of a batch as seen by the worker while recording */
+		struct Staging {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			uint8_t *mapped = nullptr;
+		};
+
+		struct AcquireSubmission {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue transferQueue = VK_NULL_HANDLE;
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		uint32_t transferQueueFamilyIndex = 0;
+		uint32_t graphicsQueueFamilyIndex = 0;
+		/** @brief False if the transfer queue is the graphics queue, which may only be used by the render thread */
+		bool workerSubmits = false;
+		bool timelineSemaphores = false;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		/** @brief Only recorded on by the worker thread */
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		/** @brief Only recorded on by the render thread */
+		VkCommandPool acquireCommandPool = VK_NULL_HANDLE;
+		vks::Buffer ring;
+		/** @brief Write position of the worker in the ring */
+		VkDeviceSize ringHead = 0;
+		vks::Thread *worker = nullptr;
+
+		/** @brief Guards the batches, the uploads and the submission counters */
+		std::mutex mutex;
+		std::deque<Batch> batches;
+		std::deque<Upload> uploads;
+		uint64_t nextValue = 0;
+		uint64_t completedValue = 0;
+
+		std::vector<AcquireSubmission> acquireSubmissions;
+		Statistics statistics;
+		double activeTime = 0.0;
+		std::chrono::time_point<std::chrono::high_resolution_clock> activeStart;
+
+		uint64_t updateCompletedValue();
+		void retireBatches();
+		bool findRingSpace(VkDeviceSize size, VkDeviceSize &offset);
+		Staging beginBatch(VkDeviceSize size, Batch &batch);
+		void endBatch(Batch &batch, Upload &upload);
+		void submitBatch(Batch &batch);
+		void addRequest(const std::function<void()> &job);
+		void processBuffer(Upload &upload, const std::vector<uint8_t> &data);
+		void processTexture2D(Upload &upload, const std::string &filename, VkFormat format, VkImageUsageFlags imageUsageFlags);
+	public:
+		~StreamingUploader();
+
+		/**
+		* Creates the staging ring buffer and starts the worker thread
+		*
+		* @param device Device the uploads are made on, if timelineSemaphores is set the submissions are tracked with a timeline semaphore
+		* @param transferQueue Queue of device->queueFamilyIndices.transfer, must not be used by anyone else unless it is the graphics queue
+		* @param graphicsQueue Queue of device->queueFamilyIndices.graphics the uploads are acquired on
+		* @param stagingSize (Optional) Size of the staging ring, larger uploads get a temporary staging buffer
+		*/
+		void create(vks::VulkanDevice *device, VkQueue transferQueue, VkQueue graphicsQueue, VkDeviceSize stagingSize = 32 * 1024 * 1024);
+		/** @brief Waits for the worker and the device, textures of uploads that have not been handed back are destroyed */
+		void destroy();
+
+		/**
+		* Copies data into a device local buffer in the background, the data is copied before the function returns
+		*
+		* @param buffer Buffer created with VK_BUFFER_USAGE_TRANSFER_DST_BIT, must not be used until the upload has completed
+		* @param dstAccessMask Accesses of the graphics queue the buffer is used for afterwards
+		* @param dstStageMask Stages of the graphics queue that wait for the upload
+		*/
+		void uploadBuffer(VkBuffer buffer, const void *data, VkDeviceSize size, VkDeviceSize offset, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, CompletionFunction onComplete = nullptr);
+		/**
+		* Loads a KTX file into a 2D texture in the background
+		*
+		* The texture has to hold a valid texture until the upload has completed (e.g. from createPlaceholder), that is destroyed and
+		* replaced by the streamed one in update(), so descriptors using the texture need to be written again in onComplete
+		*/
+		void loadTexture2D(const std::string &filename, VkFormat format, vks::Texture2D *texture, CompletionFunction onComplete = nullptr, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT);
+		/** @brief Creates a single texel RGBA texture (color is 0xAABBGGRR) on the graphics queue, to be used until a streamed texture is ready */
+		void createPlaceholder(vks::Texture2D &texture, uint32_t color);
+
+		/**
+		* Submits recorded uploads if the worker can't, acquires finished uploads for the graphics queue family and calls their completion callbacks
+		*
+		* Must be called on the render thread while the graphics queue doesn't use the textures that are replaced (e.g. before drawing a frame)
+		* Never waits for the device or the worker thread
+		*
+		* @return Number of uploads that have been completed
+		*/
+		uint32_t update();
+		/** @brief True if there are no pending uploads */
+		bool idle() const;
+		const Statistics &getStatistics() const;
+		void onUpdateUIOverlay(vks::UIOverlay *overlay) const;
+	};
+}
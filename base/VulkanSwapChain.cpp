@@ -288,6 +288,20 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		}
 	}
 
+	// An explicitly requested present mode overrides the vsync based selection
+	if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+	{
+		if (std::find(presentModes.begin(), presentModes.end(), requestedPresentMode) != presentModes.end())
+		{
+			swapchainPresentMode = requestedPresentMode;
+		}
+		else
+		{
+			std::cerr << "Present mode " << vks::tools::presentModeString(requestedPresentMode) << " is not supported by the surface, using " << vks::tools::presentModeString(swapchainPresentMode) << "\n";
+		}
+	}
+	presentMode = swapchainPresentMode;
+
 	// Determine the number of images
 	uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
@@ -301,6 +315,10 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		desiredNumberOfSwapchainImages = surfCaps.minImageCount;
 	}
 #endif
+	if (requestedImageCount > 0)
+	{
+		desiredNumberOfSwapchainImages = std::max(requestedImageCount, surfCaps.minImageCount);
+	}
 	if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount))
 	{
 		desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
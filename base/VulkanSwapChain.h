@@ -57,6 +57,12 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Present mode to use if the surface supports it, VK_PRESENT_MODE_MAX_ENUM_KHR selects one based on vsync */
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	/** @brief Minimum number of images to request, 0 uses one more than the surface's minimum */
+	uint32_t requestedImageCount = 0;
+	/** @brief Present mode of the current swap chain */
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -52,6 +52,105 @@ namespace vks
 		return result;
 	}
 
+	/**
+	* Read back all mip levels and layers of the texture's image and write them to a KTX file
+	*
+	* @param filename File to write
+	* @param format Vulkan format of the image (only uncompressed color formats are supported)
+	* @param copyQueue Queue used for the readback copy commands (must support transfer)
+	* @param (Optional) cubeMap Store the six layers of the image as cube map faces
+	* @param (Optional) keyValues Key/value pairs added to the file's meta data (e.g. to validate cache files)
+	*
+	* @note The image must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, width, height, mipLevels, layerCount and imageLayout need to be set
+	* @return False if the format is not supported or the file could not be written
+	*/
+	bool Texture::saveToKTXFile(std::string filename, VkFormat format, VkQueue copyQueue, bool cubeMap, const std::vector<std::pair<std::string, std::string>> &keyValues)
+	{
+		// KTX 1 stores OpenGL internal formats
+		uint32_t glInternalformat = 0;
+		uint32_t texelSize = 0;
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM: glInternalformat = 0x8058 /* GL_RGBA8 */; texelSize = 4; break;
+		case VK_FORMAT_R8G8B8A8_SRGB: glInternalformat = 0x8C43 /* GL_SRGB8_ALPHA8 */; texelSize = 4; break;
+		case VK_FORMAT_R16_SFLOAT: glInternalformat = 0x822D /* GL_R16F */; texelSize = 2; break;
+		case VK_FORMAT_R16G16_SFLOAT: glInternalformat = 0x822F /* GL_RG16F */; texelSize = 4; break;
+		case VK_FORMAT_R16G16B16A16_SFLOAT: glInternalformat = 0x881A /* GL_RGBA16F */; texelSize = 8; break;
+		case VK_FORMAT_R32_SFLOAT: glInternalformat = 0x822E /* GL_R32F */; texelSize = 4; break;
+		case VK_FORMAT_R32G32_SFLOAT: glInternalformat = 0x8230 /* GL_RG32F */; texelSize = 8; break;
+		case VK_FORMAT_R32G32B32A32_SFLOAT: glInternalformat = 0x8814 /* GL_RGBA32F */; texelSize = 16; break;
+		default:
+			std::cerr << "Format " << format << " is not supported for writing KTX files" << std::endl;
+			return false;
+		}
+		assert(!cubeMap || layerCount == 6);
+
+		// Tightly packed copy of all layers for each mip level
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize bufferSize = 0;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			for (uint32_t layer = 0; layer < layerCount; layer++) {
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.bufferOffset = bufferSize;
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = std::max(1u, width >> level);
+				bufferCopyRegion.imageExtent.height = std::max(1u, height >> level);
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegions.push_back(bufferCopyRegion);
+				bufferSize += bufferCopyRegion.imageExtent.width * bufferCopyRegion.imageExtent.height * texelSize;
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, bufferSize));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = layerCount;
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, image, imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		vkCmdCopyImageToBuffer(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer.buffer, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageLayout, subresourceRange);
+		device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+		ktxTextureCreateInfo createInfo = {};
+		createInfo.glInternalformat = glInternalformat;
+		createInfo.baseWidth = width;
+		createInfo.baseHeight = height;
+		createInfo.baseDepth = 1;
+		createInfo.numDimensions = 2;
+		createInfo.numLevels = mipLevels;
+		createInfo.numLayers = cubeMap ? 1 : layerCount;
+		createInfo.numFaces = cubeMap ? 6 : 1;
+		createInfo.isArray = (!cubeMap && layerCount > 1) ? KTX_TRUE : KTX_FALSE;
+		createInfo.generateMipmaps = KTX_FALSE;
+
+		ktxTexture* ktxTexture;
+		if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktxTexture) != KTX_SUCCESS) {
+			stagingBuffer.destroy();
+			return false;
+		}
+		VK_CHECK_RESULT(stagingBuffer.map());
+		const ktx_uint8_t* data = static_cast<const ktx_uint8_t*>(stagingBuffer.mapped);
+		for (auto& region : bufferCopyRegions) {
+			const uint32_t layer = region.imageSubresource.baseArrayLayer;
+			const ktx_size_t imageSize = region.imageExtent.width * region.imageExtent.height * texelSize;
+			ktxTexture_SetImageFromMemory(ktxTexture, region.imageSubresource.mipLevel, cubeMap ? 0 : layer, cubeMap ? layer : 0, data + region.bufferOffset, imageSize);
+		}
+		stagingBuffer.destroy();
+
+		for (auto& keyValue : keyValues) {
+			ktxHashList_AddKVPair(&ktxTexture->kvDataHead, keyValue.first.c_str(), static_cast<unsigned int>(keyValue.second.size() + 1), keyValue.second.c_str());
+		}
+		ktxResult result = ktxTexture_WriteToNamedFile(ktxTexture, filename.c_str());
+		ktxTexture_Destroy(ktxTexture);
+		return result == KTX_SUCCESS;
+	}
+
 	/**
 	* Load a 2D texture including all mip levels
 	*
@@ -343,15 +442,16 @@ namespace vks
 	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) mipLevels Number of mip levels stored in the buffer, tightly packed one after another starting with the base level (uncompressed formats only, defaults to 1)
 	*/
-	void Texture2D::fromBuffer(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t texWidth, uint32_t texHeight, vks::VulkanDevice *device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	void Texture2D::fromBuffer(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t texWidth, uint32_t texHeight, vks::VulkanDevice *device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, uint32_t mipLevels)
 	{
 		assert(buffer);
 
 		this->device = device;
 		width = texWidth;
 		height = texHeight;
-		mipLevels = 1;
+		this->mipLevels = mipLevels;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -387,15 +487,28 @@ namespace vks
 		memcpy(data, buffer, bufferSize);
 		vkUnmapMemory(device->logicalDevice, stagingMemory);
 
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = 0;
+		// The texel size is derived from the buffer size, as all levels are tightly packed
+		VkDeviceSize texelCount = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			texelCount += static_cast<VkDeviceSize>(std::max(width >> i, 1u)) * std::max(height >> i, 1u);
+		}
+		const VkDeviceSize texelSize = bufferSize / texelCount;
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(width >> i, 1u);
+			bufferCopyRegion.imageExtent.height = std::max(height >> i, 1u);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			offset += static_cast<VkDeviceSize>(bufferCopyRegion.imageExtent.width) * bufferCopyRegion.imageExtent.height * texelSize;
+		}
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -445,8 +558,8 @@ namespace vks
 			stagingBuffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferCopyRegion
+			static_cast<uint32_t>(bufferCopyRegions.size()),
+			bufferCopyRegions.data()
 		);
 
 		// Change texture image layout to shader read after all mip levels have been copied
@@ -476,7 +589,7 @@ namespace vks
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxLod = (float)mipLevels;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
 		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
 
@@ -487,7 +600,7 @@ namespace vks
 		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewCreateInfo.format = format;
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
@@ -45,6 +45,7 @@ class Texture
 	void      updateDescriptor();
 	void      destroy();
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	bool      saveToKTXFile(std::string filename, VkFormat format, VkQueue copyQueue, bool cubeMap = false, const std::vector<std::pair<std::string, std::string>> &keyValues = {});
 };
 
 class Texture2D : public Texture
@@ -68,7 +69,8 @@ class Texture2D : public Texture
 	    VkQueue            copyQueue,
 	    VkFilter           filter          = VK_FILTER_LINEAR,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    uint32_t           mipLevels       = 1);
 };
 
 class Texture2DArray : public Texture
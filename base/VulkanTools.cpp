@@ -8,6 +8,12 @@
 
 #include "VulkanTools.h"
 
+#include <errno.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
 const std::string getAssetPath()
@@ -77,6 +83,20 @@ namespace vks
 			}
 		}
 
+		std::string presentModeString(VkPresentModeKHR presentMode)
+		{
+			switch (presentMode)
+			{
+#define STR(r) case VK_PRESENT_MODE_ ##r ##_KHR: return #r
+				STR(IMMEDIATE);
+				STR(MAILBOX);
+				STR(FIFO);
+				STR(FIFO_RELAXED);
+#undef STR
+			default: return "UNKNOWN_PRESENT_MODE";
+			}
+		}
+
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 		{
 			// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -394,6 +414,55 @@ namespace vks
 			return !f.fail();
 		}
 
+		bool getFileInfo(const std::string &filename, uint64_t &size, int64_t &modificationTime)
+		{
+#if defined(_WIN32)
+			struct _stat64 fileStat;
+			if (_stat64(filename.c_str(), &fileStat) != 0) {
+				return false;
+			}
+#else
+			struct stat fileStat;
+			if (stat(filename.c_str(), &fileStat) != 0) {
+				return false;
+			}
+#endif
+			size = static_cast<uint64_t>(fileStat.st_size);
+			modificationTime = static_cast<int64_t>(fileStat.st_mtime);
+			return true;
+		}
+
+		uint64_t hash(const void *data, size_t size, uint64_t seed)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			uint64_t value = seed;
+			for (size_t i = 0; i < size; i++) {
+				value = (value ^ bytes[i]) * 1099511628211ull;
+			}
+			return value;
+		}
+
+		const std::string getCachePath()
+		{
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+			const std::string path = std::string(androidApp->activity->internalDataPath) + "/cache/";
+#elif defined(VK_EXAMPLE_CACHE_DIR)
+			const std::string path = VK_EXAMPLE_CACHE_DIR;
+#else
+			const std::string path = "./cache/";
+#endif
+#if defined(_WIN32)
+			const int result = _mkdir(path.c_str());
+#else
+			const int result = mkdir(path.c_str(), 0755);
+#endif
+			if ((result != 0) && (errno != EEXIST)) {
+				std::cerr << "Could not create cache directory \"" << path << "\"" << std::endl;
+				return "";
+			}
+			return path;
+		}
+
 		uint32_t alignedSize(uint32_t value, uint32_t alignment)
         {
 	        return (value + alignment - 1) & ~(alignment - 1);
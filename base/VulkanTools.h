@@ -75,6 +75,9 @@ namespace vks
 		/** @brief Returns the device type as a string */
 		std::string physicalDeviceTypeString(VkPhysicalDeviceType type);
 
+		/** @brief Returns the present mode as a string */
+		std::string presentModeString(VkPresentModeKHR presentMode);
+
 		// Selected a suitable supported depth format starting with 32 bit down to 16 bit
 		// Returns false if none of the depth formats in the list is supported by the device
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat);
@@ -128,6 +131,22 @@ namespace vks
 
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
+		/** @brief Returns the size and the last modification time (seconds since the epoch) of a file, false if it does not exist */
+		bool getFileInfo(const std::string &filename, uint64_t &size, int64_t &modificationTime);
+
+		/** @brief Offset basis of the 64 bit FNV-1a hash, the initial seed for a new hash */
+		const uint64_t hashSeed = 14695981039346656037ull;
+		/**
+		* Returns the 64 bit FNV-1a hash of the given data, used for content keys of cached files and shader modules
+		* Pass a previous result as seed to hash data spread over several buffers, data/shaders/packshaders.py implements the same function
+		*/
+		uint64_t hash(const void *data, size_t size, uint64_t seed = hashSeed);
+
+		/**
+		* Returns the directory for files generated from the assets at runtime (e.g. meshlets), including the trailing separator
+		* The directory is created if it doesn't exist yet, if that fails an empty string is returned and callers should not cache anything
+		*/
+		const std::string getCachePath();
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
 	}
@@ -12,11 +12,16 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+#include "VulkanCpuProfiler.h"
+#include "frustum.hpp"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutBindless = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+vks::MipGenerator* vkglTF::mipGenerator = nullptr;
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -62,7 +67,7 @@ void vkglTF::Texture::destroy()
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue, const vks::imageprocessing::MipChain* mipChain)
 {
 	this->device = device;
 
@@ -79,23 +84,22 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	if (!isKtx) {
 		// Texture was loaded using STB_Image
 
+		// A mip chain generated on the CPU already contains the RGBA data of all levels
+		const bool cpuMips = (mipChain != nullptr) && (mipChain->levelCount() > 0);
+
 		unsigned char* buffer = nullptr;
 		VkDeviceSize bufferSize = 0;
 		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
+		if (cpuMips) {
+			buffer = const_cast<unsigned char*>(mipChain->data.data());
+			bufferSize = mipChain->data.size();
+		}
+		else if (gltfimage.component == 3) {
 			// Most devices don't support RGB only on Vulkan so convert if necessary
 			// TODO: Check actual format support and transform only if required
 			bufferSize = gltfimage.width * gltfimage.height * 4;
 			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
+			vks::imageprocessing::expandRgbToRgba(buffer, &gltfimage.image[0], static_cast<size_t>(gltfimage.width) * gltfimage.height);
 			deleteBuffer = true;
 		}
 		else {
@@ -109,11 +113,15 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 		width = gltfimage.width;
 		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		mipLevels = cpuMips ? mipChain->levelCount() : static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+		// Prefer generating the mip chain with compute, which doesn't require blit support for the format
+		const bool computeMips = !cpuMips && mipGeneration.compute && (vkglTF::mipGenerator != nullptr) && vkglTF::mipGenerator->isFormatSupported(format);
+		if (!computeMips && !cpuMips) {
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		}
 
 		VkMemoryAllocateInfo memAllocInfo{};
 		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -152,6 +160,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { width, height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (computeMips) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -163,7 +174,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
+		// The compute path transitions all levels at once, so they share a layout when the mip chain is generated
+		subresourceRange.levelCount = (computeMips || cpuMips) ? mipLevels : 1;
 		subresourceRange.layerCount = 1;
 
 		{
@@ -178,18 +190,34 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
 
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t i = 0; i < (cpuMips ? mipLevels : 1); i++) {
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(width >> i, 1u);
+			bufferCopyRegion.imageExtent.height = std::max(height >> i, 1u);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = cpuMips ? mipChain->levelOffsets[i] : 0;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+		}
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 
-		{
+		if (cpuMips) {
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+		else if (!computeMips) {
 			VkImageMemoryBarrier imageMemoryBarrier{};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -206,78 +234,84 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually), a chain generated on the CPU has already been uploaded
+		if (computeMips) {
+			vkglTF::mipGenerator->generate(image, format, width, height, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, copyQueue, mipGeneration.filter, mipGeneration.srgb);
+		}
+		else if (!cpuMips) {
+			VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (uint32_t i = 1; i < mipLevels; i++) {
+				VkImageBlit imageBlit{};
+
+				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.srcSubresource.layerCount = 1;
+				imageBlit.srcSubresource.mipLevel = i - 1;
+				imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
+				imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+				imageBlit.srcOffsets[1].z = 1;
+
+				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.dstSubresource.layerCount = 1;
+				imageBlit.dstSubresource.mipLevel = i;
+				imageBlit.dstOffsets[1].x = int32_t(width >> i);
+				imageBlit.dstOffsets[1].y = int32_t(height >> i);
+				imageBlit.dstOffsets[1].z = 1;
+
+				VkImageSubresourceRange mipSubRange = {};
+				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				mipSubRange.baseMipLevel = i;
+				mipSubRange.levelCount = 1;
+				mipSubRange.layerCount = 1;
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = 0;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
+
+				vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 			}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			subresourceRange.levelCount = mipLevels;
 
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
 				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
-		}
-
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			device->flushCommandBuffer(blitCmd, copyQueue, true);
 		}
 
         if (deleteBuffer) {
             delete[] buffer;
         }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -528,17 +562,15 @@ glm::mat4 vkglTF::Node::getMatrix() {
 void vkglTF::Node::update() {
 	if (mesh) {
 		glm::mat4 m = getMatrix();
-		if (skin) {
+		if (skin && mesh->jointMatrices) {
 			mesh->uniformBlock.matrix = m;
-			// Update join matrices
+			// Joint matrices are written straight into the mapped joint palette, the uniform buffer only stores the range
 			glm::mat4 inverseTransform = glm::inverse(m);
 			for (size_t i = 0; i < skin->joints.size(); i++) {
 				vkglTF::Node *jointNode = skin->joints[i];
 				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
+				mesh->jointMatrices[i] = inverseTransform * jointMat;
 			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
 			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
 		} else {
 			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
@@ -568,10 +600,39 @@ std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttrib
 VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
 
 VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
-	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
+	return Vertex::inputBindingDescription(binding, VertexLayout::Default);
+}
+
+VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding, VertexLayout layout) {
+	const uint32_t stride = (layout == VertexLayout::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
+	return VkVertexInputBindingDescription({ binding, stride, VK_VERTEX_INPUT_RATE_VERTEX });
 }
 
 VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
+	return Vertex::inputAttributeDescription(binding, location, component, VertexLayout::Default);
+}
+
+VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component, VertexLayout layout) {
+	if (layout == VertexLayout::Packed) {
+		switch (component) {
+			case VertexComponent::Position:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, pos) });
+			case VertexComponent::Normal:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal) });
+			case VertexComponent::UV:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv) });
+			case VertexComponent::Color:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color) });
+			case VertexComponent::Tangent:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_SNORM, offsetof(PackedVertex, tangent) });
+			case VertexComponent::Joint0:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_UINT, offsetof(PackedVertex, joint0) });
+			case VertexComponent::Weight0:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, weight0) });
+			default:
+				return VkVertexInputAttributeDescription({});
+		}
+	}
 	switch (component) {
 		case VertexComponent::Position: 
 			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
@@ -593,10 +654,14 @@ VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint
 }
 
 std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
+	return Vertex::inputAttributeDescriptions(binding, components, VertexLayout::Default);
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components, VertexLayout layout) {
 	std::vector<VkVertexInputAttributeDescription> result;
 	uint32_t location = 0;
 	for (VertexComponent component : components) {
-		result.push_back(Vertex::inputAttributeDescription(binding, location, component));
+		result.push_back(Vertex::inputAttributeDescription(binding, location, component, layout));
 		location++;
 	}
 	return result;
@@ -604,8 +669,12 @@ std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDes
 
 /** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
 VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
-	vertexInputBindingDescription = Vertex::inputBindingDescription(0);
-	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+	return Vertex::getPipelineVertexInputState(components, VertexLayout::Default);
+}
+
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexLayout layout) {
+	vertexInputBindingDescription = Vertex::inputBindingDescription(0, layout);
+	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components, layout);
 	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
 	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
@@ -614,6 +683,94 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+/*
+	Quantized vertex layout
+*/
+
+namespace
+{
+	// Octahedral encoding of a unit vector into the [-1..1] range (see "A Survey of Efficient Representations for Independent Unit Vectors")
+	glm::vec2 octahedralEncode(glm::vec3 n)
+	{
+		const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (l1 == 0.0f || std::isnan(l1)) {
+			return glm::vec2(0.0f);
+		}
+		n /= l1;
+		glm::vec2 p = glm::vec2(n.x, n.y);
+		if (n.z < 0.0f) {
+			p.x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+			p.y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return p;
+	}
+
+	uint16_t packUnorm16(float value)
+	{
+		return static_cast<uint16_t>(roundf(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	int16_t packSnorm16(float value)
+	{
+		return static_cast<int16_t>(roundf(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint8_t packUnorm8(float value)
+	{
+		return static_cast<uint8_t>(roundf(glm::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	int8_t packSnorm8(float value)
+	{
+		return static_cast<int8_t>(roundf(glm::clamp(value, -1.0f, 1.0f) * 127.0f));
+	}
+}
+
+vkglTF::PackedVertex vkglTF::PackedVertex::pack(const Vertex& vertex, const glm::vec3& positionOffset, const glm::vec3& positionScale)
+{
+	PackedVertex packed{};
+	for (uint32_t i = 0; i < 3; i++) {
+		packed.pos[i] = packUnorm16(positionScale[i] > 0.0f ? (vertex.pos[i] - positionOffset[i]) / positionScale[i] : 0.0f);
+	}
+	packed.pos[3] = 65535;
+
+	const glm::vec2 normal = octahedralEncode(vertex.normal);
+	packed.normal[0] = packSnorm16(normal.x);
+	packed.normal[1] = packSnorm16(normal.y);
+
+	packed.uv[0] = glm::packHalf1x16(vertex.uv.x);
+	packed.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+	for (uint32_t i = 0; i < 4; i++) {
+		packed.color[i] = packUnorm8(vertex.color[i]);
+		// glTF stores joint indices as unsigned byte or unsigned short, so 16 bits hold any valid index
+		packed.joint0[i] = static_cast<uint16_t>(glm::clamp(vertex.joint0[i], 0.0f, 65535.0f));
+	}
+
+	// Quantize weights so that they still add up to one (255) after unorm8 conversion
+	const float weightSum = vertex.weight0.x + vertex.weight0.y + vertex.weight0.z + vertex.weight0.w;
+	if (weightSum > 0.0f) {
+		int32_t quantizedSum = 0;
+		uint32_t largest = 0;
+		for (uint32_t i = 0; i < 4; i++) {
+			packed.weight0[i] = packUnorm8(vertex.weight0[i] / weightSum);
+			quantizedSum += packed.weight0[i];
+			if (packed.weight0[i] > packed.weight0[largest]) {
+				largest = i;
+			}
+		}
+		packed.weight0[largest] = static_cast<uint8_t>(packed.weight0[largest] + (255 - quantizedSum));
+	}
+
+	const glm::vec2 tangent = octahedralEncode(glm::vec3(vertex.tangent));
+	packed.tangent[0] = packSnorm8(tangent.x);
+	packed.tangent[1] = packSnorm8(tangent.y);
+	packed.tangent[2] = 0;
+	packed.tangent[3] = vertex.tangent.w < 0.0f ? -127 : 127;
+
+	return packed;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -744,6 +901,14 @@ vkglTF::Model::~Model()
     for (auto skin : skins) {
         delete skin;
     }
+	jointPalette.buffer.destroy();
+	skinning.vertices.destroy();
+	if (skinning.pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, skinning.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, skinning.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, skinning.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, skinning.descriptorPool, nullptr);
+	}
 	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
 		descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -752,6 +917,22 @@ vkglTF::Model::~Model()
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
+	if (descriptorSetLayoutBindless != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutBindless, nullptr);
+		descriptorSetLayoutBindless = VK_NULL_HANDLE;
+	}
+	bindless.materialBuffer.destroy();
+	if (indirect.pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, indirect.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, indirect.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, indirect.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, indirect.descriptorPool, nullptr);
+	}
+	indirect.instanceBuffer.destroy();
+	indirect.commandBuffer.destroy();
+	indirect.countBuffer.destroy();
+	indirect.countReadback.destroy();
+	indirect.cullingBuffer.destroy();
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 	emptyTexture.destroy();
 }
@@ -959,6 +1140,7 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 
 void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadSkins");
 	for (tinygltf::Skin &source : gltfModel.skins) {
 		Skin *newSkin = new Skin{};
 		newSkin->name = source.name;
@@ -991,10 +1173,79 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadImages");
+	// Color textures store sRGB encoded data, their mip chains are filtered in linear space
+	std::vector<bool> srgbImages(gltfModel.images.size(), false);
+	for (tinygltf::Material &mat : gltfModel.materials) {
+		for (const char* colorTexture : { "baseColorTexture", "emissiveTexture" }) {
+			int32_t textureIndex = -1;
+			if (mat.values.find(colorTexture) != mat.values.end()) {
+				textureIndex = mat.values[colorTexture].TextureIndex();
+			}
+			if (mat.additionalValues.find(colorTexture) != mat.additionalValues.end()) {
+				textureIndex = mat.additionalValues[colorTexture].TextureIndex();
+			}
+			if ((textureIndex > -1) && (gltfModel.textures[textureIndex].source > -1)) {
+				srgbImages[gltfModel.textures[textureIndex].source] = true;
+			}
+		}
+	}
+
+	// Without the compute mip generator, the mip chains of images decoded by stb_image are generated on the CPU, with one job per image
+	std::vector<vks::imageprocessing::MipChain> mipChains(gltfModel.images.size());
+	if ((vkglTF::mipGenerator == nullptr) && imageSettings.generateMipChains) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		size_t sourceBytes = 0;
+		std::vector<size_t> jobs;
+		for (size_t i = 0; i < gltfModel.images.size(); i++) {
+			const tinygltf::Image &image = gltfModel.images[i];
+			if (!image.image.empty() && (image.bits == 8) && ((image.component == 3) || (image.component == 4))) {
+				jobs.push_back(i);
+				sourceBytes += image.image.size();
+			}
+		}
+		if (!jobs.empty()) {
+			const vks::imageprocessing::Filter filter = imageSettings.filter;
+			auto mipChainJob = [&gltfModel, &mipChains, &srgbImages, filter](size_t index) {
+				VKS_PROFILE_ZONE("Generate mip chain");
+				const tinygltf::Image &image = gltfModel.images[index];
+				const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+				if (image.component == 3) {
+					std::vector<uint8_t> rgba(pixelCount * 4);
+					vks::imageprocessing::expandRgbToRgba(rgba.data(), image.image.data(), pixelCount);
+					vks::imageprocessing::generateMipChain(mipChains[index], rgba.data(), image.width, image.height, filter, srgbImages[index]);
+				}
+				else {
+					vks::imageprocessing::generateMipChain(mipChains[index], image.image.data(), image.width, image.height, filter, srgbImages[index]);
+				}
+			};
+			uint32_t threadCount = imageSettings.threadCount > 0 ? imageSettings.threadCount : std::thread::hardware_concurrency();
+			threadCount = std::max(1u, std::min(threadCount, static_cast<uint32_t>(jobs.size())));
+			vks::ThreadPool threadPool;
+			threadPool.setThreadCount(threadCount);
+			for (size_t i = 0; i < jobs.size(); i++) {
+				const size_t index = jobs[i];
+				threadPool.threads[i % threadCount]->addJob([=] { mipChainJob(index); });
+			}
+			threadPool.wait();
+			// Throughput summary, only reported on request to keep regular model loads quiet
+			if (imageSettings.reportThroughput) {
+				auto tDuration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				std::cout << "Generated mip chains for " << jobs.size() << " images in " << tDuration << " ms using " << threadCount << " threads (" << (tDuration > 0.0 ? sourceBytes / (tDuration * 1000.0) : 0.0) << " MB/s)" << std::endl;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		VKS_PROFILE_ZONE("Upload image");
+		tinygltf::Image &image = gltfModel.images[i];
 		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
+		texture.mipGeneration.filter = mipFilter;
+		texture.mipGeneration.srgb = srgbImages[i];
+		texture.fromglTfImage(image, path, device, transferQueue, &mipChains[i]);
 		textures.push_back(texture);
+		// Release the CPU copy once it has been uploaded
+		std::vector<uint8_t>().swap(mipChains[i].data);
 	}
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
@@ -1002,6 +1253,7 @@ void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *de
 
 void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadMaterials");
 	for (tinygltf::Material &mat : gltfModel.materials) {
 		vkglTF::Material material(device);
 		if (mat.values.find("baseColorTexture") != mat.values.end()) {
@@ -1044,14 +1296,17 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
 		}
 
+		material.index = static_cast<uint32_t>(materials.size());
 		materials.push_back(material);
 	}
 	// Push a default material at the end of the list for meshes with no material assigned
 	materials.push_back(Material(device));
+	materials.back().index = static_cast<uint32_t>(materials.size() - 1);
 }
 
 void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadAnimations");
 	for (tinygltf::Animation &anim : gltfModel.animations) {
 		vkglTF::Animation animation{};
 		animation.name = anim.name;
@@ -1164,8 +1419,228 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
+void vkglTF::Model::optimizeMeshes(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer)
+{
+	VKS_PROFILE_ZONE("vkglTF::Model::optimizeMeshes");
+	auto tStart = std::chrono::high_resolution_clock::now();
+	uint32_t primitiveCount = 0;
+	uint32_t triangleCount = 0;
+	uint32_t vertexCount = 0;
+	uint32_t transformsBefore = 0;
+	uint32_t transformsAfter = 0;
+	std::vector<uint32_t> localIndices, optimizedIndices, clusters, remap;
+	for (Node* node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (Primitive* primitive : node->mesh->primitives) {
+			if ((primitive->indexCount < 3) || (primitive->vertexCount == 0)) {
+				continue;
+			}
+			// Indices are stored relative to the start of the model's vertex buffer, so rebase them to the primitive
+			localIndices.assign(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+			for (auto& index : localIndices) {
+				index -= primitive->firstVertex;
+			}
+			optimizedIndices.resize(localIndices.size());
+			remap.resize(primitive->vertexCount);
+
+			vks::meshoptimizer::VertexCacheStatistics before = vks::meshoptimizer::analyzeVertexCache(localIndices.data(), localIndices.size(), primitive->vertexCount);
+
+			// Vertex cache order, then sort the resulting clusters for overdraw
+			vks::meshoptimizer::optimizeVertexCache(optimizedIndices.data(), localIndices.data(), localIndices.size(), primitive->vertexCount, vks::meshoptimizer::defaultCacheSize, &clusters);
+			vks::meshoptimizer::optimizeOverdraw(localIndices.data(), optimizedIndices.data(), optimizedIndices.size(), &vertexBuffer[primitive->firstVertex].pos.x, primitive->vertexCount, sizeof(Vertex), clusters);
+
+			// Reorder vertices by first use for vertex fetch locality
+			vks::meshoptimizer::optimizeVertexFetchRemap(remap.data(), localIndices.data(), localIndices.size(), primitive->vertexCount);
+			vks::meshoptimizer::remapIndexBuffer(localIndices.data(), localIndices.size(), remap.data());
+			vks::meshoptimizer::remapVertexBuffer(&vertexBuffer[primitive->firstVertex], primitive->vertexCount, remap.data());
+
+			vks::meshoptimizer::VertexCacheStatistics after = vks::meshoptimizer::analyzeVertexCache(localIndices.data(), localIndices.size(), primitive->vertexCount);
+
+			for (size_t i = 0; i < localIndices.size(); i++) {
+				indexBuffer[primitive->firstIndex + i] = localIndices[i] + primitive->firstVertex;
+			}
+
+			primitiveCount++;
+			triangleCount += primitive->indexCount / 3;
+			vertexCount += primitive->vertexCount;
+			transformsBefore += before.vertexTransforms;
+			transformsAfter += after.vertexTransforms;
+		}
+	}
+	if (triangleCount > 0) {
+		auto tDuration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Optimized " << primitiveCount << " primitives (" << triangleCount << " triangles) in " << tDuration << " ms" << std::endl;
+		std::cout << "  ACMR: " << (float)transformsBefore / (float)triangleCount << " -> " << (float)transformsAfter / (float)triangleCount << std::endl;
+		std::cout << "  ATVR: " << (float)transformsBefore / (float)vertexCount << " -> " << (float)transformsAfter / (float)vertexCount << std::endl;
+	}
+}
+
+void vkglTF::Model::generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	VKS_PROFILE_ZONE("vkglTF::Model::generateLods");
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	std::vector<Primitive*> primitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				primitive->lods.clear();
+				primitive->lods.push_back({ primitive->firstIndex, primitive->indexCount, 0.0f });
+				if ((primitive->indexCount >= 3) && (primitive->vertexCount > 0)) {
+					primitives.push_back(primitive);
+				}
+			}
+		}
+	}
+	const size_t levelCount = lodSettings.ratios.size();
+	if (primitives.empty() || (levelCount == 0)) {
+		return;
+	}
+
+	// Every level is simplified from the full detail primitive, so all levels of all primitives can be generated in parallel
+	struct Job {
+		Primitive* primitive;
+		float ratio;
+		std::vector<uint32_t> indices;
+		float error;
+		double time;
+	};
+	std::vector<Job> jobs;
+	jobs.reserve(primitives.size() * levelCount);
+	for (Primitive* primitive : primitives) {
+		for (float ratio : lodSettings.ratios) {
+			jobs.push_back({ primitive, ratio, {}, 0.0f, 0.0 });
+		}
+	}
+
+	const float maxError = lodSettings.maxError;
+	auto simplifyJob = [&indexBuffer, &vertexBuffer, maxError](Job* job) {
+		VKS_PROFILE_ZONE("Simplify primitive");
+		auto tJobStart = std::chrono::high_resolution_clock::now();
+		const Primitive* primitive = job->primitive;
+		std::vector<uint32_t> localIndices(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+		for (auto& index : localIndices) {
+			index -= primitive->firstVertex;
+		}
+		const size_t targetIndexCount = static_cast<size_t>(primitive->indexCount / 3 * job->ratio) * 3;
+		job->indices.resize(localIndices.size());
+		const size_t indexCount = vks::meshoptimizer::simplify(job->indices.data(), localIndices.data(), localIndices.size(), &vertexBuffer[primitive->firstVertex].pos.x, primitive->vertexCount, sizeof(Vertex), targetIndexCount, maxError, &job->error);
+		job->indices.resize(indexCount);
+		// Simplification destroys the vertex cache order of the source
+		localIndices.resize(indexCount);
+		vks::meshoptimizer::optimizeVertexCache(localIndices.data(), job->indices.data(), indexCount, primitive->vertexCount);
+		job->indices.swap(localIndices);
+		job->time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tJobStart).count();
+	};
+
+	uint32_t threadCount = lodSettings.threadCount > 0 ? lodSettings.threadCount : std::thread::hardware_concurrency();
+	threadCount = std::max(1u, std::min(threadCount, static_cast<uint32_t>(jobs.size())));
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threadCount);
+	for (size_t i = 0; i < jobs.size(); i++) {
+		Job* job = &jobs[i];
+		threadPool.threads[i % threadCount]->addJob([=] { simplifyJob(job); });
+	}
+	threadPool.wait();
+
+	// Append the levels to the index buffer, levels that hit the error limit before reaching their target don't reduce the triangle count any further and are dropped
+	struct LevelStatistics {
+		uint32_t primitives = 0;
+		uint32_t sourceTriangles = 0;
+		uint32_t triangles = 0;
+		float maxError = 0.0f;
+		double time = 0.0;
+	};
+	std::vector<LevelStatistics> levelStatistics(levelCount);
+	for (size_t i = 0; i < primitives.size(); i++) {
+		Primitive* primitive = primitives[i];
+		for (size_t level = 0; level < levelCount; level++) {
+			Job& job = jobs[i * levelCount + level];
+			levelStatistics[level].time += job.time;
+			if (job.indices.empty() || (job.indices.size() >= primitive->lods.back().indexCount)) {
+				break;
+			}
+			Primitive::Lod lod{};
+			lod.firstIndex = static_cast<uint32_t>(indexBuffer.size());
+			lod.indexCount = static_cast<uint32_t>(job.indices.size());
+			lod.error = job.error;
+			for (uint32_t index : job.indices) {
+				indexBuffer.push_back(index + primitive->firstVertex);
+			}
+			primitive->lods.push_back(lod);
+			levelStatistics[level].primitives++;
+			levelStatistics[level].sourceTriangles += primitive->indexCount / 3;
+			levelStatistics[level].triangles += lod.indexCount / 3;
+			levelStatistics[level].maxError = std::max(levelStatistics[level].maxError, lod.error);
+		}
+	}
+
+	auto tDuration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	std::cout << "Generated levels of detail for " << primitives.size() << " primitives in " << tDuration << " ms using " << threadCount << " threads" << std::endl;
+	for (size_t level = 0; level < levelCount; level++) {
+		const LevelStatistics& statistics = levelStatistics[level];
+		const double trianglesPerSecond = statistics.time > 0.0 ? (double)statistics.sourceTriangles / (statistics.time / 1000.0) : 0.0;
+		std::cout << "  LOD " << level + 1 << " (" << lodSettings.ratios[level] * 100.0f << "%): " << statistics.primitives << " primitives, " << statistics.triangles << " triangles, max. error " << statistics.maxError << ", " << trianglesPerSecond / 1.0e6 << " M triangles/s" << std::endl;
+	}
+}
+
+void vkglTF::Model::buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, const std::string& cacheFile)
+{
+	VKS_PROFILE_ZONE("vkglTF::Model::buildMeshlets");
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	// The cache is only valid for the exact same geometry and limits
+	const uint32_t limits[2] = { vks::meshlet::defaultMaxVertices, vks::meshlet::defaultMaxTriangles };
+	uint64_t key = vks::tools::hash(limits, sizeof(limits));
+	key = vks::tools::hash(indexBuffer.data(), indexBuffer.size() * sizeof(uint32_t), key);
+	key = vks::tools::hash(vertexBuffer.data(), vertexBuffer.size() * sizeof(Vertex), key);
+
+	std::vector<Primitive*> primitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+
+	// Groups are stored in primitive order, so a cache file that matches the key can be assigned directly
+	bool cached = !cacheFile.empty() && vks::meshlet::loadFromFile(meshlets, cacheFile, key) && (meshlets.groups.size() == primitives.size());
+	if (!cached) {
+		meshlets.clear();
+		std::vector<uint32_t> localIndices;
+		for (Primitive* primitive : primitives) {
+			// Meshlets are built per primitive with local indices and rebased to the model's vertex buffer afterwards
+			localIndices.assign(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+			for (auto& index : localIndices) {
+				index -= primitive->firstVertex;
+			}
+			const size_t vertexOffset = meshlets.vertices.size();
+			vks::meshlet::build(meshlets, localIndices.data(), localIndices.size() - localIndices.size() % 3, primitive->vertexCount > 0 ? &vertexBuffer[primitive->firstVertex].pos.x : nullptr, primitive->vertexCount, sizeof(Vertex));
+			for (size_t i = vertexOffset; i < meshlets.vertices.size(); i++) {
+				meshlets.vertices[i] += primitive->firstVertex;
+			}
+		}
+		if (!cacheFile.empty() && !vks::meshlet::saveToFile(meshlets, cacheFile, key)) {
+			std::cout << "Could not write meshlet cache file \"" << cacheFile << "\"" << std::endl;
+		}
+	}
+
+	for (size_t i = 0; i < primitives.size(); i++) {
+		primitives[i]->firstMeshlet = meshlets.groups[i].firstMeshlet;
+		primitives[i]->meshletCount = meshlets.groups[i].meshletCount;
+	}
+
+	auto tDuration = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	vks::meshlet::Statistics statistics = vks::meshlet::getStatistics(meshlets);
+	std::cout << (cached ? "Loaded " : "Built ") << statistics.meshletCount << " meshlets in " << tDuration << " ms" << std::endl;
+	std::cout << "  Average vertices: " << statistics.averageVertices << " (" << statistics.vertexUtilization * 100.0f << "%), average triangles: " << statistics.averageTriangles << " (" << statistics.triangleUtilization * 100.0f << "%)" << std::endl;
+	std::cout << "  Cone cullable: " << statistics.coneCullable << std::endl;
+}
+
 void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
 {
+	VKS_PROFILE_ZONE("vkglTF::Model::loadFromFile");
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
@@ -1184,13 +1659,23 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	std::string error, warning;
 
 	this->device = device;
+	// The mesh shaders read meshlet vertices as full precision floats from the vertex buffer
+	if ((fileLoadingFlags & FileLoadingFlags::PackVertices) && (fileLoadingFlags & FileLoadingFlags::BuildMeshlets)) {
+		std::cerr << "Vertex packing is not supported for meshlet rendering, \"" << filename << "\" uses the default vertex layout" << std::endl;
+		fileLoadingFlags &= ~FileLoadingFlags::PackVertices;
+	}
+	this->fileLoadingFlags = fileLoadingFlags;
 
 #if defined(__ANDROID__)
 	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	bool fileLoaded = false;
+	{
+		VKS_PROFILE_ZONE("Parse glTF");
+		fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	}
 
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
@@ -1201,21 +1686,27 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 		loadMaterials(gltfModel);
 		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+		{
+			VKS_PROFILE_ZONE("Load nodes");
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			}
 		}
 		if (gltfModel.animations.size() > 0) {
 			loadAnimations(gltfModel);
 		}
 		loadSkins(gltfModel);
 
+		// Assign skins
 		for (auto node : linearNodes) {
-			// Assign skins
 			if (node->skinIndex > -1) {
 				node->skin = skins[node->skinIndex];
 			}
-			// Initial pose
+		}
+		prepareJointPalette();
+		// Initial pose
+		for (auto node : linearNodes) {
 			if (node->mesh) {
 				node->update();
 			}
@@ -1227,6 +1718,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		return;
 	}
 
+	if (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) {
+		optimizeMeshes(indexBuffer, vertexBuffer);
+	}
+
 	// Pre-Calculations for requested features
 	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
 		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
@@ -1258,6 +1753,18 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
+	// Levels of detail are generated from the final vertex positions, so this needs to be done after the pre-calculations
+	if (fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+		generateLods(indexBuffer, vertexBuffer);
+	}
+
+	// Meshlets are built from the final vertex positions, so this needs to be done after the pre-calculations
+	if (fileLoadingFlags & FileLoadingFlags::BuildMeshlets) {
+		// The cache is validated against the geometry, so models that share a file name only cost a rebuild
+		const std::string cachePath = vks::tools::getCachePath();
+		buildMeshlets(indexBuffer, vertexBuffer, cachePath.empty() ? "" : cachePath + filename.substr(filename.find_last_of('/') + 1) + ".meshlets");
+	}
+
 	for (auto extension : gltfModel.extensionsUsed) {
 		if (extension == "KHR_materials_pbrSpecularGlossiness") {
 			std::cout << "Required extension: " << extension;
@@ -1269,36 +1776,51 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 	indices.count = static_cast<uint32_t>(indexBuffer.size());
 	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	const void* vertexData = vertexBuffer.data();
+	const void* indexData = indexBuffer.data();
+
+	// Quantize the vertex data and use 16 bit indices if possible
+	std::vector<PackedVertex> packedVertexBuffer;
+	std::vector<uint16_t> packedIndexBuffer;
+	if (fileLoadingFlags & FileLoadingFlags::PackVertices) {
+		vertexLayout = VertexLayout::Packed;
+		glm::vec3 posMin = glm::vec3(FLT_MAX);
+		glm::vec3 posMax = glm::vec3(-FLT_MAX);
+		for (const Vertex& vertex : vertexBuffer) {
+			posMin = glm::min(posMin, vertex.pos);
+			posMax = glm::max(posMax, vertex.pos);
+		}
+		quantization.offset = posMin;
+		quantization.scale = posMax - posMin;
+		packedVertexBuffer.resize(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++) {
+			packedVertexBuffer[i] = PackedVertex::pack(vertexBuffer[i], quantization.offset, quantization.scale);
+		}
+		vertexData = packedVertexBuffer.data();
+		vertexBufferSize = packedVertexBuffer.size() * sizeof(PackedVertex);
+		if (vertexBuffer.size() <= 65536) {
+			indices.type = VK_INDEX_TYPE_UINT16;
+			packedIndexBuffer.assign(indexBuffer.begin(), indexBuffer.end());
+			indexData = packedIndexBuffer.data();
+			indexBufferSize = packedIndexBuffer.size() * sizeof(uint16_t);
+		}
+		std::cout << "Packed vertex data: " << (vertexBuffer.size() * sizeof(Vertex) + indexBuffer.size() * sizeof(uint32_t)) / 1024 << " KB -> " << (vertexBufferSize + indexBufferSize) / 1024 << " KB" << std::endl;
+	}
 
 	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
-
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	// Skinned models keep a host copy of the vertices for the CPU reference skinning, and their vertex buffer can be used as the source for compute pre-skinning
+	VkBufferUsageFlags skinningUsageFlags = 0;
+	if (!skinning.jobs.empty()) {
+		skinning.sourceVertices = vertexBuffer;
+		skinningUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	}
 
+	VKS_PROFILE_ZONE("Upload geometry");
 	// Create device local buffers
 	// Vertex buffer
 	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags | skinningUsageFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBufferSize,
 		&vertices.buffer,
@@ -1311,25 +1833,63 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		&indices.buffer,
 		&indices.memory));
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	if (streamingUploader && skinning.jobs.empty()) {
+		// The buffers may also be read by ray tracing or compute (see memoryPropertyFlags), so the uploads are made visible to all stages
+		geometryReady = false;
+		pendingGeometryUploads = 2;
+		auto onUploaded = [this]() {
+			if (--pendingGeometryUploads == 0) {
+				geometryReady = true;
+			}
+		};
+		streamingUploader->uploadBuffer(vertices.buffer, vertexData, vertexBufferSize, 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, onUploaded);
+		streamingUploader->uploadBuffer(indices.buffer, indexData, indexBufferSize, 0, VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, onUploaded);
+	}
+	else {
+		struct StagingBuffer {
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+		} vertexStaging, indexStaging;
+
+		// Create staging buffers
+		// Vertex data
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			vertexBufferSize,
+			&vertexStaging.buffer,
+			&vertexStaging.memory,
+			const_cast<void*>(vertexData)));
+		// Index data
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			indexBufferSize,
+			&indexStaging.buffer,
+			&indexStaging.memory,
+			const_cast<void*>(indexData)));
+
+		// Copy from staging buffers
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-	VkBufferCopy copyRegion = {};
+		VkBufferCopy copyRegion = {};
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+		copyRegion.size = vertexBufferSize;
+		vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
 
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+		copyRegion.size = indexBufferSize;
+		vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+		device->flushCommandBuffer(copyCmd, transferQueue, true);
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	}
 
 	getSceneDimensions();
+	buildDrawList();
 
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
@@ -1344,10 +1904,25 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			imageCount++;
 		}
 	}
+	// Every node set references the mesh's uniform buffer and the model's joint palette
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uboCount },
 	};
-	if (imageCount > 0) {
+	bindless.enabled = fileLoadingFlags & FileLoadingFlags::BindlessMaterials;
+	if (bindless.enabled && (textures.size() > getMaxBindlessTextureCount())) {
+		std::cerr << "Model has " << textures.size() << " textures, but bindless materials are limited to " << getMaxBindlessTextureCount() << ", using a descriptor set per material instead" << std::endl;
+		bindless.enabled = false;
+	}
+	if (bindless.enabled) {
+		// One set for the whole model instead of one per material
+		poolSizes[1].descriptorCount++;
+		if (!textures.empty()) {
+			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(textures.size()) });
+		}
+		imageCount = 1;
+	}
+	else if (imageCount > 0) {
 		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
 			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
 		}
@@ -1368,6 +1943,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
 			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1380,8 +1956,11 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
-	// Descriptors for per-material images
-	{
+	// Descriptors for per-material images, or a single set for all materials
+	if (bindless.enabled) {
+		prepareBindlessMaterials(transferQueue);
+	}
+	else {
 		// Layout is global, so only create if it hasn't already been created before
 		if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
@@ -1405,32 +1984,670 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	}
 }
 
+void vkglTF::Model::prepareBindlessMaterials(VkQueue transferQueue)
+{
+	// Layout is global, so only create if it hasn't already been created before
+	if (descriptorSetLayoutBindless == VK_NULL_HANDLE) {
+		// The texture array is sized per set at allocation time, the layout only defines the upper bound
+		const uint32_t maxTextureCount = getMaxBindlessTextureCount();
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, maxTextureCount),
+		};
+		std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = { 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT };
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCI{};
+		bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsCI.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsCI.pBindingFlags = bindingFlags.data();
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		descriptorLayoutCI.pNext = &bindingFlagsCI;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutBindless));
+	}
+
+	// Materials refer to textures by their position in the texture array
+	auto getTextureIndex = [this](const vkglTF::Texture* texture) {
+		if ((texture == nullptr) || textures.empty() || (texture < &textures.front()) || (texture > &textures.back())) {
+			return -1;
+		}
+		return static_cast<int32_t>(texture - &textures.front());
+	};
+	std::vector<BindlessMaterials::MaterialData> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		BindlessMaterials::MaterialData& data = materialData[i];
+		data.baseColorFactor = material.baseColorFactor;
+		data.metallicFactor = material.metallicFactor;
+		data.roughnessFactor = material.roughnessFactor;
+		data.alphaCutoff = material.alphaCutoff;
+		data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		data.baseColorTexture = getTextureIndex(material.baseColorTexture);
+		data.metallicRoughnessTexture = getTextureIndex(material.metallicRoughnessTexture);
+		data.normalTexture = getTextureIndex(material.normalTexture);
+		data.occlusionTexture = getTextureIndex(material.occlusionTexture);
+		data.emissiveTexture = getTextureIndex(material.emissiveTexture);
+		data.padding[0] = data.padding[1] = data.padding[2] = 0;
+	}
+
+	const VkDeviceSize bufferSize = materialData.size() * sizeof(BindlessMaterials::MaterialData);
+	vks::Buffer stagingBuffer;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, bufferSize, materialData.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &bindless.materialBuffer, bufferSize));
+	device->copyBuffer(&stagingBuffer, &bindless.materialBuffer, transferQueue);
+	stagingBuffer.destroy();
+
+	const uint32_t textureCount = static_cast<uint32_t>(textures.size());
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &textureCount;
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayoutBindless, 1);
+	descriptorSetAllocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &bindless.descriptorSet));
+
+	std::vector<VkDescriptorImageInfo> imageDescriptors;
+	imageDescriptors.reserve(textures.size());
+	for (auto& texture : textures) {
+		imageDescriptors.push_back(texture.descriptor);
+	}
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bindless.materialBuffer.descriptor),
+	};
+	if (textureCount > 0) {
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, imageDescriptors.data(), textureCount);
+		writeDescriptorSets.push_back(writeDescriptorSet);
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+uint32_t vkglTF::Model::getMaxBindlessTextureCount() const
+{
+	const VkPhysicalDeviceLimits& limits = device->properties.limits;
+	return std::min({ 4096u, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+}
+
+VkPushConstantRange vkglTF::Model::getMaterialPushConstantRange() const
+{
+	return vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), bindless.pushConstantOffset);
+}
+
+void vkglTF::Model::prepareJointPalette()
+{
+	// Every skinned mesh gets its own range, as the joint matrices are relative to the mesh's node
+	jointPalette.count = 0;
+	skinning.jobs.clear();
+	for (auto node : linearNodes) {
+		if (node->mesh && node->skin) {
+			node->mesh->uniformBlock.jointOffset = jointPalette.count;
+			node->mesh->uniformBlock.jointCount = static_cast<uint32_t>(node->skin->joints.size());
+			for (Primitive* primitive : node->mesh->primitives) {
+				if (primitive->vertexCount > 0) {
+					skinning.jobs.push_back({ primitive->firstVertex, primitive->vertexCount, jointPalette.count, sizeof(Vertex) / sizeof(float) });
+				}
+			}
+			jointPalette.count += node->mesh->uniformBlock.jointCount;
+		}
+	}
+	// Models without skins get a single identity matrix, so the palette binding of the node descriptor sets is always valid
+	const uint32_t matrixCount = std::max(jointPalette.count, 1u);
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&jointPalette.buffer,
+		matrixCount * sizeof(glm::mat4)));
+	VK_CHECK_RESULT(jointPalette.buffer.map());
+	glm::mat4* matrices = static_cast<glm::mat4*>(jointPalette.buffer.mapped);
+	for (uint32_t i = 0; i < matrixCount; i++) {
+		matrices[i] = glm::mat4(1.0f);
+	}
+	for (auto node : linearNodes) {
+		if (node->mesh && node->skin) {
+			node->mesh->jointMatrices = matrices + node->mesh->uniformBlock.jointOffset;
+		}
+	}
+}
+
+void vkglTF::Model::prepareSkinning(VkQueue queue, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+{
+	if (skinning.jobs.empty()) {
+		return;
+	}
+	// The compute shader reads and writes full precision vertices
+	assert(vertexLayout == VertexLayout::Default);
+
+	// The skinned vertex buffer starts as a copy of the source, the compute shader then only needs to write the attributes affected by skinning
+	const VkDeviceSize bufferSize = skinning.sourceVertices.size() * sizeof(Vertex);
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | memoryPropertyFlags,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&skinning.vertices,
+		bufferSize));
+	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkBufferCopy copyRegion{ 0, 0, bufferSize };
+	vkCmdCopyBuffer(copyCmd, vertices.buffer, skinning.vertices.buffer, 1, &copyRegion);
+	device->flushCommandBuffer(copyCmd, queue, true);
+
+	// Binding 0: Source vertices, binding 1: joint palette, binding 2: skinned vertices
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &skinning.descriptorPool));
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &skinning.descriptorSetLayout));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(skinning.descriptorPool, &skinning.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &skinning.descriptorSet));
+	VkDescriptorBufferInfo sourceDescriptor{ vertices.buffer, 0, bufferSize };
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceDescriptor),
+		vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &jointPalette.buffer.descriptor),
+		vks::initializers::writeDescriptorSet(skinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &skinning.vertices.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(Skinning::Job), 0);
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&skinning.descriptorSetLayout, 1);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &skinning.pipelineLayout));
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(skinning.pipelineLayout, 0);
+	computePipelineCI.stage = shaderStage;
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &skinning.pipeline));
+
+	skinning.enabled = true;
+}
+
+void vkglTF::Model::recordSkinning(VkCommandBuffer commandBuffer)
+{
+	if (!skinning.enabled) {
+		return;
+	}
+	// Previous draws reading the skinned vertices need to be finished before they get overwritten
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.buffer = skinning.vertices.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipelineLayout, 0, 1, &skinning.descriptorSet, 0, nullptr);
+	for (auto& job : skinning.jobs) {
+		vkCmdPushConstants(commandBuffer, skinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Skinning::Job), &job);
+		// Must match the local size of the skinning compute shader
+		vkCmdDispatch(commandBuffer, (job.vertexCount + 63) / 64, 1, 1);
+	}
+
+	// Make the skinned vertices visible to all following passes that use them as vertex input
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+namespace vkglTF
+{
+	// Every mesh primitive of the node tree, in the same order as draw
+	static void gatherNodePrimitives(Node* node, std::vector<std::pair<Node*, Primitive*>>& nodePrimitives)
+	{
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				if (primitive->indexCount > 0) {
+					nodePrimitives.push_back(std::make_pair(node, primitive));
+				}
+			}
+		}
+		for (auto& child : node->children) {
+			gatherNodePrimitives(child, nodePrimitives);
+		}
+	}
+}
+
+void vkglTF::Model::prepareIndirectDrawing(VkPipelineShaderStageCreateInfo shaderStage, bool drawIndirectCount, VkPipelineCache pipelineCache)
+{
+	VKS_PROFILE_ZONE("vkglTF::Model::prepareIndirectDrawing");
+	assert(device->enabledFeatures.multiDrawIndirect && device->enabledFeatures.drawIndirectFirstInstance);
+
+	std::vector<std::pair<Node*, Primitive*>> nodePrimitives;
+	for (auto& node : nodes) {
+		gatherNodePrimitives(node, nodePrimitives);
+	}
+	// Grouping by alpha mode lets every bucket be drawn with its own pipeline
+	std::stable_sort(nodePrimitives.begin(), nodePrimitives.end(), [](const std::pair<Node*, Primitive*>& a, const std::pair<Node*, Primitive*>& b) {
+		return a.second->material.alphaMode < b.second->material.alphaMode;
+	});
+	indirect.instanceCount = static_cast<uint32_t>(nodePrimitives.size());
+	for (auto& bucket : indirect.buckets) {
+		bucket = IndirectDrawing::Bucket();
+	}
+	for (uint32_t i = 0; i < indirect.instanceCount; i++) {
+		IndirectDrawing::Bucket& bucket = indirect.buckets[nodePrimitives[i].second->material.alphaMode];
+		if (bucket.commandCount == 0) {
+			bucket.firstCommand = i;
+		}
+		bucket.commandCount++;
+	}
+	if (indirect.instanceCount == 0) {
+		return;
+	}
+
+	// Instances are rewritten whenever nodes change, so they stay in host visible memory
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&indirect.instanceBuffer,
+		indirect.instanceCount * sizeof(IndirectDrawing::Instance)));
+	VK_CHECK_RESULT(indirect.instanceBuffer.map());
+	IndirectDrawing::Instance* instances = static_cast<IndirectDrawing::Instance*>(indirect.instanceBuffer.mapped);
+	for (uint32_t i = 0; i < indirect.instanceCount; i++) {
+		const Primitive* primitive = nodePrimitives[i].second;
+		IndirectDrawing::Instance& instance = instances[i];
+		instance.firstIndex = primitive->firstIndex;
+		instance.indexCount = primitive->indexCount;
+		instance.materialIndex = primitive->material.index;
+		instance.bucket = static_cast<uint32_t>(primitive->material.alphaMode);
+		instance.firstCommand = indirect.buckets[instance.bucket].firstCommand;
+		instance.padding[0] = instance.padding[1] = instance.padding[2] = 0;
+	}
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirect.commandBuffer,
+		indirect.instanceCount * sizeof(VkDrawIndexedIndirectCommand)));
+	const VkDeviceSize countSize = sizeof(uint32_t) * 3;
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirect.countBuffer,
+		countSize));
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&indirect.countReadback,
+		countSize));
+	VK_CHECK_RESULT(indirect.countReadback.map());
+	memset(indirect.countReadback.mapped, 0, countSize);
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&indirect.cullingBuffer,
+		sizeof(IndirectDrawing::Culling)));
+	VK_CHECK_RESULT(indirect.cullingBuffer.map());
+	updateIndirectInstances();
+
+	// Without a draw count, culled commands stay in place and are skipped through their instance count
+	// Drivers may return the entry point even if the extension hasn't been enabled, so it's only loaded when the caller says so
+	indirect.vkCmdDrawIndexedIndirectCountKHR = nullptr;
+	if (drawIndirectCount) {
+		indirect.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+	updateIndirectCulling(glm::mat4(1.0f));
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &indirect.descriptorPool));
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &indirect.descriptorSetLayout));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(indirect.descriptorPool, &indirect.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &indirect.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirect.instanceBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirect.commandBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirect.countBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &indirect.cullingBuffer.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&indirect.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &indirect.pipelineLayout));
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(indirect.pipelineLayout, 0);
+	computePipelineCI.stage = shaderStage;
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &indirect.pipeline));
+
+	indirect.enabled = true;
+}
+
+void vkglTF::Model::updateIndirectInstances()
+{
+	if (indirect.instanceBuffer.mapped == nullptr) {
+		return;
+	}
+	std::vector<std::pair<Node*, Primitive*>> nodePrimitives;
+	for (auto& node : nodes) {
+		gatherNodePrimitives(node, nodePrimitives);
+	}
+	std::stable_sort(nodePrimitives.begin(), nodePrimitives.end(), [](const std::pair<Node*, Primitive*>& a, const std::pair<Node*, Primitive*>& b) {
+		return a.second->material.alphaMode < b.second->material.alphaMode;
+	});
+	assert(nodePrimitives.size() == indirect.instanceCount);
+
+	const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+	IndirectDrawing::Instance* instances = static_cast<IndirectDrawing::Instance*>(indirect.instanceBuffer.mapped);
+	for (uint32_t i = 0; i < indirect.instanceCount; i++) {
+		const glm::mat4 nodeMatrix = nodePrimitives[i].first->getMatrix();
+		const Primitive::Dimensions& dimensions = nodePrimitives[i].second->dimensions;
+		const glm::mat4 boundsMatrix = getBoundsMatrix(nodePrimitives[i].first);
+		const float scale = std::max(glm::length(glm::vec3(boundsMatrix[0])), std::max(glm::length(glm::vec3(boundsMatrix[1])), glm::length(glm::vec3(boundsMatrix[2]))));
+		// Packed positions are decoded by the instance matrix, the bounding sphere is already in model space
+		instances[i].matrix = (preTransform ? glm::mat4(1.0f) : nodeMatrix) * getDequantizationMatrix();
+		instances[i].boundingSphere = glm::vec4(glm::vec3(boundsMatrix * glm::vec4(dimensions.center, 1.0f)), dimensions.radius * scale);
+	}
+}
+
+void vkglTF::Model::updateIndirectCulling(const glm::mat4& viewProjection)
+{
+	if (indirect.cullingBuffer.mapped == nullptr) {
+		return;
+	}
+	vks::Frustum frustum;
+	frustum.update(viewProjection);
+	IndirectDrawing::Culling culling;
+	for (size_t i = 0; i < frustum.planes.size(); i++) {
+		culling.frustumPlanes[i] = frustum.planes[i];
+	}
+	culling.instanceCount = indirect.instanceCount;
+	culling.compact = (indirect.vkCmdDrawIndexedIndirectCountKHR != nullptr) ? 1 : 0;
+	memcpy(indirect.cullingBuffer.mapped, &culling, sizeof(culling));
+}
+
+void vkglTF::Model::recordIndirectCulling(VkCommandBuffer commandBuffer)
+{
+	if (!indirect.enabled) {
+		return;
+	}
+	// Draws of a previous frame may still be reading the commands and counts
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(commandBuffer, indirect.countBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.buffer = indirect.countBuffer.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.pipelineLayout, 0, 1, &indirect.descriptorSet, 0, nullptr);
+	// Must match the local size of the culling compute shader
+	vkCmdDispatch(commandBuffer, (indirect.instanceCount + 63) / 64, 1, 1);
+
+	// Commands and counts are consumed by the indirect draws, the counts are also copied back for statistics
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy copyRegion{ 0, 0, sizeof(uint32_t) * 3 };
+	vkCmdCopyBuffer(commandBuffer, indirect.countBuffer.buffer, indirect.countReadback.buffer, 1, &copyRegion);
+	bufferBarrier.buffer = indirect.countReadback.buffer;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (!indirect.enabled || !geometryReady) {
+		return;
+	}
+	if (!buffersBound) {
+		const VkDeviceSize offsets[1] = { 0 };
+		VkBuffer vertexBuffer = skinning.enabled ? skinning.vertices.buffer : vertices.buffer;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+	}
+	// Materials are looked up through the instance, so only the bindless set can be used here
+	if (renderFlags & RenderFlags::BindImages) {
+		assert(bindless.enabled);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bindless.descriptorSet, 0, nullptr);
+	}
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	for (uint32_t i = 0; i < 3; i++) {
+		const IndirectDrawing::Bucket& bucket = indirect.buckets[i];
+		if (bucket.commandCount == 0) {
+			continue;
+		}
+		if ((renderFlags & RenderFlags::RenderOpaqueNodes) && (i != Material::ALPHAMODE_OPAQUE)) {
+			continue;
+		}
+		if ((renderFlags & RenderFlags::RenderAlphaMaskedNodes) && (i != Material::ALPHAMODE_MASK)) {
+			continue;
+		}
+		if ((renderFlags & RenderFlags::RenderAlphaBlendedNodes) && (i != Material::ALPHAMODE_BLEND)) {
+			continue;
+		}
+		const VkDeviceSize offset = bucket.firstCommand * stride;
+		if (indirect.vkCmdDrawIndexedIndirectCountKHR != nullptr) {
+			indirect.vkCmdDrawIndexedIndirectCountKHR(commandBuffer, indirect.commandBuffer.buffer, offset, indirect.countBuffer.buffer, i * sizeof(uint32_t), bucket.commandCount, stride);
+		}
+		else {
+			vkCmdDrawIndexedIndirect(commandBuffer, indirect.commandBuffer.buffer, offset, bucket.commandCount, stride);
+		}
+	}
+}
+
+uint32_t vkglTF::Model::getIndirectVisibleCount() const
+{
+	if (indirect.countReadback.mapped == nullptr) {
+		return 0;
+	}
+	const uint32_t* counts = static_cast<const uint32_t*>(indirect.countReadback.mapped);
+	return counts[0] + counts[1] + counts[2];
+}
+
+void vkglTF::Model::skinVertices(std::vector<Vertex>& output)
+{
+	output = skinning.sourceVertices;
+	if (jointPalette.count == 0) {
+		return;
+	}
+	const glm::mat4* matrices = static_cast<const glm::mat4*>(jointPalette.buffer.mapped);
+	for (auto& job : skinning.jobs) {
+		for (uint32_t i = job.firstVertex; i < job.firstVertex + job.vertexCount; i++) {
+			Vertex& vertex = output[i];
+			const glm::mat4 skinMatrix =
+				vertex.weight0.x * matrices[job.jointOffset + static_cast<uint32_t>(vertex.joint0.x)] +
+				vertex.weight0.y * matrices[job.jointOffset + static_cast<uint32_t>(vertex.joint0.y)] +
+				vertex.weight0.z * matrices[job.jointOffset + static_cast<uint32_t>(vertex.joint0.z)] +
+				vertex.weight0.w * matrices[job.jointOffset + static_cast<uint32_t>(vertex.joint0.w)];
+			vertex.pos = glm::vec3(skinMatrix * glm::vec4(vertex.pos, 1.0f));
+			vertex.normal = glm::normalize(glm::mat3(skinMatrix) * vertex.normal);
+			const glm::vec3 tangent = glm::mat3(skinMatrix) * glm::vec3(vertex.tangent);
+			if (glm::length(tangent) > 0.0f) {
+				vertex.tangent = glm::vec4(glm::normalize(tangent), vertex.tangent.w);
+			}
+		}
+	}
+}
+
+float vkglTF::Model::validateSkinning(VkQueue queue)
+{
+	if (!skinning.enabled) {
+		return 0.0f;
+	}
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	vks::Buffer readbackBuffer;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readbackBuffer, skinning.vertices.size));
+	device->copyBuffer(&skinning.vertices, &readbackBuffer, queue);
+	VK_CHECK_RESULT(readbackBuffer.map());
+	const Vertex* gpuVertices = static_cast<const Vertex*>(readbackBuffer.mapped);
+
+	std::vector<Vertex> cpuVertices;
+	skinVertices(cpuVertices);
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < cpuVertices.size(); i++) {
+		maxDifference = std::max(maxDifference, glm::length(cpuVertices[i].pos - gpuVertices[i].pos));
+	}
+	readbackBuffer.destroy();
+	return maxDifference;
+}
+
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
+	if (!geometryReady) {
+		return;
+	}
 	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	// Pre-skinned vertices replace the source vertices for all passes
+	VkBuffer vertexBuffer = skinning.enabled ? skinning.vertices.buffer : vertices.buffer;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	buffersBound = true;
 }
 
+namespace vkglTF
+{
+	// Primitives can be filtered by the alpha mode of their material
+	static bool skipPrimitive(const Primitive* primitive, uint32_t renderFlags)
+	{
+		bool skip = false;
+		const vkglTF::Material& material = primitive->material;
+		if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+		}
+		if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+		}
+		if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+		}
+		return skip;
+	}
+}
+
+glm::mat4 vkglTF::Model::getBoundsMatrix(Node* node)
+{
+	// Vertices may already contain the node transform and the y flip, the bounds are stored in model space and need the same transformations
+	const glm::mat4 nodeMatrix = node->getMatrix();
+	const glm::mat4 flip = (fileLoadingFlags & FileLoadingFlags::FlipY) ? glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)) : glm::mat4(1.0f);
+	return (fileLoadingFlags & FileLoadingFlags::PreTransformVertices) ? flip * nodeMatrix : nodeMatrix * flip;
+}
+
+void vkglTF::Model::buildDrawList()
+{
+	std::vector<std::pair<Node*, Primitive*>> nodePrimitives;
+	for (auto& node : nodes) {
+		gatherNodePrimitives(node, nodePrimitives);
+	}
+	drawList.items.clear();
+	drawList.items.reserve(nodePrimitives.size());
+	for (uint32_t mode = 0; mode < 3; mode++) {
+		DrawList::Range& range = drawList.ranges[mode];
+		range.first = static_cast<uint32_t>(drawList.items.size());
+		for (auto& nodePrimitive : nodePrimitives) {
+			if (nodePrimitive.second->material.alphaMode == mode) {
+				DrawList::Item item = { nodePrimitive.first, nodePrimitive.second, 0.0f };
+				drawList.items.push_back(item);
+			}
+		}
+		range.count = static_cast<uint32_t>(drawList.items.size()) - range.first;
+		if (mode == Material::ALPHAMODE_BLEND) {
+			// Blending depends on the draw order, so these are only reordered by depth
+			continue;
+		}
+		// The pipeline is selected per alpha mode by the caller, so the material is the only state that changes within a range
+		std::stable_sort(drawList.items.begin() + range.first, drawList.items.begin() + range.first + range.count, [](const DrawList::Item& a, const DrawList::Item& b) {
+			if (a.primitive->material.index != b.primitive->material.index) {
+				return a.primitive->material.index < b.primitive->material.index;
+			}
+			return a.primitive->firstIndex < b.primitive->firstIndex;
+		});
+	}
+}
+
+void vkglTF::Model::sortBlendedPrimitives(const glm::mat4& modelView)
+{
+	const DrawList::Range& range = drawList.ranges[Material::ALPHAMODE_BLEND];
+	if (range.count < 2) {
+		return;
+	}
+	auto first = drawList.items.begin() + range.first;
+	auto last = first + range.count;
+	for (auto it = first; it != last; it++) {
+		const glm::vec4 center = modelView * getBoundsMatrix(it->node) * glm::vec4(it->primitive->dimensions.center, 1.0f);
+		it->depth = center.z;
+	}
+	// Looking down -z, so the farthest primitive has the smallest depth
+	std::stable_sort(first, last, [](const DrawList::Item& a, const DrawList::Item& b) {
+		return a.depth < b.depth;
+	});
+}
+
+void vkglTF::Model::getDrawRange(uint32_t renderFlags, uint32_t& first, uint32_t& count) const
+{
+	// Same precedence as skipPrimitive if more than one alpha mode flag is set
+	int32_t mode = -1;
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		mode = Material::ALPHAMODE_BLEND;
+	}
+	else if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		mode = Material::ALPHAMODE_MASK;
+	}
+	else if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		mode = Material::ALPHAMODE_OPAQUE;
+	}
+	if (mode < 0) {
+		first = 0;
+		count = static_cast<uint32_t>(drawList.items.size());
+	}
+	else {
+		first = drawList.ranges[mode].first;
+		count = drawList.ranges[mode].count;
+	}
+}
+
+void vkglTF::Model::bindMaterial(VkCommandBuffer commandBuffer, const Material& material, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (bindless.enabled) {
+		// The bindless set has already been bound by the caller, only the material index changes
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, bindless.pushConstantOffset, sizeof(uint32_t), &material.index);
+	}
+	else {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+	}
+}
+
+void vkglTF::Model::drawRange(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount)
+{
+	const Material* boundMaterial = nullptr;
+	for (uint32_t i = first; i < first + count; i++) {
+		const Primitive* primitive = drawList.items[i].primitive;
+		// Items are sorted by material, so consecutive primitives mostly share their material
+		if ((renderFlags & RenderFlags::BindImages) && (&primitive->material != boundMaterial)) {
+			bindMaterial(commandBuffer, primitive->material, pipelineLayout, bindImageSet);
+			boundMaterial = &primitive->material;
+		}
+		vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, 0);
+	}
+}
+
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount)
 {
+	if (!geometryReady) {
+		return;
+	}
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
 			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
+			if (!skipPrimitive(primitive, renderFlags)) {
 				if (renderFlags & RenderFlags::BindImages) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+					bindMaterial(commandBuffer, material, pipelineLayout, bindImageSet);
 				}
 				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, 0);
 			}
@@ -1443,14 +2660,29 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 
 void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount )
 {
+	if (!geometryReady) {
+		return;
+	}
 	if (!buffersBound) {
 		const VkDeviceSize offsets[1] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		VkBuffer vertexBuffer = skinning.enabled ? skinning.vertices.buffer : vertices.buffer;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
 	}
-	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, instanceCount);
+	if (bindless.enabled && (renderFlags & RenderFlags::BindImages)) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bindless.descriptorSet, 0, nullptr);
 	}
+	uint32_t first, count;
+	getDrawRange(renderFlags, first, count);
+	drawRange(commandBuffer, first, count, renderFlags, pipelineLayout, bindImageSet, instanceCount);
+}
+
+glm::mat4 vkglTF::Model::getDequantizationMatrix() const
+{
+	if (vertexLayout != VertexLayout::Packed) {
+		return glm::mat4(1.0f);
+	}
+	return glm::scale(glm::translate(glm::mat4(1.0f), quantization.offset), quantization.scale);
 }
 
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
@@ -1578,15 +2810,14 @@ void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLay
 		descriptorSetAllocInfo.descriptorSetCount = 1;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
 
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
-		writeDescriptorSet.dstBinding = 0;
-		writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
-
-		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(node->mesh->uniformBuffer.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &node->mesh->uniformBuffer.descriptor),
+		};
+		// Vertex shaders read the mesh's joint matrices at uniformBlock.jointOffset in the palette
+		if (descriptorSetLayout == descriptorSetLayoutUbo) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(node->mesh->uniformBuffer.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &jointPalette.buffer.descriptor));
+		}
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 	for (auto& child : node->children) {
 		prepareNodeDescriptor(child, descriptorSetLayout);
@@ -12,9 +12,15 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <chrono>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanMeshOptimizer.h"
+#include "VulkanMeshlet.h"
+#include "VulkanMipGenerator.h"
+#include "VulkanImageProcessing.h"
+#include "VulkanStreamingUploader.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -24,6 +30,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
@@ -43,9 +50,14 @@ enum DescriptorBindingFlags {
 };
 
 extern VkDescriptorSetLayout descriptorSetLayoutImage;
+/** @brief Layout of the per-mesh descriptor sets: binding 0 is the mesh's uniform block, binding 1 the model's joint palette (both vertex stage) */
 extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+/** @brief Layout of the descriptor set used by models loaded with FileLoadingFlags::BindlessMaterials: binding 0 is the material storage buffer, binding 1 a variable sized array of all textures */
+extern VkDescriptorSetLayout descriptorSetLayoutBindless;
 extern VkMemoryPropertyFlags memoryPropertyFlags;
 extern uint32_t descriptorBindingFlags;
+// Optional compute mip generator, if set (and the format supports storage images) it replaces the blit based mip chain generation
+extern vks::MipGenerator* mipGenerator;
 
 struct Node;
 
@@ -63,9 +75,17 @@ struct Texture {
     uint32_t layerCount;
     VkDescriptorImageInfo descriptor;
     VkSampler sampler;
+    struct MipGeneration {
+        // Use vkglTF::mipGenerator if available
+        bool compute = true;
+        vks::MipFilter filter = vks::MipFilter::Box;
+        // Set for color textures (base color, emissive) so the mip chain is filtered in linear space
+        bool srgb = false;
+    } mipGeneration;
     void updateDescriptor();
     void destroy();
-    void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+    /** @brief mipChain (optional) contains all levels generated on the CPU, these are uploaded instead of generating the levels on the device */
+    void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, const vks::imageprocessing::MipChain* mipChain = nullptr);
 };
 
 /*
@@ -89,6 +109,8 @@ struct Material {
     vkglTF::Texture* diffuseTexture;
 
     VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    /** @brief Position in Model::materials, also the index into the bindless material buffer */
+    uint32_t index = 0;
 
     Material(vks::VulkanDevice* device) : device(device) {};
     void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
@@ -102,8 +124,21 @@ struct Primitive {
     uint32_t indexCount;
     uint32_t firstVertex;
     uint32_t vertexCount;
+    /** @brief Range of this primitive's meshlets in Model::meshlets (only set if the model was loaded with FileLoadingFlags::BuildMeshlets) */
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
     Material& material;
 
+    /** @brief Level of detail stored in the model's index buffer, sharing the vertices of the primitive */
+    struct Lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        /** @brief Simplification error relative to the extent of the primitive */
+        float error;
+    };
+    /** @brief Levels of detail with the full detail primitive at index 0 (only filled if the model was loaded with FileLoadingFlags::GenerateLods) */
+    std::vector<Lod> lods;
+
     struct Dimensions {
         glm::vec3 min = glm::vec3(FLT_MAX);
         glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -133,12 +168,16 @@ struct Mesh {
         void* mapped;
     } uniformBuffer;
 
+    /** @brief Joint matrices of skinned meshes are stored in Model::jointPalette, jointOffset is the index of the mesh's first joint matrix in that buffer */
     struct UniformBlock {
         glm::mat4 matrix;
-        glm::mat4 jointMatrix[64]{};
-        float jointcount{ 0 };
+        uint32_t jointOffset{ 0 };
+        uint32_t jointCount{ 0 };
     } uniformBlock;
 
+    /** @brief Points to this mesh's joint matrices in the persistently mapped joint palette (skinned meshes only) */
+    glm::mat4* jointMatrices = nullptr;
+
     Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
     ~Mesh();
 };
@@ -210,6 +249,12 @@ struct Animation {
 */
 enum class VertexComponent { Position, Normal, UV, Color, Tangent, Joint0, Weight0 };
 
+/*
+    Vertex layouts a model's vertex buffer can be stored in
+    Default uses the full precision Vertex structure, Packed uses the quantized PackedVertex structure
+*/
+enum class VertexLayout { Default, Packed };
+
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
@@ -224,8 +269,32 @@ struct Vertex {
     static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
     static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component);
     static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
+    static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding, VertexLayout layout);
+    static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component, VertexLayout layout);
+    static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components, VertexLayout layout);
     /** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
     static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+    /** @brief Returns the pipeline vertex input state create info structure for the requested vertex components stored in the given layout (see Model::vertexLayout) */
+    static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexLayout layout);
+};
+
+/*
+    Quantized vertex layout (36 bytes instead of 100 bytes)
+    Position is stored as unorm16 relative to the model's vertex bounds (see Model::quantization), w is always 1.0
+    Normal is stored octahedral encoded as snorm16, tangent as octahedral encoded snorm8 with the handedness in w
+    UV is stored as half floats, color and joint weights as unorm8 and joint indices as uint16
+    Shaders need to decode these, see data/shaders/glsl/base/packedvertex.glsl
+*/
+struct PackedVertex {
+    uint16_t pos[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+    uint8_t color[4];
+    uint16_t joint0[4];
+    uint8_t weight0[4];
+    int8_t tangent[4];
+    /** @brief Packs a full precision vertex, position is normalized to the [0..1] range using the given offset and scale */
+    static PackedVertex pack(const Vertex& vertex, const glm::vec3& positionOffset, const glm::vec3& positionScale);
 };
 
 enum FileLoadingFlags {
@@ -233,7 +302,12 @@ enum FileLoadingFlags {
     PreTransformVertices = 0x00000001,
     PreMultiplyVertexColors = 0x00000002,
     FlipY = 0x00000004,
-    DontLoadImages = 0x00000008
+    DontLoadImages = 0x00000008,
+    OptimizeMeshes = 0x00000010,
+    PackVertices = 0x00000020,
+    BuildMeshlets = 0x00000040,
+    GenerateLods = 0x00000080,
+    BindlessMaterials = 0x00000100
 };
 
 enum RenderFlags {
@@ -250,7 +324,13 @@ class Model {
 private:
     vkglTF::Texture* getTexture(uint32_t index);
     vkglTF::Texture emptyTexture;
+    uint32_t pendingGeometryUploads = 0;
     void createEmptyTexture(VkQueue transferQueue);
+    void prepareBindlessMaterials(VkQueue transferQueue);
+    void bindMaterial(VkCommandBuffer commandBuffer, const Material& material, VkPipelineLayout pipelineLayout, uint32_t bindImageSet);
+    glm::mat4 getBoundsMatrix(Node* node);
+    void getDrawRange(uint32_t renderFlags, uint32_t& first, uint32_t& count) const;
+    void drawRange(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount);
 public:
     vks::VulkanDevice* device;
     VkDescriptorPool descriptorPool;
@@ -264,11 +344,188 @@ public:
         int count;
         VkBuffer buffer;
         VkDeviceMemory memory;
+        VkIndexType type = VK_INDEX_TYPE_UINT32;
     } indices;
 
+    /** @brief Layout of the vertex buffer, use this to get a matching vertex input state from Vertex::getPipelineVertexInputState */
+    VertexLayout vertexLayout = VertexLayout::Default;
+    /** @brief Transforms packed unorm16 positions back to model space: position = packed.xyz * scale + offset */
+    struct Quantization {
+        glm::vec3 offset = glm::vec3(0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+    } quantization;
+
+    /** @brief Meshlets for task/mesh shader rendering, vertex indices refer to the model's vertex buffer (only generated with FileLoadingFlags::BuildMeshlets) */
+    vks::meshlet::MeshletSet meshlets;
+
+    /** @brief Joint matrices of all skinned meshes in a single host visible storage buffer, updated by Node::update and bound at binding 1 of the per-mesh descriptor sets */
+    struct JointPalette {
+        vks::Buffer buffer;
+        uint32_t count = 0;
+    } jointPalette;
+
+    /** @brief Optional compute pre-skinning, writes skinned positions, normals and tangents once per frame so all passes can use static vertex pipelines */
+    struct Skinning {
+        /** @brief Range of vertices skinned by one dispatch, passed as push constants to the compute shader */
+        struct Job {
+            uint32_t firstVertex;
+            uint32_t vertexCount;
+            uint32_t jointOffset;
+            uint32_t vertexStride;
+        };
+        std::vector<Job> jobs;
+        /** @brief Unskinned vertices kept on the host for the CPU reference skinning */
+        std::vector<Vertex> sourceVertices;
+        /** @brief Skinned copy of the vertex buffer, bound instead of the model's vertex buffer once pre-skinning has been prepared */
+        vks::Buffer vertices;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        bool enabled = false;
+    } skinning;
+
+    /** @brief Settings for the level of detail generation, need to be set before loading the model with FileLoadingFlags::GenerateLods */
+    struct LodSettings {
+        /** @brief Target triangle count for each generated level relative to the full detail primitive */
+        std::vector<float> ratios = { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+        /** @brief Stop simplifying if the error relative to the primitive extent exceeds this value, the remaining levels are skipped */
+        float maxError = 0.05f;
+        /** @brief Number of worker threads, 0 uses all hardware threads */
+        uint32_t threadCount = 0;
+    } lodSettings;
+
+    /**
+    * @brief All materials in one storage buffer and all textures in one descriptor array, bound once per draw call instead of once per primitive
+    * Only set up if the model was loaded with FileLoadingFlags::BindlessMaterials (requires VK_EXT_descriptor_indexing with runtimeDescriptorArray and descriptorBindingVariableDescriptorCount)
+    * and has no more textures than getMaxBindlessTextureCount, otherwise enabled stays false and every material gets its own descriptor set
+    * With RenderFlags::BindImages the set is bound to bindImageSet and the material index is pushed as a single uint (see getMaterialPushConstantRange)
+    */
+    struct BindlessMaterials {
+        /** @brief Layout of one entry in the material buffer (std430), texture indices are -1 if the material has no such texture */
+        struct MaterialData {
+            glm::vec4 baseColorFactor;
+            float metallicFactor;
+            float roughnessFactor;
+            float alphaCutoff;
+            uint32_t alphaMode;
+            int32_t baseColorTexture;
+            int32_t metallicRoughnessTexture;
+            int32_t normalTexture;
+            int32_t occlusionTexture;
+            int32_t emissiveTexture;
+            int32_t padding[3];
+        };
+        vks::Buffer materialBuffer;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        /** @brief Offset of the material index in the push constant block, needs to be set before drawing if the pipeline layout already uses the start of the block */
+        uint32_t pushConstantOffset = 0;
+        bool enabled = false;
+    } bindless;
+
+    /**
+    * @brief GPU driven rendering, every primitive of every node becomes an instance that is frustum culled by a compute shader
+    * The shader writes the indirect draw commands of the visible instances, so drawIndirect issues one indirect draw per alpha mode bucket independent of the scene size
+    * Vertex shaders read the instance (matrix and material index) from binding 0 of descriptorSetLayout using gl_InstanceIndex
+    * Requires the multiDrawIndirect and drawIndirectFirstInstance features, commands are compacted if the caller has enabled VK_KHR_draw_indirect_count
+    */
+    struct IndirectDrawing {
+        /** @brief Layout of one entry in the instance buffer (std430) */
+        struct Instance {
+            glm::mat4 matrix;
+            /** @brief Bounding sphere in the space the model is rendered in (xyz = center, w = radius) */
+            glm::vec4 boundingSphere;
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t materialIndex;
+            /** @brief First command of the instance's bucket */
+            uint32_t firstCommand;
+            uint32_t bucket;
+            uint32_t padding[3];
+        };
+        /** @brief Layout of the culling parameters uniform block */
+        struct Culling {
+            glm::vec4 frustumPlanes[6];
+            uint32_t instanceCount;
+            /** @brief 1 if visible commands are packed to the start of their bucket and drawn with a draw count, 0 if culled commands are kept with an instance count of 0 */
+            uint32_t compact;
+        };
+        /** @brief Instances are sorted by the alpha mode of their material (see Material::AlphaMode), each bucket is a contiguous range of commands */
+        struct Bucket {
+            uint32_t firstCommand = 0;
+            uint32_t commandCount = 0;
+        } buckets[3];
+        /** @brief Host visible, updated by updateIndirectInstances */
+        vks::Buffer instanceBuffer;
+        vks::Buffer commandBuffer;
+        /** @brief Visible draws per bucket */
+        vks::Buffer countBuffer;
+        /** @brief Host visible copy of the counts written by the last culling pass */
+        vks::Buffer countReadback;
+        vks::Buffer cullingBuffer;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        /** @brief Binding 0: instances (compute and vertex stages), 1: commands, 2: counts, 3: culling parameters */
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        /** @brief Only loaded if prepareIndirectDrawing was told that VK_KHR_draw_indirect_count is enabled */
+        PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+        uint32_t instanceCount = 0;
+        bool enabled = false;
+    } indirect;
+
+    /** @brief Flags passed to loadFromFile */
+    uint32_t fileLoadingFlags = 0;
+
+    /** @brief Filter used for generating the mip chains of non-KTX images with vkglTF::mipGenerator, needs to be set before loading the model */
+    vks::MipFilter mipFilter = vks::MipFilter::Box;
+
+    /** @brief Settings for generating the mip chains of non-KTX images on the CPU (used if vkglTF::mipGenerator isn't set), need to be set before loading the model */
+    struct ImageSettings {
+        /** @brief If disabled, the mip chains are generated with blits */
+        bool generateMipChains = true;
+        vks::imageprocessing::Filter filter = vks::imageprocessing::Filter::Box;
+        /** @brief Number of worker threads (images are processed in parallel), 0 uses all hardware threads */
+        uint32_t threadCount = 0;
+        /** @brief Prints the time and throughput of the mip chain generation after loading, e.g. for benchmarking */
+        bool reportThroughput = false;
+    } imageSettings;
+
+    /**
+    * @brief Optional background uploader for the vertex and index buffers, needs to be set before loading the model
+    * Models with skinning jobs are still uploaded right away, as the compute pre-skinning is prepared from the vertex buffer
+    * The uploader has to be destroyed before the model, as its completion callbacks refer to it
+    */
+    vks::StreamingUploader* streamingUploader = nullptr;
+    /** @brief False while the geometry is streamed, the draw functions record nothing until the uploader's update() sets it (command buffers need to be rebuilt then) */
+    bool geometryReady = true;
+
     std::vector<Node*> nodes;
     std::vector<Node*> linearNodes;
 
+    /**
+    * @brief Flattened primitives of all nodes, used by draw instead of walking the node tree
+    *
+    * Items are stored in one contiguous range per alpha mode (opaque, mask, blend), opaque and masked ranges are sorted by material to minimize descriptor changes
+    * The blended range keeps the node order until it is depth sorted with sortBlendedPrimitives
+    */
+    struct DrawList {
+        struct Item {
+            Node* node;
+            const Primitive* primitive;
+            /** @brief View space depth of the primitive's center, only updated for blended items */
+            float depth;
+        };
+        struct Range {
+            uint32_t first = 0;
+            uint32_t count = 0;
+        };
+        std::vector<Item> items;
+        Range ranges[3];
+    } drawList;
+
     std::vector<Skin*> skins;
 
     std::vector<Texture> textures;
@@ -291,13 +548,57 @@ public:
     ~Model();
     void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
     void loadSkins(tinygltf::Model& gltfModel);
+    /** @brief Assigns a range of the joint palette to every skinned mesh and creates the palette buffer */
+    void prepareJointPalette();
     void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
     void loadMaterials(tinygltf::Model& gltfModel);
     void loadAnimations(tinygltf::Model& gltfModel);
+    /** @brief Reorders the indices and vertices of all primitives for vertex cache, overdraw and vertex fetch efficiency */
+    void optimizeMeshes(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+    /** @brief Generates simplified versions of all primitives and appends their indices to the index buffer (see Primitive::lods) */
+    void generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+    /** @brief Splits all primitives into meshlets, results are read from or written to the given cache file if not empty */
+    void buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, const std::string& cacheFile = "");
     void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+    /**
+    * @brief Sets up compute pre-skinning using the given compute shader stage (base/skinning.comp), does nothing for models without skins
+    * Like the joint palette the skinned vertices are relative to the mesh's node, so they still need the node matrix, but no skinning in the vertex shader
+    */
+    void prepareSkinning(VkQueue queue, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+    /** @brief Records the pre-skinning dispatches including the required barriers, needs to be called outside of a render pass before the model is drawn */
+    void recordSkinning(VkCommandBuffer commandBuffer);
+    /** @brief Reference implementation of the skinning compute shader using the current joint palette */
+    void skinVertices(std::vector<Vertex>& output);
+    /** @brief Reads back the pre-skinned vertices and returns the largest position difference to the CPU reference (waits for the device to be idle) */
+    float validateSkinning(VkQueue queue);
+    /**
+    * @brief Creates the instance and indirect command buffers and the culling pipeline using the given compute shader stage (base/indirectcull.comp)
+    * @param drawIndirectCount True if VK_KHR_draw_indirect_count has been enabled on the device, visible commands are then compacted and drawn with a draw count
+    */
+    void prepareIndirectDrawing(VkPipelineShaderStageCreateInfo shaderStage, bool drawIndirectCount, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+    /** @brief Writes the current node matrices and bounding spheres to the instance buffer, call after nodes have been moved or animated */
+    void updateIndirectInstances();
+    /** @brief Sets the frustum used by the next culling pass */
+    void updateIndirectCulling(const glm::mat4& viewProjection);
+    /** @brief Records the culling dispatch including the required barriers, needs to be called outside of a render pass before drawIndirect */
+    void recordIndirectCulling(VkCommandBuffer commandBuffer);
+    /** @brief Draws the commands written by the culling pass, one indirect draw per bucket selected by the render flags */
+    void drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+    /** @brief Number of instances that passed culling in the last completed frame */
+    uint32_t getIndirectVisibleCount() const;
     void bindBuffers(VkCommandBuffer commandBuffer);
+    /** @brief Rebuilds the draw list, done after loading and needs to be called again if nodes or their meshes have been added or removed */
+    void buildDrawList();
+    /** @brief Sorts the blended primitives back to front, call whenever the view changes before recording draws of blended nodes */
+    void sortBlendedPrimitives(const glm::mat4& modelView);
     void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t instanceCount = 1);
     void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t instanceCount = 1);
+    /** @brief Size limit of the bindless texture array, the smaller of 4096 and the device's sampler and sampled image limits */
+    uint32_t getMaxBindlessTextureCount() const;
+    /** @brief Push constant range for the material index used by bindless materials, include this in the pipeline layout */
+    VkPushConstantRange getMaterialPushConstantRange() const;
+    /** @brief Returns a matrix that transforms packed positions back to model space (identity for the default vertex layout), apply this to positions only */
+    glm::mat4 getDequantizationMatrix() const;
     void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
     void getSceneDimensions();
     void updateAnimation(uint32_t index, float time);
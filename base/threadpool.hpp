@@ -13,6 +13,8 @@
 #include <condition_variable>
 #include <functional>
 
+#include "VulkanCpuProfiler.h"
+
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
 template<typename T, typename ...Args>
@@ -35,6 +37,7 @@ namespace vks
 		// Loop through all remaining jobs
 		void queueLoop()
 		{
+			VKS_PROFILE_THREAD("Worker");
 			while (true)
 			{
 				std::function<void()> job;
@@ -48,7 +51,10 @@ namespace vks
 					job = jobQueue.front();
 				}
 
-				job();
+				{
+					VKS_PROFILE_ZONE("ThreadPool job");
+					job();
+				}
 
 				{
 					std::lock_guard<std::mutex> lock(queueMutex);
@@ -148,7 +148,10 @@ void VulkanExampleBase::renderFrame()
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	{
+		VKS_PROFILE_ZONE("vkQueueSubmit");
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
 	VulkanExampleBase::submitFrame();
 }
 
@@ -206,6 +209,15 @@ void VulkanExampleBase::prepare()
 	}
 	initSwapchain();
 	createCommandPool();
+	parallelRecorder.prepare(device, swapChain.queueNodeIndex);
+	shaderCache.prepare(device);
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+	// Optional, created with data/shaders/packshaders.py
+	const std::string shaderArchive = getShadersPath() + "shaders.pak";
+	if (vks::tools::fileExists(shaderArchive)) {
+		shaderCache.openArchive(shaderArchive, getShadersPath());
+	}
+#endif
 	setupSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
@@ -222,7 +234,20 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		if (separateOverlay.enabled) {
+			setupOverlayRenderPass();
+			setupOverlayFrameBuffers();
+			// The overlay has its own single sampled render pass, independent of the one used by the scene
+			UIOverlay.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+			UIOverlay.subpass = 0;
+			UIOverlay.preparePipeline(pipelineCache, separateOverlay.renderPass, swapChain.colorFormat, depthFormat);
+		}
+		else {
+			UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		}
+	}
+	else {
+		separateOverlay.enabled = false;
 	}
 }
 
@@ -234,7 +259,7 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
 #else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+	shaderStage.module = shaderCache.loadShader(fileName);
 #endif
 	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
@@ -242,16 +267,41 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	return shaderStage;
 }
 
+bool VulkanExampleBase::shaderAvailable(const std::string& fileName)
+{
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_UNKNOWN);
+	if (asset == nullptr) {
+		return false;
+	}
+	AAsset_close(asset);
+	return true;
+#else
+	return shaderCache.isAvailable(fileName);
+#endif
+}
+
 void VulkanExampleBase::nextFrame()
 {
 	auto tStart = std::chrono::high_resolution_clock::now();
+	latencyTracker.beginFrame();
 	if (viewUpdated)
 	{
+		VKS_PROFILE_ZONE("viewChanged");
 		viewUpdated = false;
 		viewChanged();
 	}
 
-	render();
+	{
+		VKS_PROFILE_ZONE("render");
+		render();
+	}
+	// Waiting here instead of before rendering lets the next frame pick up the input received in the meantime
+	// The wait is part of the frame time, so animations and camera movement keep their speed
+	{
+		VKS_PROFILE_ZONE("frameLimiter");
+		frameLimiter.wait();
+	}
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
@@ -261,7 +311,10 @@ void VulkanExampleBase::nextFrame()
 	auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 #endif
 	frameTimer = (float)tDiff / 1000.0f;
-	camera.update(frameTimer);
+	{
+		VKS_PROFILE_ZONE("camera.update");
+		camera.update(frameTimer);
+	}
 	if (camera.moving())
 	{
 		viewUpdated = true;
@@ -292,6 +345,9 @@ void VulkanExampleBase::nextFrame()
 	
 	// TODO: Cap UI overlay update rates
 	updateOverlay();
+
+	// Zones of this frame are collected at its end, so the overlay always shows the previous frame
+	VKS_PROFILE_FRAME();
 }
 
 void VulkanExampleBase::renderLoop()
@@ -313,6 +369,7 @@ void VulkanExampleBase::renderLoop()
 	destHeight = height;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
 	tPrevEnd = lastTimestamp;
+	VKS_PROFILE_THREAD("Main");
 #if defined(_WIN32)
 	MSG msg;
 	bool quitMessageReceived = false;
@@ -365,7 +422,9 @@ void VulkanExampleBase::renderLoop()
 		if (prepared)
 		{
 			auto tStart = std::chrono::high_resolution_clock::now();
+			latencyTracker.beginFrame();
 			render();
+			frameLimiter.wait();
 			frameCounter++;
 			auto tEnd = std::chrono::high_resolution_clock::now();
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -449,7 +508,9 @@ void VulkanExampleBase::renderLoop()
 			viewUpdated = false;
 			viewChanged();
 		}
+		latencyTracker.beginFrame();
 		render();
+		frameLimiter.wait();
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -491,7 +552,9 @@ void VulkanExampleBase::renderLoop()
 		{
 			handleEvent(&event);
 		}
+		latencyTracker.beginFrame();
 		render();
+		frameLimiter.wait();
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -537,7 +600,9 @@ void VulkanExampleBase::renderLoop()
 		wl_display_read_events(display);
 		wl_display_dispatch_pending(display);
 
+		latencyTracker.beginFrame();
 		render();
+		frameLimiter.wait();
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -586,7 +651,9 @@ void VulkanExampleBase::renderLoop()
 			handleEvent(event);
 			free(event);
 		}
+		latencyTracker.beginFrame();
 		render();
+		frameLimiter.wait();
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -630,7 +697,9 @@ void VulkanExampleBase::renderLoop()
 			viewUpdated = false;
 			viewChanged();
 		}
+		latencyTracker.beginFrame();
 		render();
+		frameLimiter.wait();
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
@@ -669,6 +738,8 @@ void VulkanExampleBase::updateOverlay()
 	if (!settings.overlay)
 		return;
 
+	VKS_PROFILE_ZONE("updateOverlay");
+
 	ImGuiIO& io = ImGui::GetIO();
 
 	io.DisplaySize = ImVec2((float)width, (float)height);
@@ -688,12 +759,27 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::TextUnformatted(deviceProperties.deviceName);
 	ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+	if (separateOverlay.enabled) {
+		ImGui::Text("Scene rebuilds avoided: %llu", static_cast<unsigned long long>(separateOverlay.avoidedRebuilds));
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+#if defined(VKS_CPU_PROFILER)
+	if (ImGui::CollapsingHeader("CPU profiler")) {
+		vks::CpuProfiler::get().onUpdateUIOverlay(&UIOverlay);
+	}
+#endif
+	if (ImGui::CollapsingHeader("Frame pacing")) {
+		ImGui::Text("Present mode: %s, %u images", vks::tools::presentModeString(swapChain.presentMode).c_str(), swapChain.imageCount);
+		if (settings.frameLimit > 0) {
+			ImGui::Text("Frame limit: %u fps, waited %.2f ms", settings.frameLimit, frameLimiter.lastWaitTime);
+		}
+		latencyTracker.onUpdateUIOverlay(&UIOverlay);
+	}
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -703,7 +789,20 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
+	const bool overlayBuffersChanged = UIOverlay.update();
+	if (separateOverlay.enabled) {
+		// The overlay command buffers are recorded each frame, so only changed settings require the scene to be rebuilt
+		if (UIOverlay.updated) {
+			VKS_PROFILE_ZONE("buildCommandBuffers");
+			buildCommandBuffers();
+			UIOverlay.updated = false;
+		}
+		else if (overlayBuffersChanged) {
+			separateOverlay.avoidedRebuilds++;
+		}
+	}
+	else if (overlayBuffersChanged || UIOverlay.updated) {
+		VKS_PROFILE_ZONE("buildCommandBuffers");
 		buildCommandBuffers();
 		UIOverlay.updated = false;
 	}
@@ -717,6 +816,10 @@ void VulkanExampleBase::updateOverlay()
 
 void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 {
+	// The overlay is recorded into its own command buffers instead
+	if (separateOverlay.enabled) {
+		return;
+	}
 	if (settings.overlay && UIOverlay.visible) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
@@ -729,6 +832,7 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_PROFILE_ZONE("prepareFrame");
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
@@ -746,7 +850,25 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VKS_PROFILE_ZONE("submitFrame");
+	latencyTracker.submit();
+	VkSemaphore presentWaitSemaphore = semaphores.renderComplete;
+	if (separateOverlay.enabled) {
+		// Draw the overlay on top of the scene once that has finished rendering
+		recordOverlayCommandBuffer(currentBuffer);
+		VkSubmitInfo overlaySubmitInfo = vks::initializers::submitInfo();
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		overlaySubmitInfo.waitSemaphoreCount = 1;
+		overlaySubmitInfo.pWaitSemaphores = &semaphores.renderComplete;
+		overlaySubmitInfo.pWaitDstStageMask = &waitStageMask;
+		overlaySubmitInfo.commandBufferCount = 1;
+		overlaySubmitInfo.pCommandBuffers = &separateOverlay.commandBuffers[currentBuffer];
+		overlaySubmitInfo.signalSemaphoreCount = 1;
+		overlaySubmitInfo.pSignalSemaphores = &separateOverlay.renderComplete;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &overlaySubmitInfo, VK_NULL_HANDLE));
+		presentWaitSemaphore = separateOverlay.renderComplete;
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, presentWaitSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -757,7 +879,9 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	VKS_PROFILE_ZONE("vkQueueWaitIdle");
 	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	latencyTracker.present();
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -795,6 +919,10 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("presentmode", { "-pm", "--presentmode" }, 1, "Select present mode (fifo, fiforelaxed, mailbox or immediate)");
+	commandLineParser.add("swapchainimages", { "-si", "--swapchainimages" }, 1, "Set the minimum number of swapchain images");
+	commandLineParser.add("framelimit", { "-fl", "--framelimit" }, 1, "Limit the frame rate to the given number of frames per second");
+	commandLineParser.add("latencyreport", { "-lr", "--latencyreport" }, 0, "Print the frame latency distribution on exit");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -848,6 +976,34 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("presentmode")) {
+		std::string value = commandLineParser.getValueAsString("presentmode", "fifo");
+		if (value == "fifo") {
+			settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		}
+		else if (value == "fiforelaxed") {
+			settings.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		}
+		else if (value == "mailbox") {
+			settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		}
+		else if (value == "immediate") {
+			settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		}
+		else {
+			std::cerr << "Present mode must be one of 'fifo', 'fiforelaxed', 'mailbox' or 'immediate'\n";
+		}
+	}
+	if (commandLineParser.isSet("swapchainimages")) {
+		settings.swapchainImages = std::max(commandLineParser.getValueAsInt("swapchainimages", 0), 0);
+	}
+	if (commandLineParser.isSet("framelimit")) {
+		settings.frameLimit = std::max(commandLineParser.getValueAsInt("framelimit", 0), 0);
+	}
+	if (commandLineParser.isSet("latencyreport")) {
+		settings.latencyReport = true;
+	}
+	frameLimiter.setFrameRate(static_cast<float>(settings.frameLimit));
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -873,6 +1029,9 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (settings.latencyReport) {
+		latencyTracker.printSummary(std::cout);
+	}
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -880,6 +1039,7 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 	destroyCommandBuffers();
+	parallelRecorder.destroy();
 	if (renderPass != VK_NULL_HANDLE)
 	{
 		vkDestroyRenderPass(device, renderPass, nullptr);
@@ -889,10 +1049,13 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
 	}
 
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	for (auto& shaderModule : shaderModules)
 	{
 		vkDestroyShaderModule(device, shaderModule, nullptr);
 	}
+#endif
+	shaderCache.destroy();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
@@ -907,6 +1070,12 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFence(device, fence, nullptr);
 	}
 
+	if (separateOverlay.enabled) {
+		destroyOverlayFrameBuffers();
+		vkDestroyRenderPass(device, separateOverlay.renderPass, nullptr);
+		vkDestroySemaphore(device, separateOverlay.renderComplete, nullptr);
+	}
+
 	if (settings.overlay) {
 		UIOverlay.freeResources();
 	}
@@ -1038,7 +1207,8 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// Dedicated compute and transfer queue families are requested if the device has them, so work can run asynchronously to graphics
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
@@ -1047,6 +1217,9 @@ bool VulkanExampleBase::initVulkan()
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+	// Only a single queue is created per family, so these are the graphics queue if the device has no separate families
+	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &computeQueue);
+	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.transfer, 0, &transferQueue);
 
 	// Find a suitable depth format
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
@@ -1236,6 +1409,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 		ValidateRect(window, NULL);
 		break;
 	case WM_KEYDOWN:
+		latencyTracker.input();
 		switch (wParam)
 		{
 		case KEY_P:
@@ -1292,14 +1466,17 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 		}
 		break;
 	case WM_LBUTTONDOWN:
+		latencyTracker.input();
 		mousePos = glm::vec2((float)LOWORD(lParam), (float)HIWORD(lParam));
 		mouseButtons.left = true;
 		break;
 	case WM_RBUTTONDOWN:
+		latencyTracker.input();
 		mousePos = glm::vec2((float)LOWORD(lParam), (float)HIWORD(lParam));
 		mouseButtons.right = true;
 		break;
 	case WM_MBUTTONDOWN:
+		latencyTracker.input();
 		mousePos = glm::vec2((float)LOWORD(lParam), (float)HIWORD(lParam));
 		mouseButtons.middle = true;
 		break;
@@ -1356,6 +1533,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 int32_t VulkanExampleBase::handleAppInput(struct android_app* app, AInputEvent* event)
 {
 	VulkanExampleBase* vulkanExample = reinterpret_cast<VulkanExampleBase*>(app->userData);
+	vulkanExample->latencyTracker.input();
 	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION)
 	{
 		int32_t eventSource = AInputEvent_getSource(event);
@@ -2147,6 +2325,7 @@ void VulkanExampleBase::pointerMotion(wl_pointer *pointer, uint32_t time, wl_fix
 void VulkanExampleBase::pointerButton(struct wl_pointer *pointer,
 		uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
 {
+	latencyTracker.input();
 	switch (button)
 	{
 	case BTN_LEFT:
@@ -2214,6 +2393,7 @@ void VulkanExampleBase::pointerAxis(wl_pointer *pointer, uint32_t time,
 void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard,
 		uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
+	latencyTracker.input();
 	switch (key)
 	{
 	case KEY_W:
@@ -2555,6 +2735,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 	break;
 	case XCB_BUTTON_PRESS:
 	{
+		latencyTracker.input();
 		xcb_button_press_event_t *press = (xcb_button_press_event_t *)event;
 		if (press->detail == XCB_BUTTON_INDEX_1)
 			mouseButtons.left = true;
@@ -2577,6 +2758,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 	break;
 	case XCB_KEY_PRESS:
 	{
+		latencyTracker.input();
 		const xcb_key_release_event_t *keyEvent = (const xcb_key_release_event_t *)event;
 		switch (keyEvent->detail)
 		{
@@ -2819,6 +3001,111 @@ void VulkanExampleBase::setupRenderPass()
 	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 }
 
+void VulkanExampleBase::setupOverlayRenderPass()
+{
+	// Draws on top of the scene, so the contents of the swap chain image are loaded and it stays in the present layout
+	VkAttachmentDescription attachment = {};
+	attachment.format = swapChain.colorFormat;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorReference = {};
+	colorReference.attachment = 0;
+	colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+
+	// The scene's color writes have to be finished before the overlay blends on top of them
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+	dependency.dependencyFlags = 0;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &attachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &separateOverlay.renderPass));
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &separateOverlay.renderComplete));
+}
+
+void VulkanExampleBase::setupOverlayFrameBuffers()
+{
+	VkFramebufferCreateInfo frameBufferCreateInfo = {};
+	frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	frameBufferCreateInfo.renderPass = separateOverlay.renderPass;
+	frameBufferCreateInfo.attachmentCount = 1;
+	frameBufferCreateInfo.width = width;
+	frameBufferCreateInfo.height = height;
+	frameBufferCreateInfo.layers = 1;
+	separateOverlay.frameBuffers.resize(swapChain.imageCount);
+	for (uint32_t i = 0; i < separateOverlay.frameBuffers.size(); i++) {
+		frameBufferCreateInfo.pAttachments = &swapChain.buffers[i].view;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &separateOverlay.frameBuffers[i]));
+	}
+
+	separateOverlay.commandBuffers.resize(swapChain.imageCount);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(separateOverlay.commandBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, separateOverlay.commandBuffers.data()));
+}
+
+void VulkanExampleBase::destroyOverlayFrameBuffers()
+{
+	for (auto& frameBuffer : separateOverlay.frameBuffers) {
+		vkDestroyFramebuffer(device, frameBuffer, nullptr);
+	}
+	separateOverlay.frameBuffers.clear();
+	if (!separateOverlay.commandBuffers.empty()) {
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(separateOverlay.commandBuffers.size()), separateOverlay.commandBuffers.data());
+		separateOverlay.commandBuffers.clear();
+	}
+}
+
+void VulkanExampleBase::recordOverlayCommandBuffer(uint32_t index)
+{
+	// Only contains the overlay's draws, so it's cheap enough to be recorded for every frame
+	VKS_PROFILE_ZONE("recordOverlayCommandBuffer");
+	VkCommandBuffer commandBuffer = separateOverlay.commandBuffers[index];
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	renderPassBeginInfo.renderPass = separateOverlay.renderPass;
+	renderPassBeginInfo.framebuffer = separateOverlay.frameBuffers[index];
+	renderPassBeginInfo.renderArea.extent.width = width;
+	renderPassBeginInfo.renderArea.extent.height = height;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (UIOverlay.visible) {
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		UIOverlay.draw(commandBuffer);
+	}
+	vkCmdEndRenderPass(commandBuffer);
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+}
+
 void VulkanExampleBase::getEnabledFeatures() {}
 
 void VulkanExampleBase::getEnabledExtensions() {}
@@ -2855,6 +3142,10 @@ void VulkanExampleBase::windowResize()
 			UIOverlay.resize(width, height);
 		}
 	}
+	if (separateOverlay.enabled) {
+		destroyOverlayFrameBuffers();
+		setupOverlayFrameBuffers();
+	}
 
 	// Command buffers need to be recreated as they may store
 	// references to the recreated frame buffer
@@ -2883,6 +3174,7 @@ void VulkanExampleBase::windowResize()
 
 void VulkanExampleBase::handleMouseMove(int32_t x, int32_t y)
 {
+	latencyTracker.input();
 	int32_t dx = (int32_t)mousePos.x - x;
 	int32_t dy = (int32_t)mousePos.y - y;
 
@@ -2937,6 +3229,8 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
+	swapChain.requestedPresentMode = settings.presentMode;
+	swapChain.requestedImageCount = settings.swapchainImages;
 	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
 }
 
@@ -68,6 +68,10 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanCpuProfiler.h"
+#include "VulkanParallelRecorder.h"
+#include "VulkanShaderCache.h"
+#include "VulkanFramePacing.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -91,8 +95,13 @@ private:
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
-	std::string shaderDir = "glsl";
+	void setupOverlayRenderPass();
+	void setupOverlayFrameBuffers();
+	void destroyOverlayFrameBuffers();
+	void recordOverlayCommandBuffer(uint32_t index);
 protected:
+	// Shader language subdirectory ("glsl" or "hlsl"), selected with the -s command line argument
+	std::string shaderDir = "glsl";
 	// Returns the path to the root of the glsl or hlsl shader directory.
 	std::string getShadersPath() const;
 	// Returns the path to the root of the homework glsl or hlsl shader directory.
@@ -123,6 +132,10 @@ protected:
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
 	VkQueue queue;
+	/** @brief Queue of vulkanDevice->queueFamilyIndices.compute, prefers a family without graphics support for asynchronous compute */
+	VkQueue computeQueue = VK_NULL_HANDLE;
+	/** @brief Queue of vulkanDevice->queueFamilyIndices.transfer, prefers a transfer only family (e.g. DMA engines) */
+	VkQueue transferQueue = VK_NULL_HANDLE;
 	// Depth buffer format (selected during Vulkan initialization)
 	VkFormat depthFormat;
 	// Command buffer pool
@@ -141,8 +154,10 @@ protected:
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	// List of shader modules created (stored for cleanup)
+	// List of shader modules in the order they were loaded (may contain shared modules, which are owned by the shader cache)
 	std::vector<VkShaderModule> shaderModules;
+	// Shares modules between identical shaders and reads them from the packed shader archive if one exists
+	vks::ShaderCache shaderCache;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
@@ -163,6 +178,25 @@ public:
 	uint32_t height = 720;
 
 	vks::UIOverlay UIOverlay;
+	/**
+	* @brief Records the UI overlay into its own command buffers instead of the scene's
+	*
+	* The overlay is then drawn in a separate render pass on top of the swap chain image and submitted after the scene, so UI changes
+	* only require the scene command buffers to be rebuilt if a widget changed a value (UIOverlay.updated), drawUI becomes a no-op
+	* Set enabled in the constructor of the derived class, requires the scene to leave the swap chain image in the present layout
+	*/
+	struct {
+		bool enabled = false;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> frameBuffers;
+		std::vector<VkCommandBuffer> commandBuffers;
+		/** @brief Signaled by the overlay submission, presentation waits on this instead of semaphores.renderComplete */
+		VkSemaphore renderComplete = VK_NULL_HANDLE;
+		/** @brief Number of UI updates that did not require the scene command buffers to be rebuilt */
+		uint64_t avoidedRebuilds = 0;
+	} separateOverlay;
+	/** @brief Records secondary command buffers on worker threads, threads and command pools are created on first use */
+	vks::ParallelCommandRecorder parallelRecorder;
 	CommandLineParser commandLineParser;
 
 	/** @brief Last frame time measured using a high performance timer (if available) */
@@ -170,6 +204,11 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief Caps the frame rate to settings.frameLimit, waits after a frame has been presented */
+	vks::FrameLimiter frameLimiter;
+	/** @brief Timestamps input, simulation, submit and present of each frame rendered by nextFrame */
+	vks::LatencyTracker latencyTracker;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -183,6 +222,14 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Present mode requested via command line, VK_PRESENT_MODE_MAX_ENUM_KHR lets the swapchain choose based on vsync */
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+		/** @brief Minimum number of swapchain images, 0 uses the swapchain's default */
+		uint32_t swapchainImages = 0;
+		/** @brief Frame rate cap in frames per second, 0 renders as fast as the present mode allows */
+		uint32_t frameLimit = 0;
+		/** @brief Print the frame latency distribution on exit */
+		bool latencyReport = false;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -376,6 +423,8 @@ public:
 
 	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+	/** @brief Returns true if the SPIR-V file can be loaded, use this to skip optional features whose shaders have not been compiled */
+	bool shaderAvailable(const std::string& fileName);
 
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
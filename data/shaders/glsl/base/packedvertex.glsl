@@ -0,0 +1,36 @@
+// Decoding functions for the quantized glTF vertex layout (vkglTF::PackedVertex)
+// Include with GL_GOOGLE_include_directive in shaders that consume models loaded with vkglTF::FileLoadingFlags::PackVertices
+//
+// Attribute formats as returned by vkglTF::Vertex::getPipelineVertexInputState(..., vkglTF::VertexLayout::Packed):
+//	Position : vec4  (unorm16, relative to the model's vertex bounds)
+//	Normal   : vec2  (snorm16, octahedral)
+//	UV       : vec2  (half float, no decoding required)
+//	Color    : vec4  (unorm8, no decoding required)
+//	Tangent  : vec4  (snorm8, octahedral in xy, handedness in w)
+//	Joint0   : uvec4 (uint16)
+//	Weight0  : vec4  (unorm8, no decoding required)
+
+// Transforms a packed position back to model space, offset and scale come from vkglTF::Model::quantization
+vec3 decodePosition(vec4 packedPos, vec3 offset, vec3 scale)
+{
+	return packedPos.xyz * scale + offset;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 decodeNormal(vec2 packedNormal)
+{
+	return decodeOctahedral(packedNormal);
+}
+
+vec4 decodeTangent(vec4 packedTangent)
+{
+	return vec4(decodeOctahedral(packedTangent.xy), packedTangent.w < 0.0 ? -1.0 : 1.0);
+}
@@ -0,0 +1,14 @@
+#version 450
+
+// Adds the result of a compute blur (see vks::PostProcessing) on top of the scene, blending is done by the pipeline
+
+layout (binding = 1) uniform sampler2D samplerColor;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	outFragColor = vec4(texture(samplerColor, inUV).rgb, 1.0);
+}
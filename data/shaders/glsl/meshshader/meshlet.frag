@@ -0,0 +1,26 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#version 450
+ 
+layout (location = 0) in VertexInput {
+	vec3 normal;
+	vec3 color;
+	vec3 viewVec;
+	vec3 lightVec;
+} vertexInput;
+
+layout(location = 0) out vec4 outFragColor;
+
+void main()
+{
+	vec3 N = normalize(vertexInput.normal);
+	vec3 L = normalize(vertexInput.lightVec);
+	vec3 V = normalize(vertexInput.viewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), 0.15) * vertexInput.color;
+	vec3 specular = pow(max(dot(R, V), 0.0), 16.0) * vec3(0.5);
+	outFragColor = vec4(diffuse + specular, 1.0);
+}
@@ -0,0 +1,94 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerposition;
+layout (binding = 1) uniform sampler2D samplerNormal;
+layout (binding = 2) uniform sampler2D samplerAlbedo;
+layout (binding = 3) uniform sampler2D samplerSSAO;
+layout (binding = 4) uniform sampler2D samplerSSAOBlur;
+layout (binding = 5) uniform UBO 
+{
+	mat4 _dummy;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int frameIndex;
+	mat4 viewToPrevClip;
+	int sampleCount;
+	int sampleStride;
+	float historyWeight;
+	// SSAO (binding 3) has a lower resolution and is upsampled with the depth in binding 6
+	int upsample;
+} uboParams;
+layout (binding = 6) uniform sampler2D samplerPositionLow;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Joint bilateral upsample, the low resolution texels around the fragment are weighted by distance and depth similarity
+float upsampleSSAO(vec2 uv, float depth)
+{
+	ivec2 lowSize = textureSize(samplerSSAO, 0);
+	vec2 lowPos = uv * vec2(lowSize) - 0.5;
+	ivec2 base = ivec2(floor(lowPos));
+	vec2 f = fract(lowPos);
+	// The blur setting widens the footprint from 2x2 to 4x4 texels
+	int range = (uboParams.ssaoBlur == 1) ? 1 : 0;
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int y = -range; y <= range + 1; y++) {
+		for (int x = -range; x <= range + 1; x++) {
+			ivec2 pos = clamp(base + ivec2(x, y), ivec2(0), lowSize - 1);
+			vec2 d = vec2(x, y) - f;
+			float lowDepth = texelFetch(samplerPositionLow, pos, 0).w;
+			float weight = exp(-dot(d, d) * 0.5) * exp(-abs(lowDepth - depth) / max(depth, 0.0001) * 32.0);
+			result += texelFetch(samplerSSAO, pos, 0).r * weight;
+			weightSum += weight;
+		}
+	}
+	// None of the texels is on the same surface, fall back to the closest one
+	if (weightSum < 0.0001) {
+		return texelFetch(samplerSSAO, clamp(ivec2(round(lowPos)), ivec2(0), lowSize - 1), 0).r;
+	}
+	return result / weightSum;
+}
+
+void main() 
+{
+	vec4 fragPosDepth = texture(samplerposition, inUV);
+	vec3 fragPos = fragPosDepth.rgb;
+	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
+	vec4 albedo = texture(samplerAlbedo, inUV);
+	 
+	float ssao;
+	if (uboParams.upsample == 1) {
+		ssao = upsampleSSAO(inUV, fragPosDepth.w);
+	} else {
+		ssao = (uboParams.ssaoBlur == 1) ? texture(samplerSSAOBlur, inUV).r : texture(samplerSSAO, inUV).r;
+	}
+
+	vec3 lightPos = vec3(0.0);
+	vec3 L = normalize(lightPos - fragPos);
+	float NdotL = max(0.5, dot(normal, L));
+
+	if (uboParams.ssaoOnly == 1)
+	{
+		outFragColor.rgb = ssao.rrr;
+	}
+	else
+	{
+		vec3 baseColor = albedo.rgb * NdotL;
+
+		if (uboParams.ssao == 1)
+		{
+			outFragColor.rgb = ssao.rrr;
+
+			if (uboParams.ssaoOnly != 1)
+				outFragColor.rgb *= baseColor;
+		}
+		else
+		{
+			outFragColor.rgb = baseColor;
+		}
+	}
+}
\ No newline at end of file
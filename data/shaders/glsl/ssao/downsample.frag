@@ -0,0 +1,34 @@
+#version 450
+
+// Reduces the G-Buffer positions and normals to half resolution for the reduced resolution SSAO
+// Alternates between the closest and the farthest of the four texels in a checkerboard, so both sides of depth edges survive
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+
+void main()
+{
+	ivec2 pos = ivec2(gl_FragCoord.xy);
+	ivec2 fullSize = textureSize(samplerPositionDepth, 0);
+	bool farthest = ((pos.x + pos.y) & 1) == 1;
+
+	ivec2 selected = min(pos * 2, fullSize - 1);
+	vec4 selectedPosition = texelFetch(samplerPositionDepth, selected, 0);
+	for (int i = 1; i < 4; i++) {
+		ivec2 texel = min(pos * 2 + ivec2(i & 1, i >> 1), fullSize - 1);
+		vec4 position = texelFetch(samplerPositionDepth, texel, 0);
+		if (farthest ? (position.w > selectedPosition.w) : (position.w < selectedPosition.w)) {
+			selected = texel;
+			selectedPosition = position;
+		}
+	}
+
+	// Position and normal are taken from the same texel so they describe the same surface
+	outPosition = selectedPosition;
+	outNormal = texelFetch(samplerNormal, selected, 0);
+}
@@ -0,0 +1,57 @@
+#version 450
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inNormal;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+} ubo;
+
+// Matches vkglTF::Model::IndirectDrawing::Instance
+struct Instance
+{
+	mat4 matrix;
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+	uint materialIndex;
+	uint firstCommand;
+	uint bucket;
+};
+
+layout (std430, set = 2, binding = 0) readonly buffer Instances
+{
+	Instance instances[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outColor;
+layout (location = 3) out vec3 outPos;
+layout (location = 4) flat out uint outMaterialIndex;
+
+void main() 
+{
+	// The culling shader stores the instance index in firstInstance of each draw command
+	Instance instance = instances[gl_InstanceIndex];
+	mat4 modelView = ubo.view * ubo.model * instance.matrix;
+
+	gl_Position = ubo.projection * modelView * inPos;
+	
+	outUV = inUV;
+
+	// Vertex position in view space
+	outPos = vec3(modelView * inPos);
+
+	// Normal in view space
+	mat3 normalMatrix = transpose(inverse(mat3(modelView)));
+	outNormal = normalMatrix * inNormal;
+
+	outColor = inColor;
+	outMaterialIndex = instance.materialIndex;
+}
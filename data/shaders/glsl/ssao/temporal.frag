@@ -0,0 +1,55 @@
+#version 450
+
+// Accumulates the reduced resolution SSAO over several frames
+// The history is reprojected with the previous frame's camera and clamped to the current neighbourhood to limit ghosting
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerHistory;
+layout (binding = 2) uniform sampler2D samplerPositionDepth;
+layout (binding = 3) uniform UBO
+{
+	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int frameIndex;
+	// Transforms view space positions of this frame into clip space of the previous frame
+	mat4 viewToPrevClip;
+	int sampleCount;
+	int sampleStride;
+	// Zero discards the history, e.g. right after accumulation has been enabled
+	float historyWeight;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+void main()
+{
+	ivec2 size = textureSize(samplerSSAO, 0);
+	ivec2 pos = ivec2(gl_FragCoord.xy);
+	float current = texelFetch(samplerSSAO, pos, 0).r;
+
+	float minOcclusion = current;
+	float maxOcclusion = current;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			float occlusion = texelFetch(samplerSSAO, clamp(pos + ivec2(x, y), ivec2(0), size - 1), 0).r;
+			minOcclusion = min(minOcclusion, occlusion);
+			maxOcclusion = max(maxOcclusion, occlusion);
+		}
+	}
+
+	vec3 viewPos = texelFetch(samplerPositionDepth, pos, 0).xyz;
+	vec4 prevClip = ubo.viewToPrevClip * vec4(viewPos, 1.0);
+	vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+
+	float weight = ubo.historyWeight;
+	if (any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0)))) {
+		weight = 0.0;
+	}
+	float history = clamp(texture(samplerHistory, prevUV).r, minOcclusion, maxOcclusion);
+
+	outFragColor = mix(current, history, weight);
+}
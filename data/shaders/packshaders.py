@@ -0,0 +1,68 @@
+import argparse
+import os
+import struct
+import sys
+
+# Packs all compiled SPIR-V shaders of a shader language folder into a single archive
+# The examples map this archive at startup instead of opening every .spv file separately
+# Layout has to match vks::ShaderArchive in base/VulkanShaderCache.h
+# Size and modification time of each file are stored as well, the examples read the .spv file instead of the archived
+# code if either has changed since packing
+
+parser = argparse.ArgumentParser(description='Pack compiled SPIR-V shaders into a single archive')
+parser.add_argument('--language', type=str, default='glsl', help='shader language folder to pack (glsl or hlsl)')
+parser.add_argument('--output', type=str, help='archive file name, defaults to shaders.pak inside the language folder')
+args = parser.parse_args()
+
+# Same as vks::tools::hash in base/VulkanTools.cpp
+def fnv1a64(data):
+    hash = 14695981039346656037
+    for byte in bytearray(data):
+        hash = ((hash ^ byte) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return hash
+
+def align(value, alignment):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+dir_path = os.path.join(os.path.dirname(os.path.realpath(__file__)), args.language)
+if not os.path.isdir(dir_path):
+    sys.exit("Shader folder %s does not exist" % dir_path)
+output_file = args.output if args.output != None else os.path.join(dir_path, "shaders.pak")
+
+shaders = []
+for root, dirs, files in os.walk(dir_path):
+    for file in files:
+        if file.endswith(".spv"):
+            input_file = os.path.join(root, file)
+            # Names are relative to the shader root, the same way the examples build their paths
+            name = os.path.relpath(input_file, dir_path).replace('\\', '/')
+            with open(input_file, 'rb') as f:
+                code = f.read()
+            if len(code) == 0 or len(code) % 4 != 0:
+                sys.exit("%s is not a valid SPIR-V file" % input_file)
+            source_stat = os.stat(input_file)
+            shaders.append((name.encode('utf-8'), code, len(code), int(source_stat.st_mtime)))
+shaders.sort()
+
+header_size = 16
+entry_size = 40
+names_offset = header_size + entry_size * len(shaders)
+names_size = sum(len(shader[0]) for shader in shaders)
+
+entries = b''
+names = b''
+data = b''
+data_offset = align(names_offset + names_size, 4)
+for name, code, source_size, source_time in shaders:
+    entries += struct.pack('<IIIIQQq', names_offset + len(names), len(name), data_offset + len(data), len(code), fnv1a64(code), source_size, source_time)
+    names += name
+    data += code + b'\0' * (align(len(code), 4) - len(code))
+
+with open(output_file, 'wb') as f:
+    f.write(struct.pack('<4sIII', b'VKSA', 2, len(shaders), 0))
+    f.write(entries)
+    f.write(names)
+    f.write(b'\0' * (align(names_offset + names_size, 4) - (names_offset + names_size)))
+    f.write(data)
+
+print("Packed %d shaders (%d bytes) into %s" % (len(shaders), data_offset + len(data), output_file))
@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanGpuProfiler.h"
+#include "VulkanPostProcessing.h"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +22,16 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool bloom = true;
 
+	// The blur can be done with the fragment shader passes or with the compute kernels of vks::PostProcessing (see base/VulkanPostProcessing.h)
+	enum BlurMode { Fragment = 0, ComputeGaussian = 1, ComputeDualFilter = 2 };
+	int32_t blurMode = Fragment;
+	bool computeBlurSupported = false;
+	vks::PostProcessing postProcessing;
+	// Indexed by blur mode - 1
+	std::array<vks::PostProcessing::Blur, 2> computeBlurs;
+	// Benchmark runs cycle through the supported blur modes to compare their GPU times
+	uint32_t benchmarkFrame = 0;
+
 	vks::TextureCubeMap cubemap;
 
 	struct {
@@ -56,6 +68,7 @@ public:
 		VkPipeline glowPass;
 		VkPipeline phongPass;
 		VkPipeline skyBox;
+		VkPipeline bloomComposite;
 	} pipelines;
 
 	struct {
@@ -68,6 +81,8 @@ public:
 		VkDescriptorSet blurHorz;
 		VkDescriptorSet scene;
 		VkDescriptorSet skyBox;
+		// Compute blur outputs, indexed like computeBlurs
+		std::array<VkDescriptorSet, 2> bloomComposite;
 	} descriptorSets;
 
 	struct {
@@ -93,6 +108,9 @@ public:
 		std::array<FrameBuffer, 2> framebuffers;
 	} offscreenPass;
 
+	// Times the passes of each command buffer
+	vks::GpuProfiler profiler;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Bloom (offscreen rendering)";
@@ -101,6 +119,9 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -10.25f));
 		camera.setRotation(glm::vec3(7.5f, -343.0f, 0.0f));
 		camera.setPerspective(45.0f, (float)width / (float)height, 0.1f, 256.0f);
+
+		// The GPU timings shown in the UI change every frame, so the overlay gets its own command buffers
+		separateOverlay.enabled = true;
 	}
 
 	~VulkanExample()
@@ -130,6 +151,13 @@ public:
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
 		vkDestroyPipeline(device, pipelines.glowPass, nullptr);
 		vkDestroyPipeline(device, pipelines.skyBox, nullptr);
+		if (computeBlurSupported) {
+			vkDestroyPipeline(device, pipelines.bloomComposite, nullptr);
+			for (auto& computeBlur : computeBlurs) {
+				postProcessing.destroyBlur(computeBlur);
+			}
+		}
+		postProcessing.destroy();
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.blur , nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
@@ -143,6 +171,23 @@ public:
 		uniformBuffers.blurParams.destroy();
 
 		cubemap.destroy();
+
+		if (benchmark.active) {
+			profiler.printSummary();
+		}
+		profiler.destroy();
+	}
+
+	// Pipeline statistics are optional and only used by the profiler
+	virtual void getEnabledFeatures()
+	{
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+		// The compute blurs write their results through storage images without a format qualifier
+		if (deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			enabledFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		}
 	}
 
 	// Setup the offscreen framebuffer for rendering the mirrored scene
@@ -282,7 +327,7 @@ public:
 
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -291,7 +336,8 @@ public:
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		// The glow pass is also read by the compute blurs
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
@@ -345,6 +391,8 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			profiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
 			if (bloom) {
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
@@ -367,6 +415,7 @@ public:
 					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
 				*/
 
+				profiler.cmdBeginZone(drawCmdBuffers[i], "Glow pass");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
@@ -375,23 +424,33 @@ public:
 				models.ufoGlow.draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				profiler.cmdEndZone(drawCmdBuffers[i]);
 
-				/*
-					Second render pass: Vertical blur
+				if (blurMode == Fragment) {
+					/*
+						Second render pass: Vertical blur
 
-					Render contents of the first pass into a second framebuffer and apply a vertical blur
-					This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
-				*/
+						Render contents of the first pass into a second framebuffer and apply a vertical blur
+						This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
+					*/
 
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
+					renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
 
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					profiler.cmdBeginZone(drawCmdBuffers[i], "Vertical blur");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					profiler.cmdEndZone(drawCmdBuffers[i]);
+				}
+				else {
+					// Both blur directions (or the whole downsample and upsample chain) run as compute dispatches outside of any render pass
+					vks::GpuZone zone(profiler, drawCmdBuffers[i], (blurMode == ComputeGaussian) ? "Compute blur (Gaussian)" : "Compute blur (dual filter)");
+					postProcessing.recordBlur(drawCmdBuffers[i], computeBlurs[blurMode - 1]);
+				}
 			}
 
 			/*
@@ -405,6 +464,8 @@ public:
 
 			*/
 			{
+				vks::GpuZone sceneZone(profiler, drawCmdBuffers[i], "Scene");
+
 				clearValues[0].color = defaultClearColor;
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
@@ -425,28 +486,46 @@ public:
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 				// Skybox
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.skyBox, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skyBox);
-				models.skyBox.draw(drawCmdBuffers[i]);
+				{
+					vks::GpuZone zone(profiler, drawCmdBuffers[i], "Skybox");
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.skyBox, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skyBox);
+					models.skyBox.draw(drawCmdBuffers[i]);
+				}
 
 				// 3D scene
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
-				models.ufo.draw(drawCmdBuffers[i]);
+				{
+					vks::GpuZone zone(profiler, drawCmdBuffers[i], "Model");
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
+					models.ufo.draw(drawCmdBuffers[i]);
+				}
 
-				if (bloom)
+				if (bloom && (blurMode == Fragment))
 				{
+					vks::GpuZone zone(profiler, drawCmdBuffers[i], "Horizontal blur");
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 				}
 
+				if (bloom && (blurMode != Fragment))
+				{
+					// The compute blur is already complete, so it only needs to be added on top of the scene
+					vks::GpuZone zone(profiler, drawCmdBuffers[i], "Bloom composite");
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.bloomComposite[blurMode - 1], 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloomComposite);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				}
+
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			}
 
+			profiler.cmdEndFrame(drawCmdBuffers[i]);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -463,10 +542,10 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 7);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -521,6 +600,18 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[1].descriptor),	// Binding 1: Fragment shader texture sampler
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		// Compute blur outputs, the composite pass only reads the image
+		if (computeBlurSupported) {
+			for (size_t i = 0; i < computeBlurs.size(); i++) {
+				descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.bloomComposite[i]));
+				writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSets.bloomComposite[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),			// Binding 0: Fragment shader uniform buffer (unused)
+					vks::initializers::writeDescriptorSet(descriptorSets.bloomComposite[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &computeBlurs[i].output.descriptor),	// Binding 1: Fragment shader texture sampler
+				};
+				vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			}
+		}
 
 		// Scene rendering
 		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.scene, 1);
@@ -592,6 +683,11 @@ public:
 		blurdirection = 1;
 		pipelineCI.renderPass = renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		// Composite pipeline for the compute blurs, additively blends the finished blur
+		if (computeBlurSupported) {
+			shaderStages[1] = loadShader(getShadersPath() + "bloom/bloomcomposite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloomComposite));
+		}
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -680,12 +776,63 @@ public:
 		memcpy(uniformBuffers.blurParams.mapped, &ubos.blurParams, sizeof(ubos.blurParams));
 	}
 
+	// Map the blur scale of the fragment shader passes to the settings of the compute blurs
+	void updateComputeBlurSettings()
+	{
+		vks::PostProcessing::BlurSettings &gaussian = computeBlurs[ComputeGaussian - 1].settings;
+		// The fragment shader passes use five taps per side with a sigma of about two texels, spread by the scale
+		gaussian.sigma = 2.0f * ubos.blurParams.blurScale;
+		gaussian.radius = std::min(static_cast<int32_t>(std::ceil(gaussian.sigma * 2.0f)), vks::PostProcessing::maxRadius);
+		gaussian.intensity = ubos.blurParams.blurStrength;
+		vks::PostProcessing::BlurSettings &dualFilter = computeBlurs[ComputeDualFilter - 1].settings;
+		dualFilter.offset = ubos.blurParams.blurScale;
+		dualFilter.intensity = ubos.blurParams.blurStrength;
+	}
+
+	void prepareComputeBlurs()
+	{
+		// The GLSL SPIR-V is generated by the build (see GLSL_BUILD_SHADERS), other shader languages may not implement the compute blurs
+		if (shaderDir != "glsl") {
+			const std::string computeBlurShaders[3] = { "base/blurseparable.comp.spv", "base/dualfilter.comp.spv", "bloom/bloomcomposite.frag.spv" };
+			for (const std::string& shader : computeBlurShaders) {
+				if (!shaderAvailable(getShadersPath() + shader)) {
+					std::cout << "Compute blur shader \"" << shader << "\" not available for " << shaderDir << ", using the fragment shader blur" << std::endl;
+					return;
+				}
+			}
+		}
+		postProcessing.create(vulkanDevice, loadShader(getShadersPath() + "base/blurseparable.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), loadShader(getShadersPath() + "base/dualfilter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		computeBlurSupported = postProcessing.isFormatSupported(FB_COLOR_FORMAT);
+		if (!computeBlurSupported) {
+			std::cout << "Compute blurs not supported for the offscreen format, using the fragment shader blur\n";
+			return;
+		}
+		// Both blur the glow pass, the separable blur at its full size, the dual filter over four levels starting at half size
+		vks::PostProcessing::BlurSettings settings;
+		postProcessing.createBlur(computeBlurs[ComputeGaussian - 1], vks::PostProcessing::BlurType::Gaussian, offscreenPass.framebuffers[0].color.view, FB_DIM, FB_DIM, FB_COLOR_FORMAT, settings);
+		settings.levels = 4;
+		postProcessing.createBlur(computeBlurs[ComputeDualFilter - 1], vks::PostProcessing::BlurType::DualFilter, offscreenPass.framebuffers[0].color.view, FB_DIM, FB_DIM, FB_COLOR_FORMAT, settings);
+		updateComputeBlurSettings();
+	}
+
+	void prepareProfiler()
+	{
+		VkQueryPipelineStatisticFlags pipelineStatistics = 0;
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		}
+		profiler.create(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 16, pipelineStatistics);
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		// Read the timings of earlier frames before their queries are reset by this submission
+		profiler.update();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		profiler.submitted(currentBuffer);
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -695,6 +842,8 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		prepareOffscreen();
+		prepareComputeBlurs();
+		prepareProfiler();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -708,6 +857,14 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		if (benchmark.active && computeBlurSupported) {
+			// Switch to the next blur mode every few hundred frames, the profiler summary then lists the passes of all modes
+			benchmarkFrame++;
+			if (benchmarkFrame % 300 == 0) {
+				blurMode = (blurMode + 1) % 3;
+				buildCommandBuffers();
+			}
+		}
 		if (!paused || camera.updated)
 		{
 			updateUniformBuffersScene();
@@ -722,6 +879,23 @@ public:
 			}
 			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
 				updateUniformBuffersBlur();
+				if (computeBlurSupported) {
+					// Compute blur settings are push constants, so they are only picked up by newly recorded command buffers
+					updateComputeBlurSettings();
+					buildCommandBuffers();
+				}
+			}
+			if (computeBlurSupported) {
+				const std::vector<std::string> blurModeNames = { "Fragment", "Compute Gaussian", "Compute dual filter" };
+				if (overlay->comboBox("Blur", &blurMode, blurModeNames)) {
+					buildCommandBuffers();
+				}
+			}
+		}
+		if (overlay->header("GPU timings")) {
+			profiler.onUpdateUIOverlay(overlay);
+			if (!profiler.isCapturing() && overlay->button("Capture trace")) {
+				profiler.captureTrace("bloom_gpu_trace.json", 60);
 			}
 		}
 	}
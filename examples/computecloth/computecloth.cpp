@@ -18,7 +18,6 @@ public:
 	uint32_t readSet = 0;
 	uint32_t indexCount;
 	bool simulateWind = false;
-	bool specializedComputeQueue = false;
 
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
@@ -136,28 +135,19 @@ public:
 		textureCloth.loadFromFile(getAssetPath() + "textures/vulkan_cloth_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
+	// Queue family ownership transfer of both storage buffers, the helpers skip the barriers if graphics and compute share a family
+	// Called with a zero destination access mask on the releasing queue and a zero source access mask on the acquiring queue
 	void addGraphicsToComputeBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
 	{
-		if (specializedComputeQueue) {
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.srcAccessMask = srcAccessMask;
-			bufferBarrier.dstAccessMask = dstAccessMask;
-			bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-			bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-
-			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			vkCmdPipelineBarrier(commandBuffer,
-				srcStageMask,
-				dstStageMask,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
-				0, nullptr);
+		const uint32_t graphicsFamily = vulkanDevice->queueFamilyIndices.graphics;
+		const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+		for (VkBuffer buffer : { compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer }) {
+			if (dstAccessMask == 0) {
+				vulkanDevice->cmdReleaseBuffer(commandBuffer, buffer, graphicsFamily, computeFamily, srcAccessMask, srcStageMask);
+			}
+			else {
+				vulkanDevice->cmdAcquireBuffer(commandBuffer, buffer, graphicsFamily, computeFamily, dstAccessMask, dstStageMask);
+			}
 		}
 	}
 
@@ -186,26 +176,15 @@ public:
 
 	void addComputeToGraphicsBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
 	{
-		if (specializedComputeQueue) {
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.srcAccessMask = srcAccessMask;
-			bufferBarrier.dstAccessMask = dstAccessMask;
-			bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-			bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				srcStageMask,
-				dstStageMask,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
-				0, nullptr);
+		const uint32_t graphicsFamily = vulkanDevice->queueFamilyIndices.graphics;
+		const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+		for (VkBuffer buffer : { compute.storageBuffers.input.buffer, compute.storageBuffers.output.buffer }) {
+			if (dstAccessMask == 0) {
+				vulkanDevice->cmdReleaseBuffer(commandBuffer, buffer, computeFamily, graphicsFamily, srcAccessMask, srcStageMask);
+			}
+			else {
+				vulkanDevice->cmdAcquireBuffer(commandBuffer, buffer, computeFamily, graphicsFamily, dstAccessMask, dstStageMask);
+			}
 		}
 	}
 
@@ -562,8 +541,8 @@ public:
 
 	void prepareCompute()
 	{
-		// Create a compute capable device queue
-		vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &compute.queue);
+		// The base class already fetched a queue of the compute family, fall back to the graphics queue if the families were forced to be shared
+		compute.queue = (vulkanDevice->queueFamilyIndices.compute == vulkanDevice->queueFamilyIndices.graphics) ? queue : computeQueue;
 
 		// Create compute pipeline
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
@@ -751,8 +730,6 @@ public:
 #ifdef DEBUG_FORCE_SHARED_GRAPHICS_COMPUTE_QUEUE
 		vulkanDevice->queueFamilyIndices.compute = vulkanDevice->queueFamilyIndices.graphics;
 #endif
-		// Check whether the compute queue family is distinct from the graphics queue family
-		specializedComputeQueue = vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute;
 		loadAssets();
 		prepareStorageBuffers();
 		prepareUniformBuffers();
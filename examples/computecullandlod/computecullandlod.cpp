@@ -29,9 +29,15 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool fixedFrustum = false;
 
+	// Generate the levels of detail at load time from a single mesh, set to false to use the hand-authored levels of detail stored in a separate model
+	bool generateLods = true;
+
 	// The model contains multiple versions of a single object with different levels of detail
 	vkglTF::Model lodModel;
 
+	// Index ranges for the levels of detail, the first one is the full detail mesh
+	std::vector<vkglTF::Primitive::Lod> lodLevels;
+
 	// Per-instance data block
 	struct InstanceData {
 		glm::vec3 pos;
@@ -243,7 +249,27 @@ public:
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		if (generateLods) {
+			// Any mesh can be used, the loader simplifies it to the requested ratios of the original triangle count
+			lodModel.lodSettings.ratios = { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+			lodModel.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, glTFLoadingFlags | vkglTF::FileLoadingFlags::OptimizeMeshes | vkglTF::FileLoadingFlags::GenerateLods);
+			for (auto node : lodModel.linearNodes) {
+				if (node->mesh) {
+					lodLevels = node->mesh->primitives[0]->lods;
+					break;
+				}
+			}
+		} else {
+			// Each node of this model contains one level of detail
+			lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
+			for (auto node : lodModel.nodes) {
+				lodLevels.push_back({ node->mesh->primitives[0]->firstIndex, node->mesh->primitives[0]->indexCount, 0.0f });
+			}
+		}
+		// The statistics in the compute shader are limited to a fixed number of levels
+		if (lodLevels.size() > MAX_LOD_LEVEL + 1) {
+			lodLevels.resize(MAX_LOD_LEVEL + 1);
+		}
 	}
 
 	void buildComputeCommandBuffer()
@@ -557,12 +583,12 @@ public:
 		};
 		std::vector<LOD> LODLevels;
 		uint32_t n = 0;
-		for (auto node : lodModel.nodes)
+		for (auto& lodLevel : lodLevels)
 		{
 			LOD lod;
-			lod.firstIndex = node->mesh->primitives[0]->firstIndex;	// First index for this LOD
-			lod.indexCount = node->mesh->primitives[0]->indexCount;	// Index count for this LOD
-			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
+			lod.firstIndex = lodLevel.firstIndex;	// First index for this LOD
+			lod.indexCount = lodLevel.indexCount;	// Index count for this LOD
+			lod.distance = 5.0f + n * 5.0f;			// Starting distance (to viewer) for this LOD
 			n++;
 			LODLevels.push_back(lod);
 		}
@@ -700,7 +726,7 @@ public:
 		specializationEntry.offset = 0;
 		specializationEntry.size = sizeof(uint32_t);
 
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		uint32_t specializationData = static_cast<uint32_t>(lodLevels.size()) - 1;
 
 		VkSpecializationInfo specializationInfo;
 		specializationInfo.mapEntryCount = 1;
@@ -843,8 +869,8 @@ public:
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
-			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
-				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
+			for (uint32_t i = 0; i < static_cast<uint32_t>(lodLevels.size()); i++) {
+				overlay->text("LOD %d: %d (%d tris, err. %.4f)", i, indirectStats.lodCount[i], lodLevels[i].indexCount / 3, lodLevels[i].error);
 			}
 		}
 	}
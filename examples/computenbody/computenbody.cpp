@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanGpuProfiler.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -22,6 +23,20 @@ class VulkanExample : public VulkanExampleBase
 public:
 	uint32_t numParticles;
 
+	// Simulation steps are submitted to the compute queue while the previous step is drawn, set to false to serialize them for comparison
+	bool asyncCompute = true;
+	// Number of frames submitted to the graphics queue, simulation step n is drawn by frame n
+	uint64_t frameIndex = 0;
+	// With timeline semaphores, the graphics and compute submissions wait on the step or frame number they depend on
+	bool timelineSemaphores = false;
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+
+	vks::GpuProfiler graphicsProfiler;
+	vks::GpuProfiler computeProfiler;
+	// Recent compute results for measuring how much of a graphics frame ran concurrently with the simulation
+	std::array<vks::GpuProfiler::FrameResult, 4> computeResults;
+	double overlap = 0.0;
+
 	struct {
 		vks::Texture2D particle;
 		vks::Texture2D gradient;
@@ -41,7 +56,9 @@ public:
 		VkDescriptorSet descriptorSet;				// Particle system rendering shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkPipeline pipeline;						// Particle rendering pipeline
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<vks::Buffer, 2> particleBuffers;	// Vertex buffers written alternately by the simulation, so one can be drawn while the next step is computed
+		VkSemaphore timeline = VK_NULL_HANDLE;		// Timeline semaphore counting the finished frames
+		std::array<VkSemaphore, 2> semaphores{};	// Fallback without timeline semaphores, signaled by the frame that last drew the particle buffer of the same index
 		struct {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -52,12 +69,14 @@ public:
 	// Resources for the compute part of the example
 	struct {
 		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
-		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles
+		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles, only accessed by the compute queue
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing particle system parameters
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<VkCommandBuffer, 2> commandBuffers;	// Simulation step and copy into the particle buffer of the same index
+		VkSemaphore timeline = VK_NULL_HANDLE;		// Timeline semaphore counting the finished simulation steps
+		VkSemaphore semaphore = VK_NULL_HANDLE;		// Fallback without timeline semaphores, signaled by each simulation step
+		std::array<VkFence, 2> fences{};			// Fallback without timeline semaphores, signaled by the command buffer of the same index
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
@@ -87,6 +106,8 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		// Required by VK_KHR_timeline_semaphore on Vulkan 1.0
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	}
 
 	~VulkanExample()
@@ -96,7 +117,13 @@ public:
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
-		vkDestroySemaphore(device, graphics.semaphore, nullptr);
+		for (auto& particleBuffer : graphics.particleBuffers) {
+			particleBuffer.destroy();
+		}
+		vkDestroySemaphore(device, graphics.timeline, nullptr);
+		for (auto& semaphore : graphics.semaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
 
 		// Compute
 		compute.storageBuffer.destroy();
@@ -105,9 +132,22 @@ public:
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
+		vkDestroySemaphore(device, compute.timeline, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
+		for (auto& fence : compute.fences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
+		if (benchmark.active) {
+			std::cout << "Graphics queue:" << std::endl;
+			graphicsProfiler.printSummary();
+			std::cout << "Compute queue:" << std::endl;
+			computeProfiler.printSummary();
+		}
+		graphicsProfiler.destroy();
+		computeProfiler.destroy();
+
 		textures.particle.destroy();
 		textures.gradient.destroy();
 	}
@@ -118,8 +158,12 @@ public:
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void buildCommandBuffers()
+	// Records the frame that draws the particle buffer written by the simulation step of the same number
+	void recordCommandBuffer(uint32_t index, uint64_t frame)
 	{
+		const uint32_t bufferIndex = static_cast<uint32_t>(frame % 2);
+		vks::Buffer &particleBuffer = graphics.particleBuffers[bufferIndex];
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -134,180 +178,135 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[index], &cmdBufInfo));
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		graphicsProfiler.cmdBeginFrame(drawCmdBuffers[index], index);
 
-			// Acquire barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
-					graphics.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+		// Acquire the particle buffer from the compute queue (no-op if the queue families are the same)
+		vulkanDevice->cmdAcquireBuffer(drawCmdBuffers[index], particleBuffer.buffer, compute.queueFamilyIndex, graphics.queueFamilyIndex, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-			// Draw the particle system using the update vertex buffer
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Draw the particle system using the update vertex buffer
+		vkCmdBeginRenderPass(drawCmdBuffers[index], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(drawCmdBuffers[index], 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(drawCmdBuffers[index], 0, 1, &scissor);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
+		graphicsProfiler.cmdBeginZone(drawCmdBuffers[index], "Particles");
+		vkCmdBindPipeline(drawCmdBuffers[index], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+		vkCmdBindDescriptorSets(drawCmdBuffers[index], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], numParticles, 1, 0, 0);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(drawCmdBuffers[index], VERTEX_BUFFER_BIND_ID, 1, &particleBuffer.buffer, offsets);
+		vkCmdDraw(drawCmdBuffers[index], numParticles, 1, 0, 0);
+		graphicsProfiler.cmdEndZone(drawCmdBuffers[index]);
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(drawCmdBuffers[index]);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(drawCmdBuffers[index]);
 
-			// Release barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					0,
-					graphics.queueFamilyIndex,
-					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+		// Release the particle buffer to the compute queue, which writes the step after next into it
+		vulkanDevice->cmdReleaseBuffer(drawCmdBuffers[index], particleBuffer.buffer, graphics.queueFamilyIndex, compute.queueFamilyIndex, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		graphicsProfiler.cmdEndFrame(drawCmdBuffers[index]);
 
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[index]));
 	}
 
-	void buildComputeCommandBuffer()
+	void buildCommandBuffers()
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		// The command buffer of the next frame is recorded again in draw() as the particle buffer alternates between frames
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			recordCommandBuffer(i, frameIndex);
+		}
+	}
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
+	void buildComputeCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		// Acquire barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		for (uint32_t i = 0; i < static_cast<uint32_t>(compute.commandBuffers.size()); i++)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			VkCommandBuffer commandBuffer = compute.commandBuffers[i];
+			vks::Buffer &particleBuffer = graphics.particleBuffers[i];
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
+			computeProfiler.cmdBeginFrame(commandBuffer, i);
+
+			// The previous step (submitted earlier to the same queue) has to finish writing and copying the particles
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.buffer = compute.storageBuffer.buffer;
+			bufferBarrier.size = compute.storageBuffer.descriptor.range;
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
+				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				1, &bufferBarrier,
 				0, nullptr);
-		}
 
-		// First pass: Calculate particle movement
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
-
-		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = compute.storageBuffer.buffer;
-		bufferBarrier.size = compute.storageBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		// Transfer ownership if compute and graphics queue family indices differ
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		vkCmdPipelineBarrier(
-			compute.commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			0, nullptr,
-			1, &bufferBarrier,
-			0, nullptr);
-
-		// Second pass: Integrate particles
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
-
-		// Release barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			// First pass: Calculate particle movement
+			// -------------------------------------------------------------------------------------------------------
+			computeProfiler.cmdBeginZone(commandBuffer, "Calculate");
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+			vkCmdDispatch(commandBuffer, numParticles / 256, 1, 1);
+			computeProfiler.cmdEndZone(commandBuffer);
+
+			// Add memory barrier to ensure that the computer shader has finished writing to the buffer
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
 
+			// Second pass: Integrate particles
+			// -------------------------------------------------------------------------------------------------------
+			computeProfiler.cmdBeginZone(commandBuffer, "Integrate");
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+			vkCmdDispatch(commandBuffer, numParticles / 256, 1, 1);
+			computeProfiler.cmdEndZone(commandBuffer);
+
+			// Copy the result into the particle buffer that is drawn by the graphics queue
+			// Only the copy has to wait for the graphics queue to release that buffer, the dispatches can run alongside the previous frame
+			computeProfiler.cmdBeginZone(commandBuffer, "Copy");
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				1, &bufferBarrier,
 				0, nullptr);
-		}
+			vulkanDevice->cmdAcquireBuffer(commandBuffer, particleBuffer.buffer, graphics.queueFamilyIndex, compute.queueFamilyIndex, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, particleBuffer.buffer, 1, &copyRegion);
+			vulkanDevice->cmdReleaseBuffer(commandBuffer, particleBuffer.buffer, compute.queueFamilyIndex, graphics.queueFamilyIndex, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			computeProfiler.cmdEndZone(commandBuffer);
 
-		vkEndCommandBuffer(compute.commandBuffer);
+			computeProfiler.cmdEndFrame(commandBuffer);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
@@ -386,42 +385,33 @@ public:
 			storageBufferSize,
 			particleBuffer.data());
 
+		// The simulation state is only accessed by the compute queue, so it's uploaded there and never changes ownership
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.storageBuffer,
 			storageBufferSize);
 
+		// Each simulation step is copied into one of two vertex buffers for drawing
+		for (auto& particleBuffer : graphics.particleBuffers) {
+			vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&particleBuffer,
+				storageBufferSize);
+		}
+
 		// Copy from staging buffer to storage buffer
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
 		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
-		// Execute a transfer barrier to the compute queue, if necessary
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-				0,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+		vulkanDevice->flushCommandBuffer(copyCmd, compute.queue, compute.commandPool, true);
 
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+		// The compute command buffers start by acquiring the particle buffers from the graphics queue, so the first acquires need matching releases
+		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& particleBuffer : graphics.particleBuffers) {
+			vulkanDevice->cmdReleaseBuffer(copyCmd, particleBuffer.buffer, graphics.queueFamilyIndex, compute.queueFamilyIndex, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
@@ -617,26 +607,26 @@ public:
 		preparePipelines();
 		setupDescriptorSet();
 
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
-
-		// Signal the semaphore
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &graphics.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		// Semaphores for compute & graphics sync
+		if (timelineSemaphores) {
+			graphics.timeline = vulkanDevice->createTimelineSemaphore(0);
+		}
+		else {
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			for (auto& semaphore : graphics.semaphores) {
+				VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+			}
+			// The first two simulation steps wait on these, signal them as no frame has drawn the particle buffers yet
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(graphics.semaphores.size());
+			submitInfo.pSignalSemaphores = graphics.semaphores.data();
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		}
 	}
 
 	void prepareCompute()
 	{
-		// Create a compute capable device queue
-		// The VulkanDevice::createLogicalDevice functions finds a compute capable queue and prefers queue families that only support compute
-		// Depending on the implementation this may result in different queue family indices for graphics and computes,
-		// requiring proper synchronization (see the memory barriers in buildComputeCommandBuffer)
-		vkGetDeviceQueue(device, compute.queueFamilyIndex, 0, &compute.queue);
-
 		// Create compute pipeline
 		// Compute pipelines are created separate from graphics pipelines even if they use the same queue (family index)
 
@@ -729,76 +719,28 @@ public:
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
-		// Separate command pool as queue family for compute may be different than graphics
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = compute.queueFamilyIndex;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
-
-		// Create a command buffer for compute operations
-		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
-
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
-
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
-
-		// SRS - By reordering compute and graphics within draw(), the following code is no longer needed:
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
-		/*
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			// Create a transient command buffer for setting up the initial buffer transfer state
-			VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+		// Command buffers for both particle buffers
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(compute.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(compute.commandBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, compute.commandBuffers.data()));
 
-			VkBufferMemoryBarrier acquire_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &acquire_buffer_barrier,
-				0, nullptr);
+		// Semaphores for compute & graphics sync
+		if (timelineSemaphores) {
+			compute.timeline = vulkanDevice->createTimelineSemaphore(0);
+		}
+		else {
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+			// Signaled, so waiting for the previous step works for the first one too
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			for (auto& fence : compute.fences) {
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+			}
+		}
 
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
+		// Timestamps of the compute queue are taken with their own query pools, one per command buffer
+		computeProfiler.create(vulkanDevice, static_cast<uint32_t>(compute.commandBuffers.size()), 8, 0, compute.queueFamilyIndex);
 
-			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
-		}
-		*/
+		buildComputeCommandBuffers();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -842,29 +784,111 @@ public:
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
-	void draw()
+	// Submits the simulation step that writes the particle buffer drawn by the frame of the same number
+	void submitCompute(uint64_t step)
 	{
-		// Wait for rendering finished
-		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		const uint32_t index = static_cast<uint32_t>(step % 2);
+
+		// The uniform buffer and the profiler queries are shared with the previous step, which may still be running
+		if (timelineSemaphores) {
+			VK_CHECK_RESULT(vulkanDevice->waitTimelineSemaphore(compute.timeline, step));
+		}
+		else {
+			VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(compute.fences.size()), compute.fences.data(), VK_TRUE, UINT64_MAX));
+			VK_CHECK_RESULT(vkResetFences(device, 1, &compute.fences[index]));
+		}
+		updateComputeUniformBuffers();
+		computeProfiler.update();
 
-		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[index];
 		computeSubmitInfo.waitSemaphoreCount = 1;
-		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
-		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
-		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
 
+		if (timelineSemaphores) {
+			// The step writes the buffer drawn two frames earlier, so with async compute it only has to wait for that frame
+			// Otherwise it waits for the frame submitted just before it and the queues take turns
+			const uint64_t waitValue = asyncCompute ? (step > 0 ? step - 1 : 0) : step;
+			const uint64_t signalValue = step + 1;
+			VkPipelineStageFlags waitStageMask = asyncCompute ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.waitSemaphoreValueCount = 1;
+			timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+			computeSubmitInfo.pNext = &timelineSubmitInfo;
+			computeSubmitInfo.pWaitSemaphores = &graphics.timeline;
+			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+			computeSubmitInfo.pSignalSemaphores = &compute.timeline;
+			VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		}
+		else {
+			// Binary semaphores are signaled by the frame that last drew the particle buffer, only the copy into it has to wait
+			VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			computeSubmitInfo.pWaitSemaphores = &graphics.semaphores[index];
+			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+			computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, compute.fences[index]));
+		}
+
+		computeProfiler.submitted(index);
+	}
+
+	// Sums up how long the latest graphics frame ran at the same time as the recent simulation steps on the device
+	void updateOverlap()
+	{
+		const vks::GpuProfiler::FrameResult &computeResult = computeProfiler.getLatestResult();
+		if ((computeResult.frame != 0) && (computeResult.frame != computeResults[0].frame)) {
+			std::rotate(computeResults.rbegin(), computeResults.rbegin() + 1, computeResults.rend());
+			computeResults[0] = computeResult;
+		}
+		const vks::GpuProfiler::FrameResult &graphicsResult = graphicsProfiler.getLatestResult();
+		if (graphicsResult.frame == 0) {
+			return;
+		}
+		overlap = 0.0;
+		for (auto& result : computeResults) {
+			if (result.frame == 0) {
+				continue;
+			}
+			const double begin = std::max(graphicsResult.start, result.start);
+			const double end = std::min(graphicsResult.start + graphicsResult.duration, result.start + result.duration);
+			if (end > begin) {
+				overlap += end - begin;
+			}
+		}
+	}
+
+	void draw()
+	{
 		VulkanExampleBase::prepareFrame();
 
+		graphicsProfiler.update();
+		// The particle buffer alternates between frames, submitFrame waits for the graphics queue so the command buffer is free to record
+		recordCommandBuffer(currentBuffer, frameIndex);
+
+		// Wait for the simulation step of this frame before reading the vertices, and for the swap chain image before writing to it
 		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
-		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
+		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphores[frameIndex % 2], semaphores.renderComplete };
+		// Values of the binary semaphores in the same arrays are ignored
+		uint64_t waitValues[] = { frameIndex + 1, 0 };
+		uint64_t signalValues[] = { frameIndex + 1, 0 };
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		if (timelineSemaphores) {
+			graphicsWaitSemaphores[0] = compute.timeline;
+			graphicsSignalSemaphores[0] = graphics.timeline;
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.waitSemaphoreValueCount = 2;
+			timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+			timelineSubmitInfo.signalSemaphoreValueCount = 2;
+			timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+		}
 
 		// Submit graphics commands
+		submitInfo.pNext = timelineSemaphores ? &timelineSubmitInfo : nullptr;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		submitInfo.waitSemaphoreCount = 2;
@@ -873,8 +897,28 @@ public:
 		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		submitInfo.pNext = nullptr;
+
+		graphicsProfiler.submitted(currentBuffer);
+
+		// Start the next simulation step before presenting, so it can run while this frame is drawn
+		submitCompute(frameIndex + 1);
 
 		VulkanExampleBase::submitFrame();
+		frameIndex++;
+
+		updateOverlap();
+	}
+
+	void getEnabledExtensions()
+	{
+		// Timeline semaphores let both queues wait for a specific frame or step, without them the example falls back to binary semaphores and fences
+		if (vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		}
 	}
 
 	void prepare()
@@ -884,11 +928,23 @@ public:
 		// If that's the case, we need additional barriers for acquiring and releasing resources
 		graphics.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
 		compute.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+		// The base class requests a compute queue, preferring a family without graphics support if the implementation offers one
+		compute.queue = computeQueue;
+		// Separate command pool as queue family for compute may be different than graphics
+		compute.commandPool = vulkanDevice->createCommandPool(compute.queueFamilyIndex);
+		timelineSemaphores = vulkanDevice->timelineSemaphores;
+		if (!timelineSemaphores) {
+			// The binary semaphore fallback always lets the simulation run alongside the previous frame
+			asyncCompute = true;
+		}
+		graphicsProfiler.create(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 4);
 		loadAssets();
 		setupDescriptorPool();
 		prepareGraphics();
 		prepareCompute();
 		buildCommandBuffers();
+		// The first frame draws the result of step zero
+		submitCompute(0);
 		prepared = true;
 	}
 
@@ -897,7 +953,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		updateComputeUniformBuffers();
 		if (camera.updated) {
 			updateGraphicsUniformBuffers();
 		}
@@ -907,6 +962,31 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (timelineSemaphores) {
+				overlay->checkBox("Async compute", &asyncCompute);
+			}
+			else {
+				overlay->text("Async compute (no timeline semaphores)");
+			}
+			if (compute.queueFamilyIndex != graphics.queueFamilyIndex) {
+				overlay->text("Compute queue family: %d (graphics: %d)", compute.queueFamilyIndex, graphics.queueFamilyIndex);
+			}
+			else {
+				overlay->text("Compute queue family: %d (shared with graphics)", compute.queueFamilyIndex);
+			}
+			overlay->text("Overlap: %.3f ms", overlap);
+		}
+		if (overlay->header("Graphics queue timings")) {
+			graphicsProfiler.onUpdateUIOverlay(overlay);
+		}
+		if (overlay->header("Compute queue timings")) {
+			computeProfiler.onUpdateUIOverlay(overlay);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
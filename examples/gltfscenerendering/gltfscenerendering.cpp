@@ -14,6 +14,12 @@
 
 #include "gltfscenerendering.h"
 
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include "threadpool.hpp"
+
 /*
 	Vulkan glTF scene class
 */
@@ -34,8 +40,8 @@ VulkanglTFScene::~VulkanglTFScene()
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
-	for (Material material : materials) {
-		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
+	for (VkPipeline pipeline : pipelines) {
+		vkDestroyPipeline(vulkanDevice->logicalDevice, pipeline, nullptr);
 	}
 }
 
@@ -280,6 +286,52 @@ void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 	}
 }
 
+// Flatten the visible part of the node hierarchy into a list of draws, in the same order as drawNode
+void VulkanglTFScene::gatherDrawItems(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, std::vector<DrawItem>& drawItems)
+{
+	if (!node->visible) {
+		return;
+	}
+	const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+	for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
+		if (primitive.indexCount > 0) {
+			drawItems.push_back({ nodeMatrix, &primitive });
+		}
+	}
+	for (auto& child : node->children) {
+		gatherDrawItems(child, nodeMatrix, drawItems);
+	}
+}
+
+void VulkanglTFScene::bindBuffers(VkCommandBuffer commandBuffer)
+{
+	VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+// Draw a range of the draw list, called from multiple threads with different command buffers
+void VulkanglTFScene::drawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<DrawItem>& drawItems, uint32_t first, uint32_t count)
+{
+	const glm::mat4* currentMatrix = nullptr;
+	VkPipeline currentPipeline = VK_NULL_HANDLE;
+	for (uint32_t i = first; i < first + count; i++) {
+		const DrawItem& drawItem = drawItems[i];
+		// Primitives of the same node share the matrix
+		if ((currentMatrix == nullptr) || (*currentMatrix != drawItem.matrix)) {
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &drawItem.matrix);
+			currentMatrix = &drawItem.matrix;
+		}
+		const VulkanglTFScene::Material& material = materials[drawItem.primitive->materialIndex];
+		if (material.pipeline != currentPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+			currentPipeline = material.pipeline;
+		}
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+		vkCmdDrawIndexed(commandBuffer, drawItem.primitive->indexCount, 1, drawItem.primitive->firstIndex, 0, 0);
+	}
+}
+
 /*
 	Vulkan Example class
 */
@@ -292,6 +344,9 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
 	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	// The scene is recorded into secondary command buffers, so the UI can't be drawn inline in the same render pass
+	separateOverlay.enabled = true;
+	recordingThreads = static_cast<int32_t>(std::thread::hardware_concurrency());
 }
 
 VulkanExample::~VulkanExample()
@@ -328,23 +383,74 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	if (recordingThreads > 0) {
+		drawItems.clear();
+		for (auto& node : glTFScene.nodes) {
+			glTFScene.gatherDrawItems(node, glm::mat4(1.0f), drawItems);
+		}
+	}
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-		// POI: Draw the glTF scene
-		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+		if (recordingThreads > 0) {
+			// The draws are split across worker threads that record them into secondary command buffers
+			// These don't inherit any state, so each one binds the buffers and sets everything it needs
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			parallelRecorder.beginFrame(i);
+			parallelRecorder.record(i, drawCmdBuffers[i], renderPass, 0, frameBuffers[i], static_cast<uint32_t>(drawItems.size()), [&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) {
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				glTFScene.bindBuffers(commandBuffer);
+				glTFScene.drawItems(commandBuffer, pipelineLayout, drawItems, first, count);
+			});
+		}
+		else {
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			// Bind scene matrices descriptor to set 0
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			// POI: Draw the glTF scene
+			glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+		}
 
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
+
+	recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+// Records all command buffers a number of times for every thread count up to the number of hardware threads
+void VulkanExample::measureRecordingTimes()
+{
+	const int32_t previousThreads = recordingThreads;
+	const uint32_t iterations = 16;
+	vkDeviceWaitIdle(device);
+	recordingTimings.clear();
+	const int32_t maxThreads = static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+	for (int32_t threads = 0; threads <= maxThreads; threads = (threads == 0) ? 1 : threads * 2) {
+		recordingThreads = threads;
+		if (threads > 0) {
+			parallelRecorder.setThreadCount(threads);
+		}
+		double totalTime = 0.0;
+		for (uint32_t i = 0; i < iterations; i++) {
+			buildCommandBuffers();
+			totalTime += recordTime;
+		}
+		recordingTimings.push_back(std::make_pair(threads, totalTime / iterations));
+	}
+	recordingThreads = previousThreads;
+	parallelRecorder.setThreadCount(std::max(recordingThreads, 1));
+	buildCommandBuffers();
 }
 
 void VulkanExample::loadglTFFile(std::string filename)
@@ -571,30 +677,94 @@ void VulkanExample::preparePipelines()
 	shaderStages[0] = loadShader(getShadersPath() + "gltfscenerendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "gltfscenerendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	// POI: Instead if using a few fixed pipelines, we create one pipeline for each material using the properties of that material
-	for (auto &material : glTFScene.materials) {
+	auto tStart = std::chrono::high_resolution_clock::now();
 
-		struct MaterialSpecializationData {
-			VkBool32 alphaMask;
-			float alphaMaskCutoff;
-		} materialSpecializationData;
+	struct MaterialSpecializationData {
+		VkBool32 alphaMask;
+		float alphaMaskCutoff;
+	};
 
-		materialSpecializationData.alphaMask = material.alphaMode == "MASK";
-		materialSpecializationData.alphaMaskCutoff = material.alphaCutOff;
+	// POI: Constant fragment shader material parameters will be set using specialization constants
+	const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+		vks::initializers::specializationMapEntry(0, offsetof(MaterialSpecializationData, alphaMask), sizeof(MaterialSpecializationData::alphaMask)),
+		vks::initializers::specializationMapEntry(1, offsetof(MaterialSpecializationData, alphaMaskCutoff), sizeof(MaterialSpecializationData::alphaMaskCutoff)),
+	};
 
-		// POI: Constant fragment shader material parameters will be set using specialization constants
-		std::vector<VkSpecializationMapEntry> specializationMapEntries = {
-			vks::initializers::specializationMapEntry(0, offsetof(MaterialSpecializationData, alphaMask), sizeof(MaterialSpecializationData::alphaMask)),
-			vks::initializers::specializationMapEntry(1, offsetof(MaterialSpecializationData, alphaMaskCutoff), sizeof(MaterialSpecializationData::alphaMaskCutoff)),
-		};
-		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(materialSpecializationData), &materialSpecializationData);
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
+	// All state that differs between materials, materials with the same key share a pipeline
+	struct PipelineKey {
+		VkBool32 alphaMask;
+		float alphaMaskCutoff;
+		bool doubleSided;
+		bool operator<(const PipelineKey& other) const {
+			if (alphaMask != other.alphaMask) return alphaMask < other.alphaMask;
+			if (alphaMaskCutoff != other.alphaMaskCutoff) return alphaMaskCutoff < other.alphaMaskCutoff;
+			return doubleSided < other.doubleSided;
+		}
+	};
+
+	// POI: Instead if using a few fixed pipelines, we create one pipeline for each distinct set of material properties
+	std::map<PipelineKey, uint32_t> pipelineIndices;
+	std::vector<PipelineKey> pipelineKeys;
+	std::vector<uint32_t> materialPipelines(glTFScene.materials.size());
+	for (size_t i = 0; i < glTFScene.materials.size(); i++) {
+		const VulkanglTFScene::Material& material = glTFScene.materials[i];
+		PipelineKey key;
+		key.alphaMask = material.alphaMode == "MASK";
+		// The cutoff is only read for masked materials, so it must not split opaque materials into different pipelines
+		key.alphaMaskCutoff = key.alphaMask ? material.alphaCutOff : 0.0f;
+		key.doubleSided = material.doubleSided;
+		auto it = pipelineIndices.find(key);
+		if (it == pipelineIndices.end()) {
+			it = pipelineIndices.insert(std::make_pair(key, static_cast<uint32_t>(pipelineKeys.size()))).first;
+			pipelineKeys.push_back(key);
+		}
+		materialPipelines[i] = it->second;
+	}
 
+	// Every unique pipeline gets its own copy of the state that differs, so they can be created independently
+	const size_t pipelineCount = pipelineKeys.size();
+	std::vector<MaterialSpecializationData> specializationData(pipelineCount);
+	std::vector<VkSpecializationInfo> specializationInfos(pipelineCount);
+	std::vector<VkPipelineRasterizationStateCreateInfo> rasterizationStateCIs(pipelineCount, rasterizationStateCI);
+	std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> pipelineShaderStages(pipelineCount, shaderStages);
+	std::vector<VkGraphicsPipelineCreateInfo> pipelineCIs(pipelineCount, pipelineCI);
+	for (size_t i = 0; i < pipelineCount; i++) {
+		specializationData[i].alphaMask = pipelineKeys[i].alphaMask;
+		specializationData[i].alphaMaskCutoff = pipelineKeys[i].alphaMaskCutoff;
+		specializationInfos[i] = vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(MaterialSpecializationData), &specializationData[i]);
+		pipelineShaderStages[i][1].pSpecializationInfo = &specializationInfos[i];
 		// For double sided materials, culling will be disabled
-		rasterizationStateCI.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+		rasterizationStateCIs[i].cullMode = pipelineKeys[i].doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+		pipelineCIs[i].pRasterizationState = &rasterizationStateCIs[i];
+		pipelineCIs[i].pStages = pipelineShaderStages[i].data();
+	}
+
+	// Pipeline caches are internally synchronized, so all threads compile into the shared cache
+	glTFScene.pipelines.resize(pipelineCount);
+	const uint32_t threadCount = static_cast<uint32_t>(std::min<size_t>(pipelineCount, std::max(1u, std::thread::hardware_concurrency())));
+	if (threadCount > 1) {
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (uint32_t t = 0; t < threadCount; t++) {
+			const uint32_t first = static_cast<uint32_t>(pipelineCount * t / threadCount);
+			const uint32_t last = static_cast<uint32_t>(pipelineCount * (t + 1) / threadCount);
+			threadPool.threads[t]->addJob([this, first, last, &pipelineCIs] {
+				VKS_PROFILE_ZONE("Create material pipelines");
+				VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, last - first, &pipelineCIs[first], nullptr, &glTFScene.pipelines[first]));
+			});
+		}
+		threadPool.wait();
+	}
+	else if (pipelineCount > 0) {
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, static_cast<uint32_t>(pipelineCount), pipelineCIs.data(), nullptr, glTFScene.pipelines.data()));
+	}
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
+	for (size_t i = 0; i < glTFScene.materials.size(); i++) {
+		glTFScene.materials[i].pipeline = glTFScene.pipelines[materialPipelines[i]];
 	}
+
+	const double pipelineTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	std::cout << "Created " << pipelineCount << " unique pipelines for " << glTFScene.materials.size() << " materials on " << threadCount << " thread(s) in " << pipelineTime << " ms" << std::endl;
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -619,6 +789,7 @@ void VulkanExample::updateUniformBuffers()
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
+	parallelRecorder.setThreadCount(std::max(recordingThreads, 1));
 	loadAssets();
 	prepareUniformBuffers();
 	setupDescriptors();
@@ -642,6 +813,31 @@ void VulkanExample::viewChanged()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
+	if (overlay->header("Command buffers")) {
+		if (overlay->sliderInt("Threads", &recordingThreads, 0, static_cast<int32_t>(std::thread::hardware_concurrency()))) {
+			if (recordingThreads > 0) {
+				parallelRecorder.setThreadCount(recordingThreads);
+			}
+			buildCommandBuffers();
+		}
+		if (recordingThreads > 0) {
+			overlay->text("Recording: %.3f ms (%d draws)", recordTime, (int32_t)drawItems.size());
+		}
+		else {
+			overlay->text("Recording: %.3f ms", recordTime);
+		}
+		if (overlay->button("Measure")) {
+			measureRecordingTimes();
+		}
+		for (auto& timing : recordingTimings) {
+			if (timing.first == 0) {
+				overlay->text("Inline: %.3f ms", timing.second);
+			}
+			else {
+				overlay->text("%d threads: %.3f ms (%.2fx)", timing.first, timing.second, recordingTimings[0].second / timing.second);
+			}
+		}
+	}
 	if (overlay->header("Visibility")) {
 
 		if (overlay->button("All")) {
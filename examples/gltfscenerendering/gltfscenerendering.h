@@ -97,6 +97,7 @@ public:
 		float alphaCutOff;
 		bool doubleSided = false;
 		VkDescriptorSet descriptorSet;
+		// May be shared with other materials that have the same pipeline state, owned by the scene
 		VkPipeline pipeline;
 	};
 
@@ -119,6 +120,14 @@ public:
 	std::vector<Texture> textures;
 	std::vector<Material> materials;
 	std::vector<Node*> nodes;
+	// Unique pipelines referenced by the materials
+	std::vector<VkPipeline> pipelines;
+
+	// A visible primitive with the final matrix of its node, used to split the scene's draws across threads
+	struct DrawItem {
+		glm::mat4 matrix;
+		const Primitive* primitive;
+	};
 
 	std::string path;
 
@@ -130,6 +139,9 @@ public:
 	void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
 	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node);
 	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void gatherDrawItems(VulkanglTFScene::Node* node, const glm::mat4& parentMatrix, std::vector<DrawItem>& drawItems);
+	void bindBuffers(VkCommandBuffer commandBuffer);
+	void drawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const std::vector<DrawItem>& drawItems, uint32_t first, uint32_t count);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -155,10 +167,19 @@ public:
 		VkDescriptorSetLayout textures;
 	} descriptorSetLayouts;
 
+	// Number of threads recording secondary command buffers, 0 records the scene directly into the primary command buffers
+	int32_t recordingThreads = 0;
+	std::vector<VulkanglTFScene::DrawItem> drawItems;
+	// CPU time for recording all command buffers in milliseconds
+	double recordTime = 0.0;
+	// Average recording time by thread count
+	std::vector<std::pair<int32_t, double>> recordingTimings;
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
 	void buildCommandBuffers();
+	void measureRecordingTimes();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void setupDescriptors();
@@ -1,6 +1,9 @@
 /*
  * Vulkan Example - Using mesh shaders
  *
+ * Renders a glTF model split into meshlets (see VulkanMeshlet.h), a task shader culls meshlets against the view frustum
+ * and their normal cones and only launches mesh shader workgroups for the visible ones
+ *
  * Copyright (C) 2022 by Sascha Willems - www.saschawillems.de
  *
  * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,22 +11,64 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
+// Number of meshlets processed by a single task shader workgroup, must match the task shader's local size
+#define TASK_GROUP_SIZE 32
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	vkglTF::Model model;
+
+	bool renderMeshlets = true;
+	// False if the meshlet shaders have not been compiled, only the single triangle is rendered then
+	bool meshletsSupported = true;
+	bool frustumCulling = true;
+	bool coneCulling = true;
+	bool colorMeshlets = true;
+
+	// Only the first three members are used by the single triangle pipeline
 	struct UniformData {
 		glm::mat4 projection;
 		glm::mat4 model;
 		glm::mat4 view;
+		// Culling is done in model space, so planes and camera position are transformed by the inverse model matrix
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPos;
+		uint32_t meshletCount;
+		uint32_t vertexStride;
+		uint32_t frustumCulling;
+		uint32_t coneCulling;
+		uint32_t colorMeshlets;
 	} uniformData;
 	vks::Buffer uniformBuffer;
 
-	uint32_t indexCount;
-
-	VkPipeline pipeline;
+	// Meshlet data generated by the glTF loader, see vks::meshlet::MeshletSet
+	struct MeshletBuffers {
+		vks::Buffer meshlets;
+		vks::Buffer bounds;
+		vks::Buffer vertices;
+		vks::Buffer triangles;
+	} meshletBuffers;
+
+	vks::Frustum frustum;
+
+	// CPU side culling results for the current view, used for statistics and to compare against the task shader
+	vks::meshlet::CullStatistics cullStatistics;
+	vks::meshlet::Statistics meshletStatistics;
+	struct CpuBenchmark {
+		uint32_t iterations = 1000;
+		double averageTime = 0.0;
+		double meshletsPerSecond = 0.0;
+	} cpuBenchmark;
+
+	struct Pipelines {
+		VkPipeline triangle;
+		VkPipeline meshlets = VK_NULL_HANDLE;
+	} pipelines;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -38,8 +83,8 @@ public:
 		timerSpeed *= 0.25f;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
-		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
-		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
+		camera.setRotation(glm::vec3(-25.0f, 23.75f, 0.0f));
+		camera.setTranslation(glm::vec3(0.0f, 0.0f, -3.0f));
 
 		// Extension require at least Vulkan 1.1
 		apiVersion = VK_API_VERSION_1_1;
@@ -55,10 +100,15 @@ public:
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, pipelines.triangle, nullptr);
+		vkDestroyPipeline(device, pipelines.meshlets, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBuffer.destroy();
+		meshletBuffers.meshlets.destroy();
+		meshletBuffers.bounds.destroy();
+		meshletBuffers.vertices.destroy();
+		meshletBuffers.triangles.destroy();
 	}
 
 	void getEnabledFeatures()
@@ -70,6 +120,47 @@ public:
 		deviceCreatepNextChain = &enabledMeshShaderFeatures;
 	}
 
+	// Uploads the contents of a host vector to a device local storage buffer
+	template <typename T>
+	void createStorageBuffer(vks::Buffer& buffer, const std::vector<T>& data)
+	{
+		vks::Buffer stagingBuffer;
+		const VkDeviceSize bufferSize = std::max(data.size() * sizeof(T), sizeof(T));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, bufferSize, data.empty() ? nullptr : (void*)data.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, bufferSize));
+		vulkanDevice->copyBuffer(&stagingBuffer, &buffer, queue);
+		stagingBuffer.destroy();
+	}
+
+	void loadAssets()
+	{
+		// The mesh shader fetches vertices from the model's vertex buffer, so it needs to be usable as a storage buffer
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		// The loader reorders the triangles for vertex locality before splitting them into meshlets, which results in better filled meshlets
+		// Y is flipped via the model matrix instead of vkglTF::FileLoadingFlags::FlipY, as that would also flip the winding used to calculate the normal cones
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::OptimizeMeshes | vkglTF::FileLoadingFlags::BuildMeshlets;
+		model.loadFromFile(getAssetPath() + "models/chinesedragon.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		createStorageBuffer(meshletBuffers.meshlets, model.meshlets.meshlets);
+		createStorageBuffer(meshletBuffers.bounds, model.meshlets.bounds);
+		createStorageBuffer(meshletBuffers.vertices, model.meshlets.vertices);
+		createStorageBuffer(meshletBuffers.triangles, model.meshlets.triangles);
+
+		meshletStatistics = vks::meshlet::getStatistics(model.meshlets);
+	}
+
+	// Runs the same culling as the task shader on the CPU several times to get a stable timing
+	void runCpuCullingBenchmark()
+	{
+		double totalTime = 0.0;
+		for (uint32_t i = 0; i < cpuBenchmark.iterations; i++) {
+			totalTime += vks::meshlet::cull(model.meshlets, uniformData.frustumPlanes, glm::vec3(uniformData.cameraPos), coneCulling).time;
+		}
+		cpuBenchmark.averageTime = totalTime / (double)cpuBenchmark.iterations;
+		cpuBenchmark.meshletsPerSecond = cpuBenchmark.averageTime > 0.0 ? (double)model.meshlets.meshlets.size() / (cpuBenchmark.averageTime / 1000.0) : 0.0;
+		std::cout << "CPU meshlet culling: " << cpuBenchmark.averageTime << " ms for " << model.meshlets.meshlets.size() << " meshlets (" << cpuBenchmark.meshletsPerSecond / 1.0e6 << " million meshlets/s)" << std::endl;
+	}
+
 
 	void buildCommandBuffers()
 	{
@@ -104,8 +195,14 @@ public:
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdDrawMeshTasksEXT(drawCmdBuffers[i], 1, 1, 1);
+			if (renderMeshlets) {
+				// One task shader workgroup per TASK_GROUP_SIZE meshlets, the task shader launches mesh shader workgroups for the visible ones
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.meshlets);
+				vkCmdDrawMeshTasksEXT(drawCmdBuffers[i], (uniformData.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, 1, 1);
+			} else {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.triangle);
+				vkCmdDrawMeshTasksEXT(drawCmdBuffers[i], 1, 1, 1);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -120,13 +217,24 @@ public:
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1: Meshlet descriptions
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 1),
+			// Binding 2: Meshlet bounds (sphere and normal cone)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_EXT, 2),
+			// Binding 3: Meshlet vertex indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 3),
+			// Binding 4: Meshlet triangles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 4),
+			// Binding 5: glTF model vertex buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 5),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayout));
@@ -134,8 +242,14 @@ public:
 		// Set
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorBufferInfo vertexBufferDescriptor{ model.vertices.buffer, 0, VK_WHOLE_SIZE };
 		std::vector<VkWriteDescriptorSet> modelWriteDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &meshletBuffers.meshlets.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &meshletBuffers.bounds.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &meshletBuffers.vertices.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &meshletBuffers.triangles.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &vertexBufferDescriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(modelWriteDescriptorSets.size()), modelWriteDescriptorSets.data(), 0, nullptr);
 	}
@@ -173,10 +287,26 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 
+		// Single triangle
 		shaderStages[0] = loadShader(getShadersPath() + "meshshader/meshshader.mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT);
 		shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshshader.task.spv", VK_SHADER_STAGE_TASK_BIT_EXT);
 		shaderStages[2] = loadShader(getShadersPath() + "meshshader/meshshader.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.triangle));
+
+		// Culled meshlets
+		const std::string meshletShaders[3] = { "meshshader/meshlet.mesh.spv", "meshshader/meshlet.task.spv", "meshshader/meshlet.frag.spv" };
+		for (const std::string& shader : meshletShaders) {
+			if (!shaderAvailable(getShadersPath() + shader)) {
+				std::cout << "Meshlet shader \"" << shader << "\" not found (see data/shaders/glsl/compileshaders.py), rendering the single triangle only" << std::endl;
+				meshletsSupported = false;
+				renderMeshlets = false;
+				return;
+			}
+		}
+		shaderStages[0] = loadShader(getShadersPath() + meshletShaders[0], VK_SHADER_STAGE_MESH_BIT_EXT);
+		shaderStages[1] = loadShader(getShadersPath() + meshletShaders[1], VK_SHADER_STAGE_TASK_BIT_EXT);
+		shaderStages[2] = loadShader(getShadersPath() + meshletShaders[2], VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.meshlets));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -191,8 +321,26 @@ public:
 	{
 		uniformData.projection = camera.matrices.perspective;
 		uniformData.view = camera.matrices.view;
-		uniformData.model = glm::mat4(1.0f);
+		uniformData.model = renderMeshlets ? glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)) : glm::mat4(1.0f);
+		uniformData.meshletCount = static_cast<uint32_t>(model.meshlets.meshlets.size());
+		uniformData.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+		uniformData.frustumCulling = frustumCulling;
+		uniformData.coneCulling = coneCulling;
+		uniformData.colorMeshlets = colorMeshlets;
+		// Frustum planes extracted from the full model-view-projection matrix are in model space
+		frustum.update(uniformData.projection * uniformData.view * uniformData.model);
+		if (frustumCulling) {
+			memcpy(uniformData.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		} else {
+			// Planes that never reject anything
+			for (uint32_t i = 0; i < 6; i++) {
+				uniformData.frustumPlanes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+		}
+		uniformData.cameraPos = glm::inverse(uniformData.view * uniformData.model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+
+		cullStatistics = vks::meshlet::cull(model.meshlets, uniformData.frustumPlanes, glm::vec3(uniformData.cameraPos), coneCulling);
 	}
 
 	void draw()
@@ -213,6 +361,7 @@ public:
 		// Get the function pointer of the mesh shader drawing funtion
 		vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
 
+		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
@@ -231,6 +380,47 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (meshletsSupported && overlay->checkBox("Render meshlets", &renderMeshlets)) {
+				updateUniformBuffers();
+				buildCommandBuffers();
+			}
+			if (renderMeshlets) {
+				if (overlay->checkBox("Frustum culling", &frustumCulling)) {
+					updateUniformBuffers();
+				}
+				if (overlay->checkBox("Normal cone culling", &coneCulling)) {
+					updateUniformBuffers();
+				}
+				if (overlay->checkBox("Color meshlets", &colorMeshlets)) {
+					updateUniformBuffers();
+				}
+			}
+		}
+		if (renderMeshlets) {
+			if (overlay->header("Meshlets")) {
+				overlay->text("Meshlets: %d", meshletStatistics.meshletCount);
+				overlay->text("Avg. vertices: %.1f (%.0f%%)", meshletStatistics.averageVertices, meshletStatistics.vertexUtilization * 100.0f);
+				overlay->text("Avg. triangles: %.1f (%.0f%%)", meshletStatistics.averageTriangles, meshletStatistics.triangleUtilization * 100.0f);
+				overlay->text("Cone cullable: %d", meshletStatistics.coneCullable);
+			}
+			if (overlay->header("Culling")) {
+				overlay->text("Visible: %d", cullStatistics.visible);
+				overlay->text("Frustum culled: %d", cullStatistics.frustumCulled);
+				overlay->text("Cone culled: %d", cullStatistics.coneCulled);
+				if (overlay->button("Run CPU benchmark")) {
+					runCpuCullingBenchmark();
+				}
+				if (cpuBenchmark.averageTime > 0.0) {
+					overlay->text("CPU: %.4f ms", cpuBenchmark.averageTime);
+					overlay->text("%.1f M meshlets/s", cpuBenchmark.meshletsPerSecond / 1.0e6);
+				}
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
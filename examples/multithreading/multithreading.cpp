@@ -12,6 +12,7 @@
 #include "frustum.hpp"
 
 #include "VulkanglTFModel.h"
+#include "VulkanOcclusionCulling.h"
 
 #define ENABLE_VALIDATION false
 
@@ -93,6 +94,22 @@ public:
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
+	// CPU occlusion culling, the objects closest to the camera are rasterized as occluders
+	// and all objects inside the view frustum are tested against them before their command buffers are recorded
+	vks::OcclusionCuller occlusionCuller;
+	bool occlusionCulling = true;
+	int32_t occluderCount = 32;
+	// Width of the software depth buffer, the height follows the aspect ratio of the window
+	const uint32_t occlusionBufferWidth = 256;
+	// Occluders need to be fully contained in the object, so a box inside the ufo's hull is used instead of the actual mesh
+	struct OccluderMesh {
+		std::vector<glm::vec3> vertices;
+		std::vector<uint32_t> indices;
+		// Size of the box relative to the model's bounding box
+		glm::vec3 extent = glm::vec3(0.5f, 0.2f, 0.5f);
+	} occluderMesh;
+	uint32_t frustumVisibleCount = 0;
+
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -112,6 +129,7 @@ public:
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
 		threadPool.setThreadCount(numThreads);
+		occlusionCuller.setThreadPool(&threadPool);
 		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
@@ -202,8 +220,9 @@ public:
 
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Culls an object against the view frustum and updates its transformation
+	// Runs for all objects before any occluders are rasterized, as these depend on the object's current position
+	void threadUpdateCode(uint32_t threadIndex, uint32_t cmdBufferIndex)
 	{
 		ThreadData *thread = &threadData[threadIndex];
 		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
@@ -216,22 +235,6 @@ public:
 			return;
 		}
 
-		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
-
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
-
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
-
 		// Update
 		if (!paused) {
 			objectData->rotation.y += 2.5f * objectData->rotationSpeed * frameTimer;
@@ -251,6 +254,41 @@ public:
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
 		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+	}
+
+	// Builds the secondary command buffer for each thread
+	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	{
+		ThreadData *thread = &threadData[threadIndex];
+		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+
+		if (!objectData->visible)
+		{
+			return;
+		}
+
+		// Objects inside the view frustum can still be hidden behind the occluders
+		if (occlusionCulling && !occlusionCuller.isVisible(thread->pushConstBlock[cmdBufferIndex].mvp, models.ufo.dimensions.min, models.ufo.dimensions.max))
+		{
+			objectData->visible = false;
+			return;
+		}
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -270,6 +308,30 @@ public:
 		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
+	// Rasterizes the occluder boxes of the objects closest to the camera
+	void rasterizeOccluders()
+	{
+		const glm::vec3 cameraPos = glm::vec3(glm::inverse(matrices.view)[3]);
+		std::vector<std::pair<float, ObjectData*>> candidates;
+		for (auto& thread : threadData) {
+			for (auto& objectData : thread.objectData) {
+				if (objectData.visible) {
+					candidates.push_back(std::make_pair(glm::distance(cameraPos, objectData.pos), &objectData));
+				}
+			}
+		}
+		frustumVisibleCount = static_cast<uint32_t>(candidates.size());
+		const size_t count = std::min(candidates.size(), static_cast<size_t>(occluderCount));
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+			[](const std::pair<float, ObjectData*>& a, const std::pair<float, ObjectData*>& b) { return a.first < b.first; });
+
+		occlusionCuller.clear();
+		for (size_t i = 0; i < count; i++) {
+			occlusionCuller.addOccluder(matrices.projection * matrices.view * candidates[i].second->model, occluderMesh.vertices.data(), static_cast<uint32_t>(occluderMesh.vertices.size()), occluderMesh.indices.data(), static_cast<uint32_t>(occluderMesh.indices.size()));
+		}
+		occlusionCuller.rasterize();
+	}
+
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
 		// Secondary command buffer for the sky sphere
@@ -371,6 +433,21 @@ public:
 			commandBuffers.push_back(secondaryCommandBuffers.background);
 		}
 
+		// Update all objects and cull them against the view frustum
+		for (uint32_t t = 0; t < numThreads; t++)
+		{
+			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+			{
+				threadPool.threads[t]->addJob([=] { threadUpdateCode(t, i); });
+			}
+		}
+
+		threadPool.wait();
+
+		if (occlusionCulling) {
+			rasterizeOccluders();
+		}
+
 		// Add a job to the thread's queue for each object to be rendered
 		for (uint32_t t = 0; t < numThreads; t++)
 		{
@@ -382,7 +459,7 @@ public:
 
 		threadPool.wait();
 
-		// Only submit if object is within the current view frustum
+		// Only submit if object is within the current view frustum and not occluded
 		for (uint32_t t = 0; t < numThreads; t++)
 		{
 			for (uint32_t i = 0; i < numObjectsPerThread; i++)
@@ -414,6 +491,25 @@ public:
 		models.starSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
+	// Builds the occluder box from the ufo's bounding box
+	void prepareOccluderMesh()
+	{
+		const glm::vec3 halfExtent = models.ufo.dimensions.size * occluderMesh.extent * 0.5f;
+		occluderMesh.vertices.resize(8);
+		for (uint32_t i = 0; i < 8; i++) {
+			occluderMesh.vertices[i] = models.ufo.dimensions.center + glm::vec3((i & 1) ? halfExtent.x : -halfExtent.x, (i & 2) ? halfExtent.y : -halfExtent.y, (i & 4) ? halfExtent.z : -halfExtent.z);
+		}
+		occluderMesh.indices = {
+			0, 1, 3, 0, 3, 2,
+			4, 6, 7, 4, 7, 5,
+			0, 4, 5, 0, 5, 1,
+			2, 3, 7, 2, 7, 6,
+			0, 2, 6, 0, 6, 4,
+			1, 5, 7, 1, 7, 3
+		};
+		occlusionCuller.resize(occlusionBufferWidth, occlusionBufferWidth * height / width);
+	}
+
 	void setupPipelineLayout()
 	{
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
@@ -507,6 +603,7 @@ public:
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		vkCreateFence(device, &fenceCreateInfo, nullptr, &renderFence);
 		loadAssets();
+		prepareOccluderMesh();
 		setupPipelineLayout();
 		preparePipelines();
 		prepareMultiThreadedRenderer();
@@ -530,13 +627,28 @@ public:
 		updateMatrices();
 	}
 
+	virtual void windowResized()
+	{
+		occlusionCuller.resize(occlusionBufferWidth, occlusionBufferWidth * height / width);
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
 		}
+		if (occlusionCulling && overlay->header("Occlusion culling")) {
+			const vks::OcclusionCuller::Statistics statistics = occlusionCuller.getStatistics();
+			overlay->text("Inside frustum: %d", frustumVisibleCount);
+			overlay->text("Tested: %d", statistics.tested);
+			overlay->text("Occluded: %d", statistics.occluded);
+			overlay->text("Occluders: %d (%d triangles)", statistics.occluders, statistics.triangles);
+			overlay->text("Rasterization: %.3f ms", statistics.rasterizationTime);
+		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			overlay->checkBox("Occlusion culling", &occlusionCulling);
+			overlay->sliderInt("Occluders", &occluderCount, 1, 128);
 		}
 
 	}
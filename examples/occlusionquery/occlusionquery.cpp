@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanQueryManager.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -53,11 +54,15 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	// Pool that stores all occlusion queries
-	VkQueryPool queryPool;
-
-	// Passed query samples
-	uint64_t passedSamples[2] = { 1,1 };
+	// Occlusion queries for the teapot and the sphere
+	// Each command buffer uses its own query pool, results are read without waiting once the pool is about to be reused
+	// Until a result is available objects are treated as visible
+	vks::QueryManager occlusionQueries;
+	// Timestamps at the start and end of each command buffer
+	vks::QueryManager timestampQueries;
+	// Vertex and fragment shader invocations for the whole frame
+	vks::QueryManager statisticsQueries;
+	bool timestampsSupported = false;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -67,6 +72,9 @@ public:
 		camera.setRotation(glm::vec3(0.0f, -123.75f, 0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
+
+		// Query results are displayed every frame, keep the UI out of the scene command buffers so these don't need to be rebuilt
+		separateOverlay.enabled = true;
 	}
 
 	~VulkanExample()
@@ -80,39 +88,63 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkDestroyQueryPool(device, queryPool, nullptr);
+		occlusionQueries.destroy();
+		if (timestampsSupported) {
+			timestampQueries.destroy();
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			statisticsQueries.destroy();
+		}
 
 		uniformBuffers.occluder.destroy();
 		uniformBuffers.sphere.destroy();
 		uniformBuffers.teapot.destroy();
 	}
 
-	// Create a query pool for storing the occlusion query result
-	void setupQueryPool()
+	// Support for pipeline statistics is optional
+	virtual void getEnabledFeatures()
+	{
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
+	// Create a ring of query pools with one pool per command buffer
+	void setupQueryPools()
+	{
+		const uint32_t frameCount = static_cast<uint32_t>(drawCmdBuffers.size());
+		occlusionQueries.create(vulkanDevice, VK_QUERY_TYPE_OCCLUSION, 2, frameCount);
+		timestampsSupported = (vulkanDevice->properties.limits.timestampComputeAndGraphics == VK_TRUE);
+		if (timestampsSupported) {
+			timestampQueries.create(vulkanDevice, VK_QUERY_TYPE_TIMESTAMP, 2, frameCount);
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			statisticsQueries.create(vulkanDevice, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, frameCount,
+				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT);
+		}
+	}
+
+	// Reads all query results that are ready without stalling, must be done before a command buffer that resets its pools is submitted again
+	void updateQueryResults()
 	{
-		VkQueryPoolCreateInfo queryPoolInfo = {};
-		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
-		queryPoolInfo.queryCount = 2;
-		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
+		occlusionQueries.update();
+		if (timestampsSupported) {
+			timestampQueries.update();
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			statisticsQueries.update();
+		}
 	}
 
-	// Retrieves the results of the occlusion queries submitted to the command buffer
-	void getQueryResults()
+	void querySubmitted(uint32_t frameIndex)
 	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			2,
-			sizeof(passedSamples),
-			passedSamples,
-			sizeof(uint64_t),
-			// Store results a 64 bit values and wait until the results have been finished
-			// If you don't want to wait, you can use VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
-			// which also returns the state of the result (ready) in the result
-			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		occlusionQueries.submitted(frameIndex);
+		if (timestampsSupported) {
+			timestampQueries.submitted(frameIndex);
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			statisticsQueries.submitted(frameIndex);
+		}
 	}
 
 	void buildCommandBuffers()
@@ -139,9 +171,17 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Reset query pool
+			// Reset this command buffer's query pools
 			// Must be done outside of render pass
-			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+			occlusionQueries.cmdReset(drawCmdBuffers[i], i);
+			if (timestampsSupported) {
+				timestampQueries.cmdReset(drawCmdBuffers[i], i);
+				timestampQueries.cmdWriteTimestamp(drawCmdBuffers[i], i, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			}
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				statisticsQueries.cmdReset(drawCmdBuffers[i], i);
+				statisticsQueries.cmdBeginQuery(drawCmdBuffers[i], i, 0);
+			}
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -169,16 +209,16 @@ public:
 			models.plane.draw(drawCmdBuffers[i]);
 
 			// Teapot
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, VK_FLAGS_NONE);
+			occlusionQueries.cmdBeginQuery(drawCmdBuffers[i], i, 0);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.teapot, 0, NULL);
 			models.teapot.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+			occlusionQueries.cmdEndQuery(drawCmdBuffers[i], i, 0);
 
 			// Sphere
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 1, VK_FLAGS_NONE);
+			occlusionQueries.cmdBeginQuery(drawCmdBuffers[i], i, 1);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sphere, 0, NULL);
 			models.sphere.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 1);
+			occlusionQueries.cmdEndQuery(drawCmdBuffers[i], i, 1);
 
 			// Visible pass
 			// Clear color and depth attachments
@@ -222,21 +262,29 @@ public:
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				statisticsQueries.cmdEndQuery(drawCmdBuffers[i], i, 0);
+			}
+			if (timestampsSupported) {
+				timestampQueries.cmdWriteTimestamp(drawCmdBuffers[i], i, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
 	void draw()
 	{
-		updateUniformBuffers();
 		VulkanExampleBase::prepareFrame();
 
+		// Poll results of earlier frames before the current command buffer resets its pools
+		updateQueryResults();
+		updateUniformBuffers();
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		// Read query results for displaying in next frame
-		getQueryResults();
+		querySubmitted(currentBuffer);
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -421,14 +469,14 @@ public:
 
 		// Teapot
 		// Toggle color depending on visibility
-		uboVS.visible = (passedSamples[0] > 0) ? 1.0f : 0.0f;
+		uboVS.visible = occlusionQueries.isVisible(0) ? 1.0f : 0.0f;
 		uboVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f));
 		uboVS.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 		memcpy(uniformBuffers.teapot.mapped, &uboVS, sizeof(uboVS));
 
 		// Sphere
 		// Toggle color depending on visibility
-		uboVS.visible = (passedSamples[1] > 0) ? 1.0f : 0.0f;
+		uboVS.visible = occlusionQueries.isVisible(1) ? 1.0f : 0.0f;
 		uboVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f));
 		uboVS.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
 		memcpy(uniformBuffers.sphere.mapped, &uboVS, sizeof(uboVS));
@@ -438,7 +486,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		setupQueryPool();
+		setupQueryPools();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -458,8 +506,24 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Occlusion query results")) {
-			overlay->text("Teapot: %d samples passed", passedSamples[0]);
-			overlay->text("Sphere: %d samples passed", passedSamples[1]);
+			const char* names[2] = { "Teapot", "Sphere" };
+			for (uint32_t i = 0; i < 2; i++) {
+				if (occlusionQueries.hasResult(i)) {
+					overlay->text("%s: %d samples passed (%d frames old)", names[i], (int32_t)occlusionQueries.getResult(i), (int32_t)occlusionQueries.getResultAge(i));
+				}
+				else {
+					overlay->text("%s: no result yet", names[i]);
+				}
+			}
+			overlay->text("Latency: %d frames", occlusionQueries.latency);
+			overlay->text("Dropped results: %d", (int32_t)occlusionQueries.droppedResults);
+		}
+		if (timestampsSupported && overlay->header("GPU timing")) {
+			overlay->text("Frame: %.3f ms", timestampQueries.getTimestampDelta(0, 1));
+		}
+		if (deviceFeatures.pipelineStatisticsQuery && statisticsQueries.hasResult(0) && overlay->header("Pipeline statistics")) {
+			overlay->text("VS invocations: %d", (int32_t)statisticsQueries.getResult(0, 0));
+			overlay->text("FS invocations: %d", (int32_t)statisticsQueries.getResult(0, 1));
 		}
 	}
 
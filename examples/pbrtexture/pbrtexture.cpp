@@ -12,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanStreamingUploader.h"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +21,10 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool displaySkybox = true;
 
+	// The material textures and the geometry of the object are streamed in on the transfer queue while rendering
+	vks::StreamingUploader streamingUploader;
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+
 	struct Textures {
 		vks::TextureCubeMap environmentCube;
 		// Generated at runtime
@@ -82,10 +87,19 @@ public:
 
 		camera.setRotation({ -7.75f, 150.25f, 0.0f });
 		camera.setPosition({ 0.7f, 0.1f, 1.7f });
+		// Required by VK_KHR_timeline_semaphore on Vulkan 1.0
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	}
 
 	~VulkanExample()
 	{
+		if (benchmark.active) {
+			const vks::StreamingUploader::Statistics &statistics = streamingUploader.getStatistics();
+			std::cout << "Streamed " << statistics.uploadsCompleted << " uploads (" << statistics.bytesUploaded / (1024 * 1024) << " MB) at " << statistics.throughput << " MB/s, render thread time " << statistics.renderThreadTime << " ms" << std::endl;
+		}
+		// Pending uploads refer to the textures and the model
+		streamingUploader.destroy();
+
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
 		vkDestroyPipeline(device, pipelines.pbr, nullptr);
 
@@ -114,6 +128,17 @@ public:
 		}
 	}
 
+	virtual void getEnabledExtensions()
+	{
+		// The uploader tracks its transfer submissions with a timeline semaphore if available and falls back to fences otherwise
+		if (vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		}
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -173,13 +198,29 @@ public:
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		// The object is only drawn once its vertex and index buffers have been uploaded
+		models.object.streamingUploader = &streamingUploader;
 		models.object.loadFromFile(getAssetPath() + "models/cerberus/cerberus.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		// The environment is needed right away for generating the irradiance and prefiltered cube maps
 		textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
-		textures.albedoMap.loadFromFile(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.normalMap.loadFromFile(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.aoMap.loadFromFile(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-		textures.metallicMap.loadFromFile(getAssetPath() + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-		textures.roughnessMap.loadFromFile(getAssetPath() + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+		// Material maps start out as single texel textures with neutral values
+		streamingUploader.createPlaceholder(textures.albedoMap, 0xff808080);
+		streamingUploader.createPlaceholder(textures.normalMap, 0xffff8080);
+		streamingUploader.createPlaceholder(textures.aoMap, 0xffffffff);
+		streamingUploader.createPlaceholder(textures.metallicMap, 0xff000000);
+		streamingUploader.createPlaceholder(textures.roughnessMap, 0xff808080);
+		streamingUploader.loadTexture2D(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, &textures.albedoMap, [this]() { updateMaterialDescriptor(5, textures.albedoMap); });
+		streamingUploader.loadTexture2D(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, &textures.normalMap, [this]() { updateMaterialDescriptor(6, textures.normalMap); });
+		streamingUploader.loadTexture2D(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, &textures.aoMap, [this]() { updateMaterialDescriptor(7, textures.aoMap); });
+		streamingUploader.loadTexture2D(getAssetPath() + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM, &textures.metallicMap, [this]() { updateMaterialDescriptor(8, textures.metallicMap); });
+		streamingUploader.loadTexture2D(getAssetPath() + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM, &textures.roughnessMap, [this]() { updateMaterialDescriptor(9, textures.roughnessMap); });
+	}
+
+	// Called by the uploader once a streamed texture has replaced its placeholder
+	void updateMaterialDescriptor(uint32_t binding, vks::Texture2D &texture)
+	{
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, binding, &texture.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 	}
 
 	void setupDescriptors()
@@ -1318,6 +1359,7 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		streamingUploader.create(vulkanDevice, transferQueue, queue);
 		loadAssets();
 		generateBRDFLUT();
 		generateIrradianceCube();
@@ -1333,6 +1375,10 @@ public:
 	{
 		if (!prepared)
 			return;
+		// Finished uploads replace placeholders and change descriptors, so the command buffers are recorded again
+		if (streamingUploader.update() > 0) {
+			buildCommandBuffers();
+		}
 		draw();
 		if (camera.updated)
 		{
@@ -1358,6 +1404,9 @@ public:
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("Streaming")) {
+			streamingUploader.onUpdateUIOverlay(overlay);
+		}
 	}
 };
 
@@ -60,6 +60,9 @@ public:
 		camera.movementSpeed = 4.0f;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		camera.rotationSpeed = 0.25f;
+
+		// Draw the UI in separate command buffers, so its draws don't show up in the statistics and updating them doesn't rebuild the scene
+		separateOverlay.enabled = true;
 	}
 
 	~VulkanExample()
@@ -46,6 +46,10 @@ public:
 	std::vector<std::string> sceneNames;
 	int32_t sceneIndex = 0;
 
+	// The animated character is skinned once per frame by a compute pass, both the shadow and the scene pass then draw the skinned vertices
+	float animationTime = 0.0f;
+	bool skinningValidated = false;
+
 	struct {
 		vks::Buffer scene;
 		vks::Buffer offscreen;
@@ -66,6 +70,9 @@ public:
 		glm::mat4 depthMVP;
 	} uboOffscreenVS;
 
+	// Light space transform without the scene's model matrix, which is applied separately by the scene shaders
+	glm::mat4 depthViewProjection;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline sceneShadow;
@@ -277,6 +284,9 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// Skin the animated character for both passes (does nothing for the static scenes)
+			scenes[sceneIndex].recordSkinning(drawCmdBuffers[i]);
+
 			/*
 				First render pass: Generate shadow map by rendering the scene from light's POV
 			*/
@@ -366,10 +376,46 @@ public:
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		scenes.resize(2);
+		scenes.resize(3);
 		scenes[0].loadFromFile(getAssetPath() + "models/vulkanscene_shadow.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		scenes[1].loadFromFile(getAssetPath() + "models/samplescene.gltf", vulkanDevice, queue, glTFLoadingFlags);
-		sceneNames = {"Vulkan scene", "Teapots and pillars" };
+		// Skinning works on the vertices as stored in the file, the node transform and the y flip are applied with the model matrix instead (see getSceneMatrix)
+		scenes[2].loadFromFile(getAssetPath() + "models/CesiumMan/glTF/CesiumMan.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreMultiplyVertexColors);
+		scenes[2].prepareSkinning(queue, loadShader(getShadersPath() + "base/skinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		sceneNames = {"Vulkan scene", "Teapots and pillars", "Animated character" };
+	}
+
+	// Model matrix of the current scene, the static scenes have been pre-transformed at load time
+	glm::mat4 getSceneMatrix()
+	{
+		vkglTF::Model& scene = scenes[sceneIndex];
+		if (!scene.skinning.enabled) {
+			return glm::mat4(1.0f);
+		}
+		// Pre-skinned vertices are relative to the skinned mesh's node
+		glm::mat4 nodeMatrix = glm::mat4(1.0f);
+		for (auto node : scene.linearNodes) {
+			if (node->mesh && node->skin) {
+				nodeMatrix = node->getMatrix();
+				break;
+			}
+		}
+		return glm::scale(glm::mat4(1.0f), glm::vec3(8.0f, -8.0f, 8.0f)) * nodeMatrix;
+	}
+
+	void updateAnimation()
+	{
+		vkglTF::Model& scene = scenes[sceneIndex];
+		if (!scene.skinning.enabled || scene.animations.empty()) {
+			return;
+		}
+		const vkglTF::Animation& animation = scene.animations[0];
+		animationTime += frameTimer;
+		if (animationTime > animation.end) {
+			animationTime -= animation.end - animation.start;
+		}
+		// Writes the joint palette read by the next frame's skinning pass
+		scene.updateAnimation(0, std::max(animationTime, animation.start));
 	}
 
 	void setupDescriptorPool()
@@ -547,9 +593,9 @@ public:
 	{
 		uboVSscene.projection = camera.matrices.perspective;
 		uboVSscene.view = camera.matrices.view;
-		uboVSscene.model = glm::mat4(1.0f);
+		uboVSscene.model = getSceneMatrix();
 		uboVSscene.lightPos = glm::vec4(lightPos, 1.0f);
-		uboVSscene.depthBiasMVP = uboOffscreenVS.depthMVP;
+		uboVSscene.depthBiasMVP = depthViewProjection;
 		uboVSscene.zNear = zNear;
 		uboVSscene.zFar = zFar;
 		memcpy(uniformBuffers.scene.mapped, &uboVSscene, sizeof(uboVSscene));
@@ -560,9 +606,10 @@ public:
 		// Matrix from light's point of view
 		glm::mat4 depthProjectionMatrix = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, zFar);
 		glm::mat4 depthViewMatrix = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0, 1, 0));
-		glm::mat4 depthModelMatrix = glm::mat4(1.0f);
+		glm::mat4 depthModelMatrix = getSceneMatrix();
 
-		uboOffscreenVS.depthMVP = depthProjectionMatrix * depthViewMatrix * depthModelMatrix;
+		depthViewProjection = depthProjectionMatrix * depthViewMatrix;
+		uboOffscreenVS.depthMVP = depthViewProjection * depthModelMatrix;
 
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
@@ -600,6 +647,15 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		// The palette still holds the matrices used by this frame, so the skinned vertices can be compared against the CPU reference once
+		if (scenes[sceneIndex].skinning.enabled && !skinningValidated) {
+			const float maxDifference = scenes[sceneIndex].validateSkinning(queue);
+			std::cout << "Compute pre-skinning differs from the CPU reference by up to " << maxDifference << " units" << std::endl;
+			skinningValidated = true;
+		}
+		if (!paused) {
+			updateAnimation();
+		}
 		if (!paused || camera.updated)
 		{
 			updateLight();
@@ -612,6 +668,9 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->comboBox("Scenes", &sceneIndex, sceneNames)) {
+				// The scenes use different model matrices
+				updateUniformBufferOffscreen();
+				updateUniformBuffers();
 				buildCommandBuffers();
 			}
 			if (overlay->checkBox("Display shadow render target", &displayShadowMap)) {
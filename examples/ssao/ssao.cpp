@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanGpuProfiler.h"
+#include "VulkanPostProcessing.h"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +22,9 @@
 #define SSAO_NOISE_DIM 4
 #endif
 
+// Number of frames the kernel is split across with temporal accumulation
+#define SSAO_TEMPORAL_FRAMES 4
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -42,35 +47,59 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Selects the kernel subset and noise offset of the frame for temporal accumulation
+		int32_t frameIndex = 0;
+		// Transforms view space positions of the current frame into clip space of the previous frame
+		glm::mat4 viewToPrevClip;
+		int32_t sampleCount = SSAO_KERNEL_SIZE;
+		int32_t sampleStride = 1;
+		float historyWeight = 0.0f;
+		int32_t upsample = false;
 	} uboSSAOParams;
 
 	struct {
 		VkPipeline offscreen;
+		VkPipeline offscreenIndirect = VK_NULL_HANDLE;
 		VkPipeline composition;
 		VkPipeline ssao;
 		VkPipeline ssaoBlur;
+		VkPipeline downsample = VK_NULL_HANDLE;
+		VkPipeline temporal = VK_NULL_HANDLE;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout gBuffer;
+		VkPipelineLayout gBufferIndirect = VK_NULL_HANDLE;
 		VkPipelineLayout ssao;
 		VkPipelineLayout ssaoBlur;
+		VkPipelineLayout downsample;
+		VkPipelineLayout temporal;
 		VkPipelineLayout composition;
 	} pipelineLayouts;
 
 	struct {
-		const uint32_t count = 5;
+		const uint32_t count = 11;
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
 		VkDescriptorSet ssao;
 		VkDescriptorSet ssaoBlur;
 		VkDescriptorSet composition;
+		// Same as composition, but samples the output of the compute blur
+		VkDescriptorSet compositionComputeBlur;
+		// Reduced resolution SSAO
+		VkDescriptorSet downsample;
+		VkDescriptorSet ssaoHalf;
+		VkDescriptorSet temporal;
+		VkDescriptorSet compositionHalf;
+		VkDescriptorSet compositionHalfTemporal;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout gBuffer;
 		VkDescriptorSetLayout ssao;
 		VkDescriptorSetLayout ssaoBlur;
+		VkDescriptorSetLayout downsample;
+		VkDescriptorSetLayout temporal;
 		VkDescriptorSetLayout composition;
 	} descriptorSetLayouts;
 
@@ -115,12 +144,46 @@ public:
 		} offscreen;
 		struct SSAO : public FrameBuffer {
 			FrameBufferAttachment color;
-		} ssao, ssaoBlur;
+		} ssao, ssaoBlur, ssaoHalf, ssaoTemporal;
+		// Half resolution positions and normals for the reduced resolution SSAO
+		struct HalfResolution : public FrameBuffer {
+			FrameBufferAttachment position, normal;
+		} halfResolution;
+		// Accumulated SSAO of the previous frame, copied from the temporal pass output
+		FrameBufferAttachment ssaoHistory;
 	} frameBuffers;
 
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler;
 
+	// If descriptor indexing is supported, all materials of the scene are bound with a single descriptor set
+	bool bindlessMaterials = false;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+	// GPU driven rendering culls the scene in a compute shader and draws it with a few indirect draws (requires bindless materials)
+	bool indirectSupported = false;
+	// Set if VK_KHR_draw_indirect_count has been enabled, culled commands are then compacted instead of drawn with zero instances
+	bool drawIndirectCount = false;
+	bool gpuDriven = false;
+
+	// Reduced resolution SSAO is computed from a downsampled G-Buffer and upsampled in the composition pass
+	// Uses its own SSAO and composition shaders, so it's only available if all of its shaders have been compiled
+	bool reducedResolutionSupported = false;
+	bool halfResolution = false;
+	// Spreads the kernel over SSAO_TEMPORAL_FRAMES frames and accumulates the reprojected results (reduced resolution only)
+	bool temporalAccumulation = false;
+	bool historyValid = false;
+	glm::mat4 prevViewProjection = glm::mat4(1.0f);
+
+	// The SSAO can be blurred with the fragment shader box blur or with a depth aware compute blur (see base/VulkanPostProcessing.h)
+	bool computeBlurSupported = false;
+	bool computeBlur = false;
+	vks::PostProcessing postProcessing;
+	vks::PostProcessing::Blur ssaoComputeBlur;
+	// Benchmark runs alternate between both blurs so their GPU times can be compared
+	uint32_t benchmarkFrame = 0;
+
+	vks::GpuProfiler profiler;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Screen space ambient occlusion";
@@ -131,6 +194,10 @@ public:
 		camera.position = { 1.0f, 0.75f, 0.0f };
 		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, uboSceneParams.nearPlane, uboSceneParams.farPlane);
+		// Keeps the per pass timings in the UI from rebuilding the scene command buffers every frame
+		separateOverlay.enabled = true;
+		// Required to query the descriptor indexing features
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	}
 
 	~VulkanExample()
@@ -144,25 +211,43 @@ public:
 		frameBuffers.offscreen.depth.destroy(device);
 		frameBuffers.ssao.color.destroy(device);
 		frameBuffers.ssaoBlur.color.destroy(device);
+		frameBuffers.halfResolution.position.destroy(device);
+		frameBuffers.halfResolution.normal.destroy(device);
+		frameBuffers.ssaoHalf.color.destroy(device);
+		frameBuffers.ssaoTemporal.color.destroy(device);
+		frameBuffers.ssaoHistory.destroy(device);
 
 		// Framebuffers
 		frameBuffers.offscreen.destroy(device);
 		frameBuffers.ssao.destroy(device);
 		frameBuffers.ssaoBlur.destroy(device);
+		frameBuffers.halfResolution.destroy(device);
+		frameBuffers.ssaoHalf.destroy(device);
+		frameBuffers.ssaoTemporal.destroy(device);
 
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		if (pipelines.offscreenIndirect != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.offscreenIndirect, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.gBufferIndirect, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
+		vkDestroyPipeline(device, pipelines.downsample, nullptr);
+		vkDestroyPipeline(device, pipelines.temporal, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.downsample, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.temporal, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.downsample, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.temporal, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 
 		// Uniform buffers
@@ -171,11 +256,55 @@ public:
 		uniformBuffers.ssaoParams.destroy();
 
 		textures.ssaoNoise.destroy();
+
+		postProcessing.destroyBlur(ssaoComputeBlur);
+		postProcessing.destroy();
+		if (benchmark.active) {
+			profiler.printSummary();
+		}
+		profiler.destroy();
 	}
 
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+		// Required by the compute blur to write its single channel output
+		enabledFeatures.shaderStorageImageWriteWithoutFormat = deviceFeatures.shaderStorageImageWriteWithoutFormat;
+	}
+
+	void getEnabledExtensions()
+	{
+		bindlessMaterials = vulkanDevice->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexingFeatures{};
+		supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		if (bindlessMaterials) {
+			// The extension doesn't imply support for the features used by the bindless set
+			VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			deviceFeatures2.pNext = &supportedIndexingFeatures;
+			PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+			vkGetPhysicalDeviceFeatures2KHR(physicalDevice, &deviceFeatures2);
+			bindlessMaterials = supportedIndexingFeatures.runtimeDescriptorArray && supportedIndexingFeatures.descriptorBindingVariableDescriptorCount;
+		}
+		if (bindlessMaterials) {
+			enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			// The material index comes from a push constant, so the texture array is only indexed with dynamically uniform values
+			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			// The indirect path reads the material index per vertex, which may differ between the draws of a multi draw
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+			deviceCreatepNextChain = &descriptorIndexingFeatures;
+		}
+		indirectSupported = bindlessMaterials && descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing && enabledFeatures.multiDrawIndirect && enabledFeatures.drawIndirectFirstInstance;
+		// Optional, without it culled draws are skipped through their instance count instead of being compacted
+		drawIndirectCount = indirectSupported && vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		if (drawIndirectCount) {
+			enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
 	}
 
 	// Create a frame buffer attachment
@@ -252,6 +381,11 @@ public:
 		frameBuffers.offscreen.setSize(width, height);
 		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
 		frameBuffers.ssaoBlur.setSize(width, height);
+		const uint32_t halfWidth = std::max(width / 2, 1u);
+		const uint32_t halfHeight = std::max(height / 2, 1u);
+		frameBuffers.halfResolution.setSize(halfWidth, halfHeight);
+		frameBuffers.ssaoHalf.setSize(halfWidth, halfHeight);
+		frameBuffers.ssaoTemporal.setSize(halfWidth, halfHeight);
 
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
@@ -270,6 +404,14 @@ public:
 		// SSAO blur
 		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
 
+		// Reduced resolution SSAO
+		createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.halfResolution.position, halfWidth, halfHeight);	// Position + Depth
+		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.halfResolution.normal, halfWidth, halfHeight);			// Normals
+		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoHalf.color, halfWidth, halfHeight);						// Color
+		// Accumulation needs more precision than the single frame result, the output is copied into the history after each frame
+		createAttachment(VK_FORMAT_R16_SFLOAT, static_cast<VkImageUsageFlagBits>(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT), &frameBuffers.ssaoTemporal.color, halfWidth, halfHeight);
+		createAttachment(VK_FORMAT_R16_SFLOAT, static_cast<VkImageUsageFlagBits>(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT), &frameBuffers.ssaoHistory, halfWidth, halfHeight);
+
 		// Render passes
 
 		// G-Buffer creation
@@ -311,9 +453,10 @@ public:
 			// Use subpass dependencies for attachment layout transitions
 			std::array<VkSubpassDependency, 2> dependencies;
 
+			// The compute blur also reads the linear depth from the position attachment
 			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 			dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -322,7 +465,7 @@ public:
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
@@ -382,12 +525,13 @@ public:
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+			// The SSAO is sampled by the fragment shader blur or the compute blur
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 			VkRenderPassCreateInfo renderPassInfo = {};
@@ -408,6 +552,14 @@ public:
 			fbufCreateInfo.height = frameBuffers.ssao.height;
 			fbufCreateInfo.layers = 1;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssao.frameBuffer));
+
+			// The reduced resolution SSAO uses a compatible render pass, so it can share the SSAO pipeline
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoHalf.renderPass));
+			fbufCreateInfo.renderPass = frameBuffers.ssaoHalf.renderPass;
+			fbufCreateInfo.pAttachments = &frameBuffers.ssaoHalf.color.view;
+			fbufCreateInfo.width = frameBuffers.ssaoHalf.width;
+			fbufCreateInfo.height = frameBuffers.ssaoHalf.height;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoHalf.frameBuffer));
 		}
 
 		// SSAO Blur
@@ -467,6 +619,135 @@ public:
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoBlur.frameBuffer));
 		}
 
+		// Half resolution G-Buffer (positions and normals picked from the full resolution G-Buffer)
+		{
+			std::array<VkAttachmentDescription, 2> attachmentDescs = {};
+			for (uint32_t i = 0; i < static_cast<uint32_t>(attachmentDescs.size()); i++)
+			{
+				attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
+				attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			attachmentDescs[0].format = frameBuffers.halfResolution.position.format;
+			attachmentDescs[1].format = frameBuffers.halfResolution.normal.format;
+
+			std::array<VkAttachmentReference, 2> colorReferences = { { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } } };
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.pColorAttachments = colorReferences.data();
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+
+			std::array<VkSubpassDependency, 2> dependencies;
+
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			VkRenderPassCreateInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.pAttachments = attachmentDescs.data();
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 2;
+			renderPassInfo.pDependencies = dependencies.data();
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.halfResolution.renderPass));
+
+			std::array<VkImageView, 2> attachments = { frameBuffers.halfResolution.position.view, frameBuffers.halfResolution.normal.view };
+			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+			fbufCreateInfo.renderPass = frameBuffers.halfResolution.renderPass;
+			fbufCreateInfo.pAttachments = attachments.data();
+			fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			fbufCreateInfo.width = frameBuffers.halfResolution.width;
+			fbufCreateInfo.height = frameBuffers.halfResolution.height;
+			fbufCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.halfResolution.frameBuffer));
+		}
+
+		// SSAO temporal accumulation
+		{
+			VkAttachmentDescription attachmentDescription{};
+			attachmentDescription.format = frameBuffers.ssaoTemporal.color.format;
+			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.pColorAttachments = &colorReference;
+			subpass.colorAttachmentCount = 1;
+
+			std::array<VkSubpassDependency, 2> dependencies;
+
+			// Waits for the copy of the last frame's result into the history to finish reading the attachment
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = 0;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
+
+			VkRenderPassCreateInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.pAttachments = &attachmentDescription;
+			renderPassInfo.attachmentCount = 1;
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 2;
+			renderPassInfo.pDependencies = dependencies.data();
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoTemporal.renderPass));
+
+			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+			fbufCreateInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+			fbufCreateInfo.pAttachments = &frameBuffers.ssaoTemporal.color.view;
+			fbufCreateInfo.attachmentCount = 1;
+			fbufCreateInfo.width = frameBuffers.ssaoTemporal.width;
+			fbufCreateInfo.height = frameBuffers.ssaoTemporal.height;
+			fbufCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoTemporal.frameBuffer));
+
+			// The history is sampled before it has been written for the first time, so it starts out as unoccluded
+			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vks::tools::setImageLayout(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+			VkClearColorValue clearColor = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+			vkCmdClearColorImage(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+			vks::tools::setImageLayout(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+			vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		}
+
 		// Shared sampler used for all color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_NEAREST;
@@ -486,8 +767,31 @@ public:
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
-		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+		uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+		if (bindlessMaterials && !shaderAvailable(getShadersPath() + "ssao/gbuffer_bindless.frag.spv")) {
+			std::cout << "Bindless G-Buffer shader not found (see data/shaders/glsl/compileshaders.py), using a descriptor set per material" << std::endl;
+			bindlessMaterials = false;
+		}
+		if (bindlessMaterials) {
+			gltfLoadingFlags |= vkglTF::FileLoadingFlags::BindlessMaterials;
+		}
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
+		// The model falls back to per material sets if it has more textures than fit into the bindless array
+		bindlessMaterials = scene.bindless.enabled;
+		indirectSupported = indirectSupported && bindlessMaterials;
+		if (indirectSupported) {
+			const std::string indirectShaders[3] = { "base/indirectcull.comp.spv", "ssao/gbuffer_indirect.vert.spv", "ssao/gbuffer_indirect.frag.spv" };
+			for (const std::string& shader : indirectShaders) {
+				if (!shaderAvailable(getShadersPath() + shader)) {
+					std::cout << "GPU driven rendering shader \"" << shader << "\" not found (see data/shaders/glsl/compileshaders.py), drawing the scene per node" << std::endl;
+					indirectSupported = false;
+					break;
+				}
+			}
+		}
+		if (indirectSupported) {
+			scene.prepareIndirectDrawing(loadShader(getShadersPath() + "base/indirectcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), drawIndirectCount, pipelineCache);
+		}
 	}
 
 	void buildCommandBuffers()
@@ -498,6 +802,13 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			profiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
+			if (gpuDriven) {
+				vks::GpuZone zone(profiler, drawCmdBuffers[i], "Culling");
+				scene.recordIndirectCulling(drawCmdBuffers[i]);
+			}
+
 			/*
 				Offscreen SSAO generation
 			*/
@@ -521,6 +832,7 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				profiler.cmdBeginZone(drawCmdBuffers[i], "G-Buffer");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -529,61 +841,160 @@ public:
 				VkRect2D scissor = vks::initializers::rect2D(frameBuffers.offscreen.width, frameBuffers.offscreen.height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets.floor, 0, NULL);
-				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Second pass: SSAO generation
-				*/
-
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Third pass: SSAO blur
-				*/
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				if (gpuDriven) {
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenIndirect);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferIndirect, 0, 1, &descriptorSets.floor, 0, NULL);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferIndirect, 2, 1, &scene.indirect.descriptorSet, 0, NULL);
+					scene.drawIndirect(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBufferIndirect);
+				}
+				else {
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets.floor, 0, NULL);
+					scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+				}
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				profiler.cmdEndZone(drawCmdBuffers[i]);
+
+				if (halfResolution) {
+					/*
+						Reduced resolution SSAO: Downsample the G-Buffer, generate the SSAO at half resolution and optionally accumulate it over several frames
+						The result is upsampled in the composition pass
+					*/
+
+					renderPassBeginInfo.framebuffer = frameBuffers.halfResolution.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.halfResolution.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.halfResolution.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.halfResolution.height;
+					renderPassBeginInfo.clearValueCount = 2;
+					renderPassBeginInfo.pClearValues = clearValues.data();
+
+					viewport = vks::initializers::viewport((float)frameBuffers.halfResolution.width, (float)frameBuffers.halfResolution.height, 0.0f, 1.0f);
+					scissor = vks::initializers::rect2D(frameBuffers.halfResolution.width, frameBuffers.halfResolution.height, 0, 0);
+
+					profiler.cmdBeginZone(drawCmdBuffers[i], "Downsample");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.downsample, 0, 1, &descriptorSets.downsample, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.downsample);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					profiler.cmdEndZone(drawCmdBuffers[i]);
+
+					renderPassBeginInfo.framebuffer = frameBuffers.ssaoHalf.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssaoHalf.renderPass;
+
+					profiler.cmdBeginZone(drawCmdBuffers[i], "SSAO (half resolution)");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssaoHalf, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					profiler.cmdEndZone(drawCmdBuffers[i]);
+
+					if (temporalAccumulation) {
+						renderPassBeginInfo.framebuffer = frameBuffers.ssaoTemporal.frameBuffer;
+						renderPassBeginInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+
+						profiler.cmdBeginZone(drawCmdBuffers[i], "Temporal accumulation");
+						vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+						vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+						vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+						vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.temporal, 0, 1, &descriptorSets.temporal, 0, NULL);
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.temporal);
+						vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+						vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+						// Keep the accumulated result as the history of the next frame
+						VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+						vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image,
+							VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+							VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+							VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+						vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoHistory.image,
+							VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+							VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+						VkImageCopy copyRegion{};
+						copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+						copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+						copyRegion.extent = { static_cast<uint32_t>(frameBuffers.ssaoTemporal.width), static_cast<uint32_t>(frameBuffers.ssaoTemporal.height), 1 };
+						vkCmdCopyImage(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+						vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image,
+							VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+							VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+							VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+						vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoHistory.image,
+							VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+							VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+							VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+						profiler.cmdEndZone(drawCmdBuffers[i]);
+					}
+				}
+				else {
+					/*
+						Second pass: SSAO generation
+					*/
+
+					clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+					clearValues[1].depthStencil = { 1.0f, 0 };
+
+					renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
+					renderPassBeginInfo.clearValueCount = 2;
+					renderPassBeginInfo.pClearValues = clearValues.data();
+
+					profiler.cmdBeginZone(drawCmdBuffers[i], "SSAO");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+					viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					profiler.cmdEndZone(drawCmdBuffers[i]);
+
+					/*
+						Third pass: SSAO blur
+					*/
+
+					if (computeBlur) {
+						// Separable bilateral blur, the weights fall off with the difference in linear depth so the occlusion doesn't bleed over edges
+						vks::GpuZone zone(profiler, drawCmdBuffers[i], "SSAO blur (compute)");
+						postProcessing.recordBlur(drawCmdBuffers[i], ssaoComputeBlur);
+					}
+					else {
+						profiler.cmdBeginZone(drawCmdBuffers[i], "SSAO blur");
+						renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
+						renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
+						renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
+						renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
+
+						vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+						viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
+						vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+						scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
+						vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+						vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
+						vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+						vkCmdEndRenderPass(drawCmdBuffers[i]);
+						profiler.cmdEndZone(drawCmdBuffers[i]);
+					}
+				}
 			}
 
 			/*
@@ -614,17 +1025,25 @@ public:
 				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
+				VkDescriptorSet compositionSet = computeBlur ? descriptorSets.compositionComputeBlur : descriptorSets.composition;
+				if (halfResolution) {
+					compositionSet = temporalAccumulation ? descriptorSets.compositionHalfTemporal : descriptorSets.compositionHalf;
+				}
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &compositionSet, 0, NULL);
 
 				// Final composition pass
+				profiler.cmdBeginZone(drawCmdBuffers[i], "Composition");
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				profiler.cmdEndZone(drawCmdBuffers[i]);
 
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			profiler.cmdEndFrame(drawCmdBuffers[i]);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -632,8 +1051,8 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 12),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 40)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -655,10 +1074,25 @@ public:
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.gBuffer));
 
-		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.gBuffer, vkglTF::descriptorSetLayoutImage };
+		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.gBuffer, bindlessMaterials ? vkglTF::descriptorSetLayoutBindless : vkglTF::descriptorSetLayoutImage };
 		pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
 		pipelineLayoutCreateInfo.setLayoutCount = 2;
+		// Bindless materials select their entry in the material buffer with a push constant
+		const VkPushConstantRange materialPushConstantRange = scene.getMaterialPushConstantRange();
+		if (bindlessMaterials) {
+			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pipelineLayoutCreateInfo.pPushConstantRanges = &materialPushConstantRange;
+		}
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBuffer));
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+		if (scene.indirect.enabled) {
+			// Materials are taken from the instance buffer instead of a push constant
+			const std::vector<VkDescriptorSetLayout> indirectSetLayouts = { descriptorSetLayouts.gBuffer, vkglTF::descriptorSetLayoutBindless, scene.indirect.descriptorSetLayout };
+			pipelineLayoutCreateInfo.pSetLayouts = indirectSetLayouts.data();
+			pipelineLayoutCreateInfo.setLayoutCount = 3;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBufferIndirect));
+		}
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.gBuffer;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.floor));
 		writeDescriptorSets = {
@@ -694,6 +1128,66 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// Reduced resolution SSAO generation, same layout but reads the downsampled G-Buffer
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoHalf));
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.halfResolution.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.halfResolution.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		for (auto& writeDescriptorSet : writeDescriptorSets) {
+			writeDescriptorSet.dstSet = descriptorSets.ssaoHalf;
+		}
+		writeDescriptorSets[0].pImageInfo = &imageDescriptors[0];
+		writeDescriptorSets[1].pImageInfo = &imageDescriptors[1];
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// G-Buffer downsampling
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Normals
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.downsample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.downsample));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.downsample));
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Normals
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO temporal accumulation
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS SSAO of this frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS SSAO history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Position+Depth (half resolution)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Params UBO
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.temporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.temporal));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.temporal));
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoHalf.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoHistory.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.halfResolution.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS SSAO of this frame
+			vks::initializers::writeDescriptorSet(descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS SSAO history
+			vks::initializers::writeDescriptorSet(descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),			// FS Position+Depth (half resolution)
+			vks::initializers::writeDescriptorSet(descriptorSets.temporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoParams.descriptor),	// FS Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
 		// SSAO Blur
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Sampler SSAO
@@ -720,6 +1214,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),						// FS SSAO
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),						// FS SSAO blurred
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),								// FS Lights UBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),						// FS Position+Depth (half resolution)
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.composition));
@@ -733,6 +1228,9 @@ public:
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoBlur.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.halfResolution.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoHalf.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoTemporal.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 		};
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler Position+Depth
@@ -741,8 +1239,65 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &imageDescriptors[3]),			// FS Sampler SSAO
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &imageDescriptors[4]),			// FS Sampler SSAO blurred
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &imageDescriptors[5]),			// FS Sampler Position+Depth (half resolution)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Compositions that upsample the reduced resolution SSAO, either directly or after temporal accumulation
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.compositionHalf));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.compositionHalfTemporal));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSetsHalf = writeDescriptorSets;
+		for (auto& writeDescriptorSet : writeDescriptorSetsHalf) {
+			writeDescriptorSet.dstSet = descriptorSets.compositionHalf;
+		}
+		writeDescriptorSetsHalf[3].pImageInfo = &imageDescriptors[6];
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSetsHalf.size()), writeDescriptorSetsHalf.data(), 0, NULL);
+		for (auto& writeDescriptorSet : writeDescriptorSetsHalf) {
+			writeDescriptorSet.dstSet = descriptorSets.compositionHalfTemporal;
+		}
+		writeDescriptorSetsHalf[3].pImageInfo = &imageDescriptors[7];
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSetsHalf.size()), writeDescriptorSetsHalf.data(), 0, NULL);
+
+		// Composition with the compute blur, only the blurred SSAO binding differs
+		if (computeBlurSupported) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.compositionComputeBlur));
+			for (auto& writeDescriptorSet : writeDescriptorSets) {
+				writeDescriptorSet.dstSet = descriptorSets.compositionComputeBlur;
+			}
+			writeDescriptorSets[4].pImageInfo = &ssaoComputeBlur.output.descriptor;
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
+	}
+
+	void prepareComputeBlur()
+	{
+		// The GLSL SPIR-V is generated by the build (see GLSL_BUILD_SHADERS), other shader languages may not implement the compute blurs
+		if (shaderDir != "glsl") {
+			const std::string computeBlurShaders[2] = { "base/blurseparable.comp.spv", "base/dualfilter.comp.spv" };
+			for (const std::string& shader : computeBlurShaders) {
+				if (!shaderAvailable(getShadersPath() + shader)) {
+					std::cout << "Compute blur shader \"" << shader << "\" not available for " << shaderDir << ", using the fragment shader blur" << std::endl;
+					return;
+				}
+			}
+		}
+		postProcessing.create(vulkanDevice, loadShader(getShadersPath() + "base/blurseparable.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), loadShader(getShadersPath() + "base/dualfilter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		computeBlurSupported = postProcessing.isFormatSupported(frameBuffers.ssaoBlur.color.format);
+		if (!computeBlurSupported) {
+			return;
+		}
+		// Blurs the (possibly lower resolution) SSAO into a full resolution image, linear depth is stored in the w component of the positions
+		vks::PostProcessing::BlurSettings settings;
+		settings.radius = 4;
+		settings.sigma = 2.0f;
+		settings.depthComponent = 3;
+		postProcessing.createBlur(ssaoComputeBlur, vks::PostProcessing::BlurType::Bilateral, frameBuffers.ssao.color.view, width, height, frameBuffers.ssaoBlur.color.format, settings, frameBuffers.offscreen.position.view);
+		computeBlur = true;
+	}
+
+	void prepareProfiler()
+	{
+		profiler.create(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 16, 0);
 	}
 
 	void preparePipelines()
@@ -774,9 +1329,19 @@ public:
 		pipelineCreateInfo.pVertexInputState = &emptyVertexInputState;
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 
+		reducedResolutionSupported = true;
+		const std::string reducedResolutionShaders[4] = { "ssao/ssao_reduced.frag.spv", "ssao/composition_reduced.frag.spv", "ssao/downsample.frag.spv", "ssao/temporal.frag.spv" };
+		for (const std::string& shader : reducedResolutionShaders) {
+			if (!shaderAvailable(getShadersPath() + shader)) {
+				std::cout << "Reduced resolution shader \"" << shader << "\" not found (see data/shaders/glsl/compileshaders.py), SSAO is computed at full resolution only" << std::endl;
+				reducedResolutionSupported = false;
+				break;
+			}
+		}
+
 		// Final composition pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "ssao/fullscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "ssao/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (reducedResolutionSupported ? "ssao/composition_reduced.frag.spv" : "ssao/composition.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.composition));
 
 		// SSAO generation pipeline
@@ -793,7 +1358,7 @@ public:
 				vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, radius), sizeof(SpecializationData::radius))
 			};
 			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(2, specializationMapEntries.data(), sizeof(specializationData), &specializationData);
-			shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + (reducedResolutionSupported ? "ssao/ssao_reduced.frag.spv" : "ssao/ssao.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 			shaderStages[1].pSpecializationInfo = &specializationInfo;
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
 		}
@@ -806,6 +1371,30 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
 		}
 
+		// G-Buffer downsampling pipeline
+		if (reducedResolutionSupported) {
+			pipelineCreateInfo.renderPass = frameBuffers.halfResolution.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.downsample;
+			std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = {
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
+			};
+			colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+			colorBlendState.pAttachments = blendAttachmentStates.data();
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/downsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.downsample));
+			colorBlendState.attachmentCount = 1;
+			colorBlendState.pAttachments = &blendAttachmentState;
+		}
+
+		// SSAO temporal accumulation pipeline
+		if (reducedResolutionSupported) {
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.temporal;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.temporal));
+		}
+
 		// Fill G-Buffer pipeline
 		{
 			// Vertex input state from glTF model loader
@@ -824,8 +1413,14 @@ public:
 			colorBlendState.pAttachments = blendAttachmentStates.data();
 			rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 			shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-			shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + (bindlessMaterials ? "ssao/gbuffer_bindless.frag.spv" : "ssao/gbuffer.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
+			if (scene.indirect.enabled) {
+				pipelineCreateInfo.layout = pipelineLayouts.gBufferIndirect;
+				shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer_indirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+				shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer_indirect.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+				VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreenIndirect));
+			}
 		}
 	}
 
@@ -834,6 +1429,45 @@ public:
 		return a + f * (b - a);
 	}
 
+	// Van der Corput sequence in the given base, the n-th component of a Halton point
+	static float radicalInverse(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / float(base);
+		while (index > 0) {
+			result += float(index % base) * fraction;
+			index /= base;
+			fraction /= float(base);
+		}
+		return result;
+	}
+
+	// Hemisphere kernel built from a Halton sequence instead of random numbers
+	// The points are well distributed for every prefix and every interleaved subset, which the temporal mode relies on
+	// when it only evaluates every n-th sample per frame. The kernel only depends on SSAO_KERNEL_SIZE, so it's generated once
+	const std::vector<glm::vec4>& getSSAOKernel()
+	{
+		static std::vector<glm::vec4> kernel;
+		if (!kernel.empty()) {
+			return kernel;
+		}
+		kernel.resize(SSAO_KERNEL_SIZE);
+		for (uint32_t i = 0; i < SSAO_KERNEL_SIZE; ++i)
+		{
+			// Skip the first point, which is zero in every base
+			const float phi = radicalInverse(i + 1, 2) * 2.0f * glm::pi<float>();
+			const float cosTheta = radicalInverse(i + 1, 3);
+			const float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+			glm::vec3 sample(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+			sample *= radicalInverse(i + 1, 5);
+			// Place more samples closer to the origin
+			float scale = float(i) / float(SSAO_KERNEL_SIZE);
+			scale = lerp(0.1f, 1.0f, scale * scale);
+			kernel[i] = glm::vec4(sample * scale, 0.0f);
+		}
+		return kernel;
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -860,16 +1494,7 @@ public:
 		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
 
 		// Sample kernel
-		std::vector<glm::vec4> ssaoKernel(SSAO_KERNEL_SIZE);
-		for (uint32_t i = 0; i < SSAO_KERNEL_SIZE; ++i)
-		{
-			glm::vec3 sample(rndDist(rndEngine) * 2.0 - 1.0, rndDist(rndEngine) * 2.0 - 1.0, rndDist(rndEngine));
-			sample = glm::normalize(sample);
-			sample *= rndDist(rndEngine);
-			float scale = float(i) / float(SSAO_KERNEL_SIZE);
-			scale = lerp(0.1f, 1.0f, scale * scale);
-			ssaoKernel[i] = glm::vec4(sample * scale, 0.0f);
-		}
+		const std::vector<glm::vec4>& ssaoKernel = getSSAOKernel();
 
 		// Upload as UBO
 		vulkanDevice->createBuffer(
@@ -877,7 +1502,7 @@ public:
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&uniformBuffers.ssaoKernel,
 			ssaoKernel.size() * sizeof(glm::vec4),
-			ssaoKernel.data());
+			const_cast<glm::vec4*>(ssaoKernel.data()));
 
 		// Random noise
 		std::vector<glm::vec4> ssaoNoise(SSAO_NOISE_DIM * SSAO_NOISE_DIM);
@@ -894,6 +1519,7 @@ public:
 		uboSceneParams.projection = camera.matrices.perspective;
 		uboSceneParams.view = camera.matrices.view;
 		uboSceneParams.model = glm::mat4(1.0f);
+		scene.updateIndirectCulling(uboSceneParams.projection * uboSceneParams.view * uboSceneParams.model);
 
 		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
 		uniformBuffers.sceneParams.copyTo(&uboSceneParams, sizeof(uboSceneParams));
@@ -909,12 +1535,43 @@ public:
 		uniformBuffers.ssaoParams.unmap();
 	}
 
+	// Applies the reduced resolution and temporal accumulation toggles to the SSAO parameters
+	void updateReducedResolutionParams()
+	{
+		const bool temporal = halfResolution && temporalAccumulation;
+		uboSSAOParams.upsample = halfResolution;
+		uboSSAOParams.sampleCount = temporal ? SSAO_KERNEL_SIZE / SSAO_TEMPORAL_FRAMES : SSAO_KERNEL_SIZE;
+		uboSSAOParams.sampleStride = temporal ? SSAO_TEMPORAL_FRAMES : 1;
+		uboSSAOParams.frameIndex = 0;
+		uboSSAOParams.historyWeight = 0.0f;
+		// The history may be stale, so the first frame after a toggle starts over
+		historyValid = false;
+		updateUniformBufferSSAOParams();
+	}
+
+	// Advances the kernel subset and passes the previous frame's camera for the history reprojection
+	void updateTemporalParams()
+	{
+		const glm::mat4 viewProjection = camera.matrices.perspective * camera.matrices.view;
+		// Wraps once every kernel subset has been combined with every noise offset
+		uboSSAOParams.frameIndex = (uboSSAOParams.frameIndex + 1) % (SSAO_TEMPORAL_FRAMES * SSAO_NOISE_DIM * SSAO_NOISE_DIM);
+		// The G-Buffer stores view space positions and the scene's model matrix is the identity
+		uboSSAOParams.viewToPrevClip = (historyValid ? prevViewProjection : viewProjection) * glm::inverse(camera.matrices.view);
+		uboSSAOParams.historyWeight = historyValid ? 0.9f : 0.0f;
+		prevViewProjection = viewProjection;
+		historyValid = true;
+		updateUniformBufferSSAOParams();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		// Timings of earlier frames have to be read before this submission resets their queries
+		profiler.update();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		profiler.submitted(currentBuffer);
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -924,6 +1581,8 @@ public:
 		loadAssets();
 		prepareOffscreenFramebuffers();
 		prepareUniformBuffers();
+		prepareComputeBlur();
+		prepareProfiler();
 		setupDescriptorPool();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
@@ -936,7 +1595,17 @@ public:
 		if (!prepared) {
 			return;
 		}
+		if (halfResolution && temporalAccumulation) {
+			updateTemporalParams();
+		}
 		draw();
+		if (benchmark.active && computeBlurSupported) {
+			benchmarkFrame++;
+			if (benchmarkFrame % 300 == 0) {
+				computeBlur = !computeBlur;
+				buildCommandBuffers();
+			}
+		}
 		if (camera.updated) {
 			updateUniformBufferMatrices();
 			updateUniformBufferSSAOParams();
@@ -958,9 +1627,32 @@ public:
 			if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
 				updateUniformBufferSSAOParams();
 			}
+			if (computeBlurSupported && overlay->checkBox("Compute blur (bilateral)", &computeBlur)) {
+				buildCommandBuffers();
+			}
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
 			}
+			if (reducedResolutionSupported && overlay->checkBox("Half resolution", &halfResolution)) {
+				updateReducedResolutionParams();
+				buildCommandBuffers();
+			}
+			if (halfResolution && overlay->checkBox("Temporal accumulation", &temporalAccumulation)) {
+				updateReducedResolutionParams();
+				buildCommandBuffers();
+			}
+			overlay->text(bindlessMaterials ? "Materials: bindless" : "Materials: descriptor set per material");
+			if (scene.indirect.enabled) {
+				if (overlay->checkBox("GPU driven rendering", &gpuDriven)) {
+					buildCommandBuffers();
+				}
+				if (gpuDriven) {
+					overlay->text("Visible draws: %u / %u", scene.getIndirectVisibleCount(), scene.indirect.instanceCount);
+				}
+			}
+		}
+		if (overlay->header("GPU timings")) {
+			profiler.onUpdateUIOverlay(overlay);
 		}
 	}
 };
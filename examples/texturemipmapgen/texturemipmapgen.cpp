@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMipGenerator.h"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -28,6 +29,14 @@ public:
 	std::vector<std::string> samplerNames{ "No mip maps" , "Mip maps (bilinear)" , "Mip maps (anisotropic)" };
 	std::vector<VkSampler> samplers;
 
+	// The mip chain can be generated with blits or with compute shaders (see base/VulkanMipGenerator.h)
+	enum MipGenerationMode { Blit = 0, ComputeBox = 1, ComputeBoxSrgb = 2, ComputeKaiser = 3 };
+	std::vector<std::string> mipGenerationNames{ "Blit", "Compute (box)", "Compute (box, sRGB)", "Compute (Kaiser)" };
+	int32_t mipGenerationMode = ComputeBox;
+	vks::MipGenerator mipGenerator;
+	// Time spent on generating the mip chain of the current texture, including the submit and wait
+	float mipGenerationTime = 0.0f;
+
 	vkglTF::Model model;
 
 	vks::Buffer uniformBufferVS;
@@ -61,6 +70,8 @@ public:
 	~VulkanExample()
 	{
 		destroyTextureImage(texture);
+		mipGenerator.destroy();
+		vkglTF::mipGenerator = nullptr;
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -116,12 +127,16 @@ public:
 		// Calculated as log2(max(width, height, depth))c + 1 (see specs)
 		texture.mipLevels = floor(log2(std::max(texture.width, texture.height))) + 1;
 
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-		// Mip-chain generation requires support for blit source and destination
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		// Compute shader mip generation writes the levels as storage images, fall back to blits if the format doesn't support this
+		const bool computeMips = (mipGenerationMode != Blit) && mipGenerator.isFormatSupported(format);
+		if (!computeMips) {
+			// Get device properties for the requested texture format
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+			// Mip-chain generation requires support for blit source and destination
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		}
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
@@ -160,6 +175,9 @@ public:
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { texture.width, texture.height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (computeMips) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -171,7 +189,8 @@ public:
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
+		// The mip generator expects all levels to be in the same layout
+		subresourceRange.levelCount = computeMips ? texture.mipLevels : 1;
 		subresourceRange.layerCount = 1;
 
 		// Optimal image will be used as destination for the copy, so we must transfer from our initial undefined image layout to the transfer destination layout
@@ -199,16 +218,18 @@ public:
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 		// Transition first mip level to transfer source for read during blit
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			texture.image,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			subresourceRange);
+		if (!computeMips) {
+			vks::tools::insertImageMemoryBarrier(
+				copyCmd,
+				texture.image,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				subresourceRange);
+		}
 
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
@@ -219,90 +240,114 @@ public:
 
 		// Generate the mip chain
 		// ---------------------------------------------------------------
-		// We copy down the whole mip chain doing a blit from mip-1 to mip
-		// An alternative way would be to always blit from the first mip level and sample that one down
-		VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Copy down mips from n-1 to n
-		for (int32_t i = 1; i < texture.mipLevels; i++)
-		{
-			VkImageBlit imageBlit{};
-
-			// Source
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i-1;
-			imageBlit.srcOffsets[1].x = int32_t(texture.width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(texture.height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			// Destination
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(texture.width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(texture.height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
-			// Prepare current mip level as image blit destination
-			vks::tools::insertImageMemoryBarrier(
-				blitCmd,
-				texture.image,
-				0,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				mipSubRange);
-
-			// Blit from previous level
-			vkCmdBlitImage(
-				blitCmd,
-				texture.image,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				texture.image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageBlit,
-				VK_FILTER_LINEAR);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (computeMips) {
+			// All levels are written by compute shaders, with a single dispatch for the box filter
+			vks::MipFilter filter = (mipGenerationMode == ComputeKaiser) ? vks::MipFilter::Kaiser : vks::MipFilter::Box;
+			mipGenerator.generate(texture.image, format, texture.width, texture.height, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, queue, filter, mipGenerationMode == ComputeBoxSrgb);
+		}
+		else {
+			// We copy down the whole mip chain doing a blit from mip-1 to mip
+			// An alternative way would be to always blit from the first mip level and sample that one down
+			VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+			// Copy down mips from n-1 to n
+			for (int32_t i = 1; i < texture.mipLevels; i++)
+			{
+				VkImageBlit imageBlit{};
+
+				// Source
+				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.srcSubresource.layerCount = 1;
+				imageBlit.srcSubresource.mipLevel = i-1;
+				imageBlit.srcOffsets[1].x = int32_t(texture.width >> (i - 1));
+				imageBlit.srcOffsets[1].y = int32_t(texture.height >> (i - 1));
+				imageBlit.srcOffsets[1].z = 1;
+
+				// Destination
+				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.dstSubresource.layerCount = 1;
+				imageBlit.dstSubresource.mipLevel = i;
+				imageBlit.dstOffsets[1].x = int32_t(texture.width >> i);
+				imageBlit.dstOffsets[1].y = int32_t(texture.height >> i);
+				imageBlit.dstOffsets[1].z = 1;
+
+				VkImageSubresourceRange mipSubRange = {};
+				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				mipSubRange.baseMipLevel = i;
+				mipSubRange.levelCount = 1;
+				mipSubRange.layerCount = 1;
+
+				// Prepare current mip level as image blit destination
+				vks::tools::insertImageMemoryBarrier(
+					blitCmd,
+					texture.image,
+					0,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					mipSubRange);
+
+				// Blit from previous level
+				vkCmdBlitImage(
+					blitCmd,
+					texture.image,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					texture.image,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1,
+					&imageBlit,
+					VK_FILTER_LINEAR);
+
+				// Prepare current mip level as image blit source for next level
+				vks::tools::insertImageMemoryBarrier(
+					blitCmd,
+					texture.image,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_ACCESS_TRANSFER_READ_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					mipSubRange);
+			}
 
-			// Prepare current mip level as image blit source for next level
+			// After the loop, all mip layers are in TRANSFER_SRC layout, so transition all to SHADER_READ
+			subresourceRange.levelCount = texture.mipLevels;
 			vks::tools::insertImageMemoryBarrier(
 				blitCmd,
 				texture.image,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
 				VK_ACCESS_TRANSFER_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_ACCESS_SHADER_READ_BIT,
 				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				mipSubRange);
-		}
-
-		// After the loop, all mip layers are in TRANSFER_SRC layout, so transition all to SHADER_READ
-		subresourceRange.levelCount = texture.mipLevels;
-		vks::tools::insertImageMemoryBarrier(
-			blitCmd,
-			texture.image,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			subresourceRange);
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				subresourceRange);
 
-		vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
+			vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
+		}
+		mipGenerationTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 		// ---------------------------------------------------------------
 
-		// Create samplers
+		// Create image view
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.image = texture.image;
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view.subresourceRange.baseMipLevel = 0;
+		view.subresourceRange.baseArrayLayer = 0;
+		view.subresourceRange.layerCount = 1;
+		view.subresourceRange.levelCount = texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+	}
+
+	// The samplers don't depend on the texture, so they are kept when the texture is recreated
+	void prepareSamplers()
+	{
 		samplers.resize(3);
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_LINEAR;
@@ -323,7 +368,7 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[0]));
 
 		// With mip mapping
-		sampler.maxLod = (float)texture.mipLevels;
+		sampler.maxLod = VK_LOD_CLAMP_NONE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[1]));
 
 		// With mip mapping and anisotropic filtering
@@ -333,18 +378,6 @@ public:
 			sampler.anisotropyEnable = VK_TRUE;
 		}
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = texture.image;
-		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.format = format;
-		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		view.subresourceRange.baseMipLevel = 0;
-		view.subresourceRange.baseArrayLayer = 0;
-		view.subresourceRange.layerCount = 1;
-		view.subresourceRange.levelCount = texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -420,6 +453,34 @@ public:
 		loadTexture(getAssetPath() + "textures/metalplate_nomips_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, false);
 	}
 
+	void prepareMipGenerator()
+	{
+		const std::string boxShader = getShadersPath() + "base/mipgen.comp.spv";
+		const std::string kaiserShader = getShadersPath() + "base/mipgenkaiser.comp.spv";
+		if (!shaderAvailable(boxShader) || !shaderAvailable(kaiserShader)) {
+			std::cout << "Mip generation compute shaders not found (see data/shaders/glsl/compileshaders.py), using blits" << std::endl;
+			mipGenerationMode = Blit;
+			mipGenerationNames.resize(1);
+			return;
+		}
+		mipGenerator.create(vulkanDevice, loadShader(boxShader, VK_SHADER_STAGE_COMPUTE_BIT), loadShader(kaiserShader, VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		// Also used for the textures of glTF models
+		vkglTF::mipGenerator = &mipGenerator;
+	}
+
+	// Recreates the texture with the currently selected mip generation mode
+	void reloadTexture()
+	{
+		vkDeviceWaitIdle(device);
+		destroyTextureImage(texture);
+		loadTexture(getAssetPath() + "textures/metalplate_nomips_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, false);
+		VkDescriptorImageInfo textureDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, &textureDescriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		// Updating the descriptor set invalidates the command buffers that use it
+		buildCommandBuffers();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
@@ -546,6 +607,8 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		prepareMipGenerator();
+		prepareSamplers();
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -576,6 +639,10 @@ public:
 			if (overlay->comboBox("Sampler type", &uboVS.samplerIndex, samplerNames)) {
 				updateUniformBuffers();
 			}
+			if (overlay->comboBox("Mip generation", &mipGenerationMode, mipGenerationNames)) {
+				reloadTexture();
+			}
+			overlay->text("Generation time: %.2f ms", mipGenerationTime);
 		}
 	}
 };
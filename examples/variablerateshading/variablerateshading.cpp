@@ -24,8 +24,10 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 
 VulkanExample::~VulkanExample()
 {
+	vkDestroyPipeline(device, basePipelines.blended, nullptr);
 	vkDestroyPipeline(device, basePipelines.masked, nullptr);
 	vkDestroyPipeline(device, basePipelines.opaque, nullptr);
+	vkDestroyPipeline(device, shadingRatePipelines.blended, nullptr);
 	vkDestroyPipeline(device, shadingRatePipelines.masked, nullptr);
 	vkDestroyPipeline(device, shadingRatePipelines.opaque, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -86,6 +88,9 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	// Blended nodes are drawn back to front for the current view
+	scene.sortBlendedPrimitives(camera.matrices.view * shaderData.values.model);
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
@@ -106,6 +111,8 @@ void VulkanExample::buildCommandBuffers()
 		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
 		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blended);
+		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaBlendedNodes, pipelineLayout);
 
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -338,13 +345,28 @@ void VulkanExample::preparePipelines()
 	VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(specializationData), &specializationData);
 	shaderStages[1].pSpecializationInfo = &specializationInfo;
 
+	// Blended materials are drawn after all other nodes with depth testing against them, but without writing depth
+	auto setBlending = [&](bool enable) {
+		blendAttachmentStateCI.blendEnable = enable ? VK_TRUE : VK_FALSE;
+		blendAttachmentStateCI.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentStateCI.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStateCI.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentStateCI.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentStateCI.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentStateCI.alphaBlendOp = VK_BLEND_OP_ADD;
+		depthStencilStateCI.depthWriteEnable = enable ? VK_FALSE : VK_TRUE;
+	};
+
 	// Create pipeline without shading rate 
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.opaque));
 	specializationData.alphaMask = true;
 	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.masked));
-	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
 	specializationData.alphaMask = false;
+	setBlending(true);
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.blended));
+	setBlending(false);
+	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
 
 	// Create pipeline with shading rate enabled
 	// [POI] Possible per-Viewport shading rate palette entries
@@ -375,6 +397,9 @@ void VulkanExample::preparePipelines()
 	specializationData.alphaMask = true;
 	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.masked));
+	specializationData.alphaMask = false;
+	setBlending(true);
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.blended));
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -420,6 +445,10 @@ void VulkanExample::prepare()
 
 void VulkanExample::render()
 {
+	if (camera.updated && (scene.drawList.ranges[vkglTF::Material::ALPHAMODE_BLEND].count > 1)) {
+		// The back to front order of the blended nodes changes with the view
+		buildCommandBuffers();
+	}
 	renderFrame();
 	if (camera.updated) {
 		updateUniformBuffers();
@@ -40,6 +40,7 @@ public:
 	struct Pipelines {
 		VkPipeline opaque;
 		VkPipeline masked;
+		VkPipeline blended;
 	};
 
 	Pipelines basePipelines;
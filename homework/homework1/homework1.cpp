@@ -26,6 +26,8 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "VulkanImageProcessing.h"
+#include "threadpool.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -116,6 +118,13 @@ public:
 	std::vector<Material> materials;
 	std::vector<Node*> nodes;
 
+	// Time spent on converting the images and generating their mip chains on the CPU
+	struct {
+		float time = 0.0f;
+		size_t sourceBytes = 0;
+		uint32_t threadCount = 0;
+	} imageProcessing;
+
 	~VulkanglTFModel()
 	{
 		for (auto node : nodes) {
@@ -144,35 +153,38 @@ public:
 	{
 		// Images can be stored inside the glTF (which is the case for the sample model), so instead of directly
 		// loading them from disk, we fetch them from the glTF loader and upload the buffers
+		// The images are converted to RGBA and get their full mip chain generated on the CPU, with one job per image
 		images.resize(input.images.size());
+		std::vector<vks::imageprocessing::MipChain> mipChains(input.images.size());
+		auto tStart = std::chrono::high_resolution_clock::now();
+		imageProcessing.sourceBytes = 0;
+		imageProcessing.threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<uint32_t>(input.images.size())));
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(imageProcessing.threadCount);
 		for (size_t i = 0; i < input.images.size(); i++) {
-			tinygltf::Image& glTFImage = input.images[i];
-			// Get the image data from the glTF loader
-			unsigned char* buffer = nullptr;
-			VkDeviceSize bufferSize = 0;
-			bool deleteBuffer = false;
-			// We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
-			if (glTFImage.component == 3) {
-				bufferSize = glTFImage.width * glTFImage.height * 4;
-				buffer = new unsigned char[bufferSize];
-				unsigned char* rgba = buffer;
-				unsigned char* rgb = &glTFImage.image[0];
-				for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i) {
-					memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-					rgba += 4;
-					rgb += 3;
+			tinygltf::Image* glTFImage = &input.images[i];
+			vks::imageprocessing::MipChain* mipChain = &mipChains[i];
+			imageProcessing.sourceBytes += glTFImage->image.size();
+			threadPool.threads[i % imageProcessing.threadCount]->addJob([glTFImage, mipChain] {
+				const size_t pixelCount = static_cast<size_t>(glTFImage->width) * glTFImage->height;
+				// We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
+				if (glTFImage->component == 3) {
+					std::vector<uint8_t> rgba(pixelCount * 4);
+					vks::imageprocessing::expandRgbToRgba(rgba.data(), glTFImage->image.data(), pixelCount);
+					vks::imageprocessing::generateMipChain(*mipChain, rgba.data(), glTFImage->width, glTFImage->height);
 				}
-				deleteBuffer = true;
-			}
-			else {
-				buffer = &glTFImage.image[0];
-				bufferSize = glTFImage.image.size();
-			}
-			// Load texture from image buffer
-			images[i].texture.fromBuffer(buffer, bufferSize, VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height, vulkanDevice, copyQueue);
-			if (deleteBuffer) {
-				delete[] buffer;
-			}
+				else {
+					vks::imageprocessing::generateMipChain(*mipChain, glTFImage->image.data(), glTFImage->width, glTFImage->height);
+				}
+			});
+		}
+		threadPool.wait();
+		imageProcessing.time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		for (size_t i = 0; i < input.images.size(); i++) {
+			tinygltf::Image& glTFImage = input.images[i];
+			// Load texture from image buffer, including all mip levels
+			images[i].texture.fromBuffer(mipChains[i].data.data(), mipChains[i].data.size(), VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height, vulkanDevice, copyQueue, VK_FILTER_LINEAR, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipChains[i].levelCount());
 		}
 	}
 
@@ -385,6 +397,10 @@ public:
 
 	VulkanglTFModel glTFModel;
 
+	// Results of the image processing benchmark, compared against the per byte loops previously used for loading
+	vks::imageprocessing::BenchmarkResult imageBenchmark;
+	bool imageBenchmarkDone = false;
+
 	struct ShaderData {
 		vks::Buffer buffer;
 		struct Values {
@@ -752,6 +768,20 @@ public:
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("Image processing")) {
+			const float rate = glTFModel.imageProcessing.time > 0.0f ? glTFModel.imageProcessing.sourceBytes / (glTFModel.imageProcessing.time * 1000.0f) : 0.0f;
+			overlay->text("Mip chains: %.2f ms (%.0f MB/s, %u threads)", glTFModel.imageProcessing.time, rate, glTFModel.imageProcessing.threadCount);
+			if (overlay->button("Run benchmark")) {
+				vks::ThreadPool threadPool;
+				threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+				imageBenchmark = vks::imageprocessing::benchmark(1024, 1024, vks::imageprocessing::Filter::Box, true, &threadPool);
+				imageBenchmarkDone = true;
+			}
+			if (imageBenchmarkDone) {
+				overlay->text("RGB to RGBA: %.0f MB/s (loop: %.0f MB/s)", imageBenchmark.expandRate / 1.0e6, imageBenchmark.referenceExpandRate / 1.0e6);
+				overlay->text("sRGB mip chain: %.0f MB/s (loop: %.0f MB/s)", imageBenchmark.mipChainRate / 1.0e6, imageBenchmark.referenceMipChainRate / 1.0e6);
+			}
+		}
 	}
 };
 
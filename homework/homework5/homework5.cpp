@@ -10,8 +10,12 @@
 
 // For reference see http://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
 
+#include <iomanip>
+#include <sstream>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanSphericalHarmonics.h"
+#include "VulkanIBLCache.h"
 
 #define ENABLE_VALIDATION false
 
@@ -34,6 +38,30 @@ public:
 		vks::Texture2D roughnessMap;
 	} textures;
 
+	// Settings for the textures generated at runtime, these are also part of the cache key
+	struct IBLSettings {
+		VkFormat lutBrdfFormat = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
+		uint32_t lutBrdfDim = 512;
+		VkFormat irradianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		uint32_t irradianceDim = 64;
+		float irradianceDeltaPhi = (2.0f * float(M_PI)) / 180.0f;
+		float irradianceDeltaTheta = (0.5f * float(M_PI)) / 64.0f;
+		VkFormat prefilteredFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		uint32_t prefilteredDim = 512;
+		uint32_t prefilteredSamples = 32;
+	} iblSettings;
+
+	// The generated textures are stored in the cache directory and loaded on later runs instead of being generated again
+	vks::IBLCache iblCache;
+
+	// Diffuse irradiance can be evaluated from spherical harmonics projected on the CPU instead of using the irradiance cube map
+	// The cube map is then only generated when switching to it at runtime
+	bool shIrradiance = true;
+	// Only the GLSL shaders have a variant that evaluates the spherical harmonics
+	bool shIrradianceSupported = false;
+	bool irradianceCubePrepared = false;
+	vks::sh::SH9 irradianceSH{};
+
 	struct Meshes {
 		vkglTF::Model skybox;
 		vkglTF::Model object;
@@ -43,6 +71,7 @@ public:
 		vks::Buffer object;
 		vks::Buffer skybox;
 		vks::Buffer params;
+		vks::Buffer irradianceSH;
 	} uniformBuffers;
 
     vks::Buffer instanceBuffer;
@@ -63,6 +92,7 @@ public:
 	struct {
 		VkPipeline skybox;
 		VkPipeline pbr;
+		VkPipeline pbrSH = VK_NULL_HANDLE;
 	} pipelines;
 
 	struct {
@@ -90,6 +120,7 @@ public:
 	{
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
 		vkDestroyPipeline(device, pipelines.pbr, nullptr);
+		vkDestroyPipeline(device, pipelines.pbrSH, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -97,10 +128,13 @@ public:
 		uniformBuffers.object.destroy();
 		uniformBuffers.skybox.destroy();
 		uniformBuffers.params.destroy();
+		uniformBuffers.irradianceSH.destroy();
         instanceBuffer.destroy();
 
 		textures.environmentCube.destroy();
-		textures.irradianceCube.destroy();
+		if (irradianceCubePrepared) {
+			textures.irradianceCube.destroy();
+		}
 		textures.prefilteredCube.destroy();
 		textures.lutBrdf.destroy();
 		textures.albedoMap.destroy();
@@ -161,7 +195,7 @@ public:
 
 			// Objects
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.object, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.pbr);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shIrradiance ? pipelines.pbrSH : pipelines.pbr);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 1, 1, &instanceBuffer.buffer, offsets);
 			models.object.draw(drawCmdBuffers[i],0, nullptr, 1, 4*4*4);
 
@@ -178,7 +212,8 @@ public:
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.object.loadFromFile(getAssetPath() + "models/cerberus/cerberus.gltf", vulkanDevice, queue, glTFLoadingFlags);
-		textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+		iblCache.setEnvironment(getAssetPath() + "textures/hdr/gcanyon_cube.ktx");
+		textures.environmentCube.loadFromFile(iblCache.getEnvironment(), VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
 		textures.albedoMap.loadFromFile(getAssetPath() + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.normalMap.loadFromFile(getAssetPath() + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.aoMap.loadFromFile(getAssetPath() + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
@@ -190,7 +225,7 @@ public:
 	{
 		// Descriptor Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =	vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
@@ -208,6 +243,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 8),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 9),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 10),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = 	vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
@@ -220,7 +256,8 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.object.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffers.params.descriptor),
-			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.irradianceCube.descriptor),
+			// The irradiance cube map may not have been generated yet, it's not accessed by the spherical harmonics pipeline so the environment map is used as a placeholder
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, irradianceCubePrepared ? &textures.irradianceCube.descriptor : &textures.environmentCube.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &textures.lutBrdf.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &textures.prefilteredCube.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &textures.albedoMap.descriptor),
@@ -228,6 +265,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &textures.aoMap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8, &textures.metallicMap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9, &textures.roughnessMap.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10, &uniformBuffers.irradianceSH.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -324,6 +362,82 @@ public:
         pipelineCI.pVertexInputState = &vertexInput;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.pbr));
+
+		// PBR pipeline variant that evaluates the diffuse irradiance from spherical harmonics
+		if (!shIrradianceSupported) {
+			return;
+		}
+		shaderStages[1] = loadShader(getHomeworkShadersPath() + "homework5/pbrtexturesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VkBool32 shIrradianceEnabled = VK_TRUE;
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &shIrradianceEnabled);
+		shaderStages[1].pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.pbrSH));
+	}
+
+	// Loads the irradiance cube from the cache if possible, otherwise it's generated
+	void prepareIrradianceCube()
+	{
+		const std::string key = iblCache.getKey({ getHomeworkShadersPath() + "homework5/filtercube.vert.spv", getHomeworkShadersPath() + "homework5/irradiancecube.frag.spv" }, true, &iblSettings, sizeof(IBLSettings));
+		iblCache.prepare(textures.irradianceCube, "irradiance", iblSettings.irradianceFormat, key, vulkanDevice, queue, [this]() { generateIrradianceCube(); });
+		irradianceCubePrepared = true;
+	}
+
+	// Projects the environment map onto spherical harmonics on the CPU and convolves them for diffuse irradiance
+	void computeIrradianceSH()
+	{
+		ktxTexture* ktxTexture;
+		ktxResult result = textures.environmentCube.loadKTXFile(iblCache.getEnvironment(), &ktxTexture);
+		assert(result == KTX_SUCCESS);
+		// Comparing against the reference projection is only worth its cost when debugging
+		const bool projected = vks::sh::computeIrradiance(ktxTexture, VK_FORMAT_R16G16B16A16_SFLOAT, irradianceSH, settings.validation);
+		ktxTexture_Destroy(ktxTexture);
+		if (!projected) {
+			vks::tools::exitFatal("Could not project the environment map onto spherical harmonics", -1);
+		}
+	}
+
+	// Loads the image based lighting textures from the cache if possible, otherwise they're generated and stored in the cache
+	void prepareIBLTextures()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		iblCache.timeSaved = 0.0;
+
+		// BRDF LUT (does not depend on the environment map)
+		const std::string lutBrdfKey = iblCache.getKey({ getHomeworkShadersPath() + "homework5/genbrdflut.vert.spv", getHomeworkShadersPath() + "homework5/genbrdflut.frag.spv" }, false, &iblSettings, sizeof(IBLSettings));
+		if (iblCache.prepare(textures.lutBrdf, "lutbrdf", iblSettings.lutBrdfFormat, lutBrdfKey, vulkanDevice, queue, [this]() { generateBRDFLUT(); })) {
+			// The LUT must not wrap around at the edges
+			vkDestroySampler(device, textures.lutBrdf.sampler, nullptr);
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_LINEAR;
+			samplerCI.minFilter = VK_FILTER_LINEAR;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.minLod = 0.0f;
+			samplerCI.maxLod = 1.0f;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.lutBrdf.sampler));
+			textures.lutBrdf.updateDescriptor();
+		}
+
+		// Irradiance cube
+		if (!shIrradiance) {
+			prepareIrradianceCube();
+		}
+
+		// Pre-filtered environment cube
+		const std::string prefilteredKey = iblCache.getKey({ getHomeworkShadersPath() + "homework5/filtercube.vert.spv", getHomeworkShadersPath() + "homework5/prefilterenvmap.frag.spv" }, true, &iblSettings, sizeof(IBLSettings));
+		iblCache.prepare(textures.prefilteredCube, "prefiltered", iblSettings.prefilteredFormat, prefilteredKey, vulkanDevice, queue, [this]() { generatePrefilteredCube(); });
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		std::cout << "Preparing image based lighting textures took " << tDiff << " ms";
+		if (iblCache.timeSaved > 0.0) {
+			std::cout << ", loading from the cache saved " << std::max(iblCache.timeSaved - tDiff, 0.0) << " ms (generation took " << iblCache.timeSaved << " ms)";
+		}
+		std::cout << std::endl;
 	}
 
 	// Generate a BRDF integration map used as a look-up-table (stores roughness / NdotV)
@@ -331,8 +445,8 @@ public:
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
-		const int32_t dim = 512;
+		const VkFormat format = iblSettings.lutBrdfFormat;
+		const int32_t dim = static_cast<int32_t>(iblSettings.lutBrdfDim);
 
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -345,7 +459,8 @@ public:
 		imageCI.arrayLayers = 1;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// Transfer source is required for storing the image in the cache
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -380,6 +495,11 @@ public:
 		textures.lutBrdf.descriptor.imageView = textures.lutBrdf.view;
 		textures.lutBrdf.descriptor.sampler = textures.lutBrdf.sampler;
 		textures.lutBrdf.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.lutBrdf.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.lutBrdf.width = dim;
+		textures.lutBrdf.height = dim;
+		textures.lutBrdf.mipLevels = 1;
+		textures.lutBrdf.layerCount = 1;
 		textures.lutBrdf.device = vulkanDevice;
 
 		// FB, Att, RP, Pipe, etc.
@@ -535,8 +655,8 @@ public:
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		const int32_t dim = 64;
+		const VkFormat format = iblSettings.irradianceFormat;
+		const int32_t dim = static_cast<int32_t>(iblSettings.irradianceDim);
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
 		// Pre-filtered cube map
@@ -551,7 +671,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -587,6 +707,11 @@ public:
 		textures.irradianceCube.descriptor.imageView = textures.irradianceCube.view;
 		textures.irradianceCube.descriptor.sampler = textures.irradianceCube.sampler;
 		textures.irradianceCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.irradianceCube.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.irradianceCube.width = dim;
+		textures.irradianceCube.height = dim;
+		textures.irradianceCube.mipLevels = numMips;
+		textures.irradianceCube.layerCount = 6;
 		textures.irradianceCube.device = vulkanDevice;
 
 		// FB, Att, RP, Pipe, etc.
@@ -725,9 +850,11 @@ public:
 		struct PushBlock {
 			glm::mat4 mvp;
 			// Sampling deltas
-			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
+			float deltaPhi;
+			float deltaTheta;
 		} pushBlock;
+		pushBlock.deltaPhi = iblSettings.irradianceDeltaPhi;
+		pushBlock.deltaTheta = iblSettings.irradianceDeltaTheta;
 
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -915,8 +1042,8 @@ public:
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		const int32_t dim = 512;
+		const VkFormat format = iblSettings.prefilteredFormat;
+		const int32_t dim = static_cast<int32_t>(iblSettings.prefilteredDim);
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
 		// Pre-filtered cube map
@@ -931,7 +1058,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -967,6 +1094,11 @@ public:
 		textures.prefilteredCube.descriptor.imageView = textures.prefilteredCube.view;
 		textures.prefilteredCube.descriptor.sampler = textures.prefilteredCube.sampler;
 		textures.prefilteredCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.prefilteredCube.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.prefilteredCube.width = dim;
+		textures.prefilteredCube.height = dim;
+		textures.prefilteredCube.mipLevels = numMips;
+		textures.prefilteredCube.layerCount = 6;
 		textures.prefilteredCube.device = vulkanDevice;
 
 		// FB, Att, RP, Pipe, etc.
@@ -1105,8 +1237,9 @@ public:
 		struct PushBlock {
 			glm::mat4 mvp;
 			float roughness;
-			uint32_t numSamples = 32u;
+			uint32_t numSamples;
 		} pushBlock;
+		pushBlock.numSamples = iblSettings.prefilteredSamples;
 
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -1318,6 +1451,9 @@ public:
 		VK_CHECK_RESULT(uniformBuffers.skybox.map());
 		VK_CHECK_RESULT(uniformBuffers.params.map());
 
+		// Spherical harmonics for diffuse irradiance, these don't change at runtime
+		VK_CHECK_RESULT(vks::sh::createUniformBuffer(vulkanDevice, &uniformBuffers.irradianceSH, irradianceSH));
+
 		updateUniformBuffers();
 		updateParams();
 	}
@@ -1385,9 +1521,13 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		generateBRDFLUT();
-		generateIrradianceCube();
-		generatePrefilteredCube();
+		// The spherical harmonics irradiance option is only implemented in the GLSL shaders, their SPIR-V is generated by the build (see GLSL_BUILD_SHADERS)
+		shIrradianceSupported = (shaderDir == "glsl");
+		shIrradiance = shIrradiance && shIrradianceSupported;
+		if (shIrradianceSupported) {
+			computeIrradianceSH();
+		}
+		prepareIBLTextures();
 		prepareUniformBuffers();
 		prepareInstanceBuffer();
 		setupDescriptors();
@@ -1424,6 +1564,16 @@ public:
 			if (overlay->checkBox("Skybox", &displaySkybox)) {
 				buildCommandBuffers();
 			}
+			if (shIrradianceSupported && overlay->checkBox("SH irradiance", &shIrradiance)) {
+				if (!shIrradiance && !irradianceCubePrepared) {
+					// Generate (or load) the irradiance cube on first use and replace the placeholder
+					vkDeviceWaitIdle(device);
+					prepareIrradianceCube();
+					VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.irradianceCube.descriptor);
+					vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+				}
+				buildCommandBuffers();
+			}
 		}
 	}
 };